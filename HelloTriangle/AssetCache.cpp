@@ -0,0 +1,206 @@
+#include "pch.h"
+#include "AssetCache.h"
+
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <climits>
+#include <unistd.h>
+#endif
+
+namespace dxh
+{
+	AssetCache::AssetCache(CachedImageDecoder decoder, size_t budgetBytes)
+		: decoder(decoder), budget(budgetBytes)
+	{
+	}
+
+	ImageHandle AssetCache::Get(const std::string& path, const ImageLoadOptions& options)
+	{
+		const std::string canonical = CanonicalPath(path);
+		const std::string key = canonical + "|" + options.Key();
+
+		std::promise<ImageHandle> promise;
+		std::unique_lock<std::mutex> lock(mutex);
+		auto found = entries.find(key);
+		if (found != entries.end())
+		{
+			++stats.hits;
+			lru.splice(lru.begin(), lru, found->second.lru);
+			return found->second.image;
+		}
+		auto pending = inFlight.find(key);
+		if (pending != inFlight.end())
+		{
+			++stats.coalesced;
+			std::shared_future<ImageHandle> result = pending->second.result;
+			lock.unlock();
+			return result.get();
+		}
+		++stats.misses;
+		const uint64_t generation = nextGeneration++;
+		inFlight.emplace(key, Pending{ promise.get_future().share(), generation });
+		lock.unlock();
+
+		// Decode outside the lock, other keys and hits are not blocked
+		std::shared_ptr<ImageData> decoded = std::make_shared<ImageData>();
+		ImageHandle image;
+		if (decoder(canonical, options, *decoded))
+			image = decoded;
+
+		lock.lock();
+		// A decode Invalidate detached read the old file, it is not cached and only its own waiters get it
+		pending = inFlight.find(key);
+		const bool current = pending != inFlight.end() && pending->second.generation == generation;
+		if (current)
+			inFlight.erase(pending);
+		if (image && current)
+		{
+			lru.push_front(key);
+			Entry entry;
+			entry.image = image;
+			entry.bytes = image->ByteSize();
+			entry.lru = lru.begin();
+			entries.emplace(key, entry);
+			stats.bytesResident += entry.bytes;
+			EvictLocked();
+		}
+		else if (!image)
+		{
+			++stats.failures;
+		}
+		lock.unlock();
+		promise.set_value(image);
+		return image;
+	}
+
+	bool AssetCache::Contains(const std::string& path, const ImageLoadOptions& options) const
+	{
+		const std::string key = CanonicalPath(path) + "|" + options.Key();
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.count(key) != 0;
+	}
+
+	size_t AssetCache::Invalidate(const std::string& path)
+	{
+		const std::string prefix = CanonicalPath(path) + "|";
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t count = 0;
+		for (auto it = entries.begin(); it != entries.end();)
+		{
+			if (it->first.compare(0, prefix.size(), prefix) != 0)
+			{
+				++it;
+				continue;
+			}
+			stats.bytesResident -= it->second.bytes;
+			lru.erase(it->second.lru);
+			it = entries.erase(it);
+			++count;
+		}
+		for (auto it = inFlight.begin(); it != inFlight.end();)
+		{
+			if (it->first.compare(0, prefix.size(), prefix) != 0)
+			{
+				++it;
+				continue;
+			}
+			it = inFlight.erase(it);
+		}
+		return count;
+	}
+
+	void AssetCache::SetBudget(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		budget = bytes;
+		EvictLocked();
+	}
+
+	size_t AssetCache::GetBudget() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return budget;
+	}
+
+	AssetCacheStats AssetCache::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		AssetCacheStats result = stats;
+		result.entries = entries.size();
+		return result;
+	}
+
+	void AssetCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.evictions += entries.size();
+		entries.clear();
+		lru.clear();
+		stats.bytesResident = 0;
+	}
+
+	void AssetCache::EvictLocked()
+	{
+		//oldest first, images someone still holds would not free anything and are skipped
+		auto it = lru.end();
+		while (stats.bytesResident > budget && it != lru.begin())
+		{
+			--it;
+			auto entry = entries.find(*it);
+			if (entry->second.image.use_count() > 1)
+				continue;
+			stats.bytesResident -= entry->second.bytes;
+			++stats.evictions;
+			entries.erase(entry);
+			it = lru.erase(it);
+		}
+	}
+
+	std::string AssetCache::CanonicalPath(const std::string& path)
+	{
+		std::string absolute = path;
+#if defined(_WIN32) || defined(_WIN64)
+		char buffer[MAX_PATH];
+		const DWORD length = GetFullPathNameA(path.c_str(), MAX_PATH, buffer, NULL);
+		if (length > 0 && length < MAX_PATH)
+			absolute.assign(buffer, length);
+		for (char& c : absolute)
+			c = c == '\\' ? '/' : static_cast<char>(tolower(static_cast<unsigned char>(c)));
+#else
+		if (!path.empty() && path[0] != '/')
+		{
+			char buffer[PATH_MAX];
+			if (getcwd(buffer, sizeof(buffer)))
+				absolute = std::string(buffer) + "/" + path;
+		}
+#endif
+		// Drop empty and "." parts, resolve ".." against the previous part
+		std::vector<std::string> parts;
+		size_t start = 0;
+		while (start <= absolute.size())
+		{
+			size_t end = absolute.find('/', start);
+			if (end == std::string::npos)
+				end = absolute.size();
+			const std::string part = absolute.substr(start, end - start);
+			if (part == "..")
+			{
+				if (!parts.empty())
+					parts.pop_back();
+			}
+			else if (!part.empty() && part != ".")
+			{
+				parts.push_back(part);
+			}
+			start = end + 1;
+		}
+
+		std::string result = absolute.size() > 0 && absolute[0] == '/' ? "/" : "";
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			if (i > 0)
+				result += '/';
+			result += parts[i];
+		}
+		return result;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//Everything besides the path that changes the decoded image, part of the cache key
+	struct ImageLoadOptions
+	{
+		int channels = 4;			//1 to 4, the loader converts to this
+		bool flipVertically = false;
+		std::string Key() const { return std::to_string(channels) + (flipVertically ? "f" : "-"); }
+	};
+
+	//decodes path into target, may be called from several threads at once
+	typedef std::function<bool(const std::string& path, const ImageLoadOptions& options, ImageData& target)> CachedImageDecoder;
+
+	//Shared, read only decoded image. The pixels live as long as any handle does,
+	//eviction only drops the cache's own reference.
+	typedef std::shared_ptr<const ImageData> ImageHandle;
+
+	struct AssetCacheStats
+	{
+		size_t hits = 0;
+		size_t misses = 0;			//requests that decoded
+		size_t coalesced = 0;		//requests that waited for a decode another thread had started
+		size_t failures = 0;
+		size_t evictions = 0;
+		size_t bytesResident = 0;	//decoded bytes the cache holds
+		size_t entries = 0;
+	};
+
+	//Decoded images keyed by canonical path + load options.
+	//Get decodes at most once per key even when called from several threads at the same time,
+	//the other callers wait for that decode (single flight). When the images held exceed the
+	//budget, least recently used images nobody else holds a handle to are dropped.
+	class AssetCache
+	{
+	public:
+		AssetCache(CachedImageDecoder decoder, size_t budgetBytes = 256 << 20);
+		~AssetCache() {}
+		AssetCache(const AssetCache&) = delete;
+		AssetCache& operator=(const AssetCache&) = delete;
+
+		//nullptr when decoding failed, failures are not cached
+		ImageHandle Get(const std::string& path, const ImageLoadOptions& options = ImageLoadOptions());
+		bool Contains(const std::string& path, const ImageLoadOptions& options = ImageLoadOptions()) const;
+		//drops every cached decode of path (all options) so the next Get reads the file again, returns how many
+		//cached images were dropped. Decodes still running are detached and not counted: their callers get
+		//the old image, later Gets decode again.
+		size_t Invalidate(const std::string& path);
+
+		void SetBudget(size_t bytes);
+		size_t GetBudget() const;
+		AssetCacheStats GetStats() const;
+		void Clear(); //drops every cached image, handles stay valid
+
+		//absolute, '/' separated path without "." and ".." parts, lower case on Windows
+		static std::string CanonicalPath(const std::string& path);
+
+	private:
+		struct Entry
+		{
+			ImageHandle image;
+			size_t bytes;
+			std::list<std::string>::iterator lru;
+		};
+		struct Pending
+		{
+			std::shared_future<ImageHandle> result;
+			uint64_t generation;	//tells a decode whether Invalidate replaced it while it ran
+		};
+
+		void EvictLocked();
+
+		CachedImageDecoder decoder;
+		size_t budget;
+		mutable std::mutex mutex;
+		std::unordered_map<std::string, Entry> entries;
+		std::unordered_map<std::string, Pending> inFlight;
+		uint64_t nextGeneration = 0;
+		std::list<std::string> lru; //front is the most recently used
+		AssetCacheStats stats;
+	};
+}
@@ -0,0 +1,706 @@
+#include "pch.h"
+#include "BlockCompression.h"
+
+#include "Utilities.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace
+{
+	using dxh::BlockFormat;
+	using dxh::CompressionQuality;
+
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	//the 16 texels of a block as float streams, r g b a
+	struct alignas(16) BlockPixels
+	{
+		float c[4][16];
+	};
+
+	void LoadBlock(const unsigned char* rgba, UINT width, UINT height, UINT pitch, UINT bx, UINT by, BlockPixels& px)
+	{
+		for (UINT y = 0; y < 4; ++y)
+		{
+			const unsigned char* row = rgba + size_t(std::min(by * 4 + y, height - 1)) * pitch;
+			for (UINT x = 0; x < 4; ++x)
+			{
+				const unsigned char* p = row + std::min(bx * 4 + x, width - 1) * 4;
+				for (int c = 0; c < 4; ++c)
+					px.c[c][y * 4 + x] = p[c];
+			}
+		}
+	}
+
+	// ************************************************************************************************
+	// FITTING
+	// ************************************************************************************************
+
+	//nearest palette entry for every texel over the first channels channels, returns the squared error
+	float SelectIndicesScalar(const BlockPixels& px, const float palette[][4], int count, int channels, unsigned char* indices)
+	{
+		float total = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = FLT_MAX;
+			for (int k = 0; k < count; ++k)
+			{
+				float d = 0.0f;
+				for (int c = 0; c < channels; ++c)
+				{
+					const float t = px.c[c][i] - palette[k][c];
+					d += t * t;
+				}
+				if (d < best)
+				{
+					best = d;
+					indices[i] = static_cast<unsigned char>(k);
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+#if DXH_X86
+	//four texels against one palette entry per step
+	DXH_TARGET_SSE float SelectIndicesSSE(const BlockPixels& px, const float palette[][4], int count, int channels, unsigned char* indices)
+	{
+		__m128 total = _mm_setzero_ps();
+		for (int g = 0; g < 16; g += 4)
+		{
+			__m128 ch[4];
+			for (int c = 0; c < channels; ++c)
+				ch[c] = _mm_load_ps(px.c[c] + g);
+
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			for (int k = 0; k < count; ++k)
+			{
+				__m128 d = _mm_setzero_ps();
+				for (int c = 0; c < channels; ++c)
+				{
+					const __m128 t = _mm_sub_ps(ch[c], _mm_set1_ps(palette[k][c]));
+					d = _mm_add_ps(d, _mm_mul_ps(t, t));
+				}
+				const __m128 closer = _mm_cmplt_ps(d, best);
+				best = _mm_min_ps(d, best);
+				bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(float(k))), _mm_andnot_ps(closer, bestIndex));
+			}
+			total = _mm_add_ps(total, best);
+
+			alignas(16) int idx[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(idx), _mm_cvttps_epi32(bestIndex));
+			for (int i = 0; i < 4; ++i)
+				indices[g + i] = static_cast<unsigned char>(idx[i]);
+		}
+		alignas(16) float sum[4];
+		_mm_store_ps(sum, total);
+		return sum[0] + sum[1] + sum[2] + sum[3];
+	}
+#endif
+
+	float SelectIndices(const BlockPixels& px, const float palette[][4], int count, int channels, unsigned char* indices)
+	{
+#if DXH_X86
+		static const bool sse = util::CpuHasSSE2();
+		if (sse)
+			return SelectIndicesSSE(px, palette, count, channels, indices);
+#endif
+		return SelectIndicesScalar(px, palette, count, channels, indices);
+	}
+
+	//Endpoints at the extremes of the texels along their principal axis (power iteration on the covariance)
+	void PrincipalEndpoints(const BlockPixels& px, int channels, float e0[4], float e1[4])
+	{
+		float mean[4] = {};
+		for (int c = 0; c < channels; ++c)
+		{
+			for (int i = 0; i < 16; ++i)
+				mean[c] += px.c[c][i];
+			mean[c] /= 16.0f;
+		}
+		float cov[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+			for (int a = 0; a < channels; ++a)
+				for (int b = a; b < channels; ++b)
+					cov[a][b] += (px.c[a][i] - mean[a]) * (px.c[b][i] - mean[b]);
+		for (int a = 0; a < channels; ++a)
+			for (int b = 0; b < a; ++b)
+				cov[a][b] = cov[b][a];
+
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (int a = 0; a < channels; ++a)
+			{
+				for (int b = 0; b < channels; ++b)
+					next[a] += cov[a][b] * axis[b];
+				length = std::max(length, std::fabs(next[a]));
+			}
+			if (length < 1e-6f)
+				break; //flat block, any axis works
+			for (int a = 0; a < channels; ++a)
+				axis[a] = next[a] / length;
+		}
+
+		float lo = FLT_MAX, hi = -FLT_MAX;
+		float axisLength = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			axisLength += axis[c] * axis[c];
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				t += (px.c[c][i] - mean[c]) * axis[c];
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+		for (int c = 0; c < channels; ++c)
+		{
+			e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * hi / axisLength));
+			e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lo / axisLength));
+		}
+	}
+
+	//Least squares endpoints for fixed indices, weights[i] is how much of e1 index i contains.
+	//Returns false when the indices can not determine both endpoints.
+	bool RefineEndpoints(const BlockPixels& px, int channels, const unsigned char* indices, const float* weights, float e0[4], float e1[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ap[4] = {}, bp[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			const float b = weights[indices[i]];
+			const float a = 1.0f - b;
+			aa += a * a, ab += a * b, bb += b * b;
+			for (int c = 0; c < channels; ++c)
+			{
+				ap[c] += a * px.c[c][i];
+				bp[c] += b * px.c[c][i];
+			}
+		}
+		const float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+			return false;
+		for (int c = 0; c < channels; ++c)
+		{
+			e0[c] = std::min(255.0f, std::max(0.0f, (ap[c] * bb - bp[c] * ab) / det));
+			e1[c] = std::min(255.0f, std::max(0.0f, (bp[c] * aa - ap[c] * ab) / det));
+		}
+		return true;
+	}
+
+	int Refinements(CompressionQuality quality)
+	{
+		return quality == CompressionQuality::Fast ? 0 : quality == CompressionQuality::Normal ? 1 : 4;
+	}
+
+	// ************************************************************************************************
+	// BC1 / BC3
+	// ************************************************************************************************
+
+	const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	uint16_t To565(const float c[4])
+	{
+		const int r = std::min(31, std::max(0, int(c[0] * 31.0f / 255.0f + 0.5f)));
+		const int g = std::min(63, std::max(0, int(c[1] * 63.0f / 255.0f + 0.5f)));
+		const int b = std::min(31, std::max(0, int(c[2] * 31.0f / 255.0f + 0.5f)));
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void From565(uint16_t v, int rgb[3])
+	{
+		const int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	//four color palette as the hardware decodes it
+	void BC1Palette(uint16_t c0, uint16_t c1, float palette[4][4])
+	{
+		int a[3], b[3];
+		From565(c0, a);
+		From565(c1, b);
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[0][c] = float(a[c]);
+			palette[1][c] = float(b[c]);
+			palette[2][c] = float((2 * a[c] + b[c]) / 3);
+			palette[3][c] = float((a[c] + 2 * b[c]) / 3);
+		}
+		for (int k = 0; k < 4; ++k)
+			palette[k][3] = 255.0f;
+	}
+
+	float EncodeColorEndpoints(const BlockPixels& px, const float e0[4], const float e1[4], uint16_t& c0, uint16_t& c1, unsigned char indices[16])
+	{
+		c0 = To565(e0);
+		c1 = To565(e1);
+		if (c0 < c1)
+			std::swap(c0, c1); //c0 > c1 selects the four color mode
+		float palette[4][4];
+		BC1Palette(c0, c1, palette);
+		if (c0 == c1)
+		{
+			memset(indices, 0, 16);
+			return SelectIndicesScalar(px, palette, 1, 3, indices);
+		}
+		return SelectIndices(px, palette, 4, 3, indices);
+	}
+
+	void EncodeBC1(const BlockPixels& px, CompressionQuality quality, unsigned char* block)
+	{
+		float e0[4], e1[4];
+		PrincipalEndpoints(px, 3, e0, e1);
+
+		uint16_t c0, c1;
+		unsigned char indices[16];
+		float error = EncodeColorEndpoints(px, e0, e1, c0, c1, indices);
+		for (int r = 0; r < Refinements(quality) && error > 0.0f; ++r)
+		{
+			if (!RefineEndpoints(px, 3, indices, BC1_WEIGHTS, e0, e1))
+				break;
+			uint16_t n0, n1;
+			unsigned char nextIndices[16];
+			const float next = EncodeColorEndpoints(px, e0, e1, n0, n1, nextIndices);
+			if (next >= error)
+				break;
+			error = next, c0 = n0, c1 = n1;
+			memcpy(indices, nextIndices, 16);
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= uint32_t(indices[i]) << (i * 2);
+		memcpy(block, &c0, 2);
+		memcpy(block + 2, &c1, 2);
+		memcpy(block + 4, &bits, 4);
+	}
+
+	//eight value alpha palette, a0 > a1
+	void AlphaPalette(int a0, int a1, float palette[8][4])
+	{
+		palette[0][0] = float(a0);
+		palette[1][0] = float(a1);
+		for (int i = 2; i < 8; ++i)
+			palette[i][0] = float(((8 - i) * a0 + (i - 1) * a1) / 7);
+	}
+
+	void EncodeAlpha(const BlockPixels& px, CompressionQuality quality, unsigned char* block)
+	{
+		BlockPixels alpha;
+		memcpy(alpha.c[0], px.c[3], sizeof(alpha.c[0]));
+		float lo = 255.0f, hi = 0.0f;
+		for (int i = 0; i < 16; ++i)
+			lo = std::min(lo, alpha.c[0][i]), hi = std::max(hi, alpha.c[0][i]);
+
+		int a0 = int(hi), a1 = int(lo);
+		unsigned char indices[16] = {};
+		if (a0 > a1)
+		{
+			float palette[8][4];
+			AlphaPalette(a0, a1, palette);
+			float error = SelectIndices(alpha, palette, 8, 1, indices);
+			//High also tries pulling the endpoints in by one step, the extremes are often outliers
+			if (quality == CompressionQuality::High)
+			{
+				for (int d0 = 0; d0 <= 2; ++d0)
+					for (int d1 = 0; d1 <= 2; ++d1)
+					{
+						const int t0 = a0 - d0, t1 = a1 + d1;
+						if ((d0 == 0 && d1 == 0) || t0 <= t1)
+							continue;
+						unsigned char next[16];
+						AlphaPalette(t0, t1, palette);
+						const float e = SelectIndices(alpha, palette, 8, 1, next);
+						if (e < error)
+						{
+							error = e;
+							memcpy(indices, next, 16);
+							a0 = t0, a1 = t1;
+						}
+					}
+			}
+		}
+		else
+		{
+			a0 = a1 = int(hi); //constant alpha, index 0 everywhere
+		}
+
+		block[0] = static_cast<unsigned char>(a0);
+		block[1] = static_cast<unsigned char>(a1);
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= uint64_t(indices[i]) << (i * 3);
+		for (int i = 0; i < 6; ++i)
+			block[2 + i] = static_cast<unsigned char>(bits >> (i * 8));
+	}
+
+	void EncodeBC3(const BlockPixels& px, CompressionQuality quality, unsigned char* block)
+	{
+		EncodeAlpha(px, quality, block);
+		EncodeBC1(px, quality, block + 8);
+	}
+
+	// ************************************************************************************************
+	// BC7 MODE 6
+	// ************************************************************************************************
+
+	//7 bit endpoint + shared p-bit per endpoint, 4 bit indices, one subset
+	struct BC7Endpoints
+	{
+		int q[2][4];	//7 bit values
+		int p[2];
+	};
+
+	void BC7Palette(const BC7Endpoints& e, float palette[16][4])
+	{
+		for (int k = 0; k < 16; ++k)
+			for (int c = 0; c < 4; ++c)
+			{
+				const int a = (e.q[0][c] << 1) | e.p[0];
+				const int b = (e.q[1][c] << 1) | e.p[1];
+				palette[k][c] = float(((64 - BC7_WEIGHTS[k]) * a + BC7_WEIGHTS[k] * b + 32) >> 6);
+			}
+	}
+
+	float QuantizeBC7(const BlockPixels& px, const float e0[4], const float e1[4], CompressionQuality quality, BC7Endpoints& out, unsigned char indices[16])
+	{
+		static const int PBITS[4][2] = { { 0, 0 }, { 1, 1 }, { 0, 1 }, { 1, 0 } };
+		const int combinations = quality == CompressionQuality::Fast ? 2 : 4;
+		float best = FLT_MAX;
+		for (int pc = 0; pc < combinations; ++pc)
+		{
+			BC7Endpoints e;
+			const float* src[2] = { e0, e1 };
+			for (int j = 0; j < 2; ++j)
+			{
+				e.p[j] = PBITS[pc][j];
+				for (int c = 0; c < 4; ++c)
+					e.q[j][c] = std::min(127, std::max(0, int((src[j][c] - e.p[j]) * 0.5f + 0.5f)));
+			}
+			float palette[16][4];
+			BC7Palette(e, palette);
+			unsigned char next[16];
+			const float error = SelectIndices(px, palette, 16, 4, next);
+			if (error < best)
+			{
+				best = error;
+				out = e;
+				memcpy(indices, next, 16);
+			}
+		}
+		return best;
+	}
+
+	void EncodeBC7(const BlockPixels& px, CompressionQuality quality, unsigned char* block)
+	{
+		float weights[16];
+		for (int k = 0; k < 16; ++k)
+			weights[k] = BC7_WEIGHTS[k] / 64.0f;
+
+		float e0[4], e1[4];
+		PrincipalEndpoints(px, 4, e0, e1);
+		BC7Endpoints endpoints;
+		unsigned char indices[16];
+		float error = QuantizeBC7(px, e0, e1, quality, endpoints, indices);
+		for (int r = 0; r < Refinements(quality) && error > 0.0f; ++r)
+		{
+			if (!RefineEndpoints(px, 4, indices, weights, e0, e1))
+				break;
+			BC7Endpoints next;
+			unsigned char nextIndices[16];
+			const float e = QuantizeBC7(px, e0, e1, quality, next, nextIndices);
+			if (e >= error)
+				break;
+			error = e, endpoints = next;
+			memcpy(indices, nextIndices, 16);
+		}
+
+		//the anchor texel stores its index with 3 bits, its top bit has to be 0
+		if (indices[0] & 8)
+		{
+			std::swap(endpoints.q[0], endpoints.q[1]);
+			std::swap(endpoints.p[0], endpoints.p[1]);
+			for (unsigned char& i : indices)
+				i = static_cast<unsigned char>(15 - i);
+		}
+
+		uint64_t bits[2] = { 0, 0 };
+		int pos = 0;
+		auto put = [&bits, &pos](uint64_t value, int count)
+		{
+			for (int i = 0; i < count; ++i, ++pos)
+				bits[pos >> 6] |= ((value >> i) & 1) << (pos & 63);
+		};
+		put(1 << 6, 7); //mode 6
+		for (int c = 0; c < 4; ++c)
+		{
+			put(endpoints.q[0][c], 7);
+			put(endpoints.q[1][c], 7);
+		}
+		put(endpoints.p[0], 1);
+		put(endpoints.p[1], 1);
+		put(indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			put(indices[i], 4);
+		memcpy(block, bits, 16);
+	}
+
+	// ************************************************************************************************
+	// DECODING
+	// ************************************************************************************************
+
+	void DecodeBC1(const unsigned char* block, unsigned char out[16][4], bool alwaysFourColors)
+	{
+		uint16_t c0, c1;
+		uint32_t bits;
+		memcpy(&c0, block, 2);
+		memcpy(&c1, block + 2, 2);
+		memcpy(&bits, block + 4, 4);
+		int a[3], b[3];
+		From565(c0, a);
+		From565(c1, b);
+		int palette[4][4];
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[0][c] = a[c];
+			palette[1][c] = b[c];
+			if (c0 > c1 || alwaysFourColors)
+			{
+				palette[2][c] = (2 * a[c] + b[c]) / 3;
+				palette[3][c] = (a[c] + 2 * b[c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (a[c] + b[c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		palette[3][3] = (c0 > c1 || alwaysFourColors) ? 255 : 0;
+		for (int i = 0; i < 16; ++i)
+			for (int c = 0; c < 4; ++c)
+				out[i][c] = static_cast<unsigned char>(palette[(bits >> (i * 2)) & 3][c]);
+	}
+
+	void DecodeAlpha(const unsigned char* block, unsigned char out[16][4])
+	{
+		const int a0 = block[0], a1 = block[1];
+		int palette[8] = { a0, a1 };
+		if (a0 > a1)
+		{
+			for (int i = 2; i < 8; ++i)
+				palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		}
+		else
+		{
+			for (int i = 2; i < 6; ++i)
+				palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= uint64_t(block[2 + i]) << (i * 8);
+		for (int i = 0; i < 16; ++i)
+			out[i][3] = static_cast<unsigned char>(palette[(bits >> (i * 3)) & 7]);
+	}
+
+	bool DecodeBC7(const unsigned char* block, unsigned char out[16][4])
+	{
+		uint64_t bits[2];
+		memcpy(bits, block, 16);
+		int pos = 0;
+		auto get = [&bits, &pos](int count)
+		{
+			int value = 0;
+			for (int i = 0; i < count; ++i, ++pos)
+				value |= int((bits[pos >> 6] >> (pos & 63)) & 1) << i;
+			return value;
+		};
+		if (get(7) != 1 << 6)
+		{
+			memset(out, 0, 16 * 4);
+			return false;
+		}
+		BC7Endpoints e;
+		for (int c = 0; c < 4; ++c)
+		{
+			e.q[0][c] = get(7);
+			e.q[1][c] = get(7);
+		}
+		e.p[0] = get(1);
+		e.p[1] = get(1);
+		float palette[16][4];
+		BC7Palette(e, palette);
+		for (int i = 0; i < 16; ++i)
+		{
+			const int index = get(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; ++c)
+				out[i][c] = static_cast<unsigned char>(palette[index][c]);
+		}
+		return true;
+	}
+
+	void CompressLevel(const unsigned char* rgba, UINT width, UINT height, BlockFormat format, CompressionQuality quality, UINT threads, unsigned char* out)
+	{
+		const UINT blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+		const UINT blockBytes = dxh::BlockBytes(format);
+		util::ParallelFor(blocksHigh, 1, [&](size_t begin, size_t end)
+			{
+				BlockPixels px;
+				for (size_t by = begin; by < end; ++by)
+					for (UINT bx = 0; bx < blocksWide; ++bx)
+					{
+						LoadBlock(rgba, width, height, width * 4, bx, static_cast<UINT>(by), px);
+						unsigned char* block = out + (by * blocksWide + bx) * blockBytes;
+						switch (format)
+						{
+						case BlockFormat::BC1: EncodeBC1(px, quality, block); break;
+						case BlockFormat::BC3: EncodeBC3(px, quality, block); break;
+						case BlockFormat::BC7: EncodeBC7(px, quality, block); break;
+						default: break;
+						}
+					}
+			}, threads);
+	}
+
+	//sizes every level of out, returns the total byte size
+	size_t LayoutLevels(dxh::CompressedImage& out, const std::vector<std::pair<UINT, UINT>>& sizes, BlockFormat format)
+	{
+		out.format = format;
+		out.levels.resize(sizes.size());
+		size_t size = 0;
+		for (size_t i = 0; i < sizes.size(); ++i)
+		{
+			dxh::CompressedLevel& level = out.levels[i];
+			level.width = sizes[i].first;
+			level.height = sizes[i].second;
+			level.rowPitch = (level.width + 3) / 4 * dxh::BlockBytes(format);
+			level.offset = size;
+			size += size_t(level.rowPitch) * ((level.height + 3) / 4);
+		}
+		out.data.resize(size);
+		return size;
+	}
+}
+
+namespace dxh
+{
+	UINT BlockBytes(BlockFormat format)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1: return 8;
+		case BlockFormat::BC3: return 16;
+		case BlockFormat::BC7: return 16;
+		default: return 0;
+		}
+	}
+
+	bool CompressImage(const ImageData& image, CompressedImage& out, BlockFormat format, CompressionQuality quality, UINT threads)
+	{
+		if (format == BlockFormat::None || image.channels != 4 || image.width <= 0 || image.height <= 0 ||
+			image.ByteSize() < size_t(image.width) * image.height * 4)
+		{
+			util::ErrorMessageBox("Block compression needs a non empty rgba image and a BC format.");
+			return false;
+		}
+		LayoutLevels(out, { { UINT(image.width), UINT(image.height) } }, format);
+		CompressLevel(image.Pixels(), image.width, image.height, format, quality, threads, out.data.data());
+		return true;
+	}
+
+	bool CompressMipChain(const MipChain& mips, CompressedImage& out, BlockFormat format, CompressionQuality quality, UINT threads)
+	{
+		if (format == BlockFormat::None || mips.channels != 4 || mips.levels.empty())
+		{
+			util::ErrorMessageBox("Block compression needs a non empty rgba mip chain and a BC format.");
+			return false;
+		}
+		std::vector<std::pair<UINT, UINT>> sizes;
+		for (const MipLevel& level : mips.levels)
+			sizes.push_back({ level.width, level.height });
+		LayoutLevels(out, sizes, format);
+		for (UINT i = 0; i < mips.LevelCount(); ++i)
+			CompressLevel(mips.LevelData(i), mips.levels[i].width, mips.levels[i].height, format, quality, threads, out.data.data() + out.levels[i].offset);
+		return true;
+	}
+
+	bool DecompressImage(const CompressedImage& image, ImageData& out, UINT level)
+	{
+		if (level >= image.LevelCount() || image.format == BlockFormat::None)
+			return false;
+		const CompressedLevel& l = image.levels[level];
+		out.width = l.width;
+		out.height = l.height;
+		out.channels = 4;
+		out.external.reset();
+		out.data.assign(size_t(l.width) * l.height * 4, 0);
+
+		const UINT blockBytes = BlockBytes(image.format);
+		bool valid = true;
+		for (UINT by = 0; by < (l.height + 3) / 4; ++by)
+			for (UINT bx = 0; bx < (l.width + 3) / 4; ++bx)
+			{
+				const unsigned char* block = image.LevelData(level) + size_t(by) * l.rowPitch + bx * blockBytes;
+				unsigned char texels[16][4];
+				switch (image.format)
+				{
+				case BlockFormat::BC1: DecodeBC1(block, texels, false); break;
+				case BlockFormat::BC3: DecodeBC1(block + 8, texels, true); DecodeAlpha(block, texels); break;
+				default: valid = DecodeBC7(block, texels) && valid; break;
+				}
+				for (UINT y = 0; y < 4 && by * 4 + y < l.height; ++y)
+					for (UINT x = 0; x < 4 && bx * 4 + x < l.width; ++x)
+						memcpy(&out.data[(size_t(by * 4 + y) * l.width + bx * 4 + x) * 4], texels[y * 4 + x], 4);
+			}
+		return valid;
+	}
+
+	float PSNR(const ImageData& a, const ImageData& b, bool alpha)
+	{
+		if (a.width != b.width || a.height != b.height || a.channels != b.channels || a.ByteSize() != b.ByteSize() || a.Empty())
+			return 0.0f;
+		const int first = alpha ? 3 : 0, last = alpha ? std::min(4, a.channels) : std::min(3, a.channels);
+		double sum = 0.0;
+		size_t count = 0;
+		const unsigned char* pa = a.Pixels();
+		const unsigned char* pb = b.Pixels();
+		for (size_t i = 0; i < a.ByteSize(); i += a.channels)
+			for (int c = first; c < last; ++c, ++count)
+			{
+				const double d = double(pa[i + c]) - double(pb[i + c]);
+				sum += d * d;
+			}
+		if (count == 0 || sum == 0.0)
+			return INFINITY;
+		return static_cast<float>(10.0 * std::log10(255.0 * 255.0 / (sum / count)));
+	}
+
+	BlockCompressionStats TestBlockCompression(const ImageData& image, BlockFormat format, CompressionQuality quality, UINT threads)
+	{
+		BlockCompressionStats stats;
+		stats.format = format;
+
+		CompressedImage compressed;
+		util::DeltaTimer timer;
+		if (!CompressImage(image, compressed, format, quality, threads))
+			return stats;
+		stats.seconds = timer.GetElapsed();
+		stats.megapixelsPerSecond = stats.seconds > 0.0f ? float(image.width) * image.height / 1e6f / stats.seconds : 0.0f;
+		stats.compressionRatio = float(image.ByteSize()) / float(compressed.data.size());
+
+		ImageData decoded;
+		DecompressImage(compressed, decoded);
+		stats.psnrRGB = PSNR(image, decoded, false);
+		stats.psnrAlpha = PSNR(image, decoded, true);
+		return stats;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+#include "MipChain.h"
+
+namespace dxh
+{
+	enum class BlockFormat
+	{
+		None,	//uncompressed rgba8
+		BC1,	//rgb, 8 bytes per 4x4 block
+		BC3,	//rgb + interpolated alpha, 16 bytes per block
+		BC7,	//rgba, 16 bytes per block, mode 6 only
+	};
+
+	enum class CompressionQuality
+	{
+		Fast,	//principal axis endpoints, no refinement
+		Normal,	//one least squares refinement of the endpoints
+		High,	//several refinements, every BC7 p-bit combination
+	};
+
+	struct CompressedLevel
+	{
+		UINT width;
+		UINT height;
+		UINT rowPitch;	//bytes per row of blocks, D3D11_SUBRESOURCE_DATA::SysMemPitch
+		size_t offset;	//from the start of CompressedImage::data
+	};
+
+	//Block compressed image, one or more mip levels in one allocation in D3D subresource order
+	class CompressedImage
+	{
+	public:
+		BlockFormat format = BlockFormat::None;
+		std::vector<CompressedLevel> levels;
+		std::vector<unsigned char> data;
+
+		UINT LevelCount() const { return static_cast<UINT>(levels.size()); }
+		const unsigned char* LevelData(UINT level) const { return data.data() + levels[level].offset; }
+	};
+
+	UINT BlockBytes(BlockFormat format);
+
+	//Compresses an rgba image (channels == 4). Partial blocks at the right and bottom edge repeat the
+	//last row/column. Blocks are spread over threads, 0 uses every hardware thread.
+	bool CompressImage(const ImageData& image, CompressedImage& out, BlockFormat format, CompressionQuality quality = CompressionQuality::Normal, UINT threads = 0);
+	bool CompressMipChain(const MipChain& mips, CompressedImage& out, BlockFormat format, CompressionQuality quality = CompressionQuality::Normal, UINT threads = 0);
+	//Decodes one level back to rgba. BC7 blocks in a mode other than 6 decode to zero and make it return false.
+	bool DecompressImage(const CompressedImage& image, ImageData& out, UINT level = 0);
+
+	//peak signal to noise ratio in dB over rgb or alpha, infinite for identical images
+	float PSNR(const ImageData& a, const ImageData& b, bool alpha = false);
+
+	struct BlockCompressionStats
+	{
+		BlockFormat format = BlockFormat::None;
+		float seconds = 0.0f;				//encoding only
+		float megapixelsPerSecond = 0.0f;
+		float compressionRatio = 0.0f;		//rgba8 bytes / compressed bytes
+		float psnrRGB = 0.0f;
+		float psnrAlpha = 0.0f;
+	};
+	//round trip of image through the encoder and decoder
+	BlockCompressionStats TestBlockCompression(const ImageData& image, BlockFormat format, CompressionQuality quality = CompressionQuality::Normal, UINT threads = 0);
+}
@@ -0,0 +1,168 @@
+#include "pch.h"
+#include "BufferUploads.h"
+
+#include "Utilities.h"
+
+namespace dxh
+{
+	BlockId UploadTracker::Add(size_t bytes, UploadMode mode, const void* initial)
+	{
+		Block block;
+		block.data.resize(bytes);
+		if (initial)
+			memcpy(block.data.data(), initial, bytes);
+		block.mode = mode;
+		blocks.push_back(std::move(block));
+		const BlockId id = static_cast<BlockId>(blocks.size() - 1);
+		MarkDirty(id); //the GPU buffer has never seen it
+		return id;
+	}
+
+	bool UploadTracker::Write(BlockId id, const void* data, size_t bytes, size_t offset)
+	{
+		Block& block = blocks[id];
+		if (offset + bytes > block.data.size())
+			return false;
+		const unsigned char* src = static_cast<const unsigned char*>(data);
+		unsigned char* dst = block.data.data() + offset;
+
+		if (memcmp(src, dst, bytes) == 0) //the common case, let the library compare wide
+		{
+			++stats.unchangedWrites;
+			return false;
+		}
+		// Narrow the write down to the bytes that differ
+		size_t first = 0, last = bytes;
+		while (src[first] == dst[first])
+			++first;
+		while (last > first && src[last - 1] == dst[last - 1])
+			--last;
+
+		memcpy(dst + first, src + first, last - first);
+		++block.version;
+		MarkRange(block, offset + first, offset + last);
+		return true;
+	}
+
+	void UploadTracker::MarkRange(Block& block, size_t begin, size_t end)
+	{
+		if (block.dirty.empty())
+			dirtyBlocks.push_back(static_cast<BlockId>(&block - blocks.data()));
+		if (block.mode == UploadMode::Whole)
+		{
+			block.dirty.assign(1, { 0, block.data.size() });
+			return;
+		}
+
+		// Insert sorted, then swallow every range it touches or comes within MERGE_GAP of
+		std::vector<Range>& ranges = block.dirty;
+		auto it = std::lower_bound(ranges.begin(), ranges.end(), begin, [](const Range& r, size_t b) { return r.end + MERGE_GAP < b; });
+		Range merged = { begin, end };
+		auto last = it;
+		while (last != ranges.end() && last->begin <= merged.end + MERGE_GAP)
+		{
+			merged.begin = std::min(merged.begin, last->begin);
+			merged.end = std::max(merged.end, last->end);
+			++last;
+		}
+		it = ranges.erase(it, last);
+		ranges.insert(it, merged);
+
+		if (ranges.size() > MAX_RANGES)
+		{
+			// Too many separate uploads, close the smallest gap
+			size_t closest = 0;
+			for (size_t i = 1; i + 1 < ranges.size(); ++i)
+				if (ranges[i + 1].begin - ranges[i].end < ranges[closest + 1].begin - ranges[closest].end)
+					closest = i;
+			ranges[closest].end = ranges[closest + 1].end;
+			ranges.erase(ranges.begin() + closest + 1);
+		}
+	}
+
+	size_t UploadTracker::Flush(UploadDevice& device)
+	{
+		size_t bytes = 0, uploads = 0;
+		size_t kept = 0;
+		for (BlockId id : dirtyBlocks)
+		{
+			Block& block = blocks[id];
+			size_t failed = 0;
+			for (const Range& range : block.dirty)
+			{
+				if (!device.UploadBlock(id, block.data.data(), range.begin, range.end - range.begin))
+				{
+					block.dirty[failed++] = range; //still sorted, tried again next frame
+					continue;
+				}
+				bytes += range.end - range.begin;
+				++uploads;
+			}
+			block.dirty.resize(failed);
+			if (failed > 0)
+				dirtyBlocks[kept++] = id;
+		}
+		dirtyBlocks.resize(kept);
+
+		++stats.frames;
+		stats.lastFrameBytes = bytes;
+		stats.lastFrameUploads = uploads;
+		stats.totalBytes += bytes;
+		return bytes;
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	UploadBenchmark BenchmarkUploads(size_t objects, float movingFraction, size_t frames)
+	{
+		const size_t WVP_BYTES = sizeof(WVP);
+		const size_t MATERIAL_BYTES = sizeof(SimpleMaterial);
+		const size_t LIGHT_BYTES = sizeof(SimpleLight);
+		const size_t VERTEX_BYTES = 4 * sizeof(Vertex); //a quad per object
+		UploadBenchmark result;
+		result.objects = objects;
+		result.moving = static_cast<size_t>(objects * movingFraction);
+		// What Render did per object: map the matrices, the material and the vertices, plus the light once
+		result.naiveBytesPerFrame = objects * (WVP_BYTES + MATERIAL_BYTES + VERTEX_BYTES) + LIGHT_BYTES;
+
+		// Tracked: the same blocks, vertices live in immutable buffers and are never written again
+		UploadTracker tracker;
+		std::vector<BlockId> matrices(objects), materials(objects);
+		for (size_t i = 0; i < objects; ++i)
+		{
+			matrices[i] = tracker.Add(WVP_BYTES, UploadMode::Whole);
+			materials[i] = tracker.Add(MATERIAL_BYTES, UploadMode::Whole);
+		}
+		const BlockId light = tracker.Add(LIGHT_BYTES, UploadMode::Whole);
+
+		NullUploadDevice device;
+		tracker.Flush(device); //the first frame uploads everything
+
+		WVP wvp;
+		memset(&wvp, 0, sizeof(wvp));
+		SimpleMaterial material;
+		SimpleLight lightData;
+		size_t bytes = 0, uploads = 0;
+		const size_t spacing = result.moving > 0 ? objects / result.moving : 0;
+		util::DeltaTimer timer;
+		for (size_t frame = 1; frame <= frames; ++frame)
+		{
+			// Every block is written every frame like before, only the movers bring new data
+			for (size_t i = 0; i < objects; ++i)
+			{
+				wvp.world._41 = spacing > 0 && i % spacing == 0 ? static_cast<float>(frame) : 0.0f;
+				tracker.Set(matrices[i], wvp);
+				tracker.Set(materials[i], material);
+			}
+			tracker.Set(light, lightData);
+			bytes += tracker.Flush(device);
+			uploads += tracker.GetStats().lastFrameUploads;
+		}
+		result.trackedMsPerFrame = timer.GetElapsed() * 1000.0f / frames;
+		result.trackedBytesPerFrame = bytes / frames;
+		result.trackedUploadsPerFrame = uploads / frames;
+		return result;
+	}
+}
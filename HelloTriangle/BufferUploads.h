@@ -0,0 +1,117 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	typedef UINT BlockId;
+
+	enum class UploadMode
+	{
+		Whole,	//the whole block goes up when anything changed, constant buffers are mapped with WRITE_DISCARD
+		Ranges,	//only the changed byte ranges go up (UpdateSubresource with a box)
+	};
+
+	//Receives the uploads of an UploadTracker. DXHandler writes into its buffers,
+	//NullUploadDevice only records, so the tracking can be tested without a GPU.
+	class UploadDevice
+	{
+	public:
+		virtual ~UploadDevice() {}
+		//data points at the whole block, offset and bytes are the part to upload
+		virtual bool UploadBlock(BlockId block, const void* data, size_t offset, size_t bytes) = 0;
+	};
+
+	class NullUploadDevice : public UploadDevice
+	{
+	public:
+		struct Write
+		{
+			BlockId block;
+			size_t offset;
+			size_t bytes;
+		};
+
+		bool UploadBlock(BlockId block, const void*, size_t offset, size_t bytes) override
+		{
+			if (fail)
+				return false;
+			writes.push_back({ block, offset, bytes });
+			this->bytes += bytes;
+			return true;
+		}
+		void Reset() { writes.clear(); bytes = 0; }
+
+		std::vector<Write> writes;
+		size_t bytes = 0;
+		bool fail = false;	//every upload fails, like a lost device
+	};
+
+	struct UploadStats
+	{
+		size_t frames = 0;			//calls to Flush
+		size_t lastFrameBytes = 0;
+		size_t lastFrameUploads = 0;
+		size_t totalBytes = 0;
+		size_t unchangedWrites = 0;	//writes of data that was already there, nothing was marked
+	};
+
+	//CPU side copies of GPU buffers. Writes are compared with the copy, changed bytes bump the block's
+	//version and mark a dirty range, Flush hands the dirty parts to the device once per frame.
+	class UploadTracker
+	{
+	public:
+		static const size_t MAX_RANGES = 16;	//past this the two dirty ranges closest to each other are merged
+		static const size_t MERGE_GAP = 256;	//ranges closer than this are uploaded as one
+
+		BlockId Add(size_t bytes, UploadMode mode, const void* initial = nullptr); //starts dirty
+		//copies bytes of data to offset, returns false when nothing changed
+		bool Write(BlockId block, const void* data, size_t bytes, size_t offset = 0);
+		template<typename T>
+		bool Set(BlockId block, const T& value) { return Write(block, &value, sizeof(T)); }
+		void MarkDirty(BlockId block) { MarkRange(blocks[block], 0, blocks[block].data.size()); }
+
+		//uploads every dirty range, returns the bytes uploaded. Ranges the device failed on stay dirty for the next Flush.
+		size_t Flush(UploadDevice& device);
+
+		const void* Data(BlockId block) const { return blocks[block].data.data(); }
+		size_t Size(BlockId block) const { return blocks[block].data.size(); }
+		uint64_t Version(BlockId block) const { return blocks[block].version; }
+		bool Dirty(BlockId block) const { return !blocks[block].dirty.empty(); }
+		size_t BlockCount() const { return blocks.size(); }
+		const UploadStats& GetStats() const { return stats; }
+
+	private:
+		struct Range
+		{
+			size_t begin, end;
+		};
+		struct Block
+		{
+			std::vector<unsigned char> data;
+			UploadMode mode;
+			uint64_t version = 0;
+			std::vector<Range> dirty; //sorted, not overlapping
+		};
+
+		void MarkRange(Block& block, size_t begin, size_t end);
+
+		std::vector<Block> blocks;
+		std::vector<BlockId> dirtyBlocks;
+		UploadStats stats;
+	};
+
+	//Bytes per frame for objects that each own matrices, a material and a quad, when everything is mapped every
+	//frame (what Render did) versus tracked blocks with the quads in immutable buffers.
+	struct UploadBenchmark
+	{
+		size_t objects = 0;
+		size_t moving = 0;
+		size_t naiveBytesPerFrame = 0;
+		size_t trackedBytesPerFrame = 0;
+		size_t trackedUploadsPerFrame = 0;
+		float trackedMsPerFrame = 0.0f;	//CPU time of the writes and the flush
+	};
+	UploadBenchmark BenchmarkUploads(size_t objects = 10000, float movingFraction = 0.05f, size_t frames = 60);
+}
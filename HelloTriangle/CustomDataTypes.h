@@ -17,8 +17,8 @@ namespace dxh
 		Float2& operator=(const Float2& param) { x = param.x, y = param.y; return *this; }
 		Float2(const float& _x, const float& _y)noexcept { x = _x, y = _y; }
 		constexpr float operator[](const size_t _i) { if (_i == 0) return x; return y; }
-		bool operator==(const Float2& comp) { return (this->x == comp.x && this->y == comp.y); }
-		bool operator!=(const Float2& comp) { return !Float2::operator==(comp); }
+		bool operator==(const Float2& comp)const { return (this->x == comp.x && this->y == comp.y); }
+		bool operator!=(const Float2& comp)const { return !Float2::operator==(comp); }
 		Float2 operator+(const Float2& right)const { return Float2(this->x + right.x, this->y + right.y); }
 		Float2 operator-(const Float2& right)const { return Float2(this->x - right.x, this->y - right.y); }
 		friend std::ostream& operator<<(std::ostream& os, const Float2& obj)
@@ -40,8 +40,8 @@ namespace dxh
 		Float3(float _x, float _y, float _z)noexcept { x = _x, y = _y, z = _z; }
 		const float& operator[](const size_t _i)const { if (_i == 0) return x; if (_i == 1)return y; return z; }
 		constexpr float operator[](const size_t _i) { if (_i == 0) return x; if (_i == 1)return y; return z; }
-		bool operator==(const Float3& comp) { return (this->x == comp.x && this->y == comp.y && this->z == comp.z); }
-		bool operator!=(const Float3& comp) { return !Float3::operator==(comp); }
+		bool operator==(const Float3& comp)const { return (this->x == comp.x && this->y == comp.y && this->z == comp.z); }
+		bool operator!=(const Float3& comp)const { return !Float3::operator==(comp); }
 		Float3 operator+(const Float3& right)const { return Float3(this->x + right.x, this->y + right.y, this->z + right.z); }
 		Float3 operator-(const Float3& right)const { return Float3(this->x - right.x, this->y - right.y, this->z - right.z); }
 		Float3 operator*(const float& right)const { return Float3(x * right, y * right, z * right); }
@@ -84,8 +84,8 @@ namespace dxh
 		Vertex(const float3& _pos, const float3& _normal, const float2& _uv)
 			: pos(_pos), uv(_uv), normal(_normal) {}
 		Vertex& operator=(const Vertex& copy) { if (this != &copy) { pos = copy.pos; normal = copy.normal; uv = copy.uv; } return *this; }
-		bool operator==(const Vertex& comp) { return (this->pos == comp.pos && pos == comp.pos && uv == comp.uv); }
-		bool operator!=(const Vertex& comp) { return !(this == &comp); }
+		bool operator==(const Vertex& comp)const { return (pos == comp.pos && uv == comp.uv && normal == comp.normal); }
+		bool operator!=(const Vertex& comp)const { return !Vertex::operator==(comp); }
 	}vertex;
 	//VECTOR FORMULAS ====================================================================================================================
 	inline
@@ -95,6 +95,16 @@ namespace dxh
 			_AB.x * _AC.z - _AB.z * _AC.x,
 			_AB.x * _AC.y - _AB.y * _AC.x);
 	}
+	//BOUNDS ============================================================================================================================
+	//Axis aligned box and bounding sphere of a set of positions, an empty set has a negative radius
+	struct Bounds
+	{
+		float3 min = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+		float3 max = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		float3 center;			//of the box, the sphere shares it
+		float radius = -1.0f;	//farthest position from center
+		bool Empty() const { return radius < 0.0f; }
+	};
 	//MESH ==============================================================================================================================
 	class Mesh
 	{
@@ -102,11 +112,12 @@ namespace dxh
 		std::string name;
 		std::vector<dxh::Vertex> vertices;
 		std::vector<UINT> indices;
+		Bounds bounds; //of the vertex positions, whatever builds or edits the mesh calls UpdateBounds
 		Mesh() { name = "unnamed"; }
 		Mesh(std::vector<dxh::Vertex> _vtxs, std::vector<UINT> _indices, std::string _name = "unnamed")
-			: vertices(_vtxs), indices(_indices), name(_name) {}
+			: vertices(_vtxs), indices(_indices), name(_name) { UpdateBounds(); }
 
-		Mesh(const Mesh& copy) :name(copy.name), vertices(copy.vertices), indices(copy.indices) { }
+		Mesh(const Mesh& copy) :name(copy.name), vertices(copy.vertices), indices(copy.indices), bounds(copy.bounds) { }
 		~Mesh() {}
 		const std::vector<dxh::Vertex>& GetVertices() {
 			return vertices;
@@ -116,23 +127,45 @@ namespace dxh
 				name = right.name;
 				vertices = right.vertices;
 				indices = right.indices;
+				bounds = right.bounds;
 			}
 			return *this;
 		}
+		void UpdateBounds()
+		{
+			bounds = Bounds();
+			if (vertices.empty())
+				return;
+			for (const Vertex& v : vertices)
+			{
+				bounds.min = float3(std::min(bounds.min.x, v.pos.x), std::min(bounds.min.y, v.pos.y), std::min(bounds.min.z, v.pos.z));
+				bounds.max = float3(std::max(bounds.max.x, v.pos.x), std::max(bounds.max.y, v.pos.y), std::max(bounds.max.z, v.pos.z));
+			}
+			bounds.center = (bounds.min + bounds.max) * 0.5f;
+			float r2 = 0.0f;
+			for (const Vertex& v : vertices)
+			{
+				const float3 d = v.pos - bounds.center;
+				r2 = std::max(r2, d.x * d.x + d.y * d.y + d.z * d.z);
+			}
+			bounds.radius = std::sqrt(r2);
+		}
 		const std::size_t ByteWidth() const { return sizeof(Vertex) * this->vertices.size(); } //returns the size of the vertex array in bytes for 
+		const bool ShortIndices() const { return vertices.size() < 65536; } //every index fits in 16 bits, upload as DXGI_FORMAT_R16_UINT
+		const std::size_t IndexByteWidth() const { return indices.size() * (ShortIndices() ? sizeof(uint16_t) : sizeof(UINT)); } //size of the uploaded index buffer
 	};
 
 	//CONSTANT BUFFER OBJECT TYPES============================================================================================================
-	_declspec(align(16))
-		struct WVP
+	struct alignas(16) WVP
 	{
 		DirectX::XMFLOAT4X4 world;
 		DirectX::XMFLOAT4X4 view;
 		DirectX::XMFLOAT4X4 project;
+		DirectX::XMFLOAT4X4 wvp;	//project * view * world, see UpdateObjectMatrices
+		DirectX::XMFLOAT4X4 normal;	//inverse transpose of world
 	};
 
-	_declspec(align(16))
-		struct SimpleLight
+	struct alignas(16) SimpleLight
 	{
 		float4 pos;
 		float4 color;
@@ -142,8 +175,7 @@ namespace dxh
 		SimpleLight() { filler = 0.0f; }
 	};
 
-	_declspec(align(16))
-		struct SimpleMaterial
+	struct alignas(16) SimpleMaterial
 	{
 		float4 ambi_col;
 		float4 diff_col;
@@ -153,13 +185,34 @@ namespace dxh
 		SimpleMaterial() :spec_factor(0.0f) {}
 	};
 	//For loading with stbi_load
+	//Pixels either live in data or, without a copy, in a buffer owned elsewhere (Adopt/Borrow).
+	//Readers go through Pixels() and ByteSize() so they work with both.
 	struct ImageData
 	{
 		int width;
 		int height;
 		int channels; //max 4, rgba
 		std::vector<unsigned char> data;
+		std::shared_ptr<unsigned char> external; //set when the pixels are not in data
 		ImageData(int _width = 0, int _height = 0, int _channels = 3) : width(_width), height(_height), channels(_channels) {};
-		~ImageData() {};
+
+		const unsigned char* Pixels() const { return external ? external.get() : data.data(); }
+		unsigned char* Pixels() { return external ? external.get() : data.data(); }
+		size_t ByteSize() const { return external ? size_t(width) * height * channels : data.size(); }
+		bool Empty() const { return ByteSize() == 0 || Pixels() == nullptr; }
+		//takes ownership of pixels, release frees them once the last copy of the image is gone
+		template<typename Release>
+		void Adopt(unsigned char* pixels, int _width, int _height, int _channels, Release release)
+		{
+			width = _width, height = _height, channels = _channels;
+			data.clear();
+			data.shrink_to_fit();
+			external.reset(pixels, release);
+		}
+		//points at pixels owned by the caller, they have to outlive the image
+		void Borrow(unsigned char* pixels, int _width, int _height, int _channels)
+		{
+			Adopt(pixels, _width, _height, _channels, [](unsigned char*) {});
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include "pch.h"
+#include "FrustumCulling.h"
+
+#include "Parallel.h"
+#include "Utilities.h"
+
+namespace
+{
+	//the objects from first on, count of them
+	dxh::CullStreams Slice(const dxh::CullStreams& in, size_t first, size_t count)
+	{
+		dxh::CullStreams slice = in;
+		for (int c = 0; c < 3; ++c)
+		{
+			slice.center[c] += first;
+			slice.extent[c] += first;
+		}
+		slice.radius += first;
+		slice.count = count;
+		return slice;
+	}
+
+	//plane normal with its absolute values, for the projected half size of a box
+	struct CullPlane
+	{
+		float a, b, c, d;
+		float absA, absB, absC;
+	};
+
+	void CullPlanes(const dxh::Frustum& frustum, CullPlane planes[6])
+	{
+		for (int p = 0; p < 6; ++p)
+		{
+			const float* f = frustum.planes[p];
+			planes[p] = { f[0], f[1], f[2], f[3], std::fabs(f[0]), std::fabs(f[1]), std::fabs(f[2]) };
+		}
+	}
+
+#if DXH_X86
+	// **********************************************************************************************************
+	// SSE
+	// **********************************************************************************************************
+
+	// Every kernel does the same multiplies and adds in the same order (no fma), so they agree on
+	// objects that touch a plane.
+	DXH_TARGET_SSE size_t CullSSEBody(const CullPlane planes[6], const dxh::CullStreams& in, UINT first, UINT* visible, size_t count)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		size_t n = 0;
+		for (size_t i = 0; i < count; i += 4)
+		{
+			const __m128 cx = _mm_loadu_ps(in.center[0] + i);
+			const __m128 cy = _mm_loadu_ps(in.center[1] + i);
+			const __m128 cz = _mm_loadu_ps(in.center[2] + i);
+			const __m128 ex = _mm_loadu_ps(in.extent[0] + i);
+			const __m128 ey = _mm_loadu_ps(in.extent[1] + i);
+			const __m128 ez = _mm_loadu_ps(in.extent[2] + i);
+			const __m128 radius = _mm_loadu_ps(in.radius + i);
+			__m128 outside = zero;
+			for (int p = 0; p < 6; ++p)
+			{
+				const CullPlane& pl = planes[p];
+				const __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(cx, _mm_set1_ps(pl.a)), _mm_mul_ps(cy, _mm_set1_ps(pl.b))), _mm_mul_ps(cz, _mm_set1_ps(pl.c))), _mm_set1_ps(pl.d));
+				const __m128 box = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(ex, _mm_set1_ps(pl.absA)), _mm_mul_ps(ey, _mm_set1_ps(pl.absB))), _mm_mul_ps(ez, _mm_set1_ps(pl.absC)));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, _mm_min_ps(box, radius)), zero));
+			}
+			// Branchless compaction, every lane is written and only the visible ones advance n
+			const int mask = ~_mm_movemask_ps(outside);
+			const UINT index = first + static_cast<UINT>(i);
+			visible[n] = index + 0; n += mask & 1;
+			visible[n] = index + 1; n += (mask >> 1) & 1;
+			visible[n] = index + 2; n += (mask >> 2) & 1;
+			visible[n] = index + 3; n += (mask >> 3) & 1;
+		}
+		return n;
+	}
+
+	// **********************************************************************************************************
+	// AVX2
+	// **********************************************************************************************************
+
+	//For every 8 bit visibility mask the lanes to keep moved to the front, one byte each, and how many there are
+	struct PackTable
+	{
+		uint64_t order[256];
+		unsigned char count[256];
+		PackTable()
+		{
+			for (int mask = 0; mask < 256; ++mask)
+			{
+				uint64_t lanes = 0;
+				int n = 0;
+				for (int lane = 0; lane < 8; ++lane)
+					if (mask & (1 << lane))
+						lanes |= uint64_t(lane) << (8 * n++);
+				order[mask] = lanes;
+				count[mask] = static_cast<unsigned char>(n);
+			}
+		}
+	};
+
+	DXH_TARGET_AVX2 size_t CullAVX2Body(const CullPlane planes[6], const dxh::CullStreams& in, UINT first, UINT* visible, size_t count)
+	{
+		static const PackTable pack;
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		size_t n = 0;
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __m256 cx = _mm256_loadu_ps(in.center[0] + i);
+			const __m256 cy = _mm256_loadu_ps(in.center[1] + i);
+			const __m256 cz = _mm256_loadu_ps(in.center[2] + i);
+			const __m256 ex = _mm256_loadu_ps(in.extent[0] + i);
+			const __m256 ey = _mm256_loadu_ps(in.extent[1] + i);
+			const __m256 ez = _mm256_loadu_ps(in.extent[2] + i);
+			const __m256 radius = _mm256_loadu_ps(in.radius + i);
+			__m256 outside = zero;
+			for (int p = 0; p < 6; ++p)
+			{
+				const CullPlane& pl = planes[p];
+				const __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(cx, _mm256_set1_ps(pl.a)), _mm256_mul_ps(cy, _mm256_set1_ps(pl.b))), _mm256_mul_ps(cz, _mm256_set1_ps(pl.c))), _mm256_set1_ps(pl.d));
+				const __m256 box = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(ex, _mm256_set1_ps(pl.absA)), _mm256_mul_ps(ey, _mm256_set1_ps(pl.absB))), _mm256_mul_ps(ez, _mm256_set1_ps(pl.absC)));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, _mm256_min_ps(box, radius)), zero, _CMP_LT_OQ));
+			}
+			// Left pack the indices of the visible lanes, all 8 are stored but n only moves past the kept ones.
+			// n <= i, so the store stays inside the first count entries of visible.
+			const int mask = ~_mm256_movemask_ps(outside) & 0xff;
+			const __m256i order = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&pack.order[mask])));
+			const __m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first + i)), lanes);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(visible + n), _mm256_permutevar8x32_epi32(index, order));
+			n += pack.count[mask];
+		}
+		return n;
+	}
+#endif
+}
+
+namespace dxh
+{
+	Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& m)
+	{
+		// Clip coordinates are the rows of m times the position, so every plane is a sum of two rows
+		const float* r0 = &m._11;
+		const float* r1 = &m._21;
+		const float* r2 = &m._31;
+		const float* r3 = &m._41;
+		Frustum frustum;
+		for (int c = 0; c < 4; ++c)
+		{
+			frustum.planes[0][c] = r3[c] + r0[c];	//left,   -w <= x
+			frustum.planes[1][c] = r3[c] - r0[c];	//right,   x <= w
+			frustum.planes[2][c] = r3[c] + r1[c];	//bottom, -w <= y
+			frustum.planes[3][c] = r3[c] - r1[c];	//top,     y <= w
+			frustum.planes[4][c] = r2[c];			//near,    0 <= z
+			frustum.planes[5][c] = r3[c] - r2[c];	//far,     z <= w
+		}
+		for (int p = 0; p < 6; ++p)
+		{
+			float* plane = frustum.planes[p];
+			const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if (length > 0.0f)
+				for (int c = 0; c < 4; ++c)
+					plane[c] /= length;
+		}
+		return frustum;
+	}
+
+	bool IsVisible(const Frustum& frustum, const Bounds& bounds)
+	{
+		if (bounds.Empty())
+			return false;
+		const float3 extent = (bounds.max - bounds.min) * 0.5f;
+		const float* c = &bounds.center.x;
+		const float* e = &extent.x;
+		CullStreams single = { { c, c + 1, c + 2 }, { e, e + 1, e + 2 }, &bounds.radius, 1 };
+		UINT index;
+		return CullScalar(frustum, single, 0, &index) == 1;
+	}
+
+	// **********************************************************************************************************
+	// BOUNDS LIST
+	// **********************************************************************************************************
+
+	void BoundsList::Add(const Bounds& bounds)
+	{
+		Resize(Count() + 1);
+		Set(Count() - 1, bounds);
+	}
+
+	void BoundsList::Set(size_t i, const Bounds& bounds)
+	{
+		const float3 half = (bounds.max - bounds.min) * 0.5f;
+		for (int c = 0; c < 3; ++c)
+		{
+			center[c][i] = bounds.center[c];
+			extent[c][i] = half[c];
+		}
+		radius[i] = bounds.radius;
+	}
+
+	void BoundsList::Resize(size_t count)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			center[c].resize(count);
+			extent[c].resize(count);
+		}
+		radius.resize(count);
+	}
+
+	CullStreams BoundsList::Streams() const
+	{
+		CullStreams streams;
+		for (int c = 0; c < 3; ++c)
+		{
+			streams.center[c] = center[c].data();
+			streams.extent[c] = extent[c].data();
+		}
+		streams.radius = radius.data();
+		streams.count = Count();
+		return streams;
+	}
+
+	void TransformBounds(const Bounds& local, const void* worlds, size_t stride, size_t count, BoundsList& out, unsigned int threads)
+	{
+		out.Resize(count);
+		if (local.Empty())
+		{
+			// Nothing to see, a negative radius culls every copy
+			for (size_t i = 0; i < count; ++i)
+				out.Set(i, local);
+			return;
+		}
+		const float3 c = local.center;
+		const float3 e = (local.max - local.min) * 0.5f;
+		util::ParallelFor(count, CULL_GRAIN, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					const float* m = reinterpret_cast<const float*>(static_cast<const char*>(worlds) + i * stride);
+					Bounds world;
+					float scale2 = 0.0f;
+					for (int r = 0; r < 3; ++r)
+					{
+						const float* row = m + r * 4;
+						const float center = row[0] * c.x + row[1] * c.y + row[2] * c.z + row[3];
+						// The box of the turned box, half sizes add up by the absolute matrix
+						const float half = std::fabs(row[0]) * e.x + std::fabs(row[1]) * e.y + std::fabs(row[2]) * e.z;
+						const float column = m[r] * m[r] + m[4 + r] * m[4 + r] + m[8 + r] * m[8 + r];
+						scale2 = std::max(scale2, column);
+						(&world.center.x)[r] = center;
+						(&world.min.x)[r] = center - half;
+						(&world.max.x)[r] = center + half;
+					}
+					world.radius = local.radius * std::sqrt(scale2);
+					out.Set(i, world);
+				}
+			}, threads);
+	}
+
+	// **********************************************************************************************************
+	// KERNELS
+	// **********************************************************************************************************
+
+	size_t CullScalar(const Frustum& frustum, const CullStreams& in, UINT first, UINT* visible)
+	{
+		CullPlane planes[6];
+		CullPlanes(frustum, planes);
+		size_t n = 0;
+		for (size_t i = 0; i < in.count; ++i)
+		{
+			const float cx = in.center[0][i], cy = in.center[1][i], cz = in.center[2][i];
+			const float ex = in.extent[0][i], ey = in.extent[1][i], ez = in.extent[2][i];
+			const float radius = in.radius[i];
+			bool outside = false;
+			for (int p = 0; p < 6; ++p)
+			{
+				// Outside when the box or the sphere, whichever reaches less far, is behind the plane
+				const CullPlane& pl = planes[p];
+				const float dist = cx * pl.a + cy * pl.b + cz * pl.c + pl.d;
+				const float box = ex * pl.absA + ey * pl.absB + ez * pl.absC;
+				outside |= dist + std::min(box, radius) < 0.0f;
+			}
+			visible[n] = first + static_cast<UINT>(i);
+			n += outside ? 0 : 1;
+		}
+		return n;
+	}
+
+	size_t CullSSE(const Frustum& frustum, const CullStreams& in, UINT first, UINT* visible)
+	{
+		size_t simd = 0, n = 0;
+#if DXH_X86
+		CullPlane planes[6];
+		CullPlanes(frustum, planes);
+		simd = in.count & ~size_t(3);
+		n = CullSSEBody(planes, in, first, visible, simd);
+#endif
+		if (simd < in.count)
+			n += CullScalar(frustum, Slice(in, simd, in.count - simd), first + static_cast<UINT>(simd), visible + n);
+		return n;
+	}
+
+	size_t CullAVX2(const Frustum& frustum, const CullStreams& in, UINT first, UINT* visible)
+	{
+		size_t simd = 0, n = 0;
+#if DXH_X86
+		CullPlane planes[6];
+		CullPlanes(frustum, planes);
+		simd = in.count & ~size_t(7);
+		n = CullAVX2Body(planes, in, first, visible, simd);
+#endif
+		if (simd < in.count)
+			n += CullSSE(frustum, Slice(in, simd, in.count - simd), first + static_cast<UINT>(simd), visible + n);
+		return n;
+	}
+
+	bool CullKernelSupported(CullKernel kernel)
+	{
+#if DXH_X86
+		static const bool sse = util::CpuHasSSE2();
+		static const bool avx2 = util::CpuHasAVX2();
+		switch (kernel)
+		{
+		case CullKernel::Scalar: return true;
+		case CullKernel::SSE: return sse;
+		case CullKernel::AVX2: return avx2;
+		}
+		return false;
+#else
+		return kernel == CullKernel::Scalar;
+#endif
+	}
+
+	CullKernel BestCullKernel()
+	{
+		static const CullKernel best =
+			CullKernelSupported(CullKernel::AVX2) ? CullKernel::AVX2 :
+			CullKernelSupported(CullKernel::SSE) ? CullKernel::SSE : CullKernel::Scalar;
+		return best;
+	}
+
+	CullFunc GetCullFunc(CullKernel kernel)
+	{
+		switch (kernel)
+		{
+		case CullKernel::SSE: return CullSSE;
+		case CullKernel::AVX2: return CullAVX2;
+		default: return CullScalar;
+		}
+	}
+
+	const char* CullKernelName(CullKernel kernel)
+	{
+		switch (kernel)
+		{
+		case CullKernel::SSE: return "SSE";
+		case CullKernel::AVX2: return "AVX2";
+		default: return "Scalar";
+		}
+	}
+
+	// **********************************************************************************************************
+	// CULLING
+	// **********************************************************************************************************
+
+	size_t CullObjects(const Frustum& frustum, const CullStreams& in, std::vector<UINT>& visible, CullKernel kernel, unsigned int threads, CullStats* stats)
+	{
+		util::DeltaTimer timer;
+		if (!CullKernelSupported(kernel))
+			kernel = BestCullKernel();
+		const CullFunc cull = GetCullFunc(kernel);
+		visible.resize(in.count);
+
+		size_t count = 0;
+		if (in.count <= CULL_GRAIN)
+			count = cull(frustum, in, 0, visible.data());
+		else
+		{
+			// Every chunk compacts into its own part of visible, then the parts move down in order
+			const size_t chunks = (in.count + CULL_GRAIN - 1) / CULL_GRAIN;
+			std::vector<size_t> found(chunks);
+			util::ParallelFor(chunks, 1, [&](size_t begin, size_t end)
+				{
+					for (size_t chunk = begin; chunk < end; ++chunk)
+					{
+						const size_t first = chunk * CULL_GRAIN;
+						const size_t size = std::min(CULL_GRAIN, in.count - first);
+						found[chunk] = cull(frustum, Slice(in, first, size), static_cast<UINT>(first), visible.data() + first);
+					}
+				}, threads);
+			for (size_t chunk = 0; chunk < chunks; ++chunk)
+			{
+				const UINT* part = visible.data() + chunk * CULL_GRAIN;
+				if (part != visible.data() + count)
+					std::memmove(visible.data() + count, part, found[chunk] * sizeof(UINT));
+				count += found[chunk];
+			}
+		}
+		visible.resize(count);
+
+		if (stats)
+		{
+			stats->tested = in.count;
+			stats->visible = count;
+			stats->culled = in.count - count;
+			stats->nsPerObject = in.count ? timer.GetElapsed() * 1e9f / in.count : 0.0f;
+		}
+		return count;
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	CullBenchmark BenchmarkCulling(size_t objects, int repeats)
+	{
+		// 90 degree perspective looking down +z from the origin, near 0.1 and far 100
+		const float zn = 0.1f, zf = 100.0f, q = zf / (zf - zn);
+		const DirectX::XMFLOAT4X4 project(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, q, -zn * q,
+			0.0f, 0.0f, 1.0f, 0.0f);
+		const Frustum frustum = ExtractFrustum(project);
+
+		// Unit boxes in a cube twice the far distance wide, about a sixth of them in view
+		BoundsList bounds;
+		bounds.Resize(objects);
+		uint32_t seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) * (1.0f / 16777216.0f); };
+		for (size_t i = 0; i < objects; ++i)
+		{
+			Bounds b;
+			b.center = float3(random() * 200.0f - 100.0f, random() * 200.0f - 100.0f, random() * 200.0f - 100.0f);
+			b.min = b.center - float3(0.5f, 0.5f, 0.5f);
+			b.max = b.center + float3(0.5f, 0.5f, 0.5f);
+			b.radius = 0.866f;
+			bounds.Set(i, b);
+		}
+
+		CullBenchmark result;
+		result.objects = objects;
+		result.threads = util::JobSystem::Global().ThreadCount();
+		result.kernel = BestCullKernel();
+		std::vector<UINT> visible;
+		auto best = [&](CullKernel kernel, unsigned int threads)
+		{
+			float ns = FLT_MAX;
+			for (int r = 0; r < repeats; ++r)
+			{
+				CullStats stats;
+				CullObjects(frustum, bounds.Streams(), visible, kernel, threads, &stats);
+				ns = std::min(ns, stats.nsPerObject);
+			}
+			return ns;
+		};
+		result.scalarNs = best(CullKernel::Scalar, 1);
+		result.bestNs = best(result.kernel, 1);
+		result.threadedNs = best(result.kernel, 0);
+		result.visible = visible.size();
+		return result;
+	}
+}
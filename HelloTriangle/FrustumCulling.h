@@ -0,0 +1,100 @@
+#pragma once
+#include "pch.h"
+
+#include "Simd.h"
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//Six planes (a, b, c, d) with the normal pointing inside and unit length, a point p is inside a plane
+	//when a*p.x + b*p.y + c*p.z + d >= 0. Order is left, right, bottom, top, near, far.
+	struct Frustum
+	{
+		float planes[6][4];
+	};
+
+	//Planes of the clip volume of m (0 <= z <= w like D3D), stored the way DXHandler uploads matrices.
+	//With WVP::wvp they are in the object's space, with project * view in world space.
+	Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& m);
+	//single box and sphere against the planes, true when they may be inside
+	bool IsVisible(const Frustum& frustum, const Bounds& bounds);
+
+	//Structure of arrays input of the cull kernels, every stream holds count floats.
+	//extent is the half size of the box, radius the bounding sphere around the same center.
+	struct CullStreams
+	{
+		const float* center[3];
+		const float* extent[3];
+		const float* radius;
+		size_t count;
+	};
+
+	//Bounds of many objects in SoA streams for CullObjects
+	class BoundsList
+	{
+	public:
+		void Add(const Bounds& bounds);
+		void Set(size_t i, const Bounds& bounds);
+		void Resize(size_t count);
+		void Clear() { Resize(0); }
+		size_t Count() const { return radius.size(); }
+		CullStreams Streams() const;
+
+	private:
+		util::aligned_vector<float> center[3];
+		util::aligned_vector<float> extent[3];
+		util::aligned_vector<float> radius;
+	};
+
+	//Fills out with the bounds of local placed by count world matrices, one every stride bytes
+	//(InstanceData::world for instance). The boxes grow to stay axis aligned, the spheres take the largest scale.
+	void TransformBounds(const Bounds& local, const void* worlds, size_t stride, size_t count, BoundsList& out, unsigned int threads = 0);
+
+	enum class CullKernel
+	{
+		Scalar,
+		SSE,	//4 objects per pass
+		AVX2,	//8 objects per pass
+	};
+
+	//Writes first + i of every object i that is not outside the frustum to visible, in order, and returns
+	//how many. visible needs room for in.count indices.
+	typedef size_t(*CullFunc)(const Frustum& frustum, const CullStreams& in, UINT first, UINT* visible);
+
+	size_t CullScalar(const Frustum& frustum, const CullStreams& in, UINT first, UINT* visible);
+	size_t CullSSE(const Frustum& frustum, const CullStreams& in, UINT first, UINT* visible);
+	size_t CullAVX2(const Frustum& frustum, const CullStreams& in, UINT first, UINT* visible);
+
+	bool CullKernelSupported(CullKernel kernel);
+	CullKernel BestCullKernel();	//widest kernel the CPU supports, checked once
+	CullFunc GetCullFunc(CullKernel kernel);
+	const char* CullKernelName(CullKernel kernel);
+
+	struct CullStats
+	{
+		size_t tested = 0;
+		size_t visible = 0;
+		size_t culled = 0;
+		float nsPerObject = 0.0f;
+	};
+
+	static const size_t CULL_GRAIN = 8192; //objects per job, a multiple of 8 so only the last chunk has a tail
+
+	//Replaces visible with the indices of the objects that may be seen, in order, split over the job system
+	//when there are more than CULL_GRAIN of them. Returns how many.
+	size_t CullObjects(const Frustum& frustum, const CullStreams& in, std::vector<UINT>& visible,
+		CullKernel kernel = BestCullKernel(), unsigned int threads = 0, CullStats* stats = nullptr);
+
+	struct CullBenchmark
+	{
+		size_t objects = 0;
+		size_t visible = 0;
+		unsigned int threads = 0;
+		float scalarNs = 0.0f;		//per object, one thread
+		float bestNs = 0.0f;		//per object, best kernel, one thread
+		float threadedNs = 0.0f;	//per object, best kernel on every job system thread
+		CullKernel kernel = CullKernel::Scalar;
+	};
+	//best of repeats culls of objects scattered around a camera looking down +z
+	CullBenchmark BenchmarkCulling(size_t objects = 1 << 20, int repeats = 10);
+}
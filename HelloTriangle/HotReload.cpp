@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "HotReload.h"
+
+namespace dxh
+{
+	size_t ReloadQueue::Collect(float now, std::vector<std::string>& ready)
+	{
+		size_t count = 0;
+		for (auto it = pending.begin(); it != pending.end();)
+		{
+			if (now - it->second < debounce)
+			{
+				++it;
+				continue;
+			}
+			ready.push_back(it->first);
+			it = pending.erase(it);
+			++count;
+		}
+		return count;
+	}
+
+	HotReloader::HotReloader(ReloadTarget& target, float debounce, bool forcePolling)
+		: target(target), watcher(forcePolling), queue(debounce)
+	{
+	}
+
+	bool HotReloader::Watch(const std::string& path, AssetKind kind)
+	{
+		if (!watcher.Watch(path))
+			return false;
+		kinds[path] = kind;
+		return true;
+	}
+
+	void HotReloader::Unwatch(const std::string& path)
+	{
+		watcher.Unwatch(path);
+		kinds.erase(path);
+	}
+
+	void HotReloader::NotifyChanged(const std::string& path, float now)
+	{
+		if (!kinds.count(path))
+			return;
+		++stats.changes;
+		queue.Notify(path, now);
+	}
+
+	size_t HotReloader::Update(float now)
+	{
+		scratch.clear();
+		watcher.Poll(now, scratch);
+		for (const std::string& path : scratch)
+			NotifyChanged(path, now);
+
+		scratch.clear();
+		queue.Collect(now, scratch);
+		size_t reloads = 0;
+		for (const std::string& path : scratch)
+		{
+			auto kind = kinds.find(path);
+			if (kind == kinds.end())
+				continue; //unwatched while it was debouncing
+			if (target.ReloadAsset(kind->second, path))
+				++reloads;
+			else
+				++stats.failures;
+		}
+		stats.reloads += reloads;
+		return reloads;
+	}
+}
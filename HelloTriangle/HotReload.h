@@ -0,0 +1,75 @@
+#pragma once
+#include "pch.h"
+
+#include "FileWatcher.h"
+
+namespace dxh
+{
+	enum class AssetKind
+	{
+		Texture,
+		Shader,	//compiled .cso blob
+	};
+
+	//Rebuilds a single asset after its file changed, on the thread that calls HotReloader::Update.
+	//DXHandler recreates the texture or shader, tests can implement it without a device.
+	class ReloadTarget
+	{
+	public:
+		virtual ~ReloadTarget() {}
+		virtual bool ReloadAsset(AssetKind kind, const std::string& path) = 0; //false keeps the old asset
+	};
+
+	//Debounces change notifications: a path is handed out once it has been quiet for debounce seconds,
+	//so a compiler or image editor writing a file in several steps causes one reload.
+	class ReloadQueue
+	{
+	public:
+		explicit ReloadQueue(float debounce = 0.2f) : debounce(debounce) {}
+
+		void Notify(const std::string& path, float now) { pending[path] = now; }
+		//appends the paths that are ready and removes them from the queue
+		size_t Collect(float now, std::vector<std::string>& ready);
+		size_t Pending() const { return pending.size(); }
+		float GetDebounce() const { return debounce; }
+
+	private:
+		float debounce;
+		std::unordered_map<std::string, float> pending; //path -> time of the last change
+	};
+
+	struct HotReloadStats
+	{
+		size_t changes = 0;		//change notifications, before debouncing
+		size_t reloads = 0;
+		size_t failures = 0;	//reloads the target refused, the old asset stays
+	};
+
+	//Watches asset files and reloads only the ones that changed. Single threaded, call Update once per frame.
+	class HotReloader
+	{
+	public:
+		//forcePolling skips inotify, handy where the asset directory is on a network share
+		HotReloader(ReloadTarget& target, float debounce = 0.2f, bool forcePolling = false);
+		HotReloader(const HotReloader&) = delete;
+		HotReloader& operator=(const HotReloader&) = delete;
+
+		bool Watch(const std::string& path, AssetKind kind);
+		void Unwatch(const std::string& path);
+		//queues a change as if the watcher had seen it, for tools and tests
+		void NotifyChanged(const std::string& path, float now);
+		//polls the watcher and reloads the debounced changes, now in seconds. Returns the reloads done.
+		size_t Update(float now);
+
+		HotReloadStats GetStats() const { return stats; }
+		bool UsingInotify() const { return watcher.UsingInotify(); }
+
+	private:
+		ReloadTarget& target;
+		util::FileWatcher watcher;
+		ReloadQueue queue;
+		std::unordered_map<std::string, AssetKind> kinds;
+		std::vector<std::string> scratch;
+		HotReloadStats stats;
+	};
+}
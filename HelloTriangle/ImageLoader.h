@@ -1,7 +1,32 @@
 #pragma once
 #include "pch.h"
 
+#include "Utilities.h"
+#include "Memory.h"
+#include "FileBlob.h"
+#include "CustomDataTypes.h"
+
+//stb_image allocates through the allocator of the ImageLoadRaw that is decoding on the calling thread
+namespace util
+{
+	namespace stbi
+	{
+		inline Allocator*& CurrentAllocator()
+		{
+			static thread_local Allocator* allocator = nullptr;
+			return allocator;
+		}
+		inline Allocator& Current() { return CurrentAllocator() ? *CurrentAllocator() : DefaultAllocator(); }
+		inline void* Malloc(size_t size) { return Current().Allocate(size); }
+		inline void* Realloc(void* p, size_t oldSize, size_t newSize) { return Current().Reallocate(p, oldSize, newSize); }
+		inline void Free(void* p) { Current().Free(p); }
+	}
+}
+
 //Wrapper Class for stb_image.h
+#define STBI_MALLOC(sz) util::stbi::Malloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) util::stbi::Realloc(p, oldsz, newsz)
+#define STBI_FREE(p) util::stbi::Free(p)
 #define STB_IMAGE_IMPLEMENTATION
 #include "external/stb_image.h"
 
@@ -9,40 +34,86 @@ class
 	ImageLoadRaw
 {
 public:
-	ImageLoadRaw() {};
+	ImageLoadRaw() : allocator(&util::DefaultAllocator()) {};
+	//decoded images and stb's scratch memory come from allocator, it has to outlive the images
+	explicit ImageLoadRaw(util::Allocator& allocator) : allocator(&allocator) {};
 	ImageLoadRaw(dxh::ImageData& target, const char* filepath);
 	~ImageLoadRaw() {};
-	bool ImageFromFile(dxh::ImageData& target, const char* filepath);
+	//target adopts the decoded buffer, no copy is made. channels is what the image is converted to (1 to 4).
+	bool ImageFromFile(dxh::ImageData& target, const char* filepath, int channels = 4, bool flipVertically = false);
 
+private:
+	util::Allocator* allocator;
 };
 
-inline 
-ImageLoadRaw::ImageLoadRaw(dxh::ImageData& target, const char* filepath) 
+inline
+ImageLoadRaw::ImageLoadRaw(dxh::ImageData& target, const char* filepath) : allocator(&util::DefaultAllocator())
 {
 	ImageFromFile(target, filepath);
 }
 
 inline
-bool ImageLoadRaw::ImageFromFile(dxh::ImageData &target, const char* filepath)
+bool ImageLoadRaw::ImageFromFile(dxh::ImageData &target, const char* filepath, int channels, bool flipVertically)
 {
-	int width, height, channels;
+	int width, height, fileChannels;
+	channels = std::min(4, std::max(1, channels));
 
-	unsigned char* img = stbi_load(filepath, &width, &height, &channels, 4);
+	util::Allocator* previous = util::stbi::CurrentAllocator();
+	//decoded straight from the mapped file instead of through stdio's buffer
+	util::FileBlob file;
+	unsigned char* img = NULL;
+	if (file.Open(filepath) && file.Size() <= static_cast<size_t>(INT_MAX))
+	{
+		util::stbi::CurrentAllocator() = allocator;
+		stbi_set_flip_vertically_on_load_thread(flipVertically ? 1 : 0);
+		img = stbi_load_from_memory(file.Data(), static_cast<int>(file.Size()), &width, &height, &fileChannels, channels);
+		util::stbi::CurrentAllocator() = previous;
+	}
 	if (img == NULL)
 	{
 		util::ErrorMessageBox("could not load image from file \"" + std::string(filepath) + "\".");
 		return false;
 	}
-	channels = 4;
-	//n would be the total size of the image
-	std::vector<unsigned char> temp(img, img + (width * height * channels)); 
+	//the image frees the stb buffer once the last copy of it is gone
+	util::Allocator* owner = allocator;
+	target.Adopt(img, width, height, channels, [owner](unsigned char* p) { owner->Free(p); });
+	return true;
+}
 
-	target.channels = channels;
-	target.height = height;
-	target.width = width;
-	target.data = temp;
+//Times loading every .png in a directory and reports the peak resident set size of the process.
+//The peak can not be reset, so compare copying and pooled runs in separate processes.
+struct ImageLoadBenchmark
+{
+	size_t files = 0;
+	size_t bytesDecoded = 0;
+	float seconds = 0.0f;
+	size_t peakResidentBytes = 0;
+	size_t poolPeakBytes = 0;	//0 without the pool
+	size_t poolReuses = 0;
+};
 
-	//free the data
-	stbi_image_free(img); 
-	return true;
-}
\ No newline at end of file
+inline
+ImageLoadBenchmark BenchmarkImageDirectory(const std::string& directory, bool usePool = true)
+{
+	ImageLoadBenchmark result;
+	util::PoolAllocator pool;
+	ImageLoadRaw loader = usePool ? ImageLoadRaw(pool) : ImageLoadRaw();
+
+	util::DeltaTimer timer;
+	for (const std::string& file : util::ListFiles(directory, ".png"))
+	{
+		dxh::ImageData image;
+		if (!loader.ImageFromFile(image, file.c_str()))
+			continue;
+		++result.files;
+		result.bytesDecoded += image.ByteSize();
+	} //the image returns its buffer here, the next file reuses it through the pool
+	result.seconds = timer.GetElapsed();
+	result.peakResidentBytes = util::PeakResidentBytes();
+	if (usePool)
+	{
+		result.poolPeakBytes = pool.PeakBytesInUse();
+		result.poolReuses = pool.Reuses();
+	}
+	return result;
+}
@@ -0,0 +1,42 @@
+#include "pch.h"
+#include "Instancing.h"
+
+namespace dxh
+{
+	void BuildInstanceGrid(std::vector<InstanceData>& instances, size_t count, unsigned int threads)
+	{
+		const size_t side = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count)))));
+		const float spacing = 2.0f / side;
+		const float scale = spacing * 0.8f;
+		BuildInstances(instances, count, [side, spacing, scale](size_t i, InstanceData& instance)
+			{
+				const float x = -1.0f + spacing * (0.5f + i % side);
+				const float y = -1.0f + spacing * (0.5f + i / side);
+				// scale then translate, stored transposed so the translation sits in the last column
+				instance.world = DirectX::XMFLOAT4X4(
+					scale, 0.0f, 0.0f, x,
+					0.0f, scale, 0.0f, y,
+					0.0f, 0.0f, scale, 0.0f,
+					0.0f, 0.0f, 0.0f, 1.0f);
+				// cheap hash of the index for a stable color per copy
+				uint32_t h = static_cast<uint32_t>(i) * 2654435761u;
+				h ^= h >> 15;
+				instance.tint = DirectX::XMFLOAT4(
+					0.5f + (h & 0xff) / 510.0f,
+					0.5f + ((h >> 8) & 0xff) / 510.0f,
+					0.5f + ((h >> 16) & 0xff) / 510.0f,
+					1.0f);
+			}, 4096, threads);
+	}
+
+	void PlanDraws(std::vector<DrawCommand>& draws, UINT indexCount, size_t instanceCount, bool instanced)
+	{
+		draws.clear();
+		if (instanceCount == 0)
+			return;
+		if (instanced)
+			draws.push_back({ indexCount, static_cast<UINT>(instanceCount), 0 });
+		else
+			draws.assign(instanceCount, { indexCount, 1, 0 });
+	}
+}
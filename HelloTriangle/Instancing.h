@@ -0,0 +1,43 @@
+#pragma once
+#include "pch.h"
+
+#include "Parallel.h"
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//One element of the instance structured buffer (StructuredBuffer<INSTANCE> in VertexShaderInstanced.hlsl)
+	struct alignas(16) InstanceData
+	{
+		DirectX::XMFLOAT4X4 world;	//transposed like WVP::world, applied before the shared world matrix
+		DirectX::XMFLOAT4 tint;		//multiplies the texture color
+	};
+
+	//A draw the renderer issues, kept CPU side so the number of draws can be checked without a device
+	struct DrawCommand
+	{
+		UINT indexCount;
+		UINT instanceCount;	//1 for plain draws
+		UINT firstIndex;	//start of the LOD level in the index buffer
+	};
+
+	//Fills count instances with fill(index, instance), spread over threads in chunks of grain
+	template<typename Fill>
+	inline
+		void BuildInstances(std::vector<InstanceData>& instances, size_t count, Fill&& fill, size_t grain = 4096, unsigned int threads = 0)
+	{
+		instances.resize(count);
+		InstanceData* out = instances.data();
+		util::ParallelFor(count, grain, [out, &fill](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					fill(i, out[i]);
+			}, threads);
+	}
+
+	//count copies of a unit quad on a square grid filling [-1, 1] in x and y, each with its own tint
+	void BuildInstanceGrid(std::vector<InstanceData>& instances, size_t count, unsigned int threads = 0);
+
+	//The draws for instanceCount copies of a mesh: one instanced draw, or one draw per copy (each with its own matrices)
+	void PlanDraws(std::vector<DrawCommand>& draws, UINT indexCount, size_t instanceCount, bool instanced);
+}
@@ -0,0 +1,350 @@
+#include "pch.h"
+#include "Lighting.h"
+#include "Simd.h"
+
+namespace
+{
+	//lighting terms that are the same for every fragment
+	struct LightingConstants
+	{
+		float ambient[3];	//light color * material ambient
+		float diffuse[3];	//light color * material diffuse
+		float specular[3];	//light color * material specular
+		float lightpos[3];
+		float viewpos[3];
+		float spec_factor;
+
+		LightingConstants(const dxh::SimpleLight& light, const dxh::SimpleMaterial& material)
+		{
+			const float lc[3] = { light.color.x, light.color.y, light.color.z };
+			const float ambi[3] = { material.ambi_col.x, material.ambi_col.y, material.ambi_col.z };
+			const float diff[3] = { material.diff_col.x, material.diff_col.y, material.diff_col.z };
+			const float spec[3] = { material.spec_col.x, material.spec_col.y, material.spec_col.z };
+			for (int c = 0; c < 3; ++c)
+			{
+				ambient[c] = lc[c] * ambi[c];
+				diffuse[c] = lc[c] * diff[c];
+				specular[c] = lc[c] * spec[c];
+			}
+			lightpos[0] = light.pos.x, lightpos[1] = light.pos.y, lightpos[2] = light.pos.z;
+			viewpos[0] = light.viewpos.x, viewpos[1] = light.viewpos.y, viewpos[2] = light.viewpos.z;
+			spec_factor = material.spec_factor;
+		}
+	};
+
+	//the fragments from first to the end, used to finish the tail of the SIMD kernels
+	dxh::FragmentStreams Tail(const dxh::FragmentStreams& frags, size_t first)
+	{
+		dxh::FragmentStreams tail = frags;
+		for (int c = 0; c < 3; ++c)
+		{
+			tail.pos[c] += first;
+			tail.normal[c] += first;
+			tail.texel[c] += first;
+			tail.color[c] += first;
+		}
+		tail.count = frags.count - first;
+		return tail;
+	}
+
+	//Taylor coefficients of 2^f = e^(f ln2), good to ~1e-6 for f in [0, 1)
+	const float EXP2_C[8] = { 1.0f, 0.69314718f, 0.24022651f, 0.05550411f, 0.00961813f, 0.00133336f, 0.00015404f, 0.00001525f };
+	const float LOG2_E = 1.44269504f;
+	const float LOG2_ZERO = -1000.0f; //log2 of zero and denormals, exp2 flushes anything this small to 0
+
+#if DXH_X86
+	// **********************************************************************************************************
+	// SSE
+	// **********************************************************************************************************
+
+	//log2 = exponent + ln(mantissa) / ln2, ln(m) = 2 atanh((m - 1) / (m + 1)) as a series in z = (m - 1) / (m + 1)
+	DXH_TARGET_SSE inline __m128 Log2(__m128 x)
+	{
+		const __m128i bits = _mm_castps_si128(x);
+		const __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+		const __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 z = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+		const __m128 z2 = _mm_mul_ps(z, z);
+		__m128 p = _mm_add_ps(_mm_set1_ps(1.0f / 7.0f), _mm_mul_ps(z2, _mm_set1_ps(1.0f / 9.0f)));
+		p = _mm_add_ps(_mm_set1_ps(1.0f / 5.0f), _mm_mul_ps(z2, p));
+		p = _mm_add_ps(_mm_set1_ps(1.0f / 3.0f), _mm_mul_ps(z2, p));
+		p = _mm_add_ps(one, _mm_mul_ps(z2, p));
+		const __m128 ln = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), z), p);
+		const __m128 result = _mm_add_ps(e, _mm_mul_ps(ln, _mm_set1_ps(LOG2_E)));
+		const __m128 valid = _mm_cmpge_ps(x, _mm_set1_ps(FLT_MIN));
+		return _mm_or_ps(_mm_and_ps(valid, result), _mm_andnot_ps(valid, _mm_set1_ps(LOG2_ZERO)));
+	}
+
+	DXH_TARGET_SSE inline __m128 Exp2(__m128 y)
+	{
+		y = _mm_min_ps(_mm_max_ps(y, _mm_set1_ps(-127.0f)), _mm_set1_ps(127.0f));
+		__m128i n = _mm_cvttps_epi32(y);
+		//truncation rounds negative values up, step back one to get floor
+		n = _mm_add_epi32(n, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(n), y)));
+		const __m128 f = _mm_sub_ps(y, _mm_cvtepi32_ps(n));
+		__m128 p = _mm_set1_ps(EXP2_C[7]);
+		for (int k = 6; k >= 0; --k)
+			p = _mm_add_ps(_mm_set1_ps(EXP2_C[k]), _mm_mul_ps(f, p));
+		const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+		return _mm_mul_ps(p, scale);
+	}
+
+	DXH_TARGET_SSE inline __m128 InvLength(__m128 x, __m128 y, __m128 z)
+	{
+		const __m128 sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(sq));
+	}
+
+	DXH_TARGET_SSE void ShadeSSE(const dxh::FragmentStreams& frags, const LightingConstants& k, size_t count)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 sfac = _mm_set1_ps(k.spec_factor);
+		for (size_t i = 0; i < count; i += 4)
+		{
+			const __m128 px = _mm_loadu_ps(frags.pos[0] + i);
+			const __m128 py = _mm_loadu_ps(frags.pos[1] + i);
+			const __m128 pz = _mm_loadu_ps(frags.pos[2] + i);
+
+			// DIFFUSE
+			__m128 nx = _mm_loadu_ps(frags.normal[0] + i);
+			__m128 ny = _mm_loadu_ps(frags.normal[1] + i);
+			__m128 nz = _mm_loadu_ps(frags.normal[2] + i);
+			__m128 len = InvLength(nx, ny, nz);
+			nx = _mm_mul_ps(nx, len), ny = _mm_mul_ps(ny, len), nz = _mm_mul_ps(nz, len);
+
+			__m128 lx = _mm_sub_ps(px, _mm_set1_ps(k.lightpos[0]));
+			__m128 ly = _mm_sub_ps(py, _mm_set1_ps(k.lightpos[1]));
+			__m128 lz = _mm_sub_ps(pz, _mm_set1_ps(k.lightpos[2]));
+			len = InvLength(lx, ly, lz);
+			lx = _mm_mul_ps(lx, len), ly = _mm_mul_ps(ly, len), lz = _mm_mul_ps(lz, len);
+
+			const __m128 ndotl = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, lx), _mm_mul_ps(ny, ly)), _mm_mul_ps(nz, lz));
+			const __m128 diffuse_factor = _mm_max_ps(_mm_sub_ps(zero, ndotl), zero);
+
+			// SPECULAR
+			__m128 vx = _mm_sub_ps(_mm_set1_ps(k.viewpos[0]), px);
+			__m128 vy = _mm_sub_ps(_mm_set1_ps(k.viewpos[1]), py);
+			__m128 vz = _mm_sub_ps(_mm_set1_ps(k.viewpos[2]), pz);
+			len = InvLength(vx, vy, vz);
+			vx = _mm_mul_ps(vx, len), vy = _mm_mul_ps(vy, len), vz = _mm_mul_ps(vz, len);
+
+			const __m128 twondotl = _mm_mul_ps(two, ndotl);
+			const __m128 rx = _mm_sub_ps(lx, _mm_mul_ps(nx, twondotl));
+			const __m128 ry = _mm_sub_ps(ly, _mm_mul_ps(ny, twondotl));
+			const __m128 rz = _mm_sub_ps(lz, _mm_mul_ps(nz, twondotl));
+			const __m128 vdotr = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, rx), _mm_mul_ps(vy, ry)), _mm_mul_ps(vz, rz)), zero);
+			const __m128 spec = Exp2(_mm_mul_ps(Log2(vdotr), sfac));
+
+			// APPLY COLORS
+			for (int c = 0; c < 3; ++c)
+			{
+				const __m128 tex = _mm_loadu_ps(frags.texel[c] + i);
+				const __m128 lit = _mm_add_ps(_mm_set1_ps(k.ambient[c]), _mm_mul_ps(diffuse_factor, _mm_set1_ps(k.diffuse[c])));
+				_mm_storeu_ps(frags.color[c] + i, _mm_add_ps(_mm_mul_ps(lit, tex), _mm_mul_ps(spec, _mm_set1_ps(k.specular[c]))));
+			}
+		}
+	}
+
+	// **********************************************************************************************************
+	// AVX2
+	// **********************************************************************************************************
+
+	DXH_TARGET_AVX2 inline __m256 Log2(__m256 x)
+	{
+		const __m256i bits = _mm256_castps_si256(x);
+		const __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+		const __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 z = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+		const __m256 z2 = _mm256_mul_ps(z, z);
+		__m256 p = _mm256_fmadd_ps(z2, _mm256_set1_ps(1.0f / 9.0f), _mm256_set1_ps(1.0f / 7.0f));
+		p = _mm256_fmadd_ps(z2, p, _mm256_set1_ps(1.0f / 5.0f));
+		p = _mm256_fmadd_ps(z2, p, _mm256_set1_ps(1.0f / 3.0f));
+		p = _mm256_fmadd_ps(z2, p, one);
+		const __m256 ln = _mm256_mul_ps(_mm256_add_ps(z, z), p);
+		const __m256 result = _mm256_fmadd_ps(ln, _mm256_set1_ps(LOG2_E), e);
+		const __m256 valid = _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_GE_OQ);
+		return _mm256_blendv_ps(_mm256_set1_ps(LOG2_ZERO), result, valid);
+	}
+
+	DXH_TARGET_AVX2 inline __m256 Exp2(__m256 y)
+	{
+		y = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(-127.0f)), _mm256_set1_ps(127.0f));
+		const __m256 fl = _mm256_floor_ps(y);
+		const __m256 f = _mm256_sub_ps(y, fl);
+		__m256 p = _mm256_set1_ps(EXP2_C[7]);
+		for (int k = 6; k >= 0; --k)
+			p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(EXP2_C[k]));
+		const __m256i n = _mm256_cvtps_epi32(fl);
+		const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+		return _mm256_mul_ps(p, scale);
+	}
+
+	DXH_TARGET_AVX2 inline __m256 InvLength(__m256 x, __m256 y, __m256 z)
+	{
+		const __m256 sq = _mm256_fmadd_ps(z, z, _mm256_fmadd_ps(y, y, _mm256_mul_ps(x, x)));
+		return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(sq));
+	}
+
+	DXH_TARGET_AVX2 void ShadeAVX2(const dxh::FragmentStreams& frags, const LightingConstants& k, size_t count)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 sfac = _mm256_set1_ps(k.spec_factor);
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __m256 px = _mm256_loadu_ps(frags.pos[0] + i);
+			const __m256 py = _mm256_loadu_ps(frags.pos[1] + i);
+			const __m256 pz = _mm256_loadu_ps(frags.pos[2] + i);
+
+			// DIFFUSE
+			__m256 nx = _mm256_loadu_ps(frags.normal[0] + i);
+			__m256 ny = _mm256_loadu_ps(frags.normal[1] + i);
+			__m256 nz = _mm256_loadu_ps(frags.normal[2] + i);
+			__m256 len = InvLength(nx, ny, nz);
+			nx = _mm256_mul_ps(nx, len), ny = _mm256_mul_ps(ny, len), nz = _mm256_mul_ps(nz, len);
+
+			__m256 lx = _mm256_sub_ps(px, _mm256_set1_ps(k.lightpos[0]));
+			__m256 ly = _mm256_sub_ps(py, _mm256_set1_ps(k.lightpos[1]));
+			__m256 lz = _mm256_sub_ps(pz, _mm256_set1_ps(k.lightpos[2]));
+			len = InvLength(lx, ly, lz);
+			lx = _mm256_mul_ps(lx, len), ly = _mm256_mul_ps(ly, len), lz = _mm256_mul_ps(lz, len);
+
+			const __m256 ndotl = _mm256_fmadd_ps(nz, lz, _mm256_fmadd_ps(ny, ly, _mm256_mul_ps(nx, lx)));
+			const __m256 diffuse_factor = _mm256_max_ps(_mm256_sub_ps(zero, ndotl), zero);
+
+			// SPECULAR
+			__m256 vx = _mm256_sub_ps(_mm256_set1_ps(k.viewpos[0]), px);
+			__m256 vy = _mm256_sub_ps(_mm256_set1_ps(k.viewpos[1]), py);
+			__m256 vz = _mm256_sub_ps(_mm256_set1_ps(k.viewpos[2]), pz);
+			len = InvLength(vx, vy, vz);
+			vx = _mm256_mul_ps(vx, len), vy = _mm256_mul_ps(vy, len), vz = _mm256_mul_ps(vz, len);
+
+			const __m256 twondotl = _mm256_add_ps(ndotl, ndotl);
+			const __m256 rx = _mm256_fnmadd_ps(nx, twondotl, lx);
+			const __m256 ry = _mm256_fnmadd_ps(ny, twondotl, ly);
+			const __m256 rz = _mm256_fnmadd_ps(nz, twondotl, lz);
+			const __m256 vdotr = _mm256_max_ps(_mm256_fmadd_ps(vz, rz, _mm256_fmadd_ps(vy, ry, _mm256_mul_ps(vx, rx))), zero);
+			const __m256 spec = Exp2(_mm256_mul_ps(Log2(vdotr), sfac));
+
+			// APPLY COLORS
+			for (int c = 0; c < 3; ++c)
+			{
+				const __m256 tex = _mm256_loadu_ps(frags.texel[c] + i);
+				const __m256 lit = _mm256_fmadd_ps(diffuse_factor, _mm256_set1_ps(k.diffuse[c]), _mm256_set1_ps(k.ambient[c]));
+				_mm256_storeu_ps(frags.color[c] + i, _mm256_fmadd_ps(spec, _mm256_set1_ps(k.specular[c]), _mm256_mul_ps(lit, tex)));
+			}
+		}
+	}
+#endif
+}
+
+namespace dxh
+{
+	void ShadeFragmentsScalar(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material)
+	{
+		const LightingConstants k(light, material);
+		for (size_t i = 0; i < frags.count; ++i)
+		{
+			const float pos[3] = { frags.pos[0][i], frags.pos[1][i], frags.pos[2][i] };
+
+			// DIFFUSE
+			float n[3] = { frags.normal[0][i], frags.normal[1][i], frags.normal[2][i] };
+			float len = 1.0f / std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			n[0] *= len, n[1] *= len, n[2] *= len;
+
+			float l[3] = { pos[0] - k.lightpos[0], pos[1] - k.lightpos[1], pos[2] - k.lightpos[2] }; //from light to surface
+			len = 1.0f / std::sqrt(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+			l[0] *= len, l[1] *= len, l[2] *= len;
+
+			const float ndotl = n[0] * l[0] + n[1] * l[1] + n[2] * l[2];
+			const float diffuse_factor = std::max(-ndotl, 0.0f);
+
+			// SPECULAR
+			float v[3] = { k.viewpos[0] - pos[0], k.viewpos[1] - pos[1], k.viewpos[2] - pos[2] };
+			len = 1.0f / std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			v[0] *= len, v[1] *= len, v[2] *= len;
+
+			const float r[3] = { l[0] - 2.0f * n[0] * ndotl, l[1] - 2.0f * n[1] * ndotl, l[2] - 2.0f * n[2] * ndotl }; //reflect(l, n)
+			const float spec = std::pow(std::max(v[0] * r[0] + v[1] * r[1] + v[2] * r[2], 0.0f), k.spec_factor);
+
+			// APPLY COLORS
+			for (int c = 0; c < 3; ++c)
+				frags.color[c][i] = (k.ambient[c] + diffuse_factor * k.diffuse[c]) * frags.texel[c][i] + spec * k.specular[c];
+		}
+	}
+
+	void ShadeFragmentsSSE(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material)
+	{
+		size_t simd = 0;
+#if DXH_X86
+		simd = frags.count & ~size_t(3);
+		ShadeSSE(frags, LightingConstants(light, material), simd);
+#endif
+		if (simd < frags.count)
+			ShadeFragmentsScalar(Tail(frags, simd), light, material);
+	}
+
+	void ShadeFragmentsAVX2(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material)
+	{
+		size_t simd = 0;
+#if DXH_X86
+		simd = frags.count & ~size_t(7);
+		ShadeAVX2(frags, LightingConstants(light, material), simd);
+#endif
+		if (simd < frags.count)
+			ShadeFragmentsSSE(Tail(frags, simd), light, material);
+	}
+
+	bool LightingKernelSupported(LightingKernel kernel)
+	{
+#if DXH_X86
+		static const bool sse = util::CpuHasSSE2();
+		static const bool avx2 = util::CpuHasAVX2();
+		switch (kernel)
+		{
+		case LightingKernel::Scalar: return true;
+		case LightingKernel::SSE: return sse;
+		case LightingKernel::AVX2: return avx2;
+		}
+		return false;
+#else
+		return kernel == LightingKernel::Scalar;
+#endif
+	}
+
+	LightingKernel BestLightingKernel()
+	{
+		static const LightingKernel best =
+			LightingKernelSupported(LightingKernel::AVX2) ? LightingKernel::AVX2 :
+			LightingKernelSupported(LightingKernel::SSE) ? LightingKernel::SSE : LightingKernel::Scalar;
+		return best;
+	}
+
+	LightingFunc GetLightingFunc(LightingKernel kernel)
+	{
+		switch (kernel)
+		{
+		case LightingKernel::SSE: return ShadeFragmentsSSE;
+		case LightingKernel::AVX2: return ShadeFragmentsAVX2;
+		default: return ShadeFragmentsScalar;
+		}
+	}
+
+	const char* LightingKernelName(LightingKernel kernel)
+	{
+		switch (kernel)
+		{
+		case LightingKernel::SSE: return "SSE";
+		case LightingKernel::AVX2: return "AVX2";
+		default: return "Scalar";
+		}
+	}
+
+	void ShadeFragments(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material)
+	{
+		static const LightingFunc func = GetLightingFunc(BestLightingKernel());
+		func(frags, light, material);
+	}
+}
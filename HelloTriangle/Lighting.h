@@ -0,0 +1,41 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//Structure of arrays input for the lighting kernels, every stream holds count floats.
+	//texel is the already sampled texture color, color receives the lit rgb.
+	struct FragmentStreams
+	{
+		const float* pos[3];
+		const float* normal[3];
+		const float* texel[3];
+		float* color[3];
+		size_t count;
+	};
+
+	enum class LightingKernel
+	{
+		Scalar,
+		SSE,	//4 fragments per instruction
+		AVX2,	//8 fragments per instruction
+	};
+
+	typedef void(*LightingFunc)(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material);
+
+	//The ambient + diffuse + specular model of hlsl/PixelShader.hlsl.
+	//The scalar kernel is the reference, the SIMD kernels use polynomial log2/exp2 for the specular pow.
+	void ShadeFragmentsScalar(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material);
+	void ShadeFragmentsSSE(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material);
+	void ShadeFragmentsAVX2(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material);
+
+	bool LightingKernelSupported(LightingKernel kernel);
+	LightingKernel BestLightingKernel();	//widest kernel the CPU supports, checked once
+	LightingFunc GetLightingFunc(LightingKernel kernel);
+	const char* LightingKernelName(LightingKernel kernel);
+
+	//shades with BestLightingKernel()
+	void ShadeFragments(const FragmentStreams& frags, const SimpleLight& light, const SimpleMaterial& material);
+}
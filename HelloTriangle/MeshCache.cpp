@@ -0,0 +1,273 @@
+#include "pch.h"
+#include "MeshCache.h"
+
+#include "Utilities.h"
+#include "ObjLoader.h"
+#include "MeshSoA.h"
+#include "MeshOptimizer.h"
+
+#include <sys/stat.h>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t offset)
+	{
+		return (offset + dxh::MESH_CACHE_ALIGNMENT - 1) / dxh::MESH_CACHE_ALIGNMENT * dxh::MESH_CACHE_ALIGNMENT;
+	}
+
+	//size and modification time of a file, false if it does not exist
+	bool SourceStamp(const std::string& filepath, uint64_t& size, int64_t& modified)
+	{
+		struct stat info;
+		if (stat(filepath.c_str(), &info) != 0)
+			return false;
+		size = static_cast<uint64_t>(info.st_size);
+		modified = static_cast<int64_t>(info.st_mtime);
+#if defined(__linux__)
+		modified = modified * 1000000000ll + info.st_mtim.tv_nsec; //whole seconds miss quick saves
+#endif
+		return true;
+	}
+
+	//asks the OS to forget the cached pages of a file so the next read comes from disk
+	void EvictFromFileCache(const std::string& filepath)
+	{
+#if !(defined(_WIN32) || defined(_WIN64))
+		const int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd >= 0)
+		{
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			::close(fd);
+		}
+#else
+		(void)filepath;
+#endif
+	}
+}
+
+namespace dxh
+{
+	bool MeshCache::Open(const std::string& filepath, const std::string& sourcepath)
+	{
+		Close();
+		if (!file.Open(filepath) || file.Size() < sizeof(MeshCacheHeader))
+		{
+			file.Close();
+			return false;
+		}
+
+		const MeshCacheHeader* h = reinterpret_cast<const MeshCacheHeader*>(file.Data());
+		const uint64_t indexStride = h->indexStride;
+		bool valid = memcmp(h->magic, MESH_CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+			h->version == MESH_CACHE_VERSION &&
+			h->headerSize == sizeof(MeshCacheHeader) &&
+			h->vertexStride == sizeof(Vertex) &&
+			(indexStride == sizeof(uint16_t) || indexStride == sizeof(UINT)) &&
+			h->fileSize == file.Size() &&
+			h->vertexOffset % MESH_CACHE_ALIGNMENT == 0 && h->indexOffset % MESH_CACHE_ALIGNMENT == 0 &&
+			h->vertexOffset >= sizeof(MeshCacheHeader) &&
+			h->vertexOffset + uint64_t(h->vertexCount) * sizeof(Vertex) <= h->indexOffset &&
+			h->indexOffset + uint64_t(h->indexCount) * indexStride <= h->lodOffset &&
+			h->lodOffset % MESH_CACHE_ALIGNMENT == 0 && h->lodCount > 0 &&
+			h->lodOffset + uint64_t(h->lodCount) * sizeof(MeshCacheLOD) <= file.Size() &&
+			h->name[sizeof(h->name) - 1] == '\0';
+		if (valid)
+		{
+			const MeshCacheLOD* levels = reinterpret_cast<const MeshCacheLOD*>(file.Data() + h->lodOffset);
+			for (UINT i = 0; i < h->lodCount && valid; ++i)
+				valid = uint64_t(levels[i].firstIndex) + levels[i].indexCount <= h->indexCount;
+		}
+		uint64_t sourceSize = 0;
+		int64_t sourceModified = 0;
+		const bool current = sourcepath.empty() ||
+			(SourceStamp(sourcepath, sourceSize, sourceModified) && h->sourceSize == sourceSize && h->sourceModified == sourceModified);
+		if (!valid || !current)
+		{
+			file.Close();
+			return false;
+		}
+		header = h;
+		return true;
+	}
+
+	Bounds MeshCache::GetBounds() const
+	{
+		Bounds bounds;
+		bounds.min = float3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+		bounds.max = float3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		bounds.radius = header->vertexCount ? header->boundsRadius : -1.0f;
+		return bounds;
+	}
+
+	void MeshCache::ToLODChain(LODChain& chain) const
+	{
+		chain.levels.clear();
+		chain.levels.resize(LODCount());
+		for (UINT i = 0; i < LODCount(); ++i)
+		{
+			MeshLOD& level = chain.levels[i];
+			level.firstIndex = LOD(i).firstIndex;
+			level.indexCount = LOD(i).indexCount;
+			level.error = LOD(i).error;
+			level.ratio = LOD(i).ratio;
+		}
+	}
+
+	void MeshCache::ToMesh(Mesh& mesh) const
+	{
+		mesh.name = Name();
+		mesh.vertices.assign(Vertices(), Vertices() + VertexCount());
+		mesh.indices.resize(IndexCount());
+		if (ShortIndices())
+		{
+			const uint16_t* src = static_cast<const uint16_t*>(Indices());
+			std::copy(src, src + IndexCount(), mesh.indices.begin());
+		}
+		else
+		{
+			const UINT* src = static_cast<const UINT*>(Indices());
+			std::copy(src, src + IndexCount(), mesh.indices.begin());
+		}
+		mesh.UpdateBounds();
+	}
+
+	bool WriteMeshCache(const Mesh& mesh, const std::string& filepath, const std::string& sourcepath, const LODChain* lods)
+	{
+		std::vector<MeshCacheLOD> levels;
+		if (lods)
+		{
+			for (const MeshLOD& level : lods->levels)
+				levels.push_back({ level.firstIndex, level.indexCount, level.error, level.ratio });
+		}
+		if (levels.empty())
+			levels.push_back({ 0, static_cast<UINT>(mesh.indices.size()), 0.0f, 1.0f });
+
+
+		MeshCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+		header.version = MESH_CACHE_VERSION;
+		header.headerSize = sizeof(MeshCacheHeader);
+		header.vertexStride = sizeof(Vertex);
+		header.indexStride = mesh.ShortIndices() ? sizeof(uint16_t) : sizeof(UINT);
+		header.vertexCount = static_cast<UINT>(mesh.vertices.size());
+		header.indexCount = static_cast<UINT>(mesh.indices.size());
+		header.vertexOffset = AlignUp(sizeof(MeshCacheHeader));
+		header.indexOffset = AlignUp(header.vertexOffset + mesh.ByteWidth());
+		header.lodCount = static_cast<UINT>(levels.size());
+		header.lodOffset = AlignUp(header.indexOffset + mesh.IndexByteWidth());
+		header.fileSize = header.lodOffset + levels.size() * sizeof(MeshCacheLOD);
+		strncpy(header.name, mesh.name.c_str(), sizeof(header.name) - 1);
+		if (!sourcepath.empty() && !SourceStamp(sourcepath, header.sourceSize, header.sourceModified))
+		{
+			util::ErrorMessageBox("Mesh cache source \"" + sourcepath + "\" does not exist.");
+			return false;
+		}
+
+		float3 lo(0.0f, 0.0f, 0.0f), hi(0.0f, 0.0f, 0.0f);
+		if (!mesh.vertices.empty())
+			ComputeBounds(mesh, lo, hi);
+		header.boundsMin[0] = lo.x, header.boundsMin[1] = lo.y, header.boundsMin[2] = lo.z;
+		header.boundsMax[0] = hi.x, header.boundsMax[1] = hi.y, header.boundsMax[2] = hi.z;
+		const float3 center = (lo + hi) * 0.5f;
+		float radiusSquared = 0.0f;
+		for (const Vertex& v : mesh.vertices)
+		{
+			const float3 d = v.pos - center;
+			radiusSquared = std::max(radiusSquared, d.x * d.x + d.y * d.y + d.z * d.z);
+		}
+		header.boundsRadius = std::sqrt(radiusSquared);
+
+		std::vector<uint16_t> shortIndices;
+		if (mesh.ShortIndices())
+			PackIndices16(mesh.indices, shortIndices);
+
+		std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			util::ErrorMessageBox("Mesh cache \"" + filepath + "\" could not be created.");
+			return false;
+		}
+		const char padding[MESH_CACHE_ALIGNMENT] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(padding, header.vertexOffset - sizeof(header));
+		out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.ByteWidth());
+		out.write(padding, header.indexOffset - (header.vertexOffset + mesh.ByteWidth()));
+		if (mesh.ShortIndices())
+			out.write(reinterpret_cast<const char*>(shortIndices.data()), shortIndices.size() * sizeof(uint16_t));
+		else
+			out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(UINT));
+		out.write(padding, header.lodOffset - (header.indexOffset + mesh.IndexByteWidth()));
+		out.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(MeshCacheLOD));
+		if (!out.good())
+		{
+			util::ErrorMessageBox("Failed to write mesh cache \"" + filepath + "\".");
+			return false;
+		}
+		return true;
+	}
+
+	bool ConvertObjToMeshCache(const std::string& objpath, const std::string& cachepath, UINT threads)
+	{
+		ObjLoader loader(threads);
+		Mesh mesh;
+		if (!loader.MeshFromFile(mesh, objpath.c_str()))
+			return false;
+		OptimizeMesh(mesh);
+		LODChain lods;
+		BuildLODChain(mesh, DefaultLODRatios(), lods);
+		PackLODs(lods, mesh);
+		return WriteMeshCache(mesh, cachepath, objpath, &lods);
+	}
+
+	MeshCacheTimings BenchmarkMeshCache(const std::string& objpath, const std::string& cachepath, int repeats)
+	{
+		MeshCacheTimings timings;
+		volatile UINT sink = 0; //keeps the reads of the cache from being optimized away
+
+		//OBJ: parse into a mesh
+		auto loadObj = [&]()
+		{
+			ObjLoader loader;
+			Mesh mesh;
+			util::DeltaTimer timer;
+			loader.MeshFromFile(mesh, objpath.c_str());
+			const float ms = timer.GetElapsed() * 1000.0f;
+			timings.objBytes = loader.GetStats().bytes;
+			return ms;
+		};
+		//Cache: map and read every byte that would be handed to CreateBuffer
+		auto loadCache = [&]()
+		{
+			MeshCache cache;
+			util::DeltaTimer timer;
+			if (cache.Open(cachepath))
+			{
+				UINT sum = 0;
+				const UINT* words = reinterpret_cast<const UINT*>(cache.Vertices());
+				for (size_t i = 0; i < cache.ByteWidth() / sizeof(UINT); ++i)
+					sum += words[i];
+				const unsigned char* indices = static_cast<const unsigned char*>(cache.Indices());
+				for (size_t i = 0; i < cache.IndexByteWidth(); ++i)
+					sum += indices[i];
+				sink = sink + sum;
+				timings.cacheBytes = static_cast<size_t>(cache.Header().fileSize);
+			}
+			return timer.GetElapsed() * 1000.0f;
+		};
+
+		EvictFromFileCache(objpath);
+		timings.objCold = loadObj();
+		EvictFromFileCache(cachepath);
+		timings.cacheCold = loadCache();
+
+		timings.objWarm = timings.cacheWarm = FLT_MAX;
+		for (int r = 0; r < repeats; ++r)
+		{
+			timings.objWarm = std::min(timings.objWarm, loadObj());
+			timings.cacheWarm = std::min(timings.cacheWarm, loadCache());
+		}
+		return timings;
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "pch.h"
+
+#include "MappedFile.h"
+#include "CustomDataTypes.h"
+#include "MeshSimplifier.h"
+
+namespace dxh
+{
+	//Binary mesh cache (.dxhm). Layout of the file:
+	//	MeshCacheHeader
+	//	vertex blob, vertexCount * sizeof(Vertex), the exact dxh::Vertex layout
+	//	index blob, indexCount * indexStride, 16 bit when every vertex fits, see Mesh::ShortIndices
+	//	LOD table, lodCount * MeshCacheLOD, level 0 first, every level a range of the index blob
+	//Blobs start at MESH_CACHE_ALIGNMENT byte offsets so they can be read in place from the mapping.
+	//Files are written in native byte order, they are a cache and not an exchange format.
+	const char MESH_CACHE_MAGIC[4] = { 'D', 'X', 'H', 'M' };
+	const UINT MESH_CACHE_VERSION = 4;	//2: OBJ imports reverse the corners along with z, 3: source stamp, 4: LOD table
+	const UINT MESH_CACHE_ALIGNMENT = 64;
+
+	struct MeshCacheHeader
+	{
+		char magic[4];
+		UINT version;
+		UINT headerSize;	//sizeof(MeshCacheHeader) of the writer
+		UINT vertexStride;	//sizeof(Vertex) of the writer
+		UINT indexStride;	//2 or 4
+		UINT vertexCount;
+		UINT indexCount;
+		UINT lodCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t lodOffset;
+		uint64_t fileSize;
+		uint64_t sourceSize;		//of the file the mesh was converted from, 0 when there was none
+		int64_t sourceModified;		//its modification time, the cache is stale when either differs
+		float boundsMin[3];
+		float boundsMax[3];
+		float boundsRadius;	//around the center of the box
+		char name[64];		//null terminated, truncated
+	};
+
+	//One level of detail, the fields of MeshLOD without the mesh
+	struct MeshCacheLOD
+	{
+		UINT firstIndex;
+		UINT indexCount;
+		float error;
+		float ratio;
+	};
+
+	//A mapped .dxhm file. Vertices() and Indices() point into the mapping and can be passed
+	//straight to D3D11_SUBRESOURCE_DATA::pSysMem, they are valid until Close or destruction.
+	class MeshCache
+	{
+	public:
+		MeshCache() : header(nullptr) {}
+		~MeshCache() {}
+		MeshCache(const MeshCache&) = delete;
+		MeshCache& operator=(const MeshCache&) = delete;
+
+		//maps and validates the file, false if it is missing, truncated or from another version.
+		//With sourcepath also false when that file changed since the cache was written from it.
+		bool Open(const std::string& filepath, const std::string& sourcepath = "");
+		void Close() { file.Close(); header = nullptr; }
+		bool IsOpen() const { return header != nullptr; }
+
+		const MeshCacheHeader& Header() const { return *header; }
+		std::string Name() const { return header->name; }
+		const Vertex* Vertices() const { return reinterpret_cast<const Vertex*>(file.Data() + header->vertexOffset); }
+		UINT VertexCount() const { return header->vertexCount; }
+		const void* Indices() const { return file.Data() + header->indexOffset; }
+		UINT IndexCount() const { return header->indexCount; }
+		UINT ByteWidth() const { return header->vertexCount * header->vertexStride; }
+		UINT IndexByteWidth() const { return header->indexCount * header->indexStride; }
+		bool ShortIndices() const { return header->indexStride == sizeof(uint16_t); }
+		UINT LODCount() const { return header->lodCount; }
+		const MeshCacheLOD& LOD(UINT level) const { return reinterpret_cast<const MeshCacheLOD*>(file.Data() + header->lodOffset)[level]; }
+		Bounds GetBounds() const;
+
+		//copies the cache into a regular mesh, for code that needs to modify it
+		void ToMesh(Mesh& mesh) const;
+		//the levels with their index ranges, errors and ratios, their meshes stay empty
+		void ToLODChain(LODChain& chain) const;
+
+	private:
+		util::MappedFile file;
+		const MeshCacheHeader* header;
+	};
+
+	//Writes mesh to filepath in the cache format, stamped with the size and time of sourcepath when given.
+	//lods are the levels PackLODs packed into mesh, without them the whole mesh is the only level.
+	bool WriteMeshCache(const Mesh& mesh, const std::string& filepath, const std::string& sourcepath = "", const LODChain* lods = nullptr);
+	//Converter: loads an OBJ, optimizes it for the vertex cache, cuts the default LODs and writes them packed as a .dxhm
+	bool ConvertObjToMeshCache(const std::string& objpath, const std::string& cachepath, UINT threads = 0);
+
+	//Load times in milliseconds. Cold is the first load after the file was dropped from the OS
+	//file cache (only possible on POSIX, elsewhere it is the first load of the process), warm is
+	//the best of repeats. Both formats are read completely so page faults of the mapping count.
+	struct MeshCacheTimings
+	{
+		size_t objBytes = 0;
+		size_t cacheBytes = 0;
+		float objCold = 0.0f;
+		float objWarm = 0.0f;
+		float cacheCold = 0.0f;
+		float cacheWarm = 0.0f;
+	};
+	MeshCacheTimings BenchmarkMeshCache(const std::string& objpath, const std::string& cachepath, int repeats = 5);
+}
@@ -0,0 +1,314 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	// Forsyth scoring, values from the paper
+	const size_t LRU_CACHE_SIZE = 32;
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRI_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	float VertexScore(int cachePos, UINT remaining)
+	{
+		if (remaining == 0)
+			return -1.0f; //no triangles left, never pick it again
+
+		float score = 0.0f;
+		if (cachePos >= 0)
+		{
+			if (cachePos < 3) //used by the last triangle, fixed score so strips are not favoured over fans
+				score = LAST_TRI_SCORE;
+			else
+				score = std::pow(1.0f - float(cachePos - 3) / float(LRU_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		//boost vertices with few triangles left so lone triangles are not left behind
+		return score + VALENCE_BOOST_SCALE * std::pow(float(remaining), -VALENCE_BOOST_POWER);
+	}
+
+	bool IndicesValid(const std::vector<UINT>& indices, size_t vertexCount)
+	{
+		for (UINT i : indices)
+			if (i >= vertexCount)
+				return false;
+		return true;
+	}
+
+	dxh::float3 Cross(const dxh::float3& a, const dxh::float3& b)
+	{
+		return dxh::float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+}
+
+namespace dxh
+{
+	CacheStats AnalyzeVertexCache(const std::vector<UINT>& indices, size_t vertexCount, UINT cacheSize)
+	{
+		CacheStats stats;
+		const size_t triangles = indices.size() / 3;
+		if (triangles == 0 || vertexCount == 0)
+			return stats;
+
+		// A vertex is in the FIFO if fewer than cacheSize misses happened since it was last loaded
+		std::vector<UINT> loaded(vertexCount, 0);
+		std::vector<char> referenced(vertexCount, 0);
+		UINT time = cacheSize + 1;
+		size_t misses = 0, unique = 0;
+		for (size_t i = 0; i < triangles * 3; ++i)
+		{
+			const UINT v = indices[i];
+			if (v >= vertexCount)
+				continue;
+			if (time - loaded[v] > cacheSize)
+			{
+				loaded[v] = time++;
+				++misses;
+			}
+			if (!referenced[v])
+			{
+				referenced[v] = 1;
+				++unique;
+			}
+		}
+		stats.acmr = float(misses) / float(triangles);
+		stats.atvr = unique ? float(misses) / float(unique) : 0.0f;
+		return stats;
+	}
+
+	void OptimizeVertexCache(std::vector<UINT>& indices, size_t vertexCount)
+	{
+		const size_t triangles = indices.size() / 3;
+		if (triangles == 0 || !IndicesValid(indices, vertexCount))
+			return;
+
+		// Triangles using each vertex, the first remaining[v] entries are the ones not emitted yet
+		std::vector<UINT> remaining(vertexCount, 0);
+		for (size_t i = 0; i < triangles * 3; ++i)
+			++remaining[indices[i]];
+		std::vector<size_t> offset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			offset[v + 1] = offset[v] + remaining[v];
+		std::vector<UINT> adjacency(triangles * 3);
+		{
+			std::vector<size_t> fill(offset.begin(), offset.end() - 1);
+			for (size_t i = 0; i < triangles * 3; ++i)
+				adjacency[fill[indices[i]]++] = static_cast<UINT>(i / 3);
+		}
+
+		std::vector<int> cachePos(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			vertexScore[v] = VertexScore(-1, remaining[v]);
+
+		std::vector<float> triangleScore(triangles);
+		std::vector<char> emitted(triangles, 0);
+		size_t best = 0;
+		for (size_t t = 0; t < triangles; ++t)
+		{
+			triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+			if (triangleScore[t] > triangleScore[best])
+				best = t;
+		}
+
+		std::vector<UINT> output;
+		output.reserve(triangles * 3);
+		UINT cache[LRU_CACHE_SIZE + 3];
+		size_t cacheCount = 0;
+		size_t scan = 0; //first triangle that might not be emitted, used when the cache runs dry
+		const size_t NONE = ~size_t(0);
+
+		while (output.size() < triangles * 3)
+		{
+			if (best == NONE)
+			{
+				// Nothing in the cache has triangles left, start over at the best scoring triangle.
+				// Scores are current: every vertex whose score changed was in the cache and rescored its triangles.
+				while (emitted[scan])
+					++scan;
+				best = scan;
+				for (size_t t = scan + 1; t < triangles; ++t)
+					if (!emitted[t] && triangleScore[t] > triangleScore[best])
+						best = t;
+			}
+
+			const UINT* tri = &indices[best * 3];
+			emitted[best] = 1;
+			output.insert(output.end(), tri, tri + 3);
+
+			// Drop the triangle from its vertices' lists
+			for (int c = 0; c < 3; ++c)
+			{
+				const UINT v = tri[c];
+				UINT* list = &adjacency[offset[v]];
+				for (UINT i = 0; i < remaining[v]; ++i)
+				{
+					if (list[i] == best)
+					{
+						list[i] = list[remaining[v] - 1];
+						--remaining[v];
+						break;
+					}
+				}
+			}
+
+			// Move the triangle's vertices to the front of the LRU cache
+			UINT next[LRU_CACHE_SIZE + 3];
+			size_t nextCount = 0;
+			for (int c = 0; c < 3; ++c)
+				if (std::find(next, next + nextCount, tri[c]) == next + nextCount)
+					next[nextCount++] = tri[c];
+			for (size_t i = 0; i < cacheCount; ++i)
+				if (std::find(next, next + nextCount, cache[i]) == next + nextCount)
+					next[nextCount++] = cache[i];
+
+			for (size_t i = 0; i < nextCount; ++i)
+			{
+				const UINT v = next[i];
+				cachePos[v] = i < LRU_CACHE_SIZE ? static_cast<int>(i) : -1; //the ones past the end were evicted
+				vertexScore[v] = VertexScore(cachePos[v], remaining[v]);
+			}
+			cacheCount = std::min(nextCount, LRU_CACHE_SIZE);
+			std::copy(next, next + cacheCount, cache);
+
+			// Rescore the triangles touching the cache and pick the best one
+			best = NONE;
+			float bestScore = -1.0f;
+			for (size_t i = 0; i < nextCount; ++i)
+			{
+				const UINT v = next[i];
+				for (UINT a = 0; a < remaining[v]; ++a)
+				{
+					const UINT t = adjacency[offset[v] + a];
+					const float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					triangleScore[t] = score;
+					if (score > bestScore)
+					{
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+		}
+
+		indices.swap(output);
+	}
+
+	void OptimizeOverdraw(std::vector<UINT>& indices, const std::vector<Vertex>& vertices)
+	{
+		const size_t triangles = indices.size() / 3;
+		if (triangles < 2 || !IndicesValid(indices, vertices.size()))
+			return;
+
+		// Split into runs where a triangle misses the cache on all three vertices, i.e. the cache order jumped
+		std::vector<size_t> runStart;
+		std::vector<UINT> loaded(vertices.size(), 0);
+		UINT time = FIFO_CACHE_SIZE + 1;
+		for (size_t t = 0; t < triangles; ++t)
+		{
+			int misses = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				const UINT v = indices[t * 3 + c];
+				if (time - loaded[v] > FIFO_CACHE_SIZE)
+				{
+					loaded[v] = time++;
+					++misses;
+				}
+			}
+			if (t == 0 || misses == 3)
+				runStart.push_back(t);
+		}
+		if (runStart.size() < 2)
+			return;
+		runStart.push_back(triangles);
+
+		float3 meshCenter;
+		for (const Vertex& v : vertices)
+			meshCenter = meshCenter + v.pos;
+		meshCenter = meshCenter * (1.0f / vertices.size());
+
+		// Runs whose area weighted normal points away from the mesh center are drawn first
+		const size_t runs = runStart.size() - 1;
+		std::vector<float> key(runs);
+		for (size_t r = 0; r < runs; ++r)
+		{
+			float3 center, normal;
+			float area = 0.0f;
+			for (size_t t = runStart[r]; t < runStart[r + 1]; ++t)
+			{
+				const float3& a = vertices[indices[t * 3]].pos;
+				const float3& b = vertices[indices[t * 3 + 1]].pos;
+				const float3& c = vertices[indices[t * 3 + 2]].pos;
+				const float3 n = Cross(b - a, c - a); //points out of the front face, length is twice the area
+				const float w = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+				center = center + (a + b + c) * (w / 3.0f);
+				normal = normal + n;
+				area += w;
+			}
+			if (area > 0.0f)
+				center = center * (1.0f / area);
+			const float3 out = center - meshCenter;
+			const float len = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+			key[r] = len > 0.0f ? (out.x * normal.x + out.y * normal.y + out.z * normal.z) / len : 0.0f;
+		}
+
+		std::vector<size_t> order(runs);
+		for (size_t r = 0; r < runs; ++r)
+			order[r] = r;
+		std::stable_sort(order.begin(), order.end(), [&key](size_t a, size_t b) { return key[a] > key[b]; });
+
+		std::vector<UINT> output;
+		output.reserve(indices.size());
+		for (size_t r : order)
+			output.insert(output.end(), indices.begin() + runStart[r] * 3, indices.begin() + runStart[r + 1] * 3);
+		indices.swap(output);
+	}
+
+	void OptimizeVertexFetch(Mesh& mesh)
+	{
+		const size_t vertexCount = mesh.vertices.size();
+		if (!IndicesValid(mesh.indices, vertexCount))
+			return;
+
+		const UINT UNUSED = ~0u;
+		std::vector<UINT> remap(vertexCount, UNUSED);
+		UINT next = 0;
+		for (UINT i : mesh.indices)
+			if (remap[i] == UNUSED)
+				remap[i] = next++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			if (remap[v] == UNUSED)
+				remap[v] = next++;
+
+		std::vector<Vertex> reordered(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			reordered[remap[v]] = mesh.vertices[v];
+		for (UINT& i : mesh.indices)
+			i = remap[i];
+		mesh.vertices.swap(reordered);
+	}
+
+	MeshOptimizeStats OptimizeMesh(Mesh& mesh)
+	{
+		MeshOptimizeStats stats;
+		stats.before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+		stats.indexBytesBefore = mesh.indices.size() * sizeof(UINT);
+
+		OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+		OptimizeOverdraw(mesh.indices, mesh.vertices);
+		OptimizeVertexFetch(mesh);
+
+		stats.after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+		stats.shortIndices = mesh.ShortIndices();
+		stats.indexBytesAfter = mesh.IndexByteWidth();
+		return stats;
+	}
+
+	void PackIndices16(const std::vector<UINT>& indices, std::vector<uint16_t>& packed)
+	{
+		packed.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+			packed[i] = static_cast<uint16_t>(indices[i]);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//Vertex cache efficiency of an index buffer, simulated with a FIFO post-transform cache
+	struct CacheStats
+	{
+		float acmr = 0.0f;	//average cache miss ratio, vertex shader runs per triangle (0.5 is ideal, 3 is worst)
+		float atvr = 0.0f;	//average transform to vertex ratio, vertex shader runs per referenced vertex (1 is ideal)
+	};
+
+	struct MeshOptimizeStats
+	{
+		CacheStats before;
+		CacheStats after;
+		bool shortIndices = false;		//the mesh can be drawn with DXGI_FORMAT_R16_UINT
+		size_t indexBytesBefore = 0;	//as 32 bit indices
+		size_t indexBytesAfter = 0;		//with the index format the mesh will be uploaded with
+	};
+
+	const UINT FIFO_CACHE_SIZE = 16;
+
+	CacheStats AnalyzeVertexCache(const std::vector<UINT>& indices, size_t vertexCount, UINT cacheSize = FIFO_CACHE_SIZE);
+
+	//Reorders triangles for post-transform cache hits (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+	void OptimizeVertexCache(std::vector<UINT>& indices, size_t vertexCount);
+	//Reorders runs of triangles so outward facing parts of the mesh come first and hide what is behind them.
+	//Call after OptimizeVertexCache, runs are only split where the cache order already starts over.
+	void OptimizeOverdraw(std::vector<UINT>& indices, const std::vector<Vertex>& vertices);
+	//Reorders vertices into the order the index buffer first uses them and remaps the indices.
+	//Vertices no triangle uses are moved to the end.
+	void OptimizeVertexFetch(Mesh& mesh);
+
+	//All of the above in order, returns cache numbers from before and after
+	MeshOptimizeStats OptimizeMesh(Mesh& mesh);
+
+	//Copies indices into 16 bit storage, only valid when mesh.ShortIndices() is true
+	void PackIndices16(const std::vector<UINT>& indices, std::vector<uint16_t>& packed);
+}
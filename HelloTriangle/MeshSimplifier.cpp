@@ -0,0 +1,687 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+
+#include "MeshOptimizer.h"
+#include "Parallel.h"
+#include "Utilities.h"
+
+namespace
+{
+	const double BOUNDARY_WEIGHT = 10.0;	//of the planes holding seams and borders in place, against the triangle planes
+	const float MAX_ROTATION = 0.25f;		//cosine, triangles may turn by up to about 75 degrees in a collapse
+	const UINT NONE = ~0u;
+
+	dxh::float3 Cross(const dxh::float3& a, const dxh::float3& b)
+	{
+		return dxh::float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float Dot(const dxh::float3& a, const dxh::float3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	//Sum of squared distances to weighted planes, as the symmetric 4x4 matrix of the plane products
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+		double weight = 0;
+
+		void AddPlane(double a, double b, double c, double d, double w)
+		{
+			a2 += w * a * a, ab += w * a * b, ac += w * a * c, ad += w * a * d;
+			b2 += w * b * b, bc += w * b * c, bd += w * b * d;
+			c2 += w * c * c, cd += w * c * d;
+			d2 += w * d * d;
+			weight += w;
+		}
+		void Add(const Quadric& q)
+		{
+			a2 += q.a2, ab += q.ab, ac += q.ac, ad += q.ad, b2 += q.b2, bc += q.bc, bd += q.bd, c2 += q.c2, cd += q.cd, d2 += q.d2;
+			weight += q.weight;
+		}
+		//mean squared distance of p to the planes
+		double Error(const dxh::float3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			const double e = a2 * x * x + b2 * y * y + c2 * z * z + d2
+				+ 2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+			return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+		}
+	};
+
+	enum class VertexKind : unsigned char
+	{
+		Manifold,	//inside a surface with one uv and normal, moves onto any neighbour
+		Boundary,	//on a seam or border line, only moves along it
+		Locked,		//corners, ends of lines and non-manifold spots
+	};
+
+	struct Collapse
+	{
+		double cost;
+		UINT from, to;	//positions
+		UINT version;	//of from when the cost was computed
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	//Edge collapse simplification over positions. Vertices that share a position (uv or normal seams)
+	//move together, every one of them onto the vertex of the target position on its own side of the seam.
+	class Simplifier
+	{
+	public:
+		explicit Simplifier(const dxh::Mesh& _mesh) : mesh(_mesh), indices(_mesh.indices)
+		{
+			WeldPositions();
+			ClassifyEdges();
+			BuildQuadrics();
+		}
+
+		size_t Triangles() const { return triangles; }
+		float Error() const { return static_cast<float>(std::sqrt(maxError)); }
+
+		//collapses until target triangles are left, the heap is empty or the cheapest collapse costs more than maxError
+		void Run(size_t target, double maxErrorSquared)
+		{
+			if (!started)
+			{
+				for (UINT p = 0; p < positions.size(); ++p)
+					PushCandidate(p);
+				started = true;
+			}
+			while (triangles > target && !heap.empty())
+			{
+				const Collapse top = heap.top();
+				if (top.cost > maxErrorSquared)
+					break;
+				heap.pop();
+				if (!alive[top.from] || !alive[top.to] || top.version != version[top.from])
+					continue;
+				if (!TryCollapse(top.from, top.to))
+					continue;
+				maxError = std::max(maxError, top.cost);
+			}
+		}
+
+		//alive triangles and the vertices they use
+		void Write(dxh::Mesh& out) const
+		{
+			std::vector<UINT> remap(mesh.vertices.size(), NONE);
+			out.vertices.clear();
+			out.indices.clear();
+			out.name = mesh.name;
+			for (size_t t = 0; t < triangleAlive.size(); ++t)
+			{
+				if (!triangleAlive[t])
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					const UINT v = indices[t * 3 + k];
+					if (remap[v] == NONE)
+					{
+						remap[v] = static_cast<UINT>(out.vertices.size());
+						out.vertices.push_back(mesh.vertices[v]);
+					}
+					out.indices.push_back(remap[v]);
+				}
+			}
+			out.UpdateBounds();
+		}
+
+	private:
+		UINT PositionOf(UINT vertex) const { return positionOf[vertex]; }
+
+		void WeldPositions()
+		{
+			// Exact matches only, a seam is where the same point has different uv or normal
+			struct Key
+			{
+				float x, y, z;
+				bool operator==(const Key& o) const { return x == o.x && y == o.y && z == o.z; }
+			};
+			struct KeyHash
+			{
+				size_t operator()(const Key& k) const
+				{
+					uint32_t bits[3];
+					std::memcpy(bits, &k, sizeof(bits));
+					return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+				}
+			};
+			std::unordered_map<Key, UINT, KeyHash> lookup;
+			lookup.reserve(mesh.vertices.size());
+			positionOf.resize(mesh.vertices.size());
+			for (UINT v = 0; v < mesh.vertices.size(); ++v)
+			{
+				const dxh::float3& p = mesh.vertices[v].pos;
+				const Key key = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f }; // + 0 turns -0 into 0
+				auto found = lookup.find(key);
+				if (found == lookup.end())
+				{
+					found = lookup.emplace(key, static_cast<UINT>(positions.size())).first;
+					positions.push_back(p);
+				}
+				positionOf[v] = found->second;
+			}
+			const size_t count = positions.size();
+			alive.assign(count, 1);
+			version.assign(count, 0);
+			kind.assign(count, VertexKind::Manifold);
+			boundary.assign(count, { NONE, NONE });
+			trianglesOf.resize(count);
+			quadrics.resize(count);
+
+			triangles = indices.size() / 3;
+			triangleAlive.assign(triangles, 1);
+			for (UINT t = 0; t < triangles; ++t)
+			{
+				const UINT a = PositionOf(indices[t * 3]), b = PositionOf(indices[t * 3 + 1]), c = PositionOf(indices[t * 3 + 2]);
+				if (a == b || b == c || c == a)
+				{
+					triangleAlive[t] = 0; // already degenerate
+					continue;
+				}
+				trianglesOf[a].push_back(t);
+				trianglesOf[b].push_back(t);
+				trianglesOf[c].push_back(t);
+			}
+			triangles = std::count(triangleAlive.begin(), triangleAlive.end(), 1);
+		}
+
+		void ClassifyEdges()
+		{
+			// Every edge by its two positions: how many triangles use it and whether they agree on its vertices
+			struct Edge
+			{
+				UINT count = 0;
+				UINT va = NONE, vb = NONE;	//vertices of the first triangle, va at the lower position
+				UINT triangle = NONE;
+				bool seam = false;
+			};
+			std::unordered_map<uint64_t, Edge> edges;
+			edges.reserve(triangles * 3);
+			for (UINT t = 0; t < triangleAlive.size(); ++t)
+			{
+				if (!triangleAlive[t])
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					UINT va = indices[t * 3 + k], vb = indices[t * 3 + (k + 1) % 3];
+					UINT a = PositionOf(va), b = PositionOf(vb);
+					if (a > b)
+						std::swap(a, b), std::swap(va, vb);
+					Edge& edge = edges[(uint64_t(a) << 32) | b];
+					if (edge.count++ == 0)
+						edge.va = va, edge.vb = vb, edge.triangle = t;
+					else if (edge.va != va || edge.vb != vb)
+						edge.seam = true;
+				}
+			}
+
+			std::vector<UINT> seamEdges(positions.size(), 0), borderEdges(positions.size(), 0);
+			for (const auto& entry : edges)
+			{
+				const UINT a = static_cast<UINT>(entry.first >> 32), b = static_cast<UINT>(entry.first & 0xffffffffu);
+				const Edge& edge = entry.second;
+				if (edge.count > 2)
+				{
+					kind[a] = kind[b] = VertexKind::Locked;
+					continue;
+				}
+				const bool border = edge.count == 1;
+				if (!border && !edge.seam)
+					continue;
+				(border ? borderEdges : seamEdges)[a]++;
+				(border ? borderEdges : seamEdges)[b]++;
+				AddBoundaryNeighbour(a, b);
+				AddBoundaryNeighbour(b, a);
+				AddEdgePlane(a, b, edge.triangle);
+			}
+
+			// A boundary vertex has to sit on one line of one kind, anything else is a corner
+			for (UINT p = 0; p < positions.size(); ++p)
+			{
+				if (kind[p] == VertexKind::Locked)
+					continue;
+				const UINT lines = seamEdges[p] + borderEdges[p];
+				if (lines == 0)
+					kind[p] = VertexKind::Manifold;
+				else if ((seamEdges[p] == 2 || borderEdges[p] == 2) && lines == 2)
+					kind[p] = VertexKind::Boundary;
+				else
+					kind[p] = VertexKind::Locked;
+			}
+			// Split attributes without a seam line are not worth the trouble
+			std::vector<UINT> firstVertex(positions.size(), NONE);
+			for (UINT v = 0; v < positionOf.size(); ++v)
+			{
+				const UINT p = PositionOf(v);
+				if (firstVertex[p] == NONE)
+					firstVertex[p] = v;
+				else if (firstVertex[p] != v && kind[p] == VertexKind::Manifold && Used(v) && Used(firstVertex[p]))
+					kind[p] = VertexKind::Locked;
+			}
+		}
+
+		bool Used(UINT vertex) const
+		{
+			for (UINT t : trianglesOf[PositionOf(vertex)])
+				if (indices[t * 3] == vertex || indices[t * 3 + 1] == vertex || indices[t * 3 + 2] == vertex)
+					return true;
+			return false;
+		}
+
+		void AddBoundaryNeighbour(UINT p, UINT neighbour)
+		{
+			std::pair<UINT, UINT>& line = boundary[p];
+			if (line.first == NONE)
+				line.first = neighbour;
+			else if (line.second == NONE)
+				line.second = neighbour;
+		}
+
+		//plane through the edge, upright on its triangle, keeps the line from moving sideways
+		void AddEdgePlane(UINT a, UINT b, UINT triangle)
+		{
+			const dxh::float3& p0 = positions[PositionOf(indices[triangle * 3])];
+			const dxh::float3& p1 = positions[PositionOf(indices[triangle * 3 + 1])];
+			const dxh::float3& p2 = positions[PositionOf(indices[triangle * 3 + 2])];
+			const dxh::float3 normal = Cross(p1 - p0, p2 - p0);
+			const dxh::float3 edge = positions[b] - positions[a];
+			dxh::float3 side = Cross(edge, normal);
+			const float length = std::sqrt(Dot(side, side));
+			if (length == 0.0f)
+				return;
+			side = side * (1.0f / length);
+			const double d = -Dot(side, positions[a]);
+			const double w = Dot(edge, edge) * BOUNDARY_WEIGHT;
+			quadrics[a].AddPlane(side.x, side.y, side.z, d, w);
+			quadrics[b].AddPlane(side.x, side.y, side.z, d, w);
+		}
+
+		void BuildQuadrics()
+		{
+			for (UINT t = 0; t < triangleAlive.size(); ++t)
+			{
+				if (!triangleAlive[t])
+					continue;
+				const UINT a = PositionOf(indices[t * 3]), b = PositionOf(indices[t * 3 + 1]), c = PositionOf(indices[t * 3 + 2]);
+				const dxh::float3 normal = Cross(positions[b] - positions[a], positions[c] - positions[a]);
+				const float length = std::sqrt(Dot(normal, normal));
+				if (length == 0.0f)
+					continue;
+				const dxh::float3 n = normal * (1.0f / length);
+				const double d = -Dot(n, positions[a]);
+				const double area = 0.5 * length;
+				quadrics[a].AddPlane(n.x, n.y, n.z, d, area);
+				quadrics[b].AddPlane(n.x, n.y, n.z, d, area);
+				quadrics[c].AddPlane(n.x, n.y, n.z, d, area);
+			}
+		}
+
+		//positions sharing an alive triangle with p
+		void Neighbours(UINT p, std::vector<UINT>& out) const
+		{
+			out.clear();
+			for (UINT t : trianglesOf[p])
+			{
+				if (!triangleAlive[t])
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					const UINT q = PositionOf(indices[t * 3 + k]);
+					if (q != p && std::find(out.begin(), out.end(), q) == out.end())
+						out.push_back(q);
+				}
+			}
+		}
+
+		bool CanMove(UINT from, UINT to) const
+		{
+			switch (kind[from])
+			{
+			case VertexKind::Manifold: return true;
+			case VertexKind::Boundary: return boundary[from].first == to || boundary[from].second == to;
+			default: return false;
+			}
+		}
+
+		double Cost(UINT from, UINT to) const
+		{
+			Quadric q = quadrics[from];
+			q.Add(quadrics[to]);
+			return q.Error(positions[to]);
+		}
+
+		void PushCandidate(UINT from)
+		{
+			version[from]++;
+			if (!alive[from] || kind[from] == VertexKind::Locked)
+				return;
+			Neighbours(from, scratch);
+			Collapse best = { DBL_MAX, from, NONE, version[from] };
+			for (UINT to : scratch)
+			{
+				if (!CanMove(from, to))
+					continue;
+				const double cost = Cost(from, to);
+				if (cost < best.cost)
+					best.cost = cost, best.to = to;
+			}
+			if (best.to != NONE)
+				heap.push(best);
+		}
+
+		bool TryCollapse(UINT from, UINT to)
+		{
+			// Where every vertex of from goes: the vertex of to it shares a triangle with, one per side of a seam
+			targets.clear();
+			for (UINT t : trianglesOf[from])
+			{
+				if (!triangleAlive[t])
+					continue;
+				UINT source = NONE, target = NONE;
+				for (int k = 0; k < 3; ++k)
+				{
+					const UINT v = indices[t * 3 + k];
+					if (PositionOf(v) == from)
+						source = v;
+					else if (PositionOf(v) == to)
+						target = v;
+				}
+				if (target == NONE)
+					continue;
+				bool known = false;
+				for (const std::pair<UINT, UINT>& pair : targets)
+				{
+					if (pair.first != source)
+						continue;
+					if (pair.second != target)
+						return false; //one vertex would need two different targets
+					known = true;
+				}
+				if (!known)
+					targets.push_back({ source, target });
+			}
+			if (targets.empty())
+				return false;
+
+			// The triangles on the edge lose their from corner, every other one needs a target for it
+			// and must not flip over
+			std::vector<UINT>& shared = scratch;
+			shared.clear();
+			for (UINT t : trianglesOf[from])
+			{
+				if (!triangleAlive[t])
+					continue;
+				dxh::float3 corners[3];
+				bool onEdge = false;
+				UINT source = NONE;
+				int moved = -1;
+				for (int k = 0; k < 3; ++k)
+				{
+					const UINT v = indices[t * 3 + k];
+					corners[k] = positions[PositionOf(v)];
+					if (PositionOf(v) == to)
+						onEdge = true;
+					if (PositionOf(v) == from)
+						source = v, moved = k;
+				}
+				if (onEdge)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						const UINT q = PositionOf(indices[t * 3 + k]);
+						if (q != from && q != to)
+							shared.push_back(q);
+					}
+					continue;
+				}
+				if (Target(source) == NONE)
+					return false;
+				const dxh::float3 before = Cross(corners[1] - corners[0], corners[2] - corners[0]);
+				corners[moved] = positions[to];
+				const dxh::float3 after = Cross(corners[1] - corners[0], corners[2] - corners[0]);
+				if (Dot(before, after) <= MAX_ROTATION * std::sqrt(Dot(before, before) * Dot(after, after)))
+					return false;
+			}
+
+			// Link condition: the only neighbours from and to have in common are the corners of their shared
+			// triangles, otherwise the collapse would pinch the surface
+			Neighbours(from, fromNeighbours);
+			Neighbours(to, toNeighbours);
+			for (UINT q : fromNeighbours)
+				if (q != to && std::find(toNeighbours.begin(), toNeighbours.end(), q) != toNeighbours.end()
+					&& std::find(shared.begin(), shared.end(), q) == shared.end())
+					return false;
+
+			for (UINT t : trianglesOf[from])
+			{
+				if (!triangleAlive[t])
+					continue;
+				bool onEdge = false;
+				for (int k = 0; k < 3; ++k)
+					onEdge |= PositionOf(indices[t * 3 + k]) == to;
+				if (onEdge)
+				{
+					triangleAlive[t] = 0;
+					triangles--;
+					continue;
+				}
+				for (int k = 0; k < 3; ++k)
+				{
+					UINT& v = indices[t * 3 + k];
+					if (PositionOf(v) == from)
+						v = Target(v);
+				}
+				trianglesOf[to].push_back(t);
+			}
+			trianglesOf[from].clear();
+			trianglesOf[from].shrink_to_fit();
+			quadrics[to].Add(quadrics[from]);
+			alive[from] = 0;
+
+			// A boundary vertex slid along its line, to now continues it where from did
+			if (kind[from] == VertexKind::Boundary && kind[to] == VertexKind::Boundary)
+			{
+				const UINT next = boundary[from].first == to ? boundary[from].second : boundary[from].first;
+				std::pair<UINT, UINT>& line = boundary[to];
+				if (line.first == from)
+					line.first = next;
+				else if (line.second == from)
+					line.second = next;
+				if (line.first == line.second)
+					kind[to] = VertexKind::Locked; //the line closed into a loop of two
+			}
+
+			Neighbours(to, toNeighbours);
+			PushCandidate(to);
+			for (UINT q : toNeighbours)
+				PushCandidate(q);
+			return true;
+		}
+
+		UINT Target(UINT source) const
+		{
+			for (const std::pair<UINT, UINT>& pair : targets)
+				if (pair.first == source)
+					return pair.second;
+			return NONE;
+		}
+
+		const dxh::Mesh& mesh;
+		std::vector<UINT> indices;				//working copy, collapsed vertices are replaced
+		std::vector<UINT> positionOf;			//by vertex
+		std::vector<dxh::float3> positions;
+		std::vector<char> alive;				//by position
+		std::vector<UINT> version;				//by position, bumped whenever its candidate is recomputed
+		std::vector<VertexKind> kind;			//by position
+		std::vector<std::pair<UINT, UINT>> boundary;	//by position, the neighbours along its seam or border
+		std::vector<std::vector<UINT>> trianglesOf;		//by position, dead triangles are skipped
+		std::vector<Quadric> quadrics;			//by position
+		std::vector<char> triangleAlive;
+		size_t triangles = 0;
+		double maxError = 0.0;
+		bool started = false;
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+		std::vector<std::pair<UINT, UINT>> targets;	//vertex of from, vertex of to
+		std::vector<UINT> scratch, fromNeighbours, toNeighbours;
+	};
+}
+
+namespace dxh
+{
+	SimplifyStats SimplifyMesh(const Mesh& mesh, Mesh& out, size_t targetTriangles, float maxError)
+	{
+		util::DeltaTimer timer;
+		SimplifyStats stats;
+		stats.trianglesIn = mesh.indices.size() / 3;
+		Simplifier simplifier(mesh);
+		simplifier.Run(targetTriangles, maxError == FLT_MAX ? DBL_MAX : double(maxError) * maxError);
+		simplifier.Write(out);
+		stats.trianglesOut = out.indices.size() / 3;
+		stats.error = simplifier.Error();
+		stats.seconds = timer.GetElapsed();
+		return stats;
+	}
+
+	const std::vector<float>& DefaultLODRatios()
+	{
+		static const std::vector<float> ratios = { 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f, 0.015625f };
+		return ratios;
+	}
+
+	void BuildLODChain(const Mesh& mesh, const std::vector<float>& ratios, LODChain& chain, float maxError)
+	{
+		chain.levels.clear();
+		chain.levels.emplace_back();
+		chain.levels[0].mesh = mesh;
+
+		const size_t triangles = mesh.indices.size() / 3;
+		Simplifier simplifier(mesh);
+		const double maxErrorSquared = maxError == FLT_MAX ? DBL_MAX : double(maxError) * maxError;
+		for (float ratio : ratios)
+		{
+			// One run of collapses, stopped at every target to take a copy
+			const size_t previous = chain.levels.back().mesh.indices.size() / 3;
+			simplifier.Run(static_cast<size_t>(triangles * ratio), maxErrorSquared);
+			if (simplifier.Triangles() >= previous || simplifier.Triangles() == 0)
+				break; //stuck on locked vertices or maxError, coarser targets would give the same mesh
+			MeshLOD level;
+			simplifier.Write(level.mesh);
+			OptimizeMesh(level.mesh);
+			level.ratio = triangles ? float(level.mesh.indices.size() / 3) / triangles : 0.0f;
+			level.error = simplifier.Error();
+			chain.levels.push_back(std::move(level));
+		}
+	}
+
+	void BuildLODChains(const std::vector<Mesh>& meshes, const std::vector<float>& ratios, std::vector<LODChain>& chains, unsigned int threads)
+	{
+		chains.resize(meshes.size());
+		util::ParallelFor(meshes.size(), 1, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					BuildLODChain(meshes[i], ratios, chains[i]);
+			}, threads);
+	}
+
+	void PackLODs(LODChain& chain, Mesh& packed)
+	{
+		packed.vertices.clear();
+		packed.indices.clear();
+		if (!chain.levels.empty())
+			packed.name = chain.levels[0].mesh.name;
+		for (MeshLOD& level : chain.levels)
+		{
+			const UINT base = static_cast<UINT>(packed.vertices.size());
+			level.firstIndex = static_cast<UINT>(packed.indices.size());
+			level.indexCount = static_cast<UINT>(level.mesh.indices.size());
+			packed.vertices.insert(packed.vertices.end(), level.mesh.vertices.begin(), level.mesh.vertices.end());
+			for (UINT index : level.mesh.indices)
+				packed.indices.push_back(base + index);
+		}
+		packed.UpdateBounds();
+	}
+
+	float PixelsPerUnit(const WVP& wvp, const float3& point, float viewportHeight)
+	{
+		const DirectX::XMFLOAT4X4& m = wvp.wvp;
+		const float w = m._41 * point.x + m._42 * point.y + m._43 * point.z + m._44;
+		// project._22 is the cotangent of half the vertical field of view
+		return w > 0.0f ? wvp.project._22 * 0.5f * viewportHeight / w : FLT_MAX;
+	}
+
+	size_t SelectLOD(const LODChain& chain, float pixelsPerUnit, float pixelError)
+	{
+		size_t selected = 0;
+		for (size_t i = 1; i < chain.levels.size(); ++i)
+			if (chain.levels[i].error * pixelsPerUnit <= pixelError)
+				selected = i;
+		return selected;
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	LODBenchmark BenchmarkLODs(size_t triangles, size_t objects)
+	{
+		// Unit uv sphere, the first and last column share positions but not uvs, so it has a seam.
+		// Each pole is one vertex, a fan of pole copies with their own u would lock the rings around it.
+		const UINT slices = std::max<UINT>(8, static_cast<UINT>(std::sqrt(triangles / 2.0)));
+		const UINT stacks = std::max<UINT>(4, slices / 2);
+		Mesh sphere;
+		sphere.vertices.push_back(Vertex(float3(0.0f, 1.0f, 0.0f), float3(0.0f, 1.0f, 0.0f), float2(0.5f, 0.0f)));
+		for (UINT s = 1; s < stacks; ++s)
+		{
+			const float theta = PI * s / stacks;
+			for (UINT i = 0; i <= slices; ++i)
+			{
+				const float phi = 2.0f * PI * (i % slices) / slices;
+				const float3 p(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				sphere.vertices.push_back(Vertex(p, p, float2(float(i) / slices, float(s) / stacks)));
+			}
+		}
+		sphere.vertices.push_back(Vertex(float3(0.0f, -1.0f, 0.0f), float3(0.0f, -1.0f, 0.0f), float2(0.5f, 1.0f)));
+		const UINT south = static_cast<UINT>(sphere.vertices.size() - 1);
+		auto index = [&](UINT s, UINT i) { return s == 0 ? 0 : s == stacks ? south : 1 + (s - 1) * (slices + 1) + i; };
+		for (UINT s = 0; s < stacks; ++s)
+			for (UINT i = 0; i < slices; ++i)
+			{
+				if (s > 0)
+					sphere.indices.insert(sphere.indices.end(), { index(s, i), index(s, i + 1), index(s + 1, i) });
+				if (s + 1 < stacks)
+					sphere.indices.insert(sphere.indices.end(), { index(s, i + 1), index(s + 1, i + 1), index(s + 1, i) });
+			}
+		sphere.UpdateBounds();
+
+		LODBenchmark result;
+		result.triangles = sphere.indices.size() / 3;
+		LODChain chain;
+		util::DeltaTimer timer;
+		BuildLODChain(sphere, DefaultLODRatios(), chain);
+		result.buildMs = timer.GetElapsed() * 1000.0f;
+		result.levels = chain.levels.size();
+		for (const MeshLOD& level : chain.levels)
+			result.errors.push_back(level.error);
+
+		// 90 degree field of view on a 1080 pixel high viewport, objects evenly spread in distance
+		WVP wvp;
+		wvp.project = DirectX::XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, -0.1f,
+			0.0f, 0.0f, 1.0f, 0.0f);
+		wvp.wvp = wvp.project;
+		result.objects = objects;
+		for (size_t i = 0; i < objects; ++i)
+		{
+			const float distance = 2.0f + 98.0f * i / std::max<size_t>(1, objects - 1);
+			const size_t level = SelectLOD(chain, PixelsPerUnit(wvp, float3(0.0f, 0.0f, distance), 1080.0f));
+			result.fullVertices += chain.levels[0].mesh.vertices.size();
+			result.selectedVertices += chain.levels[level].mesh.vertices.size();
+		}
+		return result;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//Geometric error is the root mean square distance, in the mesh's own units, from the collapsed vertices
+	//to the planes of the original triangles around them (Garland and Heckbert quadrics, area weighted).
+	//Vertices move onto a neighbour and keep its uv and normal. Vertices where uv or normal are split
+	//(seams) and open borders only slide along their seam or border, corners of either never move.
+	struct SimplifyStats
+	{
+		size_t trianglesIn = 0;
+		size_t trianglesOut = 0;
+		float error = 0.0f;
+		float seconds = 0.0f;
+	};
+
+	//Removes triangles until at most targetTriangles are left or the next collapse would exceed maxError
+	SimplifyStats SimplifyMesh(const Mesh& mesh, Mesh& out, size_t targetTriangles, float maxError = FLT_MAX);
+
+	struct MeshLOD
+	{
+		Mesh mesh;
+		float ratio = 1.0f;		//triangles relative to level 0
+		float error = 0.0f;		//geometric error against level 0
+		UINT firstIndex = 0;	//where the level starts in the mesh PackLODs wrote
+		UINT indexCount = 0;
+	};
+
+	//Level 0 is the mesh itself, the others get coarser. Levels that could not be simplified further
+	//than the one before are left out, so a chain can be shorter than the ratios asked for.
+	struct LODChain
+	{
+		std::vector<MeshLOD> levels;
+	};
+
+	const std::vector<float>& DefaultLODRatios(); //1/2, 1/4, 1/8 ... 1/64 of the triangles
+
+	//ratios are of the input triangles, descending. Every level is cut from one run of collapses, so
+	//the errors are against the full mesh and do not add up over the levels.
+	void BuildLODChain(const Mesh& mesh, const std::vector<float>& ratios, LODChain& chain, float maxError = FLT_MAX);
+	//one chain per mesh, the meshes are simplified in parallel
+	void BuildLODChains(const std::vector<Mesh>& meshes, const std::vector<float>& ratios, std::vector<LODChain>& chains, unsigned int threads = 0);
+	//Every level's vertices and indices in one mesh (indices already offset), for one vertex and index buffer.
+	//Fills firstIndex and indexCount of the levels.
+	void PackLODs(LODChain& chain, Mesh& packed);
+
+	//Screen pixels one unit of the mesh covers at point, wvp needs UpdateObjectMatrices.
+	//The w of clip space is the distance along the view direction for perspective projections.
+	float PixelsPerUnit(const WVP& wvp, const float3& point, float viewportHeight);
+	//coarsest level whose error stays within pixelError pixels
+	size_t SelectLOD(const LODChain& chain, float pixelsPerUnit, float pixelError = 1.0f);
+
+	struct LODBenchmark
+	{
+		size_t triangles = 0;			//of the test sphere
+		size_t levels = 0;
+		float buildMs = 0.0f;			//BuildLODChain with the default ratios
+		std::vector<float> errors;		//by level
+		size_t objects = 0;
+		size_t fullVertices = 0;		//vertex shader runs for every object at level 0
+		size_t selectedVertices = 0;	//with the level SelectLOD picks for each
+	};
+	//a uv sphere of about triangles, then objects copies of it spread between 2 and 100 units from the camera
+	LODBenchmark BenchmarkLODs(size_t triangles = 1 << 17, size_t objects = 1000);
+}
@@ -0,0 +1,201 @@
+#include "pch.h"
+#include "MeshSoA.h"
+
+#include "Utilities.h"
+
+namespace dxh
+{
+	// **********************************************************************************************************
+	// CONVERSION
+	// **********************************************************************************************************
+
+	void MeshSoA::Resize(size_t vertexCount)
+	{
+		for (Stream& s : pos) s.resize(vertexCount);
+		for (Stream& s : uv) s.resize(vertexCount);
+		for (Stream& s : normal) s.resize(vertexCount);
+	}
+
+	void MeshSoA::FromMesh(const Mesh& mesh)
+	{
+		name = mesh.name;
+		indices.assign(mesh.indices.begin(), mesh.indices.end());
+		Resize(mesh.vertices.size());
+
+		float* px = pos[0].data(); float* py = pos[1].data(); float* pz = pos[2].data();
+		float* tu = uv[0].data(); float* tv = uv[1].data();
+		float* nx = normal[0].data(); float* ny = normal[1].data(); float* nz = normal[2].data();
+		for (size_t i = 0, n = mesh.vertices.size(); i < n; ++i)
+		{
+			const Vertex& v = mesh.vertices[i];
+			px[i] = v.pos.x, py[i] = v.pos.y, pz[i] = v.pos.z;
+			tu[i] = v.uv.x, tv[i] = v.uv.y;
+			nx[i] = v.normal.x, ny[i] = v.normal.y, nz[i] = v.normal.z;
+		}
+	}
+
+	void MeshSoA::ToMesh(Mesh& mesh) const
+	{
+		mesh.name = name;
+		mesh.indices.assign(indices.begin(), indices.end());
+		mesh.vertices.resize(VertexCount());
+
+		for (size_t i = 0, n = VertexCount(); i < n; ++i)
+		{
+			Vertex& v = mesh.vertices[i];
+			v.pos.x = pos[0][i], v.pos.y = pos[1][i], v.pos.z = pos[2][i];
+			v.uv.x = uv[0][i], v.uv.y = uv[1][i];
+			v.normal.x = normal[0][i], v.normal.y = normal[1][i], v.normal.z = normal[2][i];
+		}
+		mesh.UpdateBounds();
+	}
+
+	// **********************************************************************************************************
+	// CPU PASSES
+	// **********************************************************************************************************
+
+	void TransformPositions(const MeshSoA& mesh, const DirectX::XMFLOAT4X4& m, float* outx, float* outy, float* outz)
+	{
+		const float* px = mesh.pos[0].data();
+		const float* py = mesh.pos[1].data();
+		const float* pz = mesh.pos[2].data();
+		const size_t n = mesh.VertexCount();
+		size_t i = 0;
+#if DXH_X86
+		__m128 r[3][4];
+		for (int row = 0; row < 3; ++row)
+			for (int col = 0; col < 4; ++col)
+				r[row][col] = _mm_set1_ps(m.m[row][col]);
+		float* out[3] = { outx, outy, outz };
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(px + i);
+			const __m128 y = _mm_loadu_ps(py + i);
+			const __m128 z = _mm_loadu_ps(pz + i);
+			__m128 res[3];
+			for (int row = 0; row < 3; ++row)
+				res[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[row][0], x), _mm_mul_ps(r[row][1], y)), _mm_add_ps(_mm_mul_ps(r[row][2], z), r[row][3]));
+			for (int row = 0; row < 3; ++row)
+				_mm_storeu_ps(out[row] + i, res[row]);
+		}
+#endif
+		for (; i < n; ++i)
+		{
+			const float x = px[i], y = py[i], z = pz[i];
+			outx[i] = m.m[0][0] * x + m.m[0][1] * y + m.m[0][2] * z + m.m[0][3];
+			outy[i] = m.m[1][0] * x + m.m[1][1] * y + m.m[1][2] * z + m.m[1][3];
+			outz[i] = m.m[2][0] * x + m.m[2][1] * y + m.m[2][2] * z + m.m[2][3];
+		}
+	}
+
+	void TransformPositions(const Mesh& mesh, const DirectX::XMFLOAT4X4& m, float3* out)
+	{
+		for (size_t i = 0, n = mesh.vertices.size(); i < n; ++i)
+		{
+			const float3& p = mesh.vertices[i].pos;
+			out[i].x = m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2] * p.z + m.m[0][3];
+			out[i].y = m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2] * p.z + m.m[1][3];
+			out[i].z = m.m[2][0] * p.x + m.m[2][1] * p.y + m.m[2][2] * p.z + m.m[2][3];
+		}
+	}
+
+	void ComputeBounds(const MeshSoA& mesh, float3& min, float3& max)
+	{
+		float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		const size_t n = mesh.VertexCount();
+		for (int c = 0; c < 3; ++c)
+		{
+			const float* p = mesh.pos[c].data();
+			size_t i = 0;
+#if DXH_X86
+			__m128 vlo = _mm_set1_ps(FLT_MAX);
+			__m128 vhi = _mm_set1_ps(-FLT_MAX);
+			for (; i + 4 <= n; i += 4)
+			{
+				const __m128 v = _mm_loadu_ps(p + i);
+				vlo = _mm_min_ps(vlo, v);
+				vhi = _mm_max_ps(vhi, v);
+			}
+			alignas(16) float l[4], h[4];
+			_mm_store_ps(l, vlo);
+			_mm_store_ps(h, vhi);
+			lo[c] = std::min(std::min(l[0], l[1]), std::min(l[2], l[3]));
+			hi[c] = std::max(std::max(h[0], h[1]), std::max(h[2], h[3]));
+#endif
+			for (; i < n; ++i)
+			{
+				lo[c] = std::min(lo[c], p[i]);
+				hi[c] = std::max(hi[c], p[i]);
+			}
+		}
+		min = float3(lo[0], lo[1], lo[2]);
+		max = float3(hi[0], hi[1], hi[2]);
+	}
+
+	void ComputeBounds(const Mesh& mesh, float3& min, float3& max)
+	{
+		float3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+		float3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const Vertex& v : mesh.vertices)
+		{
+			lo.x = std::min(lo.x, v.pos.x), lo.y = std::min(lo.y, v.pos.y), lo.z = std::min(lo.z, v.pos.z);
+			hi.x = std::max(hi.x, v.pos.x), hi.y = std::max(hi.y, v.pos.y), hi.z = std::max(hi.z, v.pos.z);
+		}
+		min = lo;
+		max = hi;
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	MeshLayoutTimings BenchmarkMeshLayouts(size_t vertexCount, int repeats)
+	{
+		MeshLayoutTimings timings;
+		timings.vertices = vertexCount;
+
+		Mesh aos;
+		aos.vertices.resize(vertexCount);
+		unsigned int seed = 1;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f; };
+		for (Vertex& v : aos.vertices)
+		{
+			v.pos = float3(random(), random(), random());
+			v.uv = float2(random(), random());
+			v.normal = float3(random(), random(), random());
+		}
+		MeshSoA soa(aos);
+
+		DirectX::XMFLOAT4X4 m;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				m.m[i][j] = i == j ? 2.0f : 0.25f;
+
+		std::vector<float3> aosOut(vertexCount);
+		MeshSoA::Stream soaOut[3];
+		for (MeshSoA::Stream& s : soaOut)
+			s.resize(vertexCount);
+		float3 lo, hi;
+		volatile float sink = 0.0f; //keeps the bounds from being optimized away
+
+		auto best = [repeats](float& result, auto&& pass)
+		{
+			result = FLT_MAX;
+			for (int r = 0; r < repeats; ++r)
+			{
+				util::DeltaTimer timer;
+				pass();
+				result = std::min(result, timer.GetElapsed() * 1000.0f);
+			}
+		};
+
+		best(timings.aosTransform, [&]() { TransformPositions(aos, m, aosOut.data()); });
+		best(timings.soaTransform, [&]() { TransformPositions(soa, m, soaOut[0].data(), soaOut[1].data(), soaOut[2].data()); });
+		best(timings.aosBounds, [&]() { ComputeBounds(aos, lo, hi); sink = sink + lo.x + hi.x; });
+		best(timings.soaBounds, [&]() { ComputeBounds(soa, lo, hi); sink = sink + lo.x + hi.x; });
+		best(timings.toSoA, [&]() { soa.FromMesh(aos); });
+		best(timings.toAoS, [&]() { soa.ToMesh(aos); });
+		return timings;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "pch.h"
+
+#include "Simd.h"
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//Structure of arrays version of dxh::Mesh. Every vertex component is its own 32 byte aligned stream,
+	//so CPU passes that only need positions (bounds, culling, transforms) read nothing else.
+	//dxh::Mesh stays the layout that is uploaded, see DXHandler::CreateInputLayout.
+	class MeshSoA
+	{
+	public:
+		typedef util::aligned_vector<float> Stream;
+
+		std::string name;
+		Stream pos[3];
+		Stream uv[2];
+		Stream normal[3];
+		std::vector<UINT> indices;
+
+		MeshSoA() { name = "unnamed"; }
+		explicit MeshSoA(const Mesh& mesh) { FromMesh(mesh); }
+
+		//both conversions write into the existing storage, only growing it when it is too small
+		void FromMesh(const Mesh& mesh);
+		void ToMesh(Mesh& mesh) const;
+
+		void Resize(size_t vertexCount);
+		size_t VertexCount() const { return pos[0].size(); }
+		size_t ByteWidth() const { return VertexCount() * sizeof(Vertex); } //same as Mesh::ByteWidth
+	};
+
+	//out = m * (pos, 1) for every vertex, m is stored the way WVP is uploaded (transposed, column vectors).
+	//outx/outy/outz need VertexCount() floats each and may alias the mesh positions.
+	void TransformPositions(const MeshSoA& mesh, const DirectX::XMFLOAT4X4& m, float* outx, float* outy, float* outz);
+	void TransformPositions(const Mesh& mesh, const DirectX::XMFLOAT4X4& m, float3* out);
+	//axis aligned bounds of the positions, min > max for an empty mesh
+	void ComputeBounds(const MeshSoA& mesh, float3& min, float3& max);
+	void ComputeBounds(const Mesh& mesh, float3& min, float3& max);
+
+	//AoS vs SoA timings in milliseconds, best of repeats
+	struct MeshLayoutTimings
+	{
+		size_t vertices = 0;
+		float aosTransform = 0.0f;
+		float soaTransform = 0.0f;
+		float aosBounds = 0.0f;
+		float soaBounds = 0.0f;
+		float toSoA = 0.0f;		//Mesh -> MeshSoA into already sized streams
+		float toAoS = 0.0f;		//MeshSoA -> Mesh into an already sized vertex array
+	};
+	MeshLayoutTimings BenchmarkMeshLayouts(size_t vertexCount = 1 << 20, int repeats = 10);
+}
@@ -0,0 +1,208 @@
+#include "pch.h"
+#include "MeshWeld.h"
+
+#include "Utilities.h"
+#include "Parallel.h"
+
+namespace
+{
+	const size_t PARALLEL_MIN = 1 << 16;	//smaller inputs are welded on one thread
+	const size_t HASH_GRAIN = 1 << 14;
+
+	//bit pattern of a float with -0 folded into 0 so they weld
+	inline UINT FloatBits(float f)
+	{
+		if (f == 0.0f)
+			return 0;
+		UINT bits;
+		memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+
+	struct VertexKey
+	{
+		long long pos[3];	//float bits, or the grid cell when welding with an epsilon
+		UINT uv[2];
+		UINT normal[3];
+
+		VertexKey(const dxh::Vertex& v, float invEpsilon)
+		{
+			const float p[3] = { v.pos.x, v.pos.y, v.pos.z };
+			for (int c = 0; c < 3; ++c)
+				pos[c] = invEpsilon > 0.0f ? std::llround(p[c] * invEpsilon) : FloatBits(p[c]);
+			uv[0] = FloatBits(v.uv.x), uv[1] = FloatBits(v.uv.y);
+			normal[0] = FloatBits(v.normal.x), normal[1] = FloatBits(v.normal.y), normal[2] = FloatBits(v.normal.z);
+		}
+		bool operator==(const VertexKey& k) const
+		{
+			return pos[0] == k.pos[0] && pos[1] == k.pos[1] && pos[2] == k.pos[2] &&
+				uv[0] == k.uv[0] && uv[1] == k.uv[1] &&
+				normal[0] == k.normal[0] && normal[1] == k.normal[1] && normal[2] == k.normal[2];
+		}
+		uint64_t Hash() const
+		{
+			//combine every word, then the splitmix64 finalizer so both halves are usable
+			uint64_t h = 0;
+			const uint64_t words[8] = { uint64_t(pos[0]), uint64_t(pos[1]), uint64_t(pos[2]), uv[0], uv[1], normal[0], normal[1], normal[2] };
+			for (uint64_t w : words)
+				h = (h ^ w) * 0x9E3779B97F4A7C15ull + (h >> 29);
+			h ^= h >> 30;
+			h *= 0xBF58476D1CE4E5B9ull;
+			h ^= h >> 27;
+			h *= 0x94D049BB133111EBull;
+			h ^= h >> 31;
+			return h;
+		}
+	};
+
+	//Finds the first vertex equal to each vertex and builds the welded vertex array and the remap table.
+	//The hash table is split into shards by the high bits of the hash, every shard is filled by one thread.
+	UINT Weld(const dxh::Vertex* vertices, size_t n, float epsilon, UINT threads, std::vector<UINT>& remap, std::vector<dxh::Vertex>& unique)
+	{
+		const float invEpsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+		if (threads == 0)
+			threads = util::HardwareThreads();
+		const UINT shards = n < PARALLEL_MIN ? 1 : std::min<UINT>(threads * 4, 256);
+
+		std::vector<uint64_t> hashes(n);
+		util::ParallelFor(n, HASH_GRAIN, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					hashes[i] = VertexKey(vertices[i], invEpsilon).Hash();
+			}, threads);
+
+		// Counting sort of the vertex indices by shard, keeping input order inside each shard
+		std::vector<UINT> order(n);
+		std::vector<size_t> shardStart(shards + 1, 0);
+		{
+			const size_t chunks = shards == 1 ? 1 : threads;
+			std::vector<size_t> counts(chunks * shards, 0);
+			util::ParallelFor(chunks, 1, [&](size_t begin, size_t end)
+				{
+					for (size_t c = begin; c < end; ++c)
+						for (size_t i = n * c / chunks; i < n * (c + 1) / chunks; ++i)
+							++counts[c * shards + (hashes[i] >> 32) % shards];
+				}, threads);
+
+			size_t total = 0;
+			for (UINT s = 0; s < shards; ++s)
+			{
+				shardStart[s] = total;
+				for (size_t c = 0; c < chunks; ++c)
+				{
+					const size_t count = counts[c * shards + s];
+					counts[c * shards + s] = total; //becomes the write position of this chunk in this shard
+					total += count;
+				}
+			}
+			shardStart[shards] = total;
+
+			util::ParallelFor(chunks, 1, [&](size_t begin, size_t end)
+				{
+					for (size_t c = begin; c < end; ++c)
+						for (size_t i = n * c / chunks; i < n * (c + 1) / chunks; ++i)
+							order[counts[c * shards + (hashes[i] >> 32) % shards]++] = static_cast<UINT>(i);
+				}, threads);
+		}
+
+		// Open addressing table per shard, maps every vertex to the first one equal to it
+		std::vector<UINT> first(n);
+		util::ParallelFor(shards, 1, [&](size_t begin, size_t end)
+			{
+				const UINT EMPTY = ~0u;
+				std::vector<UINT> table;
+				for (size_t s = begin; s < end; ++s)
+				{
+					const size_t count = shardStart[s + 1] - shardStart[s];
+					size_t size = 16;
+					while (size < count * 2)
+						size <<= 1;
+					table.assign(size, EMPTY);
+
+					for (size_t o = shardStart[s]; o < shardStart[s + 1]; ++o)
+					{
+						const UINT i = order[o];
+						const uint64_t hash = hashes[i];
+						size_t slot = hash & (size - 1);
+						for (;;)
+						{
+							const UINT other = table[slot];
+							if (other == EMPTY)
+							{
+								table[slot] = i;
+								first[i] = i;
+								break;
+							}
+							if (hashes[other] == hash && VertexKey(vertices[other], invEpsilon) == VertexKey(vertices[i], invEpsilon))
+							{
+								first[i] = other;
+								break;
+							}
+							slot = (slot + 1) & (size - 1);
+						}
+					}
+				}
+			}, threads);
+
+		// Number the unique vertices in input order
+		remap.resize(n);
+		unique.clear();
+		size_t uniqueCount = 0;
+		for (size_t i = 0; i < n; ++i)
+			uniqueCount += first[i] == i;
+		unique.reserve(uniqueCount);
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (first[i] == i)
+			{
+				remap[i] = static_cast<UINT>(unique.size());
+				unique.push_back(vertices[i]);
+			}
+			else
+			{
+				remap[i] = remap[first[i]];
+			}
+		}
+		return shards;
+	}
+}
+
+namespace dxh
+{
+	WeldStats WeldVertices(const std::vector<Vertex>& soup, Mesh& out, float positionEpsilon, UINT threads)
+	{
+		util::DeltaTimer timer;
+		WeldStats stats;
+		stats.verticesIn = soup.size();
+
+		// A trailing partial triangle is dropped before welding, its vertices would be left unreferenced
+		std::vector<Vertex> unique;
+		stats.shards = Weld(soup.data(), soup.size() - soup.size() % 3, positionEpsilon, threads, out.indices, unique);
+		out.vertices.swap(unique);
+		out.UpdateBounds();
+
+		stats.verticesOut = out.vertices.size();
+		stats.seconds = timer.GetElapsed();
+		return stats;
+	}
+
+	WeldStats WeldMesh(Mesh& mesh, float positionEpsilon, UINT threads)
+	{
+		util::DeltaTimer timer;
+		WeldStats stats;
+		stats.verticesIn = mesh.vertices.size();
+
+		std::vector<UINT> remap;
+		std::vector<Vertex> unique;
+		stats.shards = Weld(mesh.vertices.data(), mesh.vertices.size(), positionEpsilon, threads, remap, unique);
+		for (UINT& i : mesh.indices)
+			if (i < remap.size())
+				i = remap[i];
+		mesh.vertices.swap(unique);
+		mesh.UpdateBounds();
+
+		stats.verticesOut = mesh.vertices.size();
+		stats.seconds = timer.GetElapsed();
+		return stats;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	struct WeldStats
+	{
+		size_t verticesIn = 0;
+		size_t verticesOut = 0;
+		UINT shards = 0;		//hash table shards the input was split over, 1 means it ran on one thread
+		float seconds = 0.0f;
+	};
+
+	//Builds an indexed mesh from unindexed triangle soup (every three vertices are a triangle,
+	//a trailing partial triangle is ignored).
+	//Vertices with the same pos, uv and normal become one. With positionEpsilon > 0 positions are
+	//snapped to a grid of that size before comparing, uv and normal still have to match exactly.
+	//Output vertices keep the order they first appear in and the data of that first occurrence.
+	WeldStats WeldVertices(const std::vector<Vertex>& soup, Mesh& out, float positionEpsilon = 0.0f, UINT threads = 0);
+	//Same for an already indexed mesh, the indices are remapped
+	WeldStats WeldMesh(Mesh& mesh, float positionEpsilon = 0.0f, UINT threads = 0);
+}
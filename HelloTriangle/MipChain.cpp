@@ -0,0 +1,230 @@
+#include "pch.h"
+#include "MipChain.h"
+
+#include "Utilities.h"
+#include "Parallel.h"
+
+namespace
+{
+	const size_t ROW_GRAIN = 16;
+
+	//8 bit <-> 16 bit linear conversion tables, one pair for sRGB and one for plain values
+	struct ConversionTables
+	{
+		uint16_t srgbToLinear[256];
+		uint16_t plainToLinear[256];
+		unsigned char linearToSrgb[65536];
+		unsigned char linearToPlain[65536];
+
+		ConversionTables()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				const double c = i / 255.0;
+				const double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+				srgbToLinear[i] = static_cast<uint16_t>(l * 65535.0 + 0.5);
+				plainToLinear[i] = static_cast<uint16_t>(i * 257);
+			}
+			for (int i = 0; i < 65536; ++i)
+			{
+				const double l = i / 65535.0;
+				const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+				linearToSrgb[i] = static_cast<unsigned char>(std::min(255.0, c * 255.0 + 0.5));
+				linearToPlain[i] = static_cast<unsigned char>((i + 128) / 257);
+			}
+		}
+	};
+
+	const ConversionTables& Tables()
+	{
+		static const ConversionTables tables;
+		return tables;
+	}
+
+	//per channel tables for one image
+	struct ChannelTables
+	{
+		const uint16_t* decode[4];
+		const unsigned char* encode[4];
+	};
+
+	void DecodeRow(const unsigned char* src, uint16_t* dst, UINT width, int channels, const ChannelTables& t)
+	{
+		for (UINT x = 0; x < width; ++x)
+			for (int c = 0; c < channels; ++c)
+				dst[x * channels + c] = t.decode[c][src[x * channels + c]];
+	}
+
+	//box filters dstWidth pixels from two decoded source rows into out
+	void BoxRowScalar(const uint16_t* a, const uint16_t* b, uint16_t* out, UINT srcWidth, UINT dstWidth, int channels, UINT firstX)
+	{
+		for (UINT x = firstX; x < dstWidth; ++x)
+		{
+			const UINT x0 = 2 * x * channels;
+			const UINT x1 = std::min(2 * x + 1, srcWidth - 1) * channels;
+			for (int c = 0; c < channels; ++c)
+				out[x * channels + c] = static_cast<uint16_t>((a[x0 + c] + a[x1 + c] + b[x0 + c] + b[x1 + c] + 2) >> 2);
+		}
+	}
+
+#if DXH_X86
+	//rgba only, two destination pixels per iteration, returns the first pixel it did not filter
+	DXH_TARGET_SSE UINT BoxRowSSE(const uint16_t* a, const uint16_t* b, uint16_t* out, UINT srcWidth, UINT dstWidth)
+	{
+		if (srcWidth < 2)
+			return 0;
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi32(2);
+		const __m128i bias32 = _mm_set1_epi32(32768);
+		const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+		UINT x = 0;
+		for (; x + 2 <= dstWidth; x += 2)
+		{
+			//every register holds the 2x1 source pixels of one destination pixel
+			const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8));
+			const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8 + 8));
+			const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8));
+			const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8 + 8));
+
+			__m128i s0 = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a0, zero), _mm_unpackhi_epi16(a0, zero)),
+				_mm_add_epi32(_mm_unpacklo_epi16(b0, zero), _mm_unpackhi_epi16(b0, zero)));
+			__m128i s1 = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a1, zero), _mm_unpackhi_epi16(a1, zero)),
+				_mm_add_epi32(_mm_unpacklo_epi16(b1, zero), _mm_unpackhi_epi16(b1, zero)));
+			s0 = _mm_srli_epi32(_mm_add_epi32(s0, round), 2);
+			s1 = _mm_srli_epi32(_mm_add_epi32(s1, round), 2);
+
+			//SSE2 only has a signed pack, shift into signed range and back
+			const __m128i packed = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(s0, bias32), _mm_sub_epi32(s1, bias32)), bias16);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), packed);
+		}
+		return x;
+	}
+#endif
+
+	bool Generate(const dxh::ImageData& image, dxh::MipChain& chain, bool srgb, UINT threads, bool simd)
+	{
+		if (image.width <= 0 || image.height <= 0 || image.channels < 1 || image.channels > 4 ||
+			image.ByteSize() < size_t(image.width) * image.height * image.channels)
+		{
+			util::ErrorMessageBox("Can not generate mips for an empty or truncated image.");
+			return false;
+		}
+		const int channels = image.channels;
+		const ConversionTables& tables = Tables();
+		ChannelTables t;
+		for (int c = 0; c < 4; ++c)
+		{
+			const bool color = srgb && c != 3;
+			t.decode[c] = color ? tables.srgbToLinear : tables.plainToLinear;
+			t.encode[c] = color ? tables.linearToSrgb : tables.linearToPlain;
+		}
+
+		// Lay out every level in one allocation
+		chain.channels = channels;
+		chain.levels.resize(dxh::MipLevelCount(image.width, image.height));
+		size_t size = 0;
+		UINT w = image.width, h = image.height;
+		for (dxh::MipLevel& level : chain.levels)
+		{
+			level.width = w;
+			level.height = h;
+			level.pitch = w * channels;
+			level.offset = size;
+			size += (size_t(level.pitch) * h + 15) & ~size_t(15);
+			w = std::max(1u, w / 2);
+			h = std::max(1u, h / 2);
+		}
+		chain.data.resize(size);
+		memcpy(chain.data.data(), image.Pixels(), size_t(image.width) * image.height * channels);
+
+#if DXH_X86
+		simd = simd && channels == 4 && util::CpuHasSSE2();
+#else
+		simd = false;
+#endif
+		// Every level from the one above, rows in parallel
+		for (UINT l = 1; l < chain.LevelCount(); ++l)
+		{
+			const dxh::MipLevel& src = chain.levels[l - 1];
+			const dxh::MipLevel& dst = chain.levels[l];
+			const unsigned char* srcData = chain.LevelData(l - 1);
+			unsigned char* dstData = chain.LevelData(l);
+
+			util::ParallelFor(dst.height, ROW_GRAIN, [&](size_t begin, size_t end)
+				{
+					std::vector<uint16_t> a(src.width * channels + 8), b(src.width * channels + 8), out(dst.width * channels + 8);
+					for (size_t y = begin; y < end; ++y)
+					{
+						const UINT y0 = static_cast<UINT>(2 * y);
+						const UINT y1 = std::min(y0 + 1, src.height - 1);
+						DecodeRow(srcData + size_t(y0) * src.pitch, a.data(), src.width, channels, t);
+						DecodeRow(srcData + size_t(y1) * src.pitch, b.data(), src.width, channels, t);
+
+						UINT x = 0;
+#if DXH_X86
+						if (simd)
+							x = BoxRowSSE(a.data(), b.data(), out.data(), src.width, dst.width);
+#endif
+						BoxRowScalar(a.data(), b.data(), out.data(), src.width, dst.width, channels, x);
+
+						unsigned char* row = dstData + y * dst.pitch;
+						for (UINT i = 0; i < dst.pitch; i += channels)
+							for (int c = 0; c < channels; ++c)
+								row[i + c] = t.encode[c][out[i + c]];
+					}
+				}, threads);
+		}
+		return true;
+	}
+}
+
+namespace dxh
+{
+	UINT MipLevelCount(UINT width, UINT height)
+	{
+		UINT levels = 1;
+		for (UINT size = std::max(width, height); size > 1; size /= 2)
+			++levels;
+		return levels;
+	}
+
+	bool GenerateMipChain(const ImageData& image, MipChain& chain, bool srgb, UINT threads)
+	{
+		return Generate(image, chain, srgb, threads, true);
+	}
+
+	MipChainTimings BenchmarkMipChain(int size, int repeats)
+	{
+		MipChainTimings timings;
+		timings.size = size;
+
+		ImageData image(size, size, 4);
+		image.data.resize(size_t(size) * size * 4);
+		unsigned int seed = 1;
+		for (unsigned char& c : image.data)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			c = static_cast<unsigned char>(seed >> 24);
+		}
+
+		MipChain chain;
+		auto best = [&](float& result, UINT threads, bool simd)
+		{
+			result = FLT_MAX;
+			for (int r = 0; r < repeats; ++r)
+			{
+				util::DeltaTimer timer;
+				Generate(image, chain, true, threads, simd);
+				result = std::min(result, timer.GetElapsed() * 1000.0f);
+			}
+		};
+		best(timings.scalar, 1, false);
+		best(timings.simd, 1, true);
+		best(timings.simdParallel, 0, true);
+
+		timings.levels = chain.LevelCount();
+		timings.megapixelsPerSecond = timings.simdParallel > 0.0f ? (float(size) * size / 1e6f) / (timings.simdParallel / 1000.0f) : 0.0f;
+		return timings;
+	}
+}
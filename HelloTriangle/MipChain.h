@@ -0,0 +1,50 @@
+#pragma once
+#include "pch.h"
+
+#include "Simd.h"
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	struct MipLevel
+	{
+		UINT width;
+		UINT height;
+		UINT pitch;		//bytes per row, D3D11_SUBRESOURCE_DATA::SysMemPitch
+		size_t offset;	//from the start of MipChain::data
+	};
+
+	//A full mip chain down to 1x1 in one allocation, level 0 is the source image.
+	//Levels are tightly packed rows of width * channels bytes, in D3D subresource order.
+	class MipChain
+	{
+	public:
+		int channels = 4;
+		std::vector<MipLevel> levels;
+		util::aligned_vector<unsigned char> data;
+
+		UINT LevelCount() const { return static_cast<UINT>(levels.size()); }
+		const unsigned char* LevelData(UINT level) const { return data.data() + levels[level].offset; }
+		unsigned char* LevelData(UINT level) { return data.data() + levels[level].offset; }
+	};
+
+	//number of levels of a full chain for a width x height texture
+	UINT MipLevelCount(UINT width, UINT height);
+
+	//Builds every level with a 2x2 box filter, D3D sizes (halved and rounded down, at least 1).
+	//With srgb the color channels are averaged in linear light and stored sRGB encoded again,
+	//alpha (channel 3) is always averaged as is. Rows of a level are filtered in parallel.
+	bool GenerateMipChain(const ImageData& image, MipChain& chain, bool srgb = true, UINT threads = 0);
+
+	//Timings in milliseconds for a size x size rgba texture, best of repeats
+	struct MipChainTimings
+	{
+		int size = 0;
+		UINT levels = 0;
+		float scalar = 0.0f;		//one thread, no SIMD
+		float simd = 0.0f;			//one thread
+		float simdParallel = 0.0f;	//all hardware threads
+		float megapixelsPerSecond = 0.0f; //source pixels, simdParallel
+	};
+	MipChainTimings BenchmarkMipChain(int size = 8192, int repeats = 3);
+}
@@ -0,0 +1,357 @@
+#include "pch.h"
+#include "ObjLoader.h"
+
+#include "Parallel.h"
+#include "MappedFile.h"
+#include "MeshWeld.h"
+
+namespace
+{
+	const size_t MIN_CHUNK_BYTES = 1 << 20;
+	//Corner indices are stored as 0-based absolute indices, as MISSING, or as RELATIVE + an index
+	//relative to the first element of the chunk (negative OBJ indices, resolved once chunks are merged)
+	const long long MISSING = -(1ll << 62);
+	const long long RELATIVE = -(1ll << 40);
+
+	//everything one chunk of the file contains
+	struct ObjChunk
+	{
+		const char* begin = nullptr;
+		const char* end = nullptr;
+		std::vector<dxh::float3> positions;
+		std::vector<dxh::float2> uvs;
+		std::vector<dxh::float3> normals;
+		std::vector<long long> corners;	//v, vt, vn for every corner, three corners per triangle
+		size_t firstPosition = 0, firstUv = 0, firstNormal = 0, firstTriangle = 0;
+		bool error = false;
+	};
+
+	inline bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	inline void SkipBlanks(const char*& p, const char* end)
+	{
+		while (p < end && IsBlank(*p))
+			++p;
+	}
+
+	inline bool ParseInt(const char*& p, const char* end, long long& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+		if (p >= end || *p < '0' || *p > '9')
+			return false;
+		long long v = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			v = v * 10 + (*p++ - '0');
+		out = negative ? -v : v;
+		return true;
+	}
+
+	//decimal float straight from the mapped text, no null terminator needed
+	inline bool ParseFloat(const char*& p, const char* end, float& out)
+	{
+		static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		unsigned long long mantissa = 0;
+		int exponent = 0, digits = 0;
+		bool any = false;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p, any = true)
+		{
+			if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) ++digits; }
+			else ++exponent; //digits past what fits only scale the value
+		}
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && *p >= '0' && *p <= '9'; ++p, any = true)
+			{
+				if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) ++digits; --exponent; }
+			}
+		}
+		if (!any)
+		{
+			p = start;
+			return false;
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			long long exp = 0;
+			if (ParseInt(e, end, exp))
+			{
+				exponent += static_cast<int>(std::max(std::min(exp, 1000ll), -1000ll));
+				p = e;
+			}
+		}
+
+		double value = static_cast<double>(mantissa);
+		int e = exponent;
+		while (e > 22) { value *= 1e22; e -= 22; }
+		while (e < -22) { value /= 1e22; e += 22; }
+		value = e >= 0 ? value * POW10[e] : value / POW10[-e];
+		out = static_cast<float>(negative ? -value : value);
+		return true;
+	}
+
+	//one v, v/vt, v//vn or v/vt/vn corner
+	inline bool ParseCorner(const char*& p, const char* end, const ObjChunk& chunk, long long corner[3])
+	{
+		const size_t counts[3] = { chunk.positions.size(), chunk.uvs.size(), chunk.normals.size() };
+		corner[0] = corner[1] = corner[2] = MISSING;
+		for (int i = 0; i < 3; ++i)
+		{
+			long long index;
+			if (ParseInt(p, end, index))
+			{
+				if (index > 0)
+					corner[i] = index - 1;
+				else if (index < 0)
+					corner[i] = RELATIVE + static_cast<long long>(counts[i]) + index;
+				else
+					return false; //OBJ indices start at 1
+			}
+			else if (i == 0)
+			{
+				return false;
+			}
+			if (i == 2 || p >= end || *p != '/')
+				break;
+			++p;
+		}
+		return true;
+	}
+
+	void ParseChunk(ObjChunk& chunk)
+	{
+		std::vector<long long> polygon; //reused for every face
+		const char* p = chunk.begin;
+		const char* end = chunk.end;
+		while (p < end)
+		{
+			SkipBlanks(p, end);
+			if (p + 1 < end && p[0] == 'v' && IsBlank(p[1]))
+			{
+				p += 2;
+				float v[3] = { 0.0f, 0.0f, 0.0f };
+				for (int i = 0; i < 3; ++i)
+				{
+					SkipBlanks(p, end);
+					if (!ParseFloat(p, end, v[i]))
+						chunk.error = true;
+				}
+				chunk.positions.push_back(dxh::float3(v[0], v[1], v[2]));
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && IsBlank(p[2]))
+			{
+				p += 3;
+				float v[2] = { 0.0f, 0.0f };
+				for (int i = 0; i < 2; ++i)
+				{
+					SkipBlanks(p, end);
+					if (!ParseFloat(p, end, v[i]) && i == 0)
+						chunk.error = true;
+				}
+				chunk.uvs.push_back(dxh::float2(v[0], v[1]));
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && IsBlank(p[2]))
+			{
+				p += 3;
+				float v[3] = { 0.0f, 0.0f, 0.0f };
+				for (int i = 0; i < 3; ++i)
+				{
+					SkipBlanks(p, end);
+					if (!ParseFloat(p, end, v[i]))
+						chunk.error = true;
+				}
+				chunk.normals.push_back(dxh::float3(v[0], v[1], v[2]));
+			}
+			else if (p + 1 < end && p[0] == 'f' && IsBlank(p[1]))
+			{
+				p += 2;
+				polygon.clear();
+				for (;;)
+				{
+					SkipBlanks(p, end);
+					if (p >= end || *p == '\n' || *p == '#')
+						break;
+					long long corner[3];
+					if (!ParseCorner(p, end, chunk, corner))
+					{
+						chunk.error = true;
+						break;
+					}
+					polygon.insert(polygon.end(), corner, corner + 3);
+				}
+				// Fan triangulation
+				for (size_t c = 2; c < polygon.size() / 3; ++c)
+				{
+					chunk.corners.insert(chunk.corners.end(), &polygon[0], &polygon[0] + 3);
+					chunk.corners.insert(chunk.corners.end(), &polygon[(c - 1) * 3], &polygon[(c - 1) * 3] + 3);
+					chunk.corners.insert(chunk.corners.end(), &polygon[c * 3], &polygon[c * 3] + 3);
+				}
+			}
+
+			const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+			p = newline ? newline + 1 : end;
+		}
+	}
+
+	//0-based index into the merged arrays, or -1 if missing or out of range
+	inline long long Resolve(long long index, size_t chunkFirst, size_t total)
+	{
+		if (index == MISSING)
+			return -1;
+		if (index < 0)
+			index = static_cast<long long>(chunkFirst) + (index - RELATIVE);
+		return index >= 0 && index < static_cast<long long>(total) ? index : -2;
+	}
+}
+
+bool ObjLoader::MeshFromFile(dxh::Mesh& target, const char* filepath)
+{
+	util::MappedFile file;
+	if (!file.Open(filepath))
+	{
+		util::ErrorMessageBox("could not open OBJ file \"" + std::string(filepath) + "\".");
+		return false;
+	}
+	return MeshFromMemory(target, file.Data(), file.Size(), filepath);
+}
+
+bool ObjLoader::MeshFromMemory(dxh::Mesh& target, const char* data, size_t size, const std::string& name)
+{
+	util::DeltaTimer timer;
+	stats = dxh::ObjLoadStats();
+	stats.bytes = size;
+	const UINT workers = threads == 0 ? util::HardwareThreads() : threads;
+
+	// Split at line boundaries
+	const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / MIN_CHUNK_BYTES, workers * 4));
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* p = data;
+	for (size_t c = 0; c < chunkCount; ++c)
+	{
+		chunks[c].begin = p;
+		const char* split = c + 1 == chunkCount ? end : data + size * (c + 1) / chunkCount;
+		if (split < p)
+			split = p;
+		const char* newline = split < end ? static_cast<const char*>(memchr(split, '\n', end - split)) : nullptr;
+		p = newline ? newline + 1 : end;
+		chunks[c].end = p;
+	}
+	stats.chunks = static_cast<UINT>(chunkCount);
+
+	util::ParallelFor(chunkCount, 1, [&](size_t begin, size_t last)
+		{
+			for (size_t c = begin; c < last; ++c)
+			{
+				const size_t bytes = chunks[c].end - chunks[c].begin;
+				chunks[c].positions.reserve(bytes / 32);
+				chunks[c].corners.reserve(bytes / 4);
+				ParseChunk(chunks[c]);
+			}
+		}, workers);
+	stats.parseSeconds = timer.GetElapsed();
+
+	// Global offsets of every chunk
+	for (size_t c = 0; c < chunkCount; ++c)
+	{
+		if (chunks[c].error)
+		{
+			util::ErrorMessageBox("malformed OBJ data in \"" + name + "\".");
+			return false;
+		}
+		chunks[c].firstPosition = stats.positions;
+		chunks[c].firstUv = stats.uvs;
+		chunks[c].firstNormal = stats.normals;
+		chunks[c].firstTriangle = stats.triangles;
+		stats.positions += chunks[c].positions.size();
+		stats.uvs += chunks[c].uvs.size();
+		stats.normals += chunks[c].normals.size();
+		stats.triangles += chunks[c].corners.size() / 9;
+	}
+
+	std::vector<dxh::float3> positions(stats.positions), normals(stats.normals);
+	std::vector<dxh::float2> uvs(stats.uvs);
+	util::ParallelFor(chunkCount, 1, [&](size_t begin, size_t last)
+		{
+			for (size_t c = begin; c < last; ++c)
+			{
+				std::copy(chunks[c].positions.begin(), chunks[c].positions.end(), positions.begin() + chunks[c].firstPosition);
+				std::copy(chunks[c].uvs.begin(), chunks[c].uvs.end(), uvs.begin() + chunks[c].firstUv);
+				std::copy(chunks[c].normals.begin(), chunks[c].normals.end(), normals.begin() + chunks[c].firstNormal);
+			}
+		}, workers);
+
+	// Expand to triangle soup, then weld identical vertices
+	std::vector<dxh::Vertex> soup(stats.triangles * 3);
+	std::atomic<bool> badIndex{ false };
+	const float zSign = leftHanded ? -1.0f : 1.0f;
+	util::ParallelFor(chunkCount, 1, [&](size_t begin, size_t last)
+		{
+			for (size_t c = begin; c < last; ++c)
+			{
+				const ObjChunk& chunk = chunks[c];
+				const size_t triangles = chunk.corners.size() / 9;
+				for (size_t t = 0; t < triangles; ++t)
+				{
+					dxh::Vertex* tri = &soup[(chunk.firstTriangle + t) * 3];
+					bool hasNormals = true;
+					for (int k = 0; k < 3; ++k)
+					{
+						const long long* corner = &chunk.corners[(t * 3 + k) * 3];
+						const long long v = Resolve(corner[0], chunk.firstPosition, positions.size());
+						const long long vt = Resolve(corner[1], chunk.firstUv, uvs.size());
+						const long long vn = Resolve(corner[2], chunk.firstNormal, normals.size());
+						if (v < 0 || vt == -2 || vn == -2)
+						{
+							badIndex = true;
+							continue;
+						}
+						const dxh::float3& pos = positions[v];
+						tri[k].pos = dxh::float3(pos.x, pos.y, pos.z * zSign);
+						if (vt >= 0)
+							tri[k].uv = dxh::float2(uvs[vt].x, flipV ? 1.0f - uvs[vt].y : uvs[vt].y);
+						if (vn >= 0)
+							tri[k].normal = dxh::float3(normals[vn].x, normals[vn].y, normals[vn].z * zSign);
+						else
+							hasNormals = false;
+					}
+					if (!hasNormals) //flat normal out of the counter clockwise face, mirrored along with z
+					{
+						const dxh::float3 ab = tri[1].pos - tri[0].pos;
+						const dxh::float3 ac = tri[2].pos - tri[0].pos;
+						dxh::float3 n(ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x);
+						const float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+						if (len > 0.0f)
+							n = n * (zSign / len);
+						for (int k = 0; k < 3; ++k)
+							tri[k].normal = n;
+					}
+					if (leftHanded) //mirroring z turns the winding around, swap back to clockwise front faces
+						std::swap(tri[1], tri[2]);
+				}
+			}
+		}, workers);
+
+	if (badIndex)
+	{
+		util::ErrorMessageBox("OBJ file \"" + name + "\" has a face index out of range.");
+		return false;
+	}
+
+	dxh::WeldVertices(soup, target, 0.0f, workers);
+	target.name = name;
+	target.UpdateBounds();
+
+	stats.vertices = target.vertices.size();
+	stats.totalSeconds = timer.GetElapsed();
+	stats.megabytesPerSecond = stats.totalSeconds > 0.0f ? (size / 1e6f) / stats.totalSeconds : 0.0f;
+	return true;
+}
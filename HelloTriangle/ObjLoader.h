@@ -0,0 +1,43 @@
+#pragma once
+#include "pch.h"
+
+#include "Utilities.h"
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	struct ObjLoadStats
+	{
+		size_t bytes = 0;
+		size_t positions = 0;	//v lines
+		size_t uvs = 0;			//vt lines
+		size_t normals = 0;		//vn lines
+		size_t triangles = 0;	//after fan triangulation of the f lines
+		size_t vertices = 0;	//in the finished mesh
+		UINT chunks = 0;		//pieces the file was parsed in
+		float parseSeconds = 0.0f;
+		float totalSeconds = 0.0f;
+		float megabytesPerSecond = 0.0f; //parse throughput over the whole load
+	};
+}
+
+//Wavefront OBJ loader. The file is memory mapped and split into chunks at line boundaries,
+//chunks are parsed in parallel straight from the mapping and merged into one welded dxh::Mesh.
+//Supports v, vt, vn and f (polygons, negative indices, v, v/vt, v//vn and v/vt/vn), other lines are skipped.
+class
+	ObjLoader
+{
+public:
+	ObjLoader(UINT threads = 0) : threads(threads) {};
+	~ObjLoader() {};
+	bool MeshFromFile(dxh::Mesh& target, const char* filepath);
+	bool MeshFromMemory(dxh::Mesh& target, const char* data, size_t size, const std::string& name = "unnamed");
+	const dxh::ObjLoadStats& GetStats() const { return stats; }
+
+	bool leftHanded = true;	//negate z and reverse the corners, OBJ is right handed with counter clockwise front faces
+	bool flipV = true;		//OBJ has v = 0 at the bottom of the image, D3D at the top
+
+private:
+	UINT threads;
+	dxh::ObjLoadStats stats;
+};
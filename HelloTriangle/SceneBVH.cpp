@@ -0,0 +1,657 @@
+#include "pch.h"
+#include "SceneBVH.h"
+
+#include "JobSystem.h"
+#include "Parallel.h"
+#include "Utilities.h"
+
+namespace
+{
+	const UINT SAH_DEPTH = 64;		//deeper nodes split in the middle, so lopsided SAH splits cannot go on forever
+	const int STACK_SIZE = 128;		//SAH_DEPTH and 32 more levels of halves
+
+	float Area(const float min[3], const float max[3])
+	{
+		const float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+		return x < 0.0f ? 0.0f : 2.0f * (x * y + y * z + z * x);
+	}
+
+	void Grow(float min[3], float max[3], const float otherMin[3], const float otherMax[3])
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			min[c] = std::min(min[c], otherMin[c]);
+			max[c] = std::max(max[c], otherMax[c]);
+		}
+	}
+
+	void Reset(float min[3], float max[3])
+	{
+		for (int c = 0; c < 3; ++c)
+			min[c] = FLT_MAX, max[c] = -FLT_MAX;
+	}
+
+	//entry distance of the ray into the box, FLT_MAX when it misses or only reaches it after maxDistance
+	float RayBox(const float origin[3], const float inverse[3], float maxDistance, const float min[3], const float max[3])
+	{
+		float enter = 0.0f, leave = maxDistance;
+		for (int c = 0; c < 3; ++c)
+		{
+			const float t0 = (min[c] - origin[c]) * inverse[c];
+			const float t1 = (max[c] - origin[c]) * inverse[c];
+			enter = std::max(enter, std::min(t0, t1));
+			leave = std::min(leave, std::max(t0, t1));
+		}
+		return enter <= leave ? enter : FLT_MAX;
+	}
+
+	float BoxDistance2(const float min[3], const float max[3], const dxh::float3& point)
+	{
+		float d2 = 0.0f;
+		for (int c = 0; c < 3; ++c)
+		{
+			const float d = std::max(std::max(min[c] - point[c], 0.0f), point[c] - max[c]);
+			d2 += d * d;
+		}
+		return d2;
+	}
+}
+
+namespace dxh
+{
+	// **********************************************************************************************************
+	// BUILD
+	// **********************************************************************************************************
+
+	//Boxes of the objects next to each other, partitioned in place while building so every node
+	//reads consecutive memory instead of following indices into the caller's streams
+	struct BuildPrim
+	{
+		float min[3];
+		UINT object;
+		float max[3];
+	};
+
+	struct SceneBVH::BuildState
+	{
+		std::vector<BuildPrim> prims;
+		std::atomic<UINT> used;		//nodes handed out
+		util::JobCounter counter;
+		bool parallel;
+		BuildState(size_t count, bool _parallel) : prims(count), used(1), parallel(_parallel) {}
+	};
+
+	void SceneBVH::Build(const CullStreams& objects, unsigned int threads)
+	{
+		util::DeltaTimer timer;
+		Clear();
+		if (objects.count == 0)
+			return;
+
+		BuildState state(objects.count, threads != 1 && objects.count > JOB_SPLIT);
+		util::ParallelFor(objects.count, CULL_GRAIN, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					BuildPrim& prim = state.prims[i];
+					for (int c = 0; c < 3; ++c)
+					{
+						prim.min[c] = objects.center[c][i] - objects.extent[c][i];
+						prim.max[c] = objects.center[c][i] + objects.extent[c][i];
+					}
+					prim.object = static_cast<UINT>(i);
+				}
+			}, threads);
+		nodes.resize(2 * objects.count - 1);
+		BuildNode(state, 0, 0, static_cast<UINT>(objects.count), 0);
+		if (state.parallel)
+			util::JobSystem::Global().Wait(state.counter);
+		nodes.resize(state.used.load());
+
+		order.resize(objects.count);
+		for (size_t s = 0; s < objects.count; ++s)
+			order[s] = state.prims[s].object;
+
+		for (UINT i = 0; i < nodes.size(); ++i)
+			if (nodes[i].Leaf())
+				leaves.push_back(i);
+		Gather(objects, threads);
+
+		stats.builds++;
+		stats.refitsSinceBuild = 0;
+		stats.cost = stats.builtCost = SAHCost();
+		stats.buildMs = timer.GetElapsed() * 1000.0f;
+	}
+
+	void SceneBVH::BuildNode(BuildState& state, UINT index, UINT begin, UINT end, UINT depth)
+	{
+		BuildPrim* prims = state.prims.data();
+		BVHNode& node = nodes[index];
+
+		// Bounds of the objects and of their centers, the centers pick the split. Locals instead of
+		// node's members, which the compiler would have to store back after every object.
+		float boxMin[3], boxMax[3], centerMin[3], centerMax[3];
+		Reset(boxMin, boxMax);
+		Reset(centerMin, centerMax);
+		for (UINT i = begin; i < end; ++i)
+		{
+			const BuildPrim& prim = prims[i];
+			for (int c = 0; c < 3; ++c)
+			{
+				const float center = (prim.min[c] + prim.max[c]) * 0.5f;
+				boxMin[c] = std::min(boxMin[c], prim.min[c]);
+				boxMax[c] = std::max(boxMax[c], prim.max[c]);
+				centerMin[c] = std::min(centerMin[c], center);
+				centerMax[c] = std::max(centerMax[c], center);
+			}
+		}
+		for (int c = 0; c < 3; ++c)
+			node.min[c] = boxMin[c], node.max[c] = boxMax[c];
+		const UINT count = end - begin;
+		if (count <= MAX_LEAF)
+		{
+			node.first = begin;
+			node.count = count;
+			return;
+		}
+
+		// Binned SAH, the cost of a split is the area of each side times the objects in it.
+		// All three axes are binned in one pass over the objects.
+		struct Bin
+		{
+			float min[3], max[3];
+			UINT count;
+		};
+		// Small nodes get fewer bins, clearing and sweeping all of them would cost more than binning the objects
+		const int binCount = static_cast<int>(std::min<UINT>(BINS, count));
+		Bin bins[3][BINS];
+		float scale[3];
+		bool splittable = false;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float width = centerMax[axis] - centerMin[axis];
+			scale[axis] = width > 0.0f ? binCount / width : 0.0f;
+			splittable |= width > 0.0f;
+			for (int b = 0; b < binCount; ++b)
+			{
+				Reset(bins[axis][b].min, bins[axis][b].max);
+				bins[axis][b].count = 0;
+			}
+		}
+		int bestAxis = -1, bestBin = 0;
+		float bestCost = FLT_MAX;
+		if (splittable && depth < SAH_DEPTH)
+		{
+			for (UINT i = begin; i < end; ++i)
+			{
+				const BuildPrim& prim = prims[i];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const int b = std::min(binCount - 1, static_cast<int>(((prim.min[axis] + prim.max[axis]) * 0.5f - centerMin[axis]) * scale[axis]));
+					Bin& bin = bins[axis][b];
+					Grow(bin.min, bin.max, prim.min, prim.max);
+					bin.count++;
+				}
+			}
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (scale[axis] == 0.0f)
+					continue;
+				// Sweep from the right for the right sides, then from the left for the costs
+				float rightArea[BINS];
+				UINT rightCount[BINS];
+				float min[3], max[3];
+				Reset(min, max);
+				UINT n = 0;
+				for (int b = binCount - 1; b > 0; --b)
+				{
+					Grow(min, max, bins[axis][b].min, bins[axis][b].max);
+					n += bins[axis][b].count;
+					rightArea[b] = Area(min, max);
+					rightCount[b] = n;
+				}
+				Reset(min, max);
+				n = 0;
+				for (int b = 0; b < binCount - 1; ++b)
+				{
+					Grow(min, max, bins[axis][b].min, bins[axis][b].max);
+					n += bins[axis][b].count;
+					if (n == 0 || rightCount[b + 1] == 0)
+						continue;
+					const float cost = Area(min, max) * n + rightArea[b + 1] * rightCount[b + 1];
+					if (cost < bestCost)
+						bestCost = cost, bestAxis = axis, bestBin = b;
+				}
+			}
+		}
+
+		UINT middle = begin + count / 2;
+		if (bestAxis >= 0)
+		{
+			const float low = centerMin[bestAxis], binScale = scale[bestAxis];
+			const int axis = bestAxis, split = bestBin, last = binCount - 1;
+			middle = static_cast<UINT>(std::partition(prims + begin, prims + end, [=](const BuildPrim& prim)
+				{
+					return std::min(last, static_cast<int>(((prim.min[axis] + prim.max[axis]) * 0.5f - low) * binScale)) <= split;
+				}) - prims);
+		}
+		// Every center in one spot, halves are as good as anything
+		if (middle == begin || middle == end)
+			middle = begin + count / 2;
+
+		const UINT left = state.used.fetch_add(2);
+		node.first = left;
+		node.count = 0;
+		if (state.parallel && count > JOB_SPLIT)
+		{
+			util::JobSystem::Global().Run([this, &state, left, begin, middle, depth]()
+				{
+					BuildNode(state, left, begin, middle, depth + 1);
+				}, &state.counter);
+		}
+		else
+			BuildNode(state, left, begin, middle, depth + 1);
+		BuildNode(state, left + 1, middle, end, depth + 1);
+	}
+
+	void SceneBVH::Clear()
+	{
+		nodes.clear();
+		leaves.clear();
+		order.clear();
+		for (int c = 0; c < 3; ++c)
+		{
+			center[c].clear();
+			extent[c].clear();
+		}
+		radius.clear();
+		BVHStats cleared;
+		cleared.builds = stats.builds;
+		cleared.refitMs = stats.refitMs;
+		stats = cleared;
+	}
+
+	// **********************************************************************************************************
+	// REFIT
+	// **********************************************************************************************************
+
+	void SceneBVH::Gather(const CullStreams& objects, unsigned int threads)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			center[c].resize(order.size());
+			extent[c].resize(order.size());
+		}
+		radius.resize(order.size());
+		// Leaves read their objects from consecutive slots instead of all over the caller's streams.
+		// One stream at a time, so the random reads stay within one stream's worth of cache.
+		float* targets[7] = { center[0].data(), center[1].data(), center[2].data(), extent[0].data(), extent[1].data(), extent[2].data(), radius.data() };
+		const float* sources[7] = { objects.center[0], objects.center[1], objects.center[2], objects.extent[0], objects.extent[1], objects.extent[2], objects.radius };
+		const UINT* slots = order.data();
+		util::ParallelFor(order.size(), CULL_GRAIN, [&](size_t begin, size_t end)
+			{
+				for (int stream = 0; stream < 7; ++stream)
+				{
+					float* target = targets[stream];
+					const float* source = sources[stream];
+					for (size_t s = begin; s < end; ++s)
+						target[s] = source[slots[s]];
+				}
+			}, threads);
+	}
+
+	void SceneBVH::RefitNodes(unsigned int threads)
+	{
+		util::ParallelFor(leaves.size(), CULL_GRAIN / MAX_LEAF, [&](size_t begin, size_t end)
+			{
+				for (size_t l = begin; l < end; ++l)
+				{
+					BVHNode& node = nodes[leaves[l]];
+					Reset(node.min, node.max);
+					for (UINT s = node.first; s < node.first + node.count; ++s)
+						for (int c = 0; c < 3; ++c)
+						{
+							node.min[c] = std::min(node.min[c], center[c][s] - extent[c][s]);
+							node.max[c] = std::max(node.max[c], center[c][s] + extent[c][s]);
+						}
+				}
+			}, threads);
+		// Children come after their parents, so walking backwards sees them first
+		for (size_t i = nodes.size(); i-- > 0;)
+		{
+			BVHNode& node = nodes[i];
+			if (node.Leaf())
+				continue;
+			const BVHNode& left = nodes[node.first];
+			const BVHNode& right = nodes[node.first + 1];
+			for (int c = 0; c < 3; ++c)
+			{
+				node.min[c] = std::min(left.min[c], right.min[c]);
+				node.max[c] = std::max(left.max[c], right.max[c]);
+			}
+		}
+	}
+
+	void SceneBVH::Refit(const CullStreams& objects, unsigned int threads)
+	{
+		util::DeltaTimer timer;
+		if (objects.count != order.size() || order.empty())
+			return;
+		Gather(objects, threads);
+		RefitNodes(threads);
+		stats.refitsSinceBuild++;
+		stats.cost = SAHCost();
+		stats.refitMs = timer.GetElapsed() * 1000.0f;
+	}
+
+	bool SceneBVH::Update(const CullStreams& objects, unsigned int threads)
+	{
+		if (nodes.empty() || objects.count != order.size())
+		{
+			Build(objects, threads);
+			return true;
+		}
+		Refit(objects, threads);
+		if (stats.cost > stats.builtCost * rebuildRatio || (rebuildInterval > 0 && stats.refitsSinceBuild >= rebuildInterval))
+		{
+			Build(objects, threads);
+			return true;
+		}
+		return false;
+	}
+
+	float SceneBVH::SAHCost()
+	{
+		// Expected boxes and objects a random ray through the root tests
+		stats.objects = order.size();
+		stats.nodes = nodes.size();
+		stats.leaves = leaves.size();
+		stats.depth = 0;
+		if (nodes.empty())
+			return 0.0f;
+		const float rootArea = Area(nodes[0].min, nodes[0].max);
+		float cost = 0.0f;
+		std::pair<UINT, UINT> stack[STACK_SIZE];
+		int top = 0;
+		stack[top++] = { 0, 1 };
+		while (top > 0)
+		{
+			const std::pair<UINT, UINT> entry = stack[--top];
+			const BVHNode& node = nodes[entry.first];
+			stats.depth = std::max(stats.depth, entry.second);
+			cost += Area(node.min, node.max) * (node.Leaf() ? static_cast<float>(node.count) : 1.0f);
+			if (!node.Leaf())
+			{
+				stack[top++] = { node.first, entry.second + 1 };
+				stack[top++] = { node.first + 1, entry.second + 1 };
+			}
+		}
+		return rootArea > 0.0f ? cost / rootArea : 0.0f;
+	}
+
+	// **********************************************************************************************************
+	// QUERIES
+	// **********************************************************************************************************
+
+	size_t SceneBVH::QueryFrustum(const Frustum& frustum, std::vector<UINT>& visible, CullStats* cullStats) const
+	{
+		util::DeltaTimer timer;
+		visible.clear();
+		float absNormal[6][3];
+		for (int p = 0; p < 6; ++p)
+			for (int c = 0; c < 3; ++c)
+				absNormal[p][c] = std::fabs(frustum.planes[p][c]);
+
+		// Planes a node is completely inside of are dropped from the mask for everything below it
+		const UINT ALL_PLANES = 0x3f;
+		std::pair<UINT, UINT> stack[STACK_SIZE];
+		int top = 0;
+		if (!nodes.empty())
+			stack[top++] = { 0, ALL_PLANES };
+		while (top > 0)
+		{
+			const BVHNode& node = nodes[stack[--top].first];
+			UINT mask = stack[top].second;
+			bool outside = false;
+			for (int p = 0; p < 6 && mask; ++p)
+			{
+				if (!(mask & (1u << p)))
+					continue;
+				const float* plane = frustum.planes[p];
+				float dist = plane[3], reach = 0.0f;
+				for (int c = 0; c < 3; ++c)
+				{
+					dist += plane[c] * (node.min[c] + node.max[c]) * 0.5f;
+					reach += absNormal[p][c] * (node.max[c] - node.min[c]) * 0.5f;
+				}
+				if (dist + reach < 0.0f)
+				{
+					outside = true;
+					break;
+				}
+				if (dist - reach >= 0.0f)
+					mask &= ~(1u << p);
+			}
+			if (outside)
+				continue;
+			if (mask == 0)
+			{
+				// Inside every plane, the subtree's objects are in consecutive slots from its leftmost to its rightmost leaf
+				const BVHNode* leftmost = &node;
+				const BVHNode* rightmost = &node;
+				while (!leftmost->Leaf())
+					leftmost = &nodes[leftmost->first];
+				while (!rightmost->Leaf())
+					rightmost = &nodes[rightmost->first + 1];
+				visible.insert(visible.end(), order.begin() + leftmost->first, order.begin() + rightmost->first + rightmost->count);
+				continue;
+			}
+			if (!node.Leaf())
+			{
+				stack[top++] = { node.first + 1, mask };
+				stack[top++] = { node.first, mask };
+				continue;
+			}
+			for (UINT s = node.first; s < node.first + node.count; ++s)
+			{
+				// The same test as the cull kernels, so both return the same objects
+				bool culled = false;
+				for (int p = 0; p < 6 && !culled; ++p)
+				{
+					if (!(mask & (1u << p)))
+						continue;
+					const float* plane = frustum.planes[p];
+					const float dist = center[0][s] * plane[0] + center[1][s] * plane[1] + center[2][s] * plane[2] + plane[3];
+					const float box = extent[0][s] * absNormal[p][0] + extent[1][s] * absNormal[p][1] + extent[2][s] * absNormal[p][2];
+					culled = dist + std::min(box, radius[s]) < 0.0f;
+				}
+				if (!culled)
+					visible.push_back(order[s]);
+			}
+		}
+
+		if (cullStats)
+		{
+			cullStats->tested = order.size();
+			cullStats->visible = visible.size();
+			cullStats->culled = order.size() - visible.size();
+			cullStats->nsPerObject = order.empty() ? 0.0f : timer.GetElapsed() * 1e9f / order.size();
+		}
+		return visible.size();
+	}
+
+	size_t SceneBVH::QuerySphere(const float3& point, float range, std::vector<UINT>& found) const
+	{
+		found.clear();
+		const float range2 = range * range;
+		UINT stack[STACK_SIZE];
+		int top = 0;
+		if (!nodes.empty())
+			stack[top++] = 0;
+		while (top > 0)
+		{
+			const BVHNode& node = nodes[stack[--top]];
+			if (BoxDistance2(node.min, node.max, point) > range2)
+				continue;
+			if (!node.Leaf())
+			{
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+				continue;
+			}
+			for (UINT s = node.first; s < node.first + node.count; ++s)
+			{
+				float min[3], max[3];
+				float d2 = 0.0f;
+				for (int c = 0; c < 3; ++c)
+				{
+					min[c] = center[c][s] - extent[c][s], max[c] = center[c][s] + extent[c][s];
+					d2 += (center[c][s] - point[c]) * (center[c][s] - point[c]);
+				}
+				const float reach = range + radius[s];
+				if (BoxDistance2(min, max, point) <= range2 && d2 <= reach * reach)
+					found.push_back(order[s]);
+			}
+		}
+		return found.size();
+	}
+
+	bool SceneBVH::Raycast(const float3& origin, const float3& direction, float maxDistance, BVHRayHit& hit) const
+	{
+		hit = BVHRayHit();
+		const float from[3] = { origin.x, origin.y, origin.z };
+		const float inverse[3] = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+		UINT stack[STACK_SIZE];
+		int top = 0;
+		if (!nodes.empty() && RayBox(from, inverse, maxDistance, nodes[0].min, nodes[0].max) != FLT_MAX)
+			stack[top++] = 0;
+		while (top > 0)
+		{
+			const BVHNode& node = nodes[stack[--top]];
+			if (node.Leaf())
+			{
+				for (UINT s = node.first; s < node.first + node.count; ++s)
+				{
+					float min[3], max[3];
+					for (int c = 0; c < 3; ++c)
+						min[c] = center[c][s] - extent[c][s], max[c] = center[c][s] + extent[c][s];
+					const float t = RayBox(from, inverse, std::min(maxDistance, hit.distance), min, max);
+					if (t < hit.distance)
+						hit.distance = t, hit.object = order[s];
+				}
+				continue;
+			}
+			// Nearer child on top, the farther one is skipped if a hit came closer meanwhile
+			const float limit = std::min(maxDistance, hit.distance);
+			float tLeft = RayBox(from, inverse, limit, nodes[node.first].min, nodes[node.first].max);
+			float tRight = RayBox(from, inverse, limit, nodes[node.first + 1].min, nodes[node.first + 1].max);
+			UINT nearer = node.first, farther = node.first + 1;
+			if (tRight < tLeft)
+			{
+				std::swap(tLeft, tRight);
+				std::swap(nearer, farther);
+			}
+			if (tRight != FLT_MAX)
+				stack[top++] = farther;
+			if (tLeft != FLT_MAX)
+				stack[top++] = nearer;
+		}
+		return hit.object != ~0u;
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	BVHBenchmark BenchmarkBVH(size_t objects, int frames)
+	{
+		// 90 degree perspective looking down +z from the origin, near 0.1 and far 100
+		const float zn = 0.1f, zf = 100.0f, q = zf / (zf - zn);
+		const Frustum frustum = ExtractFrustum(DirectX::XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, q, -zn * q,
+			0.0f, 0.0f, 1.0f, 0.0f));
+
+		uint32_t seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) * (1.0f / 16777216.0f); };
+		std::vector<float3> positions(objects), velocities(objects);
+		for (size_t i = 0; i < objects; ++i)
+		{
+			positions[i] = float3(random() * 200.0f - 100.0f, random() * 200.0f - 100.0f, random() * 200.0f - 100.0f);
+			velocities[i] = float3(random() - 0.5f, random() - 0.5f, random() - 0.5f);
+		}
+		BoundsList bounds;
+		bounds.Resize(objects);
+		auto place = [&]()
+		{
+			for (size_t i = 0; i < objects; ++i)
+			{
+				Bounds b;
+				b.center = positions[i];
+				b.min = b.center - float3(0.5f, 0.5f, 0.5f);
+				b.max = b.center + float3(0.5f, 0.5f, 0.5f);
+				b.radius = 0.866f;
+				bounds.Set(i, b);
+			}
+		};
+		place();
+
+		BVHBenchmark result;
+		result.objects = objects;
+		result.threads = util::JobSystem::Global().ThreadCount();
+		SceneBVH bvh;
+		result.buildMs = FLT_MAX;
+		result.threadedBuildMs = FLT_MAX;
+		for (int r = 0; r < 3; ++r)
+		{
+			bvh.Build(bounds.Streams(), 1);
+			result.buildMs = std::min(result.buildMs, bvh.GetStats().buildMs);
+			bvh.Build(bounds.Streams(), 0);
+			result.threadedBuildMs = std::min(result.threadedBuildMs, bvh.GetStats().buildMs);
+		}
+
+		std::vector<UINT> visible;
+		const int SPHERES = 100, RAYS = 1000;
+		for (int f = 0; f < frames; ++f)
+		{
+			for (size_t i = 0; i < objects; ++i)
+				positions[i] = positions[i] + velocities[i];
+			place();
+
+			util::DeltaTimer timer;
+			if (bvh.Update(bounds.Streams()))
+				result.rebuilds++;
+			result.updateMs += timer.GetElapsed() * 1000.0f;
+			result.refitMs += bvh.GetStats().refitMs;
+
+			CullStats flat, tree;
+			CullObjects(frustum, bounds.Streams(), visible, BestCullKernel(), 0, &flat);
+			bvh.QueryFrustum(frustum, visible, &tree);
+			result.flatCullMs += flat.nsPerObject * flat.tested * 1e-6f;
+			result.frustumMs += tree.nsPerObject * tree.tested * 1e-6f;
+			result.visible = tree.visible;
+
+			timer.Restart();
+			for (int s = 0; s < SPHERES; ++s)
+				bvh.QuerySphere(float3(random() * 200.0f - 100.0f, random() * 200.0f - 100.0f, random() * 200.0f - 100.0f), 10.0f, visible);
+			result.sphereUs += timer.GetElapsed() * 1e6f / SPHERES;
+
+			timer.Restart();
+			BVHRayHit hit;
+			for (int r = 0; r < RAYS; ++r)
+				bvh.Raycast(float3(0.0f, 0.0f, 0.0f), float3(random() - 0.5f, random() - 0.5f, random() - 0.5f), 400.0f, hit);
+			result.rayUs += timer.GetElapsed() * 1e6f / RAYS;
+		}
+		if (frames > 0)
+		{
+			result.updateMs /= frames;
+			result.refitMs /= frames;
+			result.flatCullMs /= frames;
+			result.frustumMs /= frames;
+			result.sphereUs /= frames;
+			result.rayUs /= frames;
+		}
+		return result;
+	}
+}
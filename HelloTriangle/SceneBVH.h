@@ -0,0 +1,105 @@
+#pragma once
+#include "pch.h"
+
+#include "Simd.h"
+#include "CustomDataTypes.h"
+#include "FrustumCulling.h"
+
+namespace dxh
+{
+	//32 bytes, two nodes per cache line. Children are allocated as a pair, so the right child is
+	//always first + 1 and only the left one has to be stored.
+	struct BVHNode
+	{
+		float min[3];
+		UINT first;	//leaf: first slot in the object order, interior: left child
+		float max[3];
+		UINT count;	//objects in a leaf, 0 for interior nodes
+		bool Leaf() const { return count > 0; }
+	};
+
+	struct BVHRayHit
+	{
+		UINT object = ~0u;
+		float distance = FLT_MAX;	//along the ray to the object's box, in units of the direction's length
+	};
+
+	struct BVHStats
+	{
+		size_t objects = 0;
+		size_t nodes = 0;
+		size_t leaves = 0;
+		UINT depth = 0;
+		float cost = 0.0f;			//SAH cost of the current tree, refits let it grow
+		float builtCost = 0.0f;		//SAH cost right after the last build
+		float buildMs = 0.0f;		//last build
+		float refitMs = 0.0f;		//last refit
+		UINT builds = 0;
+		UINT refitsSinceBuild = 0;
+	};
+
+	//Bounding volume hierarchy over the bounds of many objects (the same SoA streams CullObjects reads).
+	//Build sorts them top down with binned SAH, splitting large subtrees into jobs. Moving objects only need
+	//Refit, which keeps the tree and grows the boxes, Update rebuilds once refits made it too slow.
+	//Queries return object indices in tree order.
+	class SceneBVH
+	{
+	public:
+		static const UINT MAX_LEAF = 4;			//objects per leaf
+		static const int BINS = 16;				//SAH candidates per axis
+		static const size_t JOB_SPLIT = 4096;	//subtrees with more objects are built on another job
+
+		void Build(const CullStreams& objects, unsigned int threads = 0);
+		//objects must be the ones of the last Build, in the same order, only their bounds moved
+		void Refit(const CullStreams& objects, unsigned int threads = 0);
+		//Refit, or Build when the count changed, the SAH cost grew past rebuildRatio times the built one or
+		//rebuildInterval refits went by (0 never). Returns true when it rebuilt.
+		bool Update(const CullStreams& objects, unsigned int threads = 0);
+		void SetRebuildPolicy(float ratio, UINT interval) { rebuildRatio = ratio, rebuildInterval = interval; }
+		void Clear();
+
+		//objects whose box and sphere are not outside the frustum, like CullObjects
+		size_t QueryFrustum(const Frustum& frustum, std::vector<UINT>& visible, CullStats* stats = nullptr) const;
+		//objects whose box and sphere both reach into the sphere
+		size_t QuerySphere(const float3& center, float radius, std::vector<UINT>& found) const;
+		//closest object box hit by origin + t * direction with 0 <= t <= maxDistance, false if none
+		bool Raycast(const float3& origin, const float3& direction, float maxDistance, BVHRayHit& hit) const;
+
+		size_t Count() const { return order.size(); }
+		const util::aligned_vector<BVHNode, 64>& Nodes() const { return nodes; }
+		const BVHStats& GetStats() const { return stats; }
+
+	private:
+		struct BuildState;
+		void BuildNode(BuildState& state, UINT index, UINT begin, UINT end, UINT depth);
+		void Gather(const CullStreams& objects, unsigned int threads);	//object bounds into slot order
+		void RefitNodes(unsigned int threads);
+		float SAHCost();	//also fills the shape stats
+
+		util::aligned_vector<BVHNode, 64> nodes;	//root first, children after their parents
+		std::vector<UINT> leaves;		//node indices
+		std::vector<UINT> order;		//object of every slot, the objects of a leaf are in consecutive slots
+		util::aligned_vector<float> center[3], extent[3], radius;	//by slot
+		BVHStats stats;
+		float rebuildRatio = 1.5f;
+		UINT rebuildInterval = 300;
+	};
+
+	struct BVHBenchmark
+	{
+		size_t objects = 0;
+		unsigned int threads = 0;
+		float buildMs = 0.0f;			//one thread
+		float threadedBuildMs = 0.0f;	//every job system thread
+		float refitMs = 0.0f;			//average refit of a frame
+		float updateMs = 0.0f;			//average Update of a frame, rebuilds included
+		UINT rebuilds = 0;				//of Update
+		float flatCullMs = 0.0f;		//CullObjects over every object
+		float frustumMs = 0.0f;			//QueryFrustum
+		size_t visible = 0;
+		float sphereUs = 0.0f;			//per QuerySphere
+		float rayUs = 0.0f;				//per Raycast
+	};
+	//objects drifting in a cube around a camera looking down +z for frames updates, queries after each
+	BVHBenchmark BenchmarkBVH(size_t objects = 100000, int frames = 60);
+}
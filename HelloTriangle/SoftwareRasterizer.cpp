@@ -0,0 +1,349 @@
+#include "pch.h"
+#include "SoftwareRasterizer.h"
+
+namespace
+{
+	const float NEAR_W = 1e-5f;			//vertices closer than this in w are clipped away
+	const float GUARD_BAND = 32768.0f;	//screen positions are clamped to this many pixels outside the target
+
+	// **********************************************************************************************************
+	// SHADER HELPERS
+	// **********************************************************************************************************
+
+	inline unsigned char ToUnorm8(float v)
+	{
+		if (!(v > 0.0f)) return 0; //also catches NaN, like a UNORM render target
+		if (v >= 1.0f) return 255;
+		return static_cast<unsigned char>(v * 255.0f + 0.5f);
+	}
+
+	inline int Wrap(int i, int n)
+	{
+		i %= n;
+		return i < 0 ? i + n : i;
+	}
+
+	//bilinear sample with wrap addressing, the texture has no mips so this is what the anisotropic sampler returns
+	void Sample(const dxh::ImageData& tex, float u, float v, float out[3])
+	{
+		out[0] = out[1] = out[2] = 0.0f; //unbound texture
+		if (tex.Empty() || tex.width <= 0 || tex.height <= 0 || tex.channels <= 0)
+			return;
+		if (!std::isfinite(u)) u = 0.0f;
+		if (!std::isfinite(v)) v = 0.0f;
+
+		const float fx = (u - std::floor(u)) * tex.width - 0.5f;
+		const float fy = (v - std::floor(v)) * tex.height - 0.5f;
+		const float x0f = std::floor(fx);
+		const float y0f = std::floor(fy);
+		const float tx = fx - x0f;
+		const float ty = fy - y0f;
+		const int x0 = Wrap(static_cast<int>(x0f), tex.width);
+		const int y0 = Wrap(static_cast<int>(y0f), tex.height);
+		const int x1 = Wrap(x0 + 1, tex.width);
+		const int y1 = Wrap(y0 + 1, tex.height);
+
+		const int xs[4] = { x0, x1, x0, x1 };
+		const int ys[4] = { y0, y0, y1, y1 };
+		const float ws[4] = { (1 - tx) * (1 - ty), tx * (1 - ty), (1 - tx) * ty, tx * ty };
+		for (int i = 0; i < 4; ++i)
+		{
+			const unsigned char* texel = &tex.Pixels()[(static_cast<size_t>(ys[i]) * tex.width + xs[i]) * tex.channels];
+			for (int c = 0; c < 3; ++c)
+				out[c] += ws[i] * texel[tex.channels >= 3 ? c : 0] * (1.0f / 255.0f);
+		}
+	}
+
+	inline long long Edge(int ax, int ay, int bx, int by, long long px, long long py)
+	{
+		return static_cast<long long>(bx - ax) * (py - ay) - static_cast<long long>(by - ay) * (px - ax);
+	}
+
+	//top-left fill rule for clockwise triangles in y-down screen space
+	inline bool IsTopLeft(int ax, int ay, int bx, int by)
+	{
+		return (ay == by && bx > ax) || by < ay;
+	}
+}
+
+namespace dxh
+{
+	SoftwareRasterizer::SoftwareRasterizer(UINT width, UINT height, UINT threads)
+		: width(0), height(0), tilesX(0), tilesY(0), threads(threads == 0 ? util::HardwareThreads() : threads),
+		lighting(GetLightingFunc(BestLightingKernel()))
+	{
+		Resize(width, height);
+	}
+
+	void SoftwareRasterizer::Resize(UINT width, UINT height)
+	{
+		this->width = width;
+		this->height = height;
+		tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+		colorBuffer = ImageData(static_cast<int>(width), static_cast<int>(height), 4);
+		colorBuffer.data.assign(static_cast<size_t>(width) * height * 4, 0);
+		depthBuffer.assign(static_cast<size_t>(width) * height, 1.0f);
+	}
+
+	void SoftwareRasterizer::SetLightingKernel(LightingKernel kernel)
+	{
+		if (LightingKernelSupported(kernel))
+			lighting = GetLightingFunc(kernel);
+	}
+
+	void SoftwareRasterizer::Clear(const float color[4], float depth)
+	{
+		const unsigned char rgba[4] = { ToUnorm8(color[0]), ToUnorm8(color[1]), ToUnorm8(color[2]), ToUnorm8(color[3]) };
+		unsigned char* dst = colorBuffer.data.data();
+		for (size_t i = 0, n = depthBuffer.size(); i < n; ++i, dst += 4)
+			memcpy(dst, rgba, 4);
+		std::fill(depthBuffer.begin(), depthBuffer.end(), depth);
+	}
+
+	void SoftwareRasterizer::Render(const Mesh& mesh, const WVP& wvp, const SimpleLight& light, const SimpleMaterial& material, const ImageData& texture)
+	{
+		util::DeltaTimer timer;
+		stats = RasterStats();
+		const size_t triangleCount = mesh.indices.size() / 3;
+		stats.trianglesIn = static_cast<UINT>(triangleCount);
+
+		// Vertex shader
+		ShadeVertices(mesh, wvp);
+
+		// Clip, cull and bin, one contiguous range of triangles per bin to keep submission order
+		const UINT tileCount = tilesX * tilesY;
+		bins.resize(threads);
+		for (Bin& bin : bins)
+		{
+			bin.triangles.clear();
+			bin.tiles.resize(tileCount);
+			for (std::vector<UINT>& tile : bin.tiles)
+				tile.clear();
+		}
+		util::ParallelFor(bins.size(), 1, [&](size_t begin, size_t end)
+			{
+				for (size_t b = begin; b < end; ++b)
+					SetupTriangles(bins[b], mesh, triangleCount * b / bins.size(), triangleCount * (b + 1) / bins.size());
+			}, threads);
+
+		// Pixel shader
+		std::atomic<UINT> tilesShaded{ 0 };
+		util::ParallelFor(tileCount, 1, [&](size_t begin, size_t end)
+			{
+				for (size_t t = begin; t < end; ++t)
+				{
+					bool any = false;
+					for (const Bin& bin : bins)
+						any = any || !bin.tiles[t].empty();
+					if (!any)
+						continue;
+					ShadeTile(static_cast<UINT>(t), light, material, texture);
+					tilesShaded.fetch_add(1, std::memory_order_relaxed);
+				}
+			}, threads);
+
+		for (const Bin& bin : bins)
+			stats.trianglesDrawn += static_cast<UINT>(bin.triangles.size());
+		stats.tilesShaded = tilesShaded.load();
+		stats.frameTime = timer.GetElapsed();
+		stats.trianglesPerSecond = stats.frameTime > 0.0f ? stats.trianglesIn / stats.frameTime : 0.0f;
+	}
+
+	// **********************************************************************************************************
+	// PIPELINE STAGES
+	// **********************************************************************************************************
+
+	//VertexShader.hlsl
+	void SoftwareRasterizer::ShadeVertices(const Mesh& mesh, const WVP& wvp)
+	{
+		// Callers fill in world, view and project, the combined matrices are built here like DXHandler does per frame
+		WVP matrices = wvp;
+		UpdateObjectMatrices(matrices);
+		TransformVertices(mesh, matrices, shaded, threads);
+	}
+
+	void SoftwareRasterizer::SetupTriangles(Bin& bin, const Mesh& mesh, size_t first, size_t last)
+	{
+		const size_t vertexCount = shaded.size();
+		for (size_t t = first; t < last; ++t)
+		{
+			const UINT* idx = &mesh.indices[t * 3];
+			if (idx[0] >= vertexCount || idx[1] >= vertexCount || idx[2] >= vertexCount)
+				continue;
+
+			const ShadedVertex* in[3] = { &shaded[idx[0]], &shaded[idx[1]], &shaded[idx[2]] };
+			const int inside = (in[0]->vpos[3] >= NEAR_W) + (in[1]->vpos[3] >= NEAR_W) + (in[2]->vpos[3] >= NEAR_W);
+			if (inside == 3)
+			{
+				AddTriangle(bin, *in[0], *in[1], *in[2]);
+				continue;
+			}
+			if (inside == 0)
+				continue;
+
+			// Clip against w = NEAR_W, leaves a triangle or a quad
+			ShadedVertex poly[4];
+			int count = 0;
+			for (int i = 0; i < 3; ++i)
+			{
+				const ShadedVertex& a = *in[i];
+				const ShadedVertex& b = *in[(i + 1) % 3];
+				const bool aInside = a.vpos[3] >= NEAR_W;
+				const bool bInside = b.vpos[3] >= NEAR_W;
+				if (aInside)
+					poly[count++] = a;
+				if (aInside != bInside)
+				{
+					const float s = (NEAR_W - a.vpos[3]) / (b.vpos[3] - a.vpos[3]);
+					const float* fa = &a.vpos[0];
+					const float* fb = &b.vpos[0];
+					float* fo = &poly[count].vpos[0];
+					for (size_t f = 0; f < sizeof(ShadedVertex) / sizeof(float); ++f)
+						fo[f] = fa[f] + (fb[f] - fa[f]) * s;
+					++count;
+				}
+			}
+			for (int i = 2; i < count; ++i)
+				AddTriangle(bin, poly[0], poly[i - 1], poly[i]);
+		}
+	}
+
+	void SoftwareRasterizer::AddTriangle(Bin& bin, const ShadedVertex& a, const ShadedVertex& b, const ShadedVertex& c)
+	{
+		SetupTriangle tri;
+		const ShadedVertex* v[3] = { &a, &b, &c };
+		for (int i = 0; i < 3; ++i)
+		{
+			const float invw = 1.0f / v[i]->vpos[3];
+			// Viewport transform, same as SetViewport(width, height, 0, 0, 1, 0)
+			float sx = (v[i]->vpos[0] * invw * 0.5f + 0.5f) * width;
+			float sy = (0.5f - v[i]->vpos[1] * invw * 0.5f) * height;
+			sx = std::min(std::max(sx, -GUARD_BAND), width + GUARD_BAND);
+			sy = std::min(std::max(sy, -GUARD_BAND), height + GUARD_BAND);
+			tri.x[i] = static_cast<int>(std::lround(sx * SUBPIXEL));
+			tri.y[i] = static_cast<int>(std::lround(sy * SUBPIXEL));
+			tri.z[i] = v[i]->vpos[2] * invw;
+			tri.invw[i] = invw;
+
+			const float attr[8] = { v[i]->pos[0], v[i]->pos[1], v[i]->pos[2], v[i]->uv[0], v[i]->uv[1], v[i]->normal[0], v[i]->normal[1], v[i]->normal[2] };
+			for (int f = 0; f < 8; ++f)
+				tri.attr[i][f] = attr[f] * invw;
+		}
+
+		// CullMode = D3D11_CULL_BACK with clockwise front faces, zero area triangles are dropped as well
+		tri.area = Edge(tri.x[0], tri.y[0], tri.x[1], tri.y[1], tri.x[2], tri.y[2]);
+		if (tri.area <= 0)
+			return;
+
+		const int minx = std::min({ tri.x[0], tri.x[1], tri.x[2] });
+		const int maxx = std::max({ tri.x[0], tri.x[1], tri.x[2] });
+		const int miny = std::min({ tri.y[0], tri.y[1], tri.y[2] });
+		const int maxy = std::max({ tri.y[0], tri.y[1], tri.y[2] });
+		// Pixels whose centers can be inside the triangle
+		tri.minx = std::max((minx - SUBPIXEL / 2 + SUBPIXEL - 1) >> SUBPIXEL_BITS, 0);
+		tri.miny = std::max((miny - SUBPIXEL / 2 + SUBPIXEL - 1) >> SUBPIXEL_BITS, 0);
+		tri.maxx = std::min((maxx - SUBPIXEL / 2) >> SUBPIXEL_BITS, static_cast<int>(width) - 1);
+		tri.maxy = std::min((maxy - SUBPIXEL / 2) >> SUBPIXEL_BITS, static_cast<int>(height) - 1);
+		if (tri.minx > tri.maxx || tri.miny > tri.maxy)
+			return;
+
+		const UINT index = static_cast<UINT>(bin.triangles.size());
+		bin.triangles.push_back(tri);
+		for (int ty = tri.miny / static_cast<int>(TILE_SIZE); ty <= tri.maxy / static_cast<int>(TILE_SIZE); ++ty)
+			for (int tx = tri.minx / static_cast<int>(TILE_SIZE); tx <= tri.maxx / static_cast<int>(TILE_SIZE); ++tx)
+				bin.tiles[ty * tilesX + tx].push_back(index);
+	}
+
+	void SoftwareRasterizer::ShadeTile(UINT tile, const SimpleLight& light, const SimpleMaterial& material, const ImageData& texture)
+	{
+		const int tileMinX = static_cast<int>((tile % tilesX) * TILE_SIZE);
+		const int tileMinY = static_cast<int>((tile / tilesX) * TILE_SIZE);
+		const int tileMaxX = std::min(tileMinX + static_cast<int>(TILE_SIZE), static_cast<int>(width)) - 1;
+		const int tileMaxY = std::min(tileMinY + static_cast<int>(TILE_SIZE), static_cast<int>(height)) - 1;
+
+		// Fragments that pass the depth test are collected per triangle and lit as one batch
+		FragmentBatch batch;
+		FragmentStreams frags;
+		for (int c = 0; c < 3; ++c)
+		{
+			frags.pos[c] = batch.pos[c];
+			frags.normal[c] = batch.normal[c];
+			frags.texel[c] = batch.texel[c];
+			frags.color[c] = batch.color[c];
+		}
+
+		for (const Bin& bin : bins)
+		{
+			for (UINT index : bin.tiles[tile])
+			{
+				const SetupTriangle& tri = bin.triangles[index];
+				const int x0 = std::max(tri.minx, tileMinX), x1 = std::min(tri.maxx, tileMaxX);
+				const int y0 = std::max(tri.miny, tileMinY), y1 = std::min(tri.maxy, tileMaxY);
+
+				const bool topleft[3] = {
+					IsTopLeft(tri.x[1], tri.y[1], tri.x[2], tri.y[2]),
+					IsTopLeft(tri.x[2], tri.y[2], tri.x[0], tri.y[0]),
+					IsTopLeft(tri.x[0], tri.y[0], tri.x[1], tri.y[1]) };
+				const float invArea = 1.0f / static_cast<float>(tri.area);
+				size_t count = 0;
+
+				for (int py = y0; py <= y1; ++py)
+				{
+					const long long cy = static_cast<long long>(py) * SUBPIXEL + SUBPIXEL / 2;
+					for (int px = x0; px <= x1; ++px)
+					{
+						const long long cx = static_cast<long long>(px) * SUBPIXEL + SUBPIXEL / 2;
+						const long long e[3] = {
+							Edge(tri.x[1], tri.y[1], tri.x[2], tri.y[2], cx, cy),
+							Edge(tri.x[2], tri.y[2], tri.x[0], tri.y[0], cx, cy),
+							Edge(tri.x[0], tri.y[0], tri.x[1], tri.y[1], cx, cy) };
+						if (e[0] < 0 || e[1] < 0 || e[2] < 0)
+							continue;
+						if ((e[0] == 0 && !topleft[0]) || (e[1] == 0 && !topleft[1]) || (e[2] == 0 && !topleft[2]))
+							continue;
+
+						const float l[3] = { e[0] * invArea, e[1] * invArea, e[2] * invArea };
+
+						// Depth test, D3D11_COMPARISON_LESS, depth clip is disabled so depth is clamped to the viewport
+						float z = l[0] * tri.z[0] + l[1] * tri.z[1] + l[2] * tri.z[2];
+						z = std::min(std::max(z, 0.0f), 1.0f);
+						const size_t pixel = static_cast<size_t>(py) * width + px;
+						if (!(z < depthBuffer[pixel]))
+							continue;
+						depthBuffer[pixel] = z;
+
+						const float w = 1.0f / (l[0] * tri.invw[0] + l[1] * tri.invw[1] + l[2] * tri.invw[2]);
+						float attr[8];
+						for (int f = 0; f < 8; ++f)
+							attr[f] = (l[0] * tri.attr[0][f] + l[1] * tri.attr[1][f] + l[2] * tri.attr[2][f]) * w;
+
+						float texel[3];
+						Sample(texture, attr[3], attr[4], texel);
+						for (int c = 0; c < 3; ++c)
+						{
+							batch.pos[c][count] = attr[c];
+							batch.normal[c][count] = attr[5 + c];
+							batch.texel[c][count] = texel[c];
+						}
+						batch.pixel[count++] = static_cast<UINT>(pixel);
+					}
+				}
+
+				if (count == 0)
+					continue;
+				frags.count = count;
+				lighting(frags, light, material);
+				for (size_t i = 0; i < count; ++i)
+				{
+					unsigned char* dst = &colorBuffer.data[static_cast<size_t>(batch.pixel[i]) * 4];
+					dst[0] = ToUnorm8(batch.color[0][i]);
+					dst[1] = ToUnorm8(batch.color[1][i]);
+					dst[2] = ToUnorm8(batch.color[2][i]);
+					dst[3] = 255;
+				}
+			}
+		}
+	}
+}
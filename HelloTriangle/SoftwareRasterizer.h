@@ -0,0 +1,93 @@
+#pragma once
+#include "pch.h"
+
+#include "Utilities.h"
+#include "Parallel.h"
+#include "CustomDataTypes.h"
+#include "Lighting.h"
+#include "VertexTransform.h"
+
+namespace dxh
+{
+	//Numbers from the last SoftwareRasterizer::Render call
+	struct RasterStats
+	{
+		UINT trianglesIn = 0;			//triangles in the index buffer
+		UINT trianglesDrawn = 0;		//triangles left after near plane clipping and back face culling
+		UINT tilesShaded = 0;			//tiles that had at least one triangle binned to them
+		float frameTime = 0.0f;			//seconds spent inside Render
+		float trianglesPerSecond = 0.0f;
+	};
+
+	//CPU render backend for the scene drawn by DXHandler::Render. Runs the math of hlsl/VertexShader.hlsl
+	//and hlsl/PixelShader.hlsl (see Lighting.h) and writes to an RGBA8 color buffer and a float depth buffer,
+	//so it works without a GPU or Windows. Triangles are binned into TILE_SIZE screen tiles and tiles are
+	//shaded in parallel.
+	class SoftwareRasterizer
+	{
+	public:
+		static const UINT TILE_SIZE = 32;
+		static const int SUBPIXEL_BITS = 8; //same subpixel precision as D3D11
+		static const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+
+		SoftwareRasterizer(UINT width, UINT height, UINT threads = 0);
+		~SoftwareRasterizer() {};
+		void Resize(UINT width, UINT height);
+		void Clear(const float color[4], float depth = 1.0f);
+		void Render(const Mesh& mesh, const WVP& wvp, const SimpleLight& light, const SimpleMaterial& material, const ImageData& texture);
+		void SetLightingKernel(LightingKernel kernel); //ignored if the CPU does not support it
+
+		UINT GetWidth() const { return width; }
+		UINT GetHeight() const { return height; }
+		const ImageData& GetColorBuffer() const { return colorBuffer; }	//RGBA8, same layout as a loaded texture
+		const std::vector<float>& GetDepthBuffer() const { return depthBuffer; }
+		const RasterStats& GetStats() const { return stats; }
+
+	private:
+		//vertex shader output, see VS_OUT
+		typedef TransformedVertex ShadedVertex;
+		//triangle after clipping, culling and the viewport transform
+		struct SetupTriangle
+		{
+			int x[3], y[3];		//screen position in 1/SUBPIXEL steps
+			float z[3];
+			float invw[3];
+			float attr[3][8];	//pos, uv, normal divided by w for perspective correct interpolation
+			long long area;		//twice the signed area in subpixel units, positive for front faces
+			int minx, miny, maxx, maxy;
+		};
+		//lighting inputs of the fragments one triangle covers in one tile
+		struct FragmentBatch
+		{
+			float pos[3][TILE_SIZE * TILE_SIZE];
+			float normal[3][TILE_SIZE * TILE_SIZE];
+			float texel[3][TILE_SIZE * TILE_SIZE];
+			float color[3][TILE_SIZE * TILE_SIZE];
+			UINT pixel[TILE_SIZE * TILE_SIZE];
+		};
+		//one contiguous range of the index buffer, set up by a single thread
+		struct Bin
+		{
+			std::vector<SetupTriangle> triangles;
+			std::vector<std::vector<UINT>> tiles; //triangle indices per tile, in submission order
+		};
+
+		void ShadeVertices(const Mesh& mesh, const WVP& wvp);
+		void SetupTriangles(Bin& bin, const Mesh& mesh, size_t first, size_t last);
+		void AddTriangle(Bin& bin, const ShadedVertex& a, const ShadedVertex& b, const ShadedVertex& c);
+		void ShadeTile(UINT tile, const SimpleLight& light, const SimpleMaterial& material, const ImageData& texture);
+
+	private:
+		UINT width;
+		UINT height;
+		UINT tilesX;
+		UINT tilesY;
+		UINT threads;
+		ImageData colorBuffer;
+		std::vector<float> depthBuffer;
+		std::vector<ShadedVertex> shaded;
+		std::vector<Bin> bins;
+		RasterStats stats;
+		LightingFunc lighting;
+	};
+}
@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "StateCache.h"
+
+namespace dxh
+{
+	StateCache::StateCache(PipelineBackend& backend)
+		: backend(backend), slots(static_cast<size_t>(StateKind::Count) * MAX_SLOTS)
+	{
+	}
+
+	void StateCache::Set(StateKind kind, UINT slot, const StateBinding& value)
+	{
+		if (!Update({ kind, slot, value }))
+			return;
+		backend.BindStates(kind, slot, 1, &value);
+		++stats.issued;
+	}
+
+	void StateCache::Apply(StateBlock& block)
+	{
+		std::vector<StateBlock::Entry>& entries = block.entries;
+		std::stable_sort(entries.begin(), entries.end(), [](const StateBlock::Entry& a, const StateBlock::Entry& b)
+			{
+				return a.kind != b.kind ? a.kind < b.kind : a.slot < b.slot;
+			});
+		size_t kept = 0;
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			if (i + 1 < entries.size() && entries[i + 1].kind == entries[i].kind && entries[i + 1].slot == entries[i].slot)
+				continue; //set again later, only the last value counts
+			entries[kept++] = entries[i];
+		}
+		entries.resize(kept);
+
+		// Changed slots of one kind that follow each other are bound together, at most MAX_SLOTS per call
+		size_t i = 0;
+		while (i < entries.size())
+		{
+			const StateBlock::Entry& first = entries[i++];
+			if (!Update(first))
+				continue;
+			run.assign(1, first.value);
+			while (i < entries.size() && run.size() < MAX_SLOTS && entries[i].kind == first.kind && entries[i].slot == first.slot + run.size())
+			{
+				if (!Update(entries[i++]))
+					break;
+				run.push_back(entries[i - 1].value);
+			}
+			backend.BindStates(first.kind, first.slot, static_cast<UINT>(run.size()), run.data());
+			++stats.issued;
+		}
+	}
+
+	bool StateCache::Update(const StateBlock::Entry& entry)
+	{
+		++stats.requested;
+		if (entry.slot >= MAX_SLOTS)
+			return true; //not tracked, D3D has up to 128 resource slots, bound every time
+		Slot& current = At(entry.kind, entry.slot);
+		if (current.known && current.value == entry.value)
+		{
+			++stats.elided;
+			return false;
+		}
+		current.value = entry.value;
+		current.known = true;
+		return true;
+	}
+
+	void StateCache::Invalidate()
+	{
+		for (Slot& slot : slots)
+			slot.known = false;
+	}
+}
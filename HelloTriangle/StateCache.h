@@ -0,0 +1,124 @@
+#pragma once
+#include "pch.h"
+
+namespace dxh
+{
+	//Pipeline bindings the cache knows about. Kinds with slots are bound in ranges of consecutive slots.
+	enum class StateKind
+	{
+		RenderTargets,		//object = render target view, extra = depth stencil view
+		DepthStencilState,	//a = stencil reference
+		RasterizerState,
+		Topology,			//a = D3D11_PRIMITIVE_TOPOLOGY
+		InputLayout,
+		VertexBuffer,		//slotted, a = stride, b = offset
+		IndexBuffer,		//a = DXGI_FORMAT, b = offset
+		VertexShader,
+		VSConstantBuffer,	//slotted
+		VSResource,			//slotted, shader resource views
+		PixelShader,
+		PSConstantBuffer,	//slotted
+		PSResource,			//slotted, shader resource views
+		PSSampler,			//slotted
+		Count,
+	};
+
+	//The value bound to a slot. Objects are opaque here so the cache builds without the D3D headers.
+	struct StateBinding
+	{
+		const void* object = nullptr;
+		const void* extra = nullptr;
+		UINT a = 0;
+		UINT b = 0;
+
+		StateBinding() {}
+		StateBinding(const void* object, UINT a = 0, UINT b = 0, const void* extra = nullptr) : object(object), extra(extra), a(a), b(b) {}
+		bool operator==(const StateBinding& other) const { return object == other.object && extra == other.extra && a == other.a && b == other.b; }
+		bool operator!=(const StateBinding& other) const { return !(*this == other); }
+	};
+
+	//Issues the bindings the cache decided are needed. DXHandler calls the device context,
+	//RecordingPipelineBackend records the calls for tests without a device.
+	class PipelineBackend
+	{
+	public:
+		virtual ~PipelineBackend() {}
+		//values[i] goes to slot firstSlot + i, count is 1 for kinds without slots
+		virtual void BindStates(StateKind kind, UINT firstSlot, UINT count, const StateBinding* values) = 0;
+	};
+
+	class RecordingPipelineBackend : public PipelineBackend
+	{
+	public:
+		struct Call
+		{
+			StateKind kind;
+			UINT firstSlot;
+			UINT count;
+		};
+
+		void BindStates(StateKind kind, UINT firstSlot, UINT count, const StateBinding*) override { calls.push_back({ kind, firstSlot, count }); }
+
+		std::vector<Call> calls;
+	};
+
+	//The bindings of one draw. Set in any order, StateCache::Apply sorts them by kind and slot.
+	class StateBlock
+	{
+	public:
+		struct Entry
+		{
+			StateKind kind;
+			UINT slot;
+			StateBinding value;
+		};
+
+		void Clear() { entries.clear(); }
+		void Set(StateKind kind, UINT slot, const StateBinding& value) { entries.push_back({ kind, slot, value }); }
+		void Set(StateKind kind, const StateBinding& value) { Set(kind, 0, value); }
+
+		std::vector<Entry> entries;
+	};
+
+	struct StateCacheStats
+	{
+		size_t requested = 0;	//slot values asked for
+		size_t elided = 0;		//of those, already bound
+		size_t issued = 0;		//calls made on the backend, a range of slots is one call
+	};
+
+	//Remembers what is bound to every slot and only passes changes on to the backend.
+	//Anything that binds around the cache (UI libraries, debug tools) has to call Invalidate afterwards.
+	//Slots from MAX_SLOTS on are passed through uncached.
+	class StateCache
+	{
+	public:
+		static const UINT MAX_SLOTS = 16;
+
+		explicit StateCache(PipelineBackend& backend);
+
+		void Set(StateKind kind, UINT slot, const StateBinding& value);
+		void Set(StateKind kind, const StateBinding& value) { Set(kind, 0, value); }
+		//sorts the block (a slot set twice keeps the later value), skips what is bound already and binds the rest with one call per run of consecutive slots
+		void Apply(StateBlock& block);
+		//forgets everything, the next request for every slot is issued
+		void Invalidate();
+
+		const StateCacheStats& GetStats() const { return stats; }
+		void ResetStats() { stats = StateCacheStats(); }
+
+	private:
+		struct Slot
+		{
+			StateBinding value;
+			bool known = false;
+		};
+		bool Update(const StateBlock::Entry& entry); //true when the slot changed or is not tracked, counts the request
+		Slot& At(StateKind kind, UINT slot) { return slots[static_cast<size_t>(kind) * MAX_SLOTS + slot]; }
+
+		PipelineBackend& backend;
+		std::vector<Slot> slots;		//MAX_SLOTS per kind
+		std::vector<StateBinding> run;	//scratch for Apply
+		StateCacheStats stats;
+	};
+}
@@ -0,0 +1,206 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Utilities.h"
+
+namespace dxh
+{
+	bool PrepareTexture(const ImageData& image, BlockFormat format, TextureData& out, UINT threads)
+	{
+		out = TextureData();
+		if (!GenerateMipChain(image, out.mips, true, threads))
+			return false;
+		if (format == BlockFormat::None)
+			return true;
+		if (image.width % 4 != 0 || image.height % 4 != 0)
+		{
+			util::DebugLog("Texture is " + std::to_string(image.width) + "x" + std::to_string(image.height) +
+				", not a multiple of 4, uploaded uncompressed.");
+			return true;
+		}
+		if (!CompressMipChain(out.mips, out.compressed, format, CompressionQuality::Normal, threads))
+		{
+			util::DebugLog("Block compression failed, texture uploaded uncompressed.");
+			return true;
+		}
+		// Only the compressed levels are uploaded
+		out.format = format;
+		out.mips.data.clear();
+		out.mips.data.shrink_to_fit();
+		return true;
+	}
+
+	TextureStreamer::TextureStreamer(TextureUploadSink& sink, ImageDecoder decoder, UINT workers, size_t uploadBudget, BlockFormat format)
+		: sink(sink), decoder(decoder), uploadBudget(uploadBudget), format(format)
+	{
+		maxJobs = workers == 0 ? std::max(1u, util::JobSystem::Global().WorkerCount()) : workers;
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+			queue.clear(); //requests nobody started are dropped
+		}
+		util::JobSystem::Global().Wait(decodeJobs); //decodes in progress still finish
+	}
+
+	TextureHandle TextureStreamer::Request(const std::string& filepath, const unsigned char placeholder[4])
+	{
+		static const unsigned char GREY[4] = { 128, 128, 128, 255 };
+		ImageData stand(1, 1, 4);
+		const unsigned char* color = placeholder ? placeholder : GREY;
+		stand.data.assign(color, color + 4);
+
+		TextureHandle handle;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			handle = static_cast<TextureHandle>(states.size());
+			states.push_back(TextureState::Queued);
+			paths.push_back(filepath);
+		}
+		sink.CreatePlaceholder(handle, stand);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++stats.requested;
+			queue.emplace_back(handle, filepath);
+			Schedule();
+		}
+		return handle;
+	}
+
+	size_t TextureStreamer::Reload(const std::string& filepath)
+	{
+		size_t count = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (TextureHandle handle = 0; handle < paths.size(); ++handle)
+			{
+				if (paths[handle] != filepath)
+					continue;
+				states[handle] = TextureState::Queued;
+				queue.emplace_back(handle, filepath);
+				Schedule();
+				++count;
+			}
+		}
+		return count;
+	}
+
+	size_t TextureStreamer::Update()
+	{
+		size_t bytes = 0;
+		for (;;)
+		{
+			std::pair<TextureHandle, TextureData> next;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (decoded.empty())
+					break;
+				const size_t size = decoded.front().second.ByteSize();
+				if (bytes > 0 && bytes + size > uploadBudget)
+					break; //the rest waits for the next frame
+				next = std::move(decoded.front());
+				decoded.pop_front();
+			}
+
+			const bool uploaded = sink.Upload(next.first, next.second);
+			bytes += next.second.ByteSize();
+			std::lock_guard<std::mutex> lock(mutex);
+			states[next.first] = uploaded ? TextureState::Resident : TextureState::Failed;
+			if (uploaded)
+				++stats.uploaded;
+			else
+				++stats.failed;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		++stats.updates;
+		stats.bytesUploaded += bytes;
+		stats.lastFrameBytes = bytes;
+		return bytes;
+	}
+
+	TextureStreamStats TextureStreamer::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+
+	TextureState TextureStreamer::GetState(TextureHandle handle) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return handle < states.size() ? states[handle] : TextureState::Failed;
+	}
+
+	bool TextureStreamer::Idle() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return queue.empty() && decoding == 0 && decoded.empty();
+	}
+
+	void TextureStreamer::WaitForDecodes()
+	{
+		// Jobs only finish once the queue is empty, the waiting thread helps decoding
+		util::JobSystem::Global().Wait(decodeJobs);
+	}
+
+	void TextureStreamer::Schedule()
+	{
+		// Jobs that are not decoding yet are about to take from the queue
+		if (stop || jobs >= maxJobs || queue.size() <= jobs - decoding)
+			return;
+		++jobs;
+		util::JobSystem::Global().Run([this]() { DecodeQueued(); }, &decodeJobs);
+	}
+
+	void TextureStreamer::DecodeQueued()
+	{
+		for (;;)
+		{
+			std::pair<TextureHandle, std::string> job;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (stop || queue.empty())
+				{
+					--jobs;
+					return;
+				}
+				job = std::move(queue.front());
+				queue.pop_front();
+				++decoding;
+			}
+
+			ImageData image;
+			TextureData texture;
+			bool ok;
+			{
+				PROFILE_ZONE("Decode texture");
+				ok = decoder(job.second, image);
+			}
+			if (ok)
+			{
+				// Mips and block compression here, Update only copies finished subresources
+				PROFILE_ZONE("Prepare texture");
+				ok = PrepareTexture(image, format, texture);
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--decoding;
+				if (ok)
+				{
+					states[job.first] = TextureState::Decoded;
+					decoded.emplace_back(job.first, std::move(texture));
+				}
+				else
+				{
+					states[job.first] = TextureState::Failed;
+					++stats.failed;
+				}
+			}
+		}
+	}
+}
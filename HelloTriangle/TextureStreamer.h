@@ -0,0 +1,115 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+#include "MipChain.h"
+#include "BlockCompression.h"
+#include "JobSystem.h"
+
+namespace dxh
+{
+	typedef UINT TextureHandle;
+	const TextureHandle INVALID_TEXTURE = ~0u;
+
+	enum class TextureState
+	{
+		Queued,		//waiting for or being decoded, the placeholder is bound
+		Decoded,	//waiting for upload budget
+		Resident,	//full image uploaded
+		Failed,		//decoding failed, the placeholder stays
+	};
+
+	//Every subresource of a texture, ready to be copied into it. Built by PrepareTexture on a worker,
+	//so the thread that uploads has nothing left to compute.
+	struct TextureData
+	{
+		BlockFormat format = BlockFormat::None;	//None: the rgba8 levels of mips, otherwise compressed holds them
+		MipChain mips;
+		CompressedImage compressed;
+
+		UINT LevelCount() const { return format == BlockFormat::None ? mips.LevelCount() : compressed.LevelCount(); }
+		UINT Width() const { return LevelCount() == 0 ? 0 : format == BlockFormat::None ? mips.levels[0].width : compressed.levels[0].width; }
+		UINT Height() const { return LevelCount() == 0 ? 0 : format == BlockFormat::None ? mips.levels[0].height : compressed.levels[0].height; }
+		const unsigned char* LevelData(UINT level) const { return format == BlockFormat::None ? mips.LevelData(level) : compressed.LevelData(level); }
+		//D3D11_SUBRESOURCE_DATA::SysMemPitch, a row of pixels or of 4x4 blocks
+		UINT RowPitch(UINT level) const { return format == BlockFormat::None ? mips.levels[level].pitch : compressed.levels[level].rowPitch; }
+		size_t ByteSize() const { return format == BlockFormat::None ? mips.data.size() : compressed.data.size(); }
+	};
+
+	//Full mip chain of image, block compressed to format when it is not None. Images that are not whole
+	//4x4 blocks (D3D11 needs that for the top level) or fail to compress are kept as rgba8 and logged.
+	bool PrepareTexture(const ImageData& image, BlockFormat format, TextureData& out, UINT threads = 0);
+
+	//Receives the textures of the streamer on the thread that calls TextureStreamer::Update.
+	//The D3D implementation creates textures, tests can implement it without a device.
+	class TextureUploadSink
+	{
+	public:
+		virtual ~TextureUploadSink() {}
+		virtual bool CreatePlaceholder(TextureHandle handle, const ImageData& placeholder) = 0;
+		virtual bool Upload(TextureHandle handle, const TextureData& texture) = 0;
+	};
+
+	//decodes filepath into target on a job system thread, false if it could not
+	typedef std::function<bool(const std::string& filepath, ImageData& target)> ImageDecoder;
+
+	struct TextureStreamStats
+	{
+		size_t requested = 0;
+		size_t uploaded = 0;
+		size_t failed = 0;
+		size_t bytesUploaded = 0;	//TextureData::ByteSize, compressed when a format is set
+		size_t lastFrameBytes = 0;	//bytes uploaded by the last Update
+		UINT updates = 0;			//calls to Update
+	};
+
+	//Asynchronous texture loading. Request binds a 1x1 placeholder right away and queues the file for
+	//decode jobs on the shared job system, which also build the mips and block compress them to format.
+	//Update moves finished textures to the sink with at most uploadBudget bytes per call (one texture is
+	//always allowed, so textures larger than the budget still get through).
+	class TextureStreamer
+	{
+	public:
+		//workers limits how many decodes run at once, 0 allows one per job system worker
+		TextureStreamer(TextureUploadSink& sink, ImageDecoder decoder, UINT workers = 0, size_t uploadBudget = 8 << 20, BlockFormat format = BlockFormat::None);
+		~TextureStreamer();
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		//placeholder is the rgba color of the 1x1 stand-in
+		TextureHandle Request(const std::string& filepath, const unsigned char placeholder[4] = nullptr);
+		//decodes every texture requested from filepath again, the current images stay bound until
+		//the new ones are uploaded. Returns the number of textures queued.
+		size_t Reload(const std::string& filepath);
+		//call once per frame from the thread that owns the sink, returns the bytes uploaded
+		size_t Update();
+
+		TextureState GetState(TextureHandle handle) const;
+		bool Idle() const;		//nothing queued, decoding or waiting for upload
+		void WaitForDecodes();	//blocks until every queued request is decoded or failed
+		void SetUploadBudget(size_t bytes) { uploadBudget = bytes; }
+		size_t GetUploadBudget() const { return uploadBudget; }
+		TextureStreamStats GetStats() const;
+
+	private:
+		void Schedule();		//starts another decode job if allowed, mutex held
+		void DecodeQueued();	//a decode job, runs until the queue is empty
+
+		TextureUploadSink& sink;
+		ImageDecoder decoder;
+		size_t uploadBudget;
+		BlockFormat format;
+		TextureStreamStats stats;
+
+		mutable std::mutex mutex;
+		std::vector<TextureState> states;	//by handle
+		std::vector<std::string> paths;		//by handle
+		std::deque<std::pair<TextureHandle, std::string>> queue;
+		std::deque<std::pair<TextureHandle, TextureData>> decoded;
+		size_t decoding = 0;
+		bool stop = false;
+		UINT maxJobs;
+		UINT jobs = 0;				//decode jobs started and not finished
+		util::JobCounter decodeJobs;
+	};
+}
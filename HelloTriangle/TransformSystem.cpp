@@ -0,0 +1,353 @@
+#include "pch.h"
+#include "TransformSystem.h"
+
+#include "Parallel.h"
+#include "Utilities.h"
+
+namespace
+{
+	//the objects from first on, count of them
+	dxh::TransformStreams Slice(const dxh::TransformStreams& in, size_t first, size_t count)
+	{
+		dxh::TransformStreams slice = in;
+		for (int c = 0; c < 3; ++c)
+		{
+			slice.pos[c] += first;
+			slice.scale[c] += first;
+		}
+		for (int c = 0; c < 4; ++c)
+			slice.rotation[c] += first;
+		slice.count = count;
+		return slice;
+	}
+
+	float* Matrix(void* out, size_t stride, size_t i)
+	{
+		return reinterpret_cast<float*>(static_cast<char*>(out) + i * stride);
+	}
+
+#if DXH_X86
+	// **********************************************************************************************************
+	// SSE
+	// **********************************************************************************************************
+
+	//row r of 4 objects' matrices, one object per lane, written to their four matrices
+	DXH_TARGET_SSE inline void StoreRows4(__m128 a, __m128 b, __m128 c, __m128 d, void* out, size_t stride, size_t i, int r)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		_mm_store_ps(Matrix(out, stride, i + 0) + r * 4, a);
+		_mm_store_ps(Matrix(out, stride, i + 1) + r * 4, b);
+		_mm_store_ps(Matrix(out, stride, i + 2) + r * 4, c);
+		_mm_store_ps(Matrix(out, stride, i + 3) + r * 4, d);
+	}
+
+	DXH_TARGET_SSE void ComposeSSE(const dxh::TransformStreams& in, void* out, size_t stride, size_t count)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+		for (size_t i = 0; i < count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(in.rotation[0] + i);
+			const __m128 y = _mm_loadu_ps(in.rotation[1] + i);
+			const __m128 z = _mm_loadu_ps(in.rotation[2] + i);
+			const __m128 w = _mm_loadu_ps(in.rotation[3] + i);
+
+			// 2 / |q|^2 instead of 2 keeps quaternions that drifted off unit length a pure rotation
+			const __m128 n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+			const __m128 s = _mm_and_ps(_mm_cmpgt_ps(n, zero), _mm_div_ps(two, n));
+			const __m128 xs = _mm_mul_ps(x, s), ys = _mm_mul_ps(y, s), zs = _mm_mul_ps(z, s);
+			const __m128 wx = _mm_mul_ps(w, xs), wy = _mm_mul_ps(w, ys), wz = _mm_mul_ps(w, zs);
+			const __m128 xx = _mm_mul_ps(x, xs), xy = _mm_mul_ps(x, ys), xz = _mm_mul_ps(x, zs);
+			const __m128 yy = _mm_mul_ps(y, ys), yz = _mm_mul_ps(y, zs), zz = _mm_mul_ps(z, zs);
+
+			const __m128 sx = _mm_loadu_ps(in.scale[0] + i);
+			const __m128 sy = _mm_loadu_ps(in.scale[1] + i);
+			const __m128 sz = _mm_loadu_ps(in.scale[2] + i);
+
+			StoreRows4(
+				_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+				_mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+				_mm_mul_ps(_mm_add_ps(xz, wy), sz),
+				_mm_loadu_ps(in.pos[0] + i), out, stride, i, 0);
+			StoreRows4(
+				_mm_mul_ps(_mm_add_ps(xy, wz), sx),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+				_mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+				_mm_loadu_ps(in.pos[1] + i), out, stride, i, 1);
+			StoreRows4(
+				_mm_mul_ps(_mm_sub_ps(xz, wy), sx),
+				_mm_mul_ps(_mm_add_ps(yz, wx), sy),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz),
+				_mm_loadu_ps(in.pos[2] + i), out, stride, i, 2);
+			for (size_t k = 0; k < 4; ++k)
+				_mm_store_ps(Matrix(out, stride, i + k) + 12, lastRow);
+		}
+	}
+
+	// **********************************************************************************************************
+	// AVX2
+	// **********************************************************************************************************
+
+	//row r of 8 objects' matrices, the 128 bit halves hold objects 0-3 and 4-7
+	DXH_TARGET_AVX2 inline void StoreRows8(__m256 a, __m256 b, __m256 c, __m256 d, void* out, size_t stride, size_t i, int r)
+	{
+		const __m256 t0 = _mm256_unpacklo_ps(a, b);
+		const __m256 t1 = _mm256_unpackhi_ps(a, b);
+		const __m256 t2 = _mm256_unpacklo_ps(c, d);
+		const __m256 t3 = _mm256_unpackhi_ps(c, d);
+		const __m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		const __m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		_mm_store_ps(Matrix(out, stride, i + 0) + r * 4, _mm256_castps256_ps128(r0));
+		_mm_store_ps(Matrix(out, stride, i + 1) + r * 4, _mm256_castps256_ps128(r1));
+		_mm_store_ps(Matrix(out, stride, i + 2) + r * 4, _mm256_castps256_ps128(r2));
+		_mm_store_ps(Matrix(out, stride, i + 3) + r * 4, _mm256_castps256_ps128(r3));
+		_mm_store_ps(Matrix(out, stride, i + 4) + r * 4, _mm256_extractf128_ps(r0, 1));
+		_mm_store_ps(Matrix(out, stride, i + 5) + r * 4, _mm256_extractf128_ps(r1, 1));
+		_mm_store_ps(Matrix(out, stride, i + 6) + r * 4, _mm256_extractf128_ps(r2, 1));
+		_mm_store_ps(Matrix(out, stride, i + 7) + r * 4, _mm256_extractf128_ps(r3, 1));
+	}
+
+	DXH_TARGET_AVX2 void ComposeAVX2(const dxh::TransformStreams& in, void* out, size_t stride, size_t count)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		const __m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(in.rotation[0] + i);
+			const __m256 y = _mm256_loadu_ps(in.rotation[1] + i);
+			const __m256 z = _mm256_loadu_ps(in.rotation[2] + i);
+			const __m256 w = _mm256_loadu_ps(in.rotation[3] + i);
+
+			const __m256 n = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_fmadd_ps(z, z, _mm256_mul_ps(w, w))));
+			const __m256 s = _mm256_and_ps(_mm256_cmp_ps(n, zero, _CMP_GT_OQ), _mm256_div_ps(two, n));
+			const __m256 xs = _mm256_mul_ps(x, s), ys = _mm256_mul_ps(y, s), zs = _mm256_mul_ps(z, s);
+			const __m256 wx = _mm256_mul_ps(w, xs), wy = _mm256_mul_ps(w, ys), wz = _mm256_mul_ps(w, zs);
+			const __m256 xx = _mm256_mul_ps(x, xs), xy = _mm256_mul_ps(x, ys), xz = _mm256_mul_ps(x, zs);
+			const __m256 yy = _mm256_mul_ps(y, ys), yz = _mm256_mul_ps(y, zs), zz = _mm256_mul_ps(z, zs);
+
+			const __m256 sx = _mm256_loadu_ps(in.scale[0] + i);
+			const __m256 sy = _mm256_loadu_ps(in.scale[1] + i);
+			const __m256 sz = _mm256_loadu_ps(in.scale[2] + i);
+
+			StoreRows8(
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+				_mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+				_mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+				_mm256_loadu_ps(in.pos[0] + i), out, stride, i, 0);
+			StoreRows8(
+				_mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+				_mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+				_mm256_loadu_ps(in.pos[1] + i), out, stride, i, 1);
+			StoreRows8(
+				_mm256_mul_ps(_mm256_sub_ps(xz, wy), sx),
+				_mm256_mul_ps(_mm256_add_ps(yz, wx), sy),
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz),
+				_mm256_loadu_ps(in.pos[2] + i), out, stride, i, 2);
+			for (size_t k = 0; k < 8; ++k)
+				_mm_store_ps(Matrix(out, stride, i + k) + 12, lastRow);
+		}
+	}
+#endif
+}
+
+namespace dxh
+{
+	void ComposeWorldsScalar(const TransformStreams& in, void* out, size_t stride)
+	{
+		for (size_t i = 0; i < in.count; ++i)
+		{
+			const float x = in.rotation[0][i], y = in.rotation[1][i], z = in.rotation[2][i], w = in.rotation[3][i];
+			const float n = x * x + y * y + z * z + w * w;
+			const float s = n > 0.0f ? 2.0f / n : 0.0f;
+			const float xs = x * s, ys = y * s, zs = z * s;
+			const float wx = w * xs, wy = w * ys, wz = w * zs;
+			const float xx = x * xs, xy = x * ys, xz = x * zs;
+			const float yy = y * ys, yz = y * zs, zz = z * zs;
+			const float sx = in.scale[0][i], sy = in.scale[1][i], sz = in.scale[2][i];
+
+			float* m = Matrix(out, stride, i);
+			m[0] = (1.0f - (yy + zz)) * sx;	m[1] = (xy - wz) * sy;			m[2] = (xz + wy) * sz;			m[3] = in.pos[0][i];
+			m[4] = (xy + wz) * sx;			m[5] = (1.0f - (xx + zz)) * sy;	m[6] = (yz - wx) * sz;			m[7] = in.pos[1][i];
+			m[8] = (xz - wy) * sx;			m[9] = (yz + wx) * sy;			m[10] = (1.0f - (xx + yy)) * sz;	m[11] = in.pos[2][i];
+			m[12] = 0.0f;					m[13] = 0.0f;					m[14] = 0.0f;					m[15] = 1.0f;
+		}
+	}
+
+	void ComposeWorldsSSE(const TransformStreams& in, void* out, size_t stride)
+	{
+		size_t simd = 0;
+#if DXH_X86
+		simd = in.count & ~size_t(3);
+		ComposeSSE(in, out, stride, simd);
+#endif
+		if (simd < in.count)
+			ComposeWorldsScalar(Slice(in, simd, in.count - simd), Matrix(out, stride, simd), stride);
+	}
+
+	void ComposeWorldsAVX2(const TransformStreams& in, void* out, size_t stride)
+	{
+		size_t simd = 0;
+#if DXH_X86
+		simd = in.count & ~size_t(7);
+		ComposeAVX2(in, out, stride, simd);
+#endif
+		if (simd < in.count)
+			ComposeWorldsSSE(Slice(in, simd, in.count - simd), Matrix(out, stride, simd), stride);
+	}
+
+	bool TransformKernelSupported(TransformKernel kernel)
+	{
+#if DXH_X86
+		static const bool sse = util::CpuHasSSE2();
+		static const bool avx2 = util::CpuHasAVX2();
+		switch (kernel)
+		{
+		case TransformKernel::Scalar: return true;
+		case TransformKernel::SSE: return sse;
+		case TransformKernel::AVX2: return avx2;
+		}
+		return false;
+#else
+		return kernel == TransformKernel::Scalar;
+#endif
+	}
+
+	TransformKernel BestTransformKernel()
+	{
+		static const TransformKernel best =
+			TransformKernelSupported(TransformKernel::AVX2) ? TransformKernel::AVX2 :
+			TransformKernelSupported(TransformKernel::SSE) ? TransformKernel::SSE : TransformKernel::Scalar;
+		return best;
+	}
+
+	TransformFunc GetTransformFunc(TransformKernel kernel)
+	{
+		switch (kernel)
+		{
+		case TransformKernel::SSE: return ComposeWorldsSSE;
+		case TransformKernel::AVX2: return ComposeWorldsAVX2;
+		default: return ComposeWorldsScalar;
+		}
+	}
+
+	const char* TransformKernelName(TransformKernel kernel)
+	{
+		switch (kernel)
+		{
+		case TransformKernel::SSE: return "SSE";
+		case TransformKernel::AVX2: return "AVX2";
+		default: return "Scalar";
+		}
+	}
+
+	// **********************************************************************************************************
+	// TRANSFORM SYSTEM
+	// **********************************************************************************************************
+
+	TransformId TransformSystem::Add(const float3& position, const DirectX::XMFLOAT4& rotation, const float3& scale)
+	{
+		const TransformId id = static_cast<TransformId>(px.size());
+		px.push_back(position.x), py.push_back(position.y), pz.push_back(position.z);
+		qx.push_back(rotation.x), qy.push_back(rotation.y), qz.push_back(rotation.z), qw.push_back(rotation.w);
+		sx.push_back(scale.x), sy.push_back(scale.y), sz.push_back(scale.z);
+		return id;
+	}
+
+	void TransformSystem::Clear()
+	{
+		px.clear(), py.clear(), pz.clear();
+		qx.clear(), qy.clear(), qz.clear(), qw.clear();
+		sx.clear(), sy.clear(), sz.clear();
+		worlds.clear();
+	}
+
+	void TransformSystem::RotateAll(const DirectX::XMFLOAT4& q)
+	{
+		// q * r for every rotation r, written out so the compiler vectorizes it
+		float* x = qx.data();
+		float* y = qy.data();
+		float* z = qz.data();
+		float* w = qw.data();
+		util::ParallelFor(Count(), GRAIN * 4, [=](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					const float rx = x[i], ry = y[i], rz = z[i], rw = w[i];
+					x[i] = q.w * rx + q.x * rw + q.y * rz - q.z * ry;
+					y[i] = q.w * ry - q.x * rz + q.y * rw + q.z * rx;
+					z[i] = q.w * rz + q.x * ry - q.y * rx + q.z * rw;
+					w[i] = q.w * rw - q.x * rx - q.y * ry - q.z * rz;
+				}
+			});
+	}
+
+	TransformStreams TransformSystem::Streams() const
+	{
+		TransformStreams streams;
+		streams.pos[0] = px.data(), streams.pos[1] = py.data(), streams.pos[2] = pz.data();
+		streams.rotation[0] = qx.data(), streams.rotation[1] = qy.data(), streams.rotation[2] = qz.data(), streams.rotation[3] = qw.data();
+		streams.scale[0] = sx.data(), streams.scale[1] = sy.data(), streams.scale[2] = sz.data();
+		streams.count = Count();
+		return streams;
+	}
+
+	void TransformSystem::Update(TransformKernel kernel, unsigned int threads)
+	{
+		worlds.resize(Count());
+		Update(worlds.data(), sizeof(DirectX::XMFLOAT4X4), kernel, threads);
+	}
+
+	void TransformSystem::Update(void* out, size_t stride, TransformKernel kernel, unsigned int threads)
+	{
+		if (!TransformKernelSupported(kernel))
+			kernel = BestTransformKernel();
+		const TransformFunc compose = GetTransformFunc(kernel);
+		const TransformStreams streams = Streams();
+		util::ParallelFor(streams.count, GRAIN, [&](size_t begin, size_t end)
+			{
+				compose(Slice(streams, begin, end - begin), Matrix(out, stride, begin), stride);
+			}, threads);
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	TransformBenchmark BenchmarkTransforms(size_t objects, int repeats)
+	{
+		TransformSystem system;
+		for (size_t i = 0; i < objects; ++i)
+		{
+			const float f = static_cast<float>(i);
+			system.Add(float3(f, f * 0.5f, -f), DirectX::XMFLOAT4(0.0f, std::sin(f), 0.0f, std::cos(f)), float3(1.0f, 2.0f, 1.0f));
+		}
+		system.Update(); //touch the output once so the first timed run does not pay for page faults
+
+		TransformBenchmark result;
+		result.objects = objects;
+		result.threads = util::JobSystem::Global().ThreadCount();
+		result.kernel = BestTransformKernel();
+		auto best = [&](TransformKernel kernel, unsigned int threads)
+		{
+			float ms = FLT_MAX;
+			for (int r = 0; r < repeats; ++r)
+			{
+				util::DeltaTimer timer;
+				system.Update(kernel, threads);
+				ms = std::min(ms, timer.GetElapsed() * 1000.0f);
+			}
+			return ms;
+		};
+		result.scalarMs = best(TransformKernel::Scalar, 1);
+		result.bestMs = best(result.kernel, 1);
+		result.threadedMs = best(result.kernel, 0);
+		return result;
+	}
+}
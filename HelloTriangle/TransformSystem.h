@@ -0,0 +1,85 @@
+#pragma once
+#include "pch.h"
+
+#include "Simd.h"
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	typedef UINT TransformId;
+
+	//Structure of arrays input of the compose kernels, every stream holds count floats.
+	//rotation is a quaternion (x, y, z, w), it does not have to be normalized.
+	struct TransformStreams
+	{
+		const float* pos[3];
+		const float* rotation[4];
+		const float* scale[3];
+		size_t count;
+	};
+
+	enum class TransformKernel
+	{
+		Scalar,
+		SSE,	//4 objects per pass
+		AVX2,	//8 objects per pass
+	};
+
+	//Writes world = translation * rotation * scale of every object to out, one matrix every stride bytes.
+	//Matrices are stored transposed like WVP::world (translation in the last column) for mul(v, M) in hlsl.
+	//out has to be 16 byte aligned and stride a multiple of 16.
+	typedef void(*TransformFunc)(const TransformStreams& in, void* out, size_t stride);
+
+	void ComposeWorldsScalar(const TransformStreams& in, void* out, size_t stride);
+	void ComposeWorldsSSE(const TransformStreams& in, void* out, size_t stride);
+	void ComposeWorldsAVX2(const TransformStreams& in, void* out, size_t stride);
+
+	bool TransformKernelSupported(TransformKernel kernel);
+	TransformKernel BestTransformKernel();	//widest kernel the CPU supports, checked once
+	TransformFunc GetTransformFunc(TransformKernel kernel);
+	const char* TransformKernelName(TransformKernel kernel);
+
+	//Position, rotation and scale of many objects in SoA streams. Update composes every world matrix
+	//with the SIMD kernels, split over the job system, into one 16 byte aligned array ready for upload.
+	class TransformSystem
+	{
+	public:
+		static const size_t GRAIN = 16384; //objects per job, a multiple of 8 so only the last chunk has a tail
+
+		TransformId Add(const float3& position, const DirectX::XMFLOAT4& rotation = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), const float3& scale = float3(1.0f, 1.0f, 1.0f));
+		void Clear();
+		size_t Count() const { return px.size(); }
+
+		void SetPosition(TransformId id, const float3& position) { px[id] = position.x, py[id] = position.y, pz[id] = position.z; }
+		void SetRotation(TransformId id, const DirectX::XMFLOAT4& q) { qx[id] = q.x, qy[id] = q.y, qz[id] = q.z, qw[id] = q.w; }
+		void SetScale(TransformId id, const float3& scale) { sx[id] = scale.x, sy[id] = scale.y, sz[id] = scale.z; }
+		//turns every object by the quaternion q around its own position, for many objects spinning at once
+		void RotateAll(const DirectX::XMFLOAT4& q);
+
+		//composes every world matrix into GetWorlds
+		void Update(TransformKernel kernel = BestTransformKernel(), unsigned int threads = 0);
+		//composes into out instead, one matrix every stride bytes (InstanceData::world for instance)
+		void Update(void* out, size_t stride, TransformKernel kernel = BestTransformKernel(), unsigned int threads = 0);
+
+		const DirectX::XMFLOAT4X4* GetWorlds() const { return worlds.data(); }
+		TransformStreams Streams() const;
+
+	private:
+		util::aligned_vector<float> px, py, pz;
+		util::aligned_vector<float> qx, qy, qz, qw;
+		util::aligned_vector<float> sx, sy, sz;
+		util::aligned_vector<DirectX::XMFLOAT4X4, 16> worlds;
+	};
+
+	struct TransformBenchmark
+	{
+		size_t objects = 0;
+		unsigned int threads = 0;
+		float scalarMs = 0.0f;		//one thread
+		float bestMs = 0.0f;		//best kernel, one thread
+		float threadedMs = 0.0f;	//best kernel on every job system thread
+		TransformKernel kernel = TransformKernel::Scalar;
+	};
+	//best of repeats full updates of objects spinning transforms
+	TransformBenchmark BenchmarkTransforms(size_t objects = 1 << 20, int repeats = 10);
+}
@@ -0,0 +1,139 @@
+#include "pch.h"
+#include "VertexTransform.h"
+
+#include "Parallel.h"
+#include "Utilities.h"
+
+namespace
+{
+	inline void Transform(const DirectX::XMFLOAT4X4& m, const float v[4], float out[4])
+	{
+		for (int i = 0; i < 4; ++i)
+			out[i] = m.m[i][0] * v[0] + m.m[i][1] * v[1] + m.m[i][2] * v[2] + m.m[i][3] * v[3];
+	}
+
+	//w = 0, directions are not translated
+	inline void TransformDirection(const DirectX::XMFLOAT4X4& m, const float v[3], float out[3])
+	{
+		for (int i = 0; i < 3; ++i)
+			out[i] = m.m[i][0] * v[0] + m.m[i][1] * v[1] + m.m[i][2] * v[2];
+	}
+}
+
+namespace dxh
+{
+	DirectX::XMFLOAT4X4 MultiplyMatrices(const DirectX::XMFLOAT4X4& a, const DirectX::XMFLOAT4X4& b)
+	{
+		DirectX::XMFLOAT4X4 r;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		return r;
+	}
+
+	DirectX::XMFLOAT4X4 NormalMatrix(const DirectX::XMFLOAT4X4& world)
+	{
+		// The inverse transpose is the cofactor matrix over the determinant,
+		// every row of the cofactor matrix is the cross product of the other two rows
+		const float(&w)[4][4] = world.m;
+		float c[3][3];
+		for (int i = 0; i < 3; ++i)
+		{
+			const float* a = w[(i + 1) % 3];
+			const float* b = w[(i + 2) % 3];
+			c[i][0] = a[1] * b[2] - a[2] * b[1];
+			c[i][1] = a[2] * b[0] - a[0] * b[2];
+			c[i][2] = a[0] * b[1] - a[1] * b[0];
+		}
+		const float det = w[0][0] * c[0][0] + w[0][1] * c[0][1] + w[0][2] * c[0][2];
+		const float inv = det != 0.0f ? 1.0f / det : 1.0f; //degenerate, the pixel shader normalizes anyway
+
+		DirectX::XMFLOAT4X4 n;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				n.m[i][j] = i < 3 && j < 3 ? c[i][j] * inv : (i == j ? 1.0f : 0.0f);
+		return n;
+	}
+
+	void UpdateObjectMatrices(WVP& wvp)
+	{
+		wvp.wvp = MultiplyMatrices(wvp.project, MultiplyMatrices(wvp.view, wvp.world));
+		wvp.normal = NormalMatrix(wvp.world);
+	}
+
+	void TransformVertex(const WVP& wvp, const Vertex& in, TransformedVertex& out)
+	{
+		const float pos[4] = { in.pos.x, in.pos.y, in.pos.z, 1.0f };
+		const float normal[3] = { in.normal.x, in.normal.y, in.normal.z };
+		float world[4];
+		Transform(wvp.wvp, pos, out.vpos);
+		Transform(wvp.world, pos, world);
+		out.pos[0] = world[0], out.pos[1] = world[1], out.pos[2] = world[2];
+		TransformDirection(wvp.normal, normal, out.normal);
+		out.uv[0] = in.uv.x, out.uv[1] = in.uv.y;
+	}
+
+	void TransformVertices(const Mesh& mesh, const WVP& wvp, std::vector<TransformedVertex>& out, unsigned int threads)
+	{
+		out.resize(mesh.vertices.size());
+		util::ParallelFor(mesh.vertices.size(), 4096, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					TransformVertex(wvp, mesh.vertices[i], out[i]);
+			}, threads);
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	VertexTransformTimings BenchmarkVertexTransform(size_t vertexCount, int repeats)
+	{
+		Mesh mesh;
+		mesh.vertices.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			const float f = static_cast<float>(i) / vertexCount;
+			mesh.vertices[i].pos = float3(f, 1.0f - f, f * 0.5f);
+			mesh.vertices[i].normal = float3(0.0f, 0.0f, -1.0f);
+		}
+
+		// Some rotation, scale and translation, view and projection like DXHandler's
+		WVP wvp;
+		const float world[16] = { 0.8f, 0.0f, 0.6f, 0.2f,  0.0f, 2.0f, 0.0f, -0.1f,  -0.6f, 0.0f, 0.8f, 0.5f,  0.0f, 0.0f, 0.0f, 1.0f };
+		const float view[16] = { 1.0f, 0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 0.0f, 1.0f };
+		const float project[16] = { 1.3f, 0.0f, 0.0f, 0.0f,  0.0f, 1.7f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, -0.1f,  0.0f, 0.0f, 1.0f, 0.0f };
+		memcpy(wvp.world.m, world, sizeof(world));
+		memcpy(wvp.view.m, view, sizeof(view));
+		memcpy(wvp.project.m, project, sizeof(project));
+
+		VertexTransformTimings result;
+		result.vertices = vertexCount;
+		std::vector<TransformedVertex> reference(vertexCount), precomputed;
+		result.perVertexMs = FLT_MAX;
+		result.precomputedMs = FLT_MAX;
+		for (int r = 0; r < repeats; ++r)
+		{
+			// What the shader did: the full product for every vertex
+			util::DeltaTimer timer;
+			for (size_t i = 0; i < vertexCount; ++i)
+			{
+				const DirectX::XMFLOAT4X4 transform = MultiplyMatrices(wvp.project, MultiplyMatrices(wvp.view, wvp.world));
+				const Vertex& in = mesh.vertices[i];
+				const float pos[4] = { in.pos.x, in.pos.y, in.pos.z, 1.0f };
+				Transform(transform, pos, reference[i].vpos);
+			}
+			result.perVertexMs = std::min(result.perVertexMs, timer.GetElapsed() * 1000.0f);
+
+			timer.Restart();
+			WVP frame = wvp;
+			UpdateObjectMatrices(frame);
+			TransformVertices(mesh, frame, precomputed, 1);
+			result.precomputedMs = std::min(result.precomputedMs, timer.GetElapsed() * 1000.0f);
+		}
+		for (size_t i = 0; i < vertexCount; ++i)
+			for (int c = 0; c < 4; ++c)
+				result.maxClipError = std::max(result.maxClipError, std::abs(reference[i].vpos[c] - precomputed[i].vpos[c]));
+		return result;
+	}
+}
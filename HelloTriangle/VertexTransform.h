@@ -0,0 +1,38 @@
+#pragma once
+#include "pch.h"
+
+#include "CustomDataTypes.h"
+
+namespace dxh
+{
+	//Matrices are stored the way DXHandler uploads them (transposed, column vectors): out = m * v,
+	//which is mul(v, matrix) in hlsl.
+	DirectX::XMFLOAT4X4 MultiplyMatrices(const DirectX::XMFLOAT4X4& a, const DirectX::XMFLOAT4X4& b);
+	//inverse transpose of the upper 3x3 of world, normals stay perpendicular to surfaces under non-uniform scale
+	DirectX::XMFLOAT4X4 NormalMatrix(const DirectX::XMFLOAT4X4& world);
+	//fills wvp.wvp and wvp.normal from world, view and project, once per object per frame
+	void UpdateObjectMatrices(WVP& wvp);
+
+	//VS_OUT of hlsl/VertexShader.hlsl
+	struct TransformedVertex
+	{
+		float vpos[4];		//clip space
+		float pos[3];		//world space
+		float uv[2];
+		float normal[3];	//world space, not normalized
+	};
+
+	//CPU reference of hlsl/VertexShader.hlsl, wvp needs UpdateObjectMatrices first
+	void TransformVertex(const WVP& wvp, const Vertex& in, TransformedVertex& out);
+	void TransformVertices(const Mesh& mesh, const WVP& wvp, std::vector<TransformedVertex>& out, unsigned int threads = 0);
+
+	//The shader's old per vertex matrix products against the precomputed matrices, on the CPU
+	struct VertexTransformTimings
+	{
+		size_t vertices = 0;
+		float perVertexMs = 0.0f;	//world * view * project built for every vertex
+		float precomputedMs = 0.0f;	//one matrix per object
+		float maxClipError = 0.0f;	//largest clip space difference between the two
+	};
+	VertexTransformTimings BenchmarkVertexTransform(size_t vertexCount = 1 << 20, int repeats = 10);
+}
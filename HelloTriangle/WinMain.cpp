@@ -4,9 +4,15 @@
 
 HWND SetupWindow(int height, int width, int x, int y, HINSTANCE hInstance);
 static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+static std::string CommandLineValue(PCWSTR cmdLine, PCWSTR flag);
 
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ PWSTR pCmdLine, _In_ int nCmdShow)
 {
+    // -convert model.obj writes model.obj.dxhm (optimized, with its LODs) and exits, -mesh model.obj draws it through that cache
+    const std::string convert = CommandLineValue(pCmdLine, L"-convert");
+    if (!convert.empty())
+        return dxh::ConvertObjToMeshCache(convert, convert + ".dxhm") ? EXIT_SUCCESS : EXIT_FAILURE;
+
     static HWND handle = SetupWindow(800, 600, 560, 200, hInstance);
 
     if (!handle)
@@ -15,9 +21,16 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         return EXIT_FAILURE;
     }
 
-    DXHandler dxh(handle);
+    // -profile records zones and frame times from here on, reports them and writes profile.json on exit
+    const bool profile = wcsstr(pCmdLine, L"-profile") != nullptr;
+    util::Profiler::Get().SetEnabled(profile);
+    PROFILE_THREAD("Main");
+    // -instances 1000 draws that many copies of the mesh with one instanced draw
+    const std::string instances = CommandLineValue(pCmdLine, L"-instances");
+    DXHandler dxh(handle, CommandLineValue(pCmdLine, L"-mesh"), instances.empty() ? 1 : static_cast<UINT>(std::strtoul(instances.c_str(), nullptr, 10)));
 
-    util::DeltaTimer dt;
+    // 60 fps with the scene simulated in fixed 60 Hz steps, -uncapped renders as fast as possible for benchmarking
+    util::FrameScheduler scheduler(wcsstr(pCmdLine, L"-uncapped") ? 0.0 : 60.0);
 
     MSG msg{};
 
@@ -32,10 +45,34 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         }
         else 
         {
-            dxh.Render(dt.Delta());
+            const util::FrameTiming frame = scheduler.BeginFrame();
+            for (int i = 0; i < frame.steps; ++i)
+                dxh.Simulate(frame.step);
+            dxh.Render(frame.interpolation);
+            PROFILE_FRAME();
         }
     }
 
+    if (profile)
+    {
+        const util::FrameJitter jitter = scheduler.GetJitter();
+        util::DebugLog("frame time " + std::to_string(jitter.meanMs) + " ms, stddev " + std::to_string(jitter.stddevMs) +
+            " ms, p99 deviation " + std::to_string(jitter.p99DeviationMs) + " ms over " + std::to_string(jitter.frames) + " frames");
+
+#if DXH_PROFILE
+        const util::Profiler& profiler = util::Profiler::Get();
+        const util::FrameStats frames = profiler.GetFrameStats();
+        util::DebugLog("last " + std::to_string(frames.frames) + " frames: mean " + std::to_string(frames.mean) + " ms, p50 " + std::to_string(frames.p50) +
+            " ms, p95 " + std::to_string(frames.p95) + " ms, p99 " + std::to_string(frames.p99) + " ms, max " + std::to_string(frames.max) + " ms");
+        // Open in chrome://tracing or ui.perfetto.dev
+        if (!profiler.WriteChromeTrace("profile.json"))
+            util::DebugLog("Could not write profile.json.");
+        else if (profiler.DroppedEvents() > 0)
+            util::DebugLog("profile.json holds the last " + std::to_string(util::profiler::ThreadBuffer::CAPACITY) + " zones per thread, " +
+                std::to_string(profiler.DroppedEvents()) + " older ones were overwritten.");
+#endif
+    }
+
     return static_cast<int>(msg.wParam);
 }
 
@@ -93,3 +130,22 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
     }
     return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
+
+std::string CommandLineValue(PCWSTR cmdLine, PCWSTR flag)
+{
+    // The word after flag, quotes allow spaces in it. Paths are expected to be ASCII.
+    const wchar_t* found = wcsstr(cmdLine, flag);
+    if (found == nullptr)
+        return "";
+    const wchar_t* begin = found + wcslen(flag);
+    while (*begin == L' ')
+        ++begin;
+    const wchar_t stop = *begin == L'"' ? L'"' : L' ';
+    if (stop == L'"')
+        ++begin;
+    const wchar_t* end = begin;
+    while (*end != L'\0' && *end != stop)
+        ++end;
+    const std::wstring value(begin, end);
+    return std::string(value.begin(), value.end());
+}
@@ -5,7 +5,8 @@
 //implementing stb_image.h
 #include "ImageLoader.h"
 
-DXHandler::DXHandler(HWND handle)
+DXHandler::DXHandler(HWND handle, const std::string& meshPath, UINT instanceCount)
+	: meshPath(meshPath), instanceCount(std::max(1u, instanceCount))
 {
 	RECT rc;
 	GetClientRect(handle, &rc);
@@ -25,6 +26,8 @@ DXHandler::DXHandler(HWND handle)
 
 DXHandler::~DXHandler()
 {
+	// Stop decoding before the device goes away
+	textureStreamer.reset();
 	// Interface
 	if (device)	device->Release();
 	if (devicecontext) devicecontext->Release();
@@ -35,6 +38,7 @@ DXHandler::~DXHandler()
 	if (vertexShader) vertexShader->Release();
 	if (inputLayout) inputLayout->Release();
 	if (pixelShader) pixelShader->Release();
+	if (instancedVertexShader) instancedVertexShader->Release();
 	// Depth buffer
 	if (depthStencilView) depthStencilView->Release();
 	if (depthStencilState) depthStencilState->Release();
@@ -44,6 +48,8 @@ DXHandler::~DXHandler()
 	if (bMaterial) bMaterial->Release();
 	if (bLight) bLight->Release();
 	if (bIndex) bIndex->Release();
+	if (instanceView) instanceView->Release();
+	if (bInstances) bInstances->Release();
 	//Texture
 	if (textureView) textureView->Release();
 	if (samplerState) samplerState->Release();
@@ -81,19 +87,31 @@ bool DXHandler::SetUpInterface(HWND handle, RECT& rc)
 
 bool DXHandler::SetUpPipeline(RECT& rc)
 {
+	PROFILE_FUNCTION();
 	//Get window client area for later
 
 	if (!CreateShaders(vertexShader, pixelShader, inputLayout)) return false;
 
 	//CPU side objects
-	GenerateMesh(mesh);
+	if (!LoadMesh())
+		return false;
 	SetupBufferObjects(rc);
 
 	if (!CreateBuffers()) return false;
-	if (!CreateTexture(textureView))
+	assetCache.reset(new dxh::AssetCache([](const std::string& filepath, const dxh::ImageLoadOptions& options, dxh::ImageData& target)
+		{
+			static ImageLoadRaw il;
+			return il.ImageFromFile(target, filepath.c_str(), options.channels, options.flipVertically);
+		}));
+
+	// The texture is decoded, mipmapped and compressed in the background, a placeholder is bound until Render uploads it
+	textureStreamer.reset(new dxh::TextureStreamer(*this, [this](const std::string& filepath, dxh::ImageData& target)
+		{
+			return LoadImageToTexture(target, filepath);
+		}, 0, 8 << 20, textureFormat));
+	textureHandle = textureStreamer->Request("resources/" + texture);
+	if (textureView == nullptr)
 	{
-		// create texture makes its own error message box if the texture fails to be created
-		// or if the image file isn't loaded
 		util::ErrorMessageBox("Failed to create shader resource view of texture!");
 		return false;
 	}
@@ -103,6 +121,14 @@ bool DXHandler::SetUpPipeline(RECT& rc)
 		return false;
 	}
 	SetTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Saving the texture or recompiling a shader swaps just that asset in while running
+	hotReloader.reset(new dxh::HotReloader(*this));
+	hotReloader->Watch("resources/" + texture, dxh::AssetKind::Texture);
+	hotReloader->Watch(vertexShaderPath, dxh::AssetKind::Shader);
+	hotReloader->Watch(pixelShaderPath, dxh::AssetKind::Shader);
+	if (instancedVertexShader)
+		hotReloader->Watch(instancedShaderPath, dxh::AssetKind::Shader);
 	return true;
 }
 
@@ -110,28 +136,19 @@ bool DXHandler::SetUpPipeline(RECT& rc)
 // INTERNAL/HELPER FUNCTIONS
 // **********************************************************************************************************
 
-std::string DXHandler::ReadShaderData(const std::string &filepath) {
+// Mapped bytecode, the device reads it in place
+util::FileBlob DXHandler::ReadShaderData(const std::string &filepath) {
 
-	std::string data;
-	std::ifstream fstr(filepath, std::ios::binary | std::ios::ate);
-	if (!fstr.is_open())
-	{
+	util::FileBlob data;
+	if (!data.Open(filepath))
 		util::ErrorMessageBox("Shader file \"" + filepath + "\" could not be opened.");
-		return "";
-	}
-
-	fstr.seekg(0, std::ios::end);
-	data.reserve(static_cast<unsigned int>(fstr.tellg()));
-	fstr.seekg(0, std::ios::beg);
-
-	data.assign((std::istreambuf_iterator<char>(fstr)), std::istreambuf_iterator<char>());
-
 	return data;
 }
 
 void DXHandler::SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
 {
-	devicecontext->IASetPrimitiveTopology(topology);
+	this->topology = topology;
+	stateCache.Set(dxh::StateKind::Topology, dxh::StateBinding(nullptr, topology));
 }
 // **********************************************************************************************************
 // DEVICE / INTERFACE
@@ -223,9 +240,9 @@ void DXHandler::SetViewport(FLOAT width, FLOAT height, FLOAT topleftx, FLOAT top
 
 bool DXHandler::CreateVertexShader(ID3D11VertexShader*& vshader, ID3D11InputLayout*& inputLayout, std::string filepath)
 {
-	std::string data = ReadShaderData(filepath);
+	util::FileBlob data = ReadShaderData(filepath);
 
-	if (FAILED(device->CreateVertexShader(data.c_str(), data.length(), NULL, &vshader)))
+	if (FAILED(device->CreateVertexShader(data.Data(), data.Size(), NULL, &vshader)))
 	{
 		return false;
 	}
@@ -239,39 +256,55 @@ bool DXHandler::CreateVertexShader(ID3D11VertexShader*& vshader, ID3D11InputLayo
 	return true;
 }
 
+bool DXHandler::CreateVertexShader(ID3D11VertexShader*& vshader, std::string filepath)
+{
+	util::FileBlob data = ReadShaderData(filepath);
+	return SUCCEEDED(device->CreateVertexShader(data.Data(), data.Size(), NULL, &vshader));
+}
+
 bool DXHandler::CreatePixelShader(ID3D11PixelShader*& pshader, std::string filepath) {
 
-	std::string data = ReadShaderData(filepath);
-	return SUCCEEDED(device->CreatePixelShader(data.c_str(), data.length(), NULL, &pshader));
+	util::FileBlob data = ReadShaderData(filepath);
+	return SUCCEEDED(device->CreatePixelShader(data.Data(), data.Size(), NULL, &pshader));
 }
 
 bool DXHandler::CreateShaders(ID3D11VertexShader*& vertexshader, ID3D11PixelShader*& pixelshader, ID3D11InputLayout*& inputLayout)
 {
-	if (!CreateVertexShader(vertexshader, inputLayout, "hlsl/VertexShader.cso"))
+	PROFILE_FUNCTION();
+	if (!CreateVertexShader(vertexshader, inputLayout, vertexShaderPath))
 	{
 		util::ErrorMessageBox("Failed to create vertex shader. ");
 		return false;
 	}
-	if (!CreatePixelShader(pixelshader, "hlsl/PixelShader.cso"))
+	if (!CreatePixelShader(pixelshader, pixelShaderPath))
 	{
 		util::ErrorMessageBox("Failed to create pixel shader. ");
 		return false;
 	}
+	if (instanceCount > 1 && !CreateVertexShader(instancedVertexShader, instancedShaderPath))
+	{
+		util::ErrorMessageBox("Failed to create instanced vertex shader. ");
+		return false;
+	}
 	return true;
 }
 
 bool DXHandler::CreateBuffers()
 {
-	if (!CreateVertexBuffer(bVertex, mesh))
+	// A mapped cache goes to the device as it is, the immutable buffers keep their own copy
+	const bool mapped = meshCache.IsOpen();
+	if (!(mapped ? CreateVertexBuffer(bVertex, meshCache.Vertices(), meshCache.ByteWidth()) : CreateVertexBuffer(bVertex, mesh)))
 	{
 		util::ErrorMessageBox("Failed to set up Vertex Buffer");
 		return false;
 	}
-	if (!CreateIndexBuffer(bIndex, mesh))
+	if (!(mapped ? CreateIndexBuffer(bIndex, meshCache.Indices(), meshCache.IndexByteWidth(), meshCache.ShortIndices() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT)
+		: CreateIndexBuffer(bIndex, mesh)))
 	{
 		util::ErrorMessageBox("Failed to set up Index Buffer");
 		return false;
 	}
+	meshCache.Close();
 
 	if (!CreateConstantBuffer(bMatrix, sizeof(dxh::WVP)))
 	{
@@ -289,9 +322,61 @@ bool DXHandler::CreateBuffers()
 		util::ErrorMessageBox("Failed to set up material buffer");
 		return false;
 	}
+
+	// Everything starts dirty, the first Render uploads it
+	wvpBlock = TrackBuffer(bMatrix, &wvp, sizeof(wvp));
+	lightBlock = TrackBuffer(bLight, &light, sizeof(light));
+	materialBlock = TrackBuffer(bMaterial, &material, sizeof(material));
+
+	if (instanceCount > 1)
+	{
+		{
+			PROFILE_ZONE("Build instances");
+			dxh::BuildInstanceGrid(instances, instanceCount);
+			for (const dxh::InstanceData& instance : instances)
+			{
+				const dx::XMFLOAT4X4& w = instance.world;
+				instanceTransforms.Add({ w._14, w._24, w._34 }, dx::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), { w._11, w._22, w._33 });
+			}
+		}
+		if (!CreateInstanceBuffer(bInstances, instanceView, instances))
+		{
+			util::ErrorMessageBox("Failed to set up instance buffer");
+			return false;
+		}
+		// Only the bytes that changed are uploaded again
+		instanceBlock = TrackBuffer(bInstances, instances.data(), instances.size() * sizeof(dxh::InstanceData), dxh::UploadMode::Ranges);
+	}
+	dxh::PlanDraws(draws, lods.levels[0].indexCount, instanceCount, instanceCount > 1);
 	return true;
 }
 
+bool DXHandler::CreateInstanceBuffer(ID3D11Buffer*& ibuffer, ID3D11ShaderResourceView*& view, const std::vector<dxh::InstanceData>& instances)
+{
+	D3D11_BUFFER_DESC bd{};
+	ZeroMemory(&bd, sizeof(bd));
+	bd.Usage = D3D11_USAGE_DEFAULT; //written through UpdateSubresource by the upload tracker
+	bd.ByteWidth = static_cast<UINT>(instances.size() * sizeof(dxh::InstanceData));
+	bd.CPUAccessFlags = 0;
+	bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bd.StructureByteStride = sizeof(dxh::InstanceData);
+
+	D3D11_SUBRESOURCE_DATA data{};
+	ZeroMemory(&data, sizeof(data));
+	data.pSysMem = instances.data();
+	if (FAILED(device->CreateBuffer(&bd, &data, &ibuffer)))
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvd{};
+	ZeroMemory(&srvd, sizeof(srvd));
+	srvd.Format = DXGI_FORMAT_UNKNOWN;
+	srvd.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvd.Buffer.FirstElement = 0;
+	srvd.Buffer.NumElements = static_cast<UINT>(instances.size());
+	return SUCCEEDED(device->CreateShaderResourceView(ibuffer, &srvd, &view));
+}
+
 bool DXHandler::CreateConstantBuffer(ID3D11Buffer*& cBuffer, UINT byteWidth)
 {
 	D3D11_BUFFER_DESC bd{};
@@ -306,6 +391,34 @@ bool DXHandler::CreateConstantBuffer(ID3D11Buffer*& cBuffer, UINT byteWidth)
 	return SUCCEEDED(device->CreateBuffer(&bd, NULL, &cBuffer));
 }
 
+dxh::BlockId DXHandler::TrackBuffer(ID3D11Buffer* buffer, const void* data, size_t bytes, dxh::UploadMode mode)
+{
+	const dxh::BlockId block = uploads.Add(bytes, mode, data);
+	uploadTargets.resize(block + 1, nullptr);
+	uploadTargets[block] = buffer;
+	return block;
+}
+
+bool DXHandler::UploadBlock(dxh::BlockId block, const void* data, size_t offset, size_t bytes)
+{
+	ID3D11Buffer* buffer = block < uploadTargets.size() ? uploadTargets[block] : nullptr;
+	if (buffer == nullptr)
+		return false;
+	D3D11_BUFFER_DESC desc{};
+	buffer->GetDesc(&desc);
+	if (desc.Usage == D3D11_USAGE_DYNAMIC)
+	{
+		// WRITE_DISCARD throws the old contents away, so the whole block goes up
+		MapBuffer(buffer, data, uploads.Size(block));
+		return true;
+	}
+	if (desc.Usage != D3D11_USAGE_DEFAULT)
+		return false; //immutable
+	D3D11_BOX box{ static_cast<UINT>(offset), 0, 0, static_cast<UINT>(offset + bytes), 1, 1 };
+	devicecontext->UpdateSubresource(buffer, 0, &box, static_cast<const char*>(data) + offset, 0, 0);
+	return true;
+}
+
 bool DXHandler::CreateDepthStencil(UINT width, UINT height, ID3D11DepthStencilView*& dsview, ID3D11DepthStencilState*& dsstate)
 {
 	D3D11_TEXTURE2D_DESC dstexdesc{};
@@ -381,8 +494,12 @@ bool DXHandler::CreateDepthStencil(UINT width, UINT height, ID3D11DepthStencilVi
 //Loads an image from a file using the stb_image library and converts it to a usable texture
 bool DXHandler::LoadImageToTexture(dxh::ImageData& target, const std::string filepath)
 {
-	static ImageLoadRaw il;
-	return	il.ImageFromFile(target, filepath.c_str());
+	// Decoded once per path, target shares the cached pixels
+	dxh::ImageHandle image = assetCache->Get(filepath);
+	if (!image)
+		return false;
+	target = *image;
+	return true;
 }
 
 bool DXHandler::CreateTexture(ID3D11ShaderResourceView*& shaderresourceview)
@@ -393,13 +510,25 @@ bool DXHandler::CreateTexture(ID3D11ShaderResourceView*& shaderresourceview)
 		util::ErrorMessageBox("Failed to load image data.");
 		return false;
 	}
-
-
+	return CreateTexture(shaderresourceview, idTex, textureFormat);
+}
+bool DXHandler::CreateTexture(ID3D11ShaderResourceView*& shaderresourceview, const dxh::ImageData& idTex, dxh::BlockFormat format)
+{
+	// Synchronous path, the streamer prepares its textures on a worker
+	dxh::TextureData texture;
+	if (!dxh::PrepareTexture(idTex, format, texture))
+		return false;
+	return CreateTexture(shaderresourceview, texture);
+}
+bool DXHandler::CreateTexture(ID3D11ShaderResourceView*& shaderresourceview, const dxh::TextureData& texture)
+{
+	PROFILE_FUNCTION();
 	D3D11_TEXTURE2D_DESC texDesc{ 0 };
 	ZeroMemory(&texDesc, sizeof(texDesc));
-	texDesc.Width = idTex.width;
-	texDesc.Height = idTex.height;
-	texDesc.MipLevels = texDesc.ArraySize = 1;
+	texDesc.Width = texture.Width();
+	texDesc.Height = texture.Height();
+	texDesc.MipLevels = texture.LevelCount();
+	texDesc.ArraySize = 1;
 	texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	texDesc.SampleDesc.Count = 1;
 	texDesc.SampleDesc.Quality = 0;
@@ -408,14 +537,25 @@ bool DXHandler::CreateTexture(ID3D11ShaderResourceView*& shaderresourceview)
 	texDesc.MiscFlags = 0;
 	texDesc.CPUAccessFlags = 0;
 
-	D3D11_SUBRESOURCE_DATA texData{};
-	texData.pSysMem = &idTex.data[0]; //start point
-	texData.SysMemPitch = idTex.width * idTex.channels; //width of one row
-	texData.SysMemSlicePitch = 0;
+	// The formats stay _UNORM like the uncompressed one on purpose: the back buffer is UNORM and the pixel
+	// shader lights the texels in the image's own (sRGB) encoding, as it always has. An _SRGB view would
+	// hand it linear values and darken the picture unless the render target went sRGB as well. The mips
+	// are still averaged in linear light by GenerateMipChain, only the sampler's blend is in sRGB space.
+	if (texture.format != dxh::BlockFormat::None)
+		texDesc.Format = texture.format == dxh::BlockFormat::BC1 ? DXGI_FORMAT_BC1_UNORM :
+			texture.format == dxh::BlockFormat::BC3 ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC7_UNORM;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> texData(texture.LevelCount());
+	for (UINT i = 0; i < texture.LevelCount(); ++i)
+	{
+		texData[i].pSysMem = texture.LevelData(i); //start point
+		texData[i].SysMemPitch = texture.RowPitch(i); //one row of pixels or of 4x4 blocks
+		texData[i].SysMemSlicePitch = 0;
+	}
 
 	ID3D11Texture2D* texTemp;
 
-	HRESULT hr = device->CreateTexture2D(&texDesc, &texData, &texTemp);
+	HRESULT hr = device->CreateTexture2D(&texDesc, texData.data(), &texTemp);
 	if (FAILED(hr))
 	{
 		util::ErrorMessageBox("Failed to create 2D texture.");
@@ -436,6 +576,25 @@ bool DXHandler::CreateTexture(ID3D11ShaderResourceView*& shaderresourceview)
 	return SUCCEEDED(hr);
 }
 
+bool DXHandler::CreatePlaceholder(dxh::TextureHandle handle, const dxh::ImageData& placeholder)
+{
+	if (handle != textureHandle && textureHandle != dxh::INVALID_TEXTURE)
+		return false;
+	if (textureView) textureView->Release();
+	textureView = nullptr;
+	return CreateTexture(textureView, placeholder, dxh::BlockFormat::None);
+}
+bool DXHandler::Upload(dxh::TextureHandle handle, const dxh::TextureData& texture)
+{
+	if (handle != textureHandle)
+		return false;
+	ID3D11ShaderResourceView* view = nullptr;
+	if (!CreateTexture(view, texture))
+		return false; //keep the placeholder
+	if (textureView) textureView->Release();
+	textureView = view;
+	return true;
+}
 bool DXHandler::CreateSamplerState(ID3D11SamplerState*& samplerstate)
 {
 	D3D11_SAMPLER_DESC samplerDesc{};
@@ -454,6 +613,58 @@ bool DXHandler::CreateSamplerState(ID3D11SamplerState*& samplerstate)
 	return SUCCEEDED(device->CreateSamplerState(&samplerDesc, &samplerstate));
 }
 
+// **********************************************************************************************************
+// HOT RELOAD
+// **********************************************************************************************************
+
+bool DXHandler::ReloadAsset(dxh::AssetKind kind, const std::string& path)
+{
+	PROFILE_FUNCTION();
+	if (kind == dxh::AssetKind::Texture)
+	{
+		// The old texture stays bound until the streamer uploads the new decode
+		assetCache->Invalidate(path);
+		return textureStreamer->Reload(path) > 0;
+	}
+
+	// A blob that does not build (still being written) leaves the current shader in place
+	if (path == vertexShaderPath)
+	{
+		ID3D11VertexShader* vshader = nullptr;
+		ID3D11InputLayout* layout = nullptr;
+		if (!CreateVertexShader(vshader, layout, path))
+		{
+			if (vshader) vshader->Release();
+			if (layout) layout->Release();
+			return false;
+		}
+		if (vertexShader) vertexShader->Release();
+		if (inputLayout) inputLayout->Release();
+		vertexShader = vshader;
+		inputLayout = layout;
+		return true;
+	}
+	if (path == instancedShaderPath && instancedVertexShader)
+	{
+		ID3D11VertexShader* vshader = nullptr;
+		if (!CreateVertexShader(vshader, path))
+			return false;
+		instancedVertexShader->Release();
+		instancedVertexShader = vshader;
+		return true;
+	}
+	if (path == pixelShaderPath)
+	{
+		ID3D11PixelShader* pshader = nullptr;
+		if (!CreatePixelShader(pshader, path))
+			return false;
+		if (pixelShader) pixelShader->Release();
+		pixelShader = pshader;
+		return true;
+	}
+	return false;
+}
+
 //*********************************************************
 //MESH
 //*********************************************************
@@ -495,9 +706,41 @@ void DXHandler::GenerateMesh(dxh::Mesh& mesh) {
 	{
 		mesh.indices.push_back(indices[i]);
 	}
+	mesh.UpdateBounds();
+}
+
+bool DXHandler::LoadMesh()
+{
+	PROFILE_FUNCTION();
+	if (!meshPath.empty())
+	{
+		// The converter's output is optimized and holds the LODs, it stays mapped until CreateBuffers uploaded it.
+		// A cache that is missing, from an older version or older than the OBJ is converted again first.
+		const std::string cachePath = meshPath + ".dxhm";
+		if (meshCache.Open(cachePath, meshPath) || (dxh::ConvertObjToMeshCache(meshPath, cachePath) && meshCache.Open(cachePath, meshPath)))
+		{
+			meshCache.ToLODChain(lods);
+			mesh.name = meshCache.Name();
+			mesh.bounds = meshCache.GetBounds();
+			return true;
+		}
+		// No cache could be written, the OBJ is loaded into memory instead
+		ObjLoader loader;
+		if (!loader.MeshFromFile(mesh, meshPath.c_str()))
+			return false;
+	}
+	else
+	{
+		GenerateMesh(mesh);
+	}
+	dxh::OptimizeMesh(mesh);
+	PROFILE_ZONE("Build LODs");
+	dxh::BuildLODChain(mesh, dxh::DefaultLODRatios(), lods);
+	dxh::PackLODs(lods, mesh);
+	return true;
 }
 
-bool DXHandler::CreateInputLayout(ID3D11InputLayout*& layout, const std::string& bytecode)
+bool DXHandler::CreateInputLayout(ID3D11InputLayout*& layout, const util::FileBlob& bytecode)
 {
 
 	D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
@@ -506,23 +749,29 @@ bool DXHandler::CreateInputLayout(ID3D11InputLayout*& layout, const std::string&
 		{ "NORMAL",	  0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
 	};
 
-	HRESULT hr = device->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), bytecode.c_str(), bytecode.length(), &layout); //create input-layout for the assembler stage
+	HRESULT hr = device->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), bytecode.Data(), bytecode.Size(), &layout); //create input-layout for the assembler stage
 
 	return SUCCEEDED(hr);
 }
 
 bool DXHandler::CreateVertexBuffer(ID3D11Buffer*& vbuffer, const dxh::Mesh& mesh)
+{
+	return CreateVertexBuffer(vbuffer, mesh.vertices.data(), static_cast<UINT>(mesh.ByteWidth()));
+}
+
+bool DXHandler::CreateVertexBuffer(ID3D11Buffer*& vbuffer, const void* vertices, UINT byteWidth)
 {
 
+	// Static geometry, written once here and never mapped again
 	D3D11_BUFFER_DESC buffdesc{ 0 };
 	ZeroMemory(&buffdesc, sizeof(buffdesc));
 	buffdesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	buffdesc.Usage = D3D11_USAGE_DYNAMIC;
-	buffdesc.ByteWidth = mesh.ByteWidth();
-	buffdesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	buffdesc.Usage = D3D11_USAGE_IMMUTABLE;
+	buffdesc.ByteWidth = byteWidth;
+	buffdesc.CPUAccessFlags = 0;
 
 	D3D11_SUBRESOURCE_DATA blob{};
-	blob.pSysMem = mesh.vertices.data();
+	blob.pSysMem = vertices;
 
 	HRESULT hr = device->CreateBuffer(&buffdesc, &blob, &vbuffer);
 	return SUCCEEDED(hr);
@@ -530,17 +779,29 @@ bool DXHandler::CreateVertexBuffer(ID3D11Buffer*& vbuffer, const dxh::Mesh& mesh
 
 bool DXHandler::CreateIndexBuffer(ID3D11Buffer*& bIndex, const dxh::Mesh& mesh)
 {
+	// 16 bit indices halve the index buffer when every vertex can be addressed with them
+	std::vector<uint16_t> shortIndices;
+	if (mesh.ShortIndices())
+		dxh::PackIndices16(mesh.indices, shortIndices);
+	const void* indices = mesh.ShortIndices() ? static_cast<const void*>(shortIndices.data()) : static_cast<const void*>(mesh.indices.data());
+	return CreateIndexBuffer(bIndex, indices, static_cast<UINT>(mesh.IndexByteWidth()), mesh.ShortIndices() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT);
+}
+
+bool DXHandler::CreateIndexBuffer(ID3D11Buffer*& bIndex, const void* indices, UINT byteWidth, DXGI_FORMAT format)
+{
+	indexFormat = format;
+
 	D3D11_BUFFER_DESC ibd{};
 	ZeroMemory(&ibd, sizeof(ibd));
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = static_cast<UINT>(mesh.indices.size())*sizeof(UINT);
+	ibd.ByteWidth = byteWidth;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
 	ibd.StructureByteStride = 0;
 
 	D3D11_SUBRESOURCE_DATA initData{};
-	initData.pSysMem = mesh.indices.data();
+	initData.pSysMem = indices;
 	HRESULT hr = device->CreateBuffer(&ibd, &initData, &bIndex);
 
 	return SUCCEEDED(hr);
@@ -548,11 +809,14 @@ bool DXHandler::CreateIndexBuffer(ID3D11Buffer*& bIndex, const dxh::Mesh& mesh)
 
 void DXHandler::SetupBufferObjects(RECT& rc)
 {
+	viewportHeight = FLOAT(rc.bottom - rc.top);
+
 	// CAMERA
 	dxh::float3 viewpos = { 0.0f, 0.0, -1.0f };
 
 	// world
 	dx::XMStoreFloat4x4(&wvp.world, dx::XMMatrixIdentity());
+	previousWorld = wvp.world;
 
 	// view
 	dx::XMStoreFloat4x4(&wvp.view, dx::XMMatrixTranspose(
@@ -573,6 +837,7 @@ void DXHandler::SetupBufferObjects(RECT& rc)
 			)
 		)
 	);
+	dxh::UpdateObjectMatrices(wvp);
 
 	// LIGHTS
 	light.pos = dxh::Float4(-0.5f, 0.5f, -2.0f, 1.0f); //up, to the left and back
@@ -615,42 +880,112 @@ void DXHandler::GenerateTexture(dxh::ImageData& id)
 // RENDER AND RENDER HELP FUNCTIONS
 //*********************************************************
 
-void DXHandler::Rotate(float dt) //Rotates world matrix at a rate of 2pi(rad)/rot_time(sec)
+dx::XMMATRIX DXHandler::RotationStep(float dt) const //rotation of dt seconds at a rate of 2pi(rad)/rot_time(sec)
 {
 	// one whole lap in radians, time in seconds for a full rotation
 	float rot_time_div = 1.f / rotation_time; //division is expensive so we do this once. separate variables
 	
-	dx::XMMATRIX rotation	= dx::XMMatrixTranspose(dx::XMMatrixRotationY(dt * (rotation_angle * rot_time_div))); 
-	dx::XMMATRIX translate	= dx::XMMatrixTranspose(dx::XMMatrixTranslation(0, 0, -0.5f));
-	dx::XMMATRIX inverse	= dx::XMMatrixTranspose(dx::XMMatrixTranslation(0, 0, 0.5f)); //needed to not have fucky normals
+	// normals go through the normal matrix now, so the quad turns around its own center
+	return dx::XMMatrixTranspose(dx::XMMatrixRotationY(dt * (rotation_angle * rot_time_div)));
+}
+
+void DXHandler::Rotate(float dt) //Rotates world matrix at a rate of 2pi(rad)/rot_time(sec)
+{
 	dx::XMMATRIX world = dx::XMLoadFloat4x4(&wvp.world);
 
-	world = world * (inverse * rotation * translate); //right to left
+	world = world * RotationStep(dt);
 
 	dx::XMStoreFloat4x4(&wvp.world, world);
 }
 
-void DXHandler::SetAll() // set every frame
+void DXHandler::SetAll() // set every frame, the state cache drops everything that is bound already
 {
-	const UINT32 pStride = sizeof(dxh::Vertex);
-	const UINT32 offset = 0;
+	frameState.Clear();
 	//Interface
-	devicecontext->OMSetRenderTargets(1, &bbRenderTargetView, depthStencilView);
-	devicecontext->OMSetDepthStencilState(depthStencilState, 0);
-	devicecontext->RSSetState(rasterizerState);
+	frameState.Set(dxh::StateKind::RenderTargets, dxh::StateBinding(bbRenderTargetView, 0, 0, depthStencilView));
+	frameState.Set(dxh::StateKind::DepthStencilState, dxh::StateBinding(depthStencilState, 0));
+	frameState.Set(dxh::StateKind::RasterizerState, dxh::StateBinding(rasterizerState));
 	//Vertex Shader
-	devicecontext->VSSetShader(vertexShader, nullptr, 0);
-	devicecontext->VSSetConstantBuffers(0, 1, &bMatrix);
-	devicecontext->IASetInputLayout(inputLayout);
-	devicecontext->IASetVertexBuffers(0, 1, &bVertex, &pStride, &offset);
-	devicecontext->IASetIndexBuffer(bIndex, DXGI_FORMAT_R32_UINT, 0);
+	frameState.Set(dxh::StateKind::VertexShader, dxh::StateBinding(instancedVertexShader ? instancedVertexShader : vertexShader));
+	frameState.Set(dxh::StateKind::VSConstantBuffer, 0, dxh::StateBinding(bMatrix));
+	if (instancedVertexShader)
+		frameState.Set(dxh::StateKind::VSResource, 0, dxh::StateBinding(instanceView));
+	frameState.Set(dxh::StateKind::Topology, dxh::StateBinding(nullptr, topology));
+	frameState.Set(dxh::StateKind::InputLayout, dxh::StateBinding(inputLayout));
+	frameState.Set(dxh::StateKind::VertexBuffer, 0, dxh::StateBinding(bVertex, sizeof(dxh::Vertex), 0));
+	frameState.Set(dxh::StateKind::IndexBuffer, dxh::StateBinding(bIndex, indexFormat, 0));
 	// Pixel shader
-	devicecontext->PSSetShader(pixelShader, nullptr, 0);
-	devicecontext->PSSetConstantBuffers(0, 1, &bLight);
-	devicecontext->PSSetConstantBuffers(1, 1, &bMaterial);
+	frameState.Set(dxh::StateKind::PixelShader, dxh::StateBinding(pixelShader));
+	frameState.Set(dxh::StateKind::PSConstantBuffer, 0, dxh::StateBinding(bLight));
+	frameState.Set(dxh::StateKind::PSConstantBuffer, 1, dxh::StateBinding(bMaterial));
 	//Texture
-	devicecontext->PSSetShaderResources(0, 1, &textureView);
-	devicecontext->PSSetSamplers(0, 1, &samplerState);
+	frameState.Set(dxh::StateKind::PSResource, 0, dxh::StateBinding(textureView));
+	frameState.Set(dxh::StateKind::PSSampler, 0, dxh::StateBinding(samplerState));
+	stateCache.Apply(frameState);
+}
+
+void DXHandler::BindStates(dxh::StateKind kind, UINT first, UINT count, const dxh::StateBinding* values)
+{
+	// Runs of slots are never longer than the cache has slots
+	void* objects[dxh::StateCache::MAX_SLOTS];
+	UINT a[dxh::StateCache::MAX_SLOTS], b[dxh::StateCache::MAX_SLOTS];
+	for (UINT i = 0; i < count; ++i)
+	{
+		objects[i] = const_cast<void*>(values[i].object);
+		a[i] = values[i].a;
+		b[i] = values[i].b;
+	}
+
+	switch (kind)
+	{
+	case dxh::StateKind::RenderTargets:
+	{
+		ID3D11RenderTargetView* rtv = static_cast<ID3D11RenderTargetView*>(objects[0]);
+		devicecontext->OMSetRenderTargets(1, &rtv, static_cast<ID3D11DepthStencilView*>(const_cast<void*>(values[0].extra)));
+		break;
+	}
+	case dxh::StateKind::DepthStencilState:
+		devicecontext->OMSetDepthStencilState(static_cast<ID3D11DepthStencilState*>(objects[0]), a[0]);
+		break;
+	case dxh::StateKind::RasterizerState:
+		devicecontext->RSSetState(static_cast<ID3D11RasterizerState*>(objects[0]));
+		break;
+	case dxh::StateKind::Topology:
+		devicecontext->IASetPrimitiveTopology(static_cast<D3D11_PRIMITIVE_TOPOLOGY>(a[0]));
+		break;
+	case dxh::StateKind::InputLayout:
+		devicecontext->IASetInputLayout(static_cast<ID3D11InputLayout*>(objects[0]));
+		break;
+	case dxh::StateKind::VertexBuffer:
+		devicecontext->IASetVertexBuffers(first, count, reinterpret_cast<ID3D11Buffer* const*>(objects), a, b);
+		break;
+	case dxh::StateKind::IndexBuffer:
+		devicecontext->IASetIndexBuffer(static_cast<ID3D11Buffer*>(objects[0]), static_cast<DXGI_FORMAT>(a[0]), b[0]);
+		break;
+	case dxh::StateKind::VertexShader:
+		devicecontext->VSSetShader(static_cast<ID3D11VertexShader*>(objects[0]), nullptr, 0);
+		break;
+	case dxh::StateKind::VSConstantBuffer:
+		devicecontext->VSSetConstantBuffers(first, count, reinterpret_cast<ID3D11Buffer* const*>(objects));
+		break;
+	case dxh::StateKind::VSResource:
+		devicecontext->VSSetShaderResources(first, count, reinterpret_cast<ID3D11ShaderResourceView* const*>(objects));
+		break;
+	case dxh::StateKind::PixelShader:
+		devicecontext->PSSetShader(static_cast<ID3D11PixelShader*>(objects[0]), nullptr, 0);
+		break;
+	case dxh::StateKind::PSConstantBuffer:
+		devicecontext->PSSetConstantBuffers(first, count, reinterpret_cast<ID3D11Buffer* const*>(objects));
+		break;
+	case dxh::StateKind::PSResource:
+		devicecontext->PSSetShaderResources(first, count, reinterpret_cast<ID3D11ShaderResourceView* const*>(objects));
+		break;
+	case dxh::StateKind::PSSampler:
+		devicecontext->PSSetSamplers(first, count, reinterpret_cast<ID3D11SamplerState* const*>(objects));
+		break;
+	default:
+		break;
+	}
 }
 
 void DXHandler::MapBuffer(ID3D11Buffer*& gBuffer, const void* src, size_t size)
@@ -662,31 +997,114 @@ void DXHandler::MapBuffer(ID3D11Buffer*& gBuffer, const void* src, size_t size)
 	devicecontext->Unmap(gBuffer, 0);
 }
 
+void DXHandler::Simulate(float step)
+{
+	PROFILE_FUNCTION();
+	previousWorld = wvp.world;
+	lastStep = step;
+	Rotate(step);
+	if (instanceTransforms.Count() > 0)
+	{
+		// Same rate as the whole scene, around each copy's own y axis
+		const float half = 0.5f * step * (rotation_angle / rotation_time);
+		instanceTransforms.RotateAll(dx::XMFLOAT4(0.0f, std::sin(half), 0.0f, std::cos(half)));
+	}
+}
+
 //main render loop
-void DXHandler::Render(float dt)
+void DXHandler::Render(float interpolation)
 {
+	PROFILE_FUNCTION();
 	const FLOAT clearColor[] = { 0.1f, 0.f, 0.3f, 1.0f };
 	devicecontext->ClearRenderTargetView(bbRenderTargetView, clearColor);
 	devicecontext->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
+	{
+		PROFILE_ZONE("Asset updates");
+		// Reload changed assets, a changed texture is queued on the streamer below
+		hotReloader->Update(reloadClock.GetElapsed());
+		// Upload finished textures, bounded by the streamer's per frame budget
+		textureStreamer->Update();
+	}
+
 	//Set everything
 	SetAll();
 
-	// Update buffers
-	Rotate(dt);
+	// The rotation is a constant rate, so part of the last step from the previous world is exact
+	dxh::WVP frame = wvp;
+	if (interpolation < 1.0f)
+		dx::XMStoreFloat4x4(&frame.world, dx::XMLoadFloat4x4(&previousWorld) * RotationStep(lastStep * interpolation));
+	dxh::UpdateObjectMatrices(frame); //once per object instead of once per vertex in the shader
+
+	// Upload what changed, the light and material only after they were edited
+	uploads.Set(wvpBlock, frame);
+	uploads.Set(lightBlock, light);
+	uploads.Set(materialBlock, material);
+	// The planes of wvp are in object space, where the mesh bounds and the instances are
+	const dxh::Frustum frustum = dxh::ExtractFrustum(frame.wvp);
+	if (instanceTransforms.Count() > 0)
+	{
+		{
+			PROFILE_ZONE("Instance transforms");
+			instanceTransforms.Update(&instances[0].world, sizeof(dxh::InstanceData));
+		}
+		{
+			PROFILE_ZONE("Frustum culling");
+			dxh::TransformBounds(mesh.bounds, &instances[0].world, sizeof(dxh::InstanceData), instances.size(), instanceBounds);
+			const size_t visible = dxh::CullObjects(frustum, instanceBounds.Streams(), visibleIds, dxh::BestCullKernel(), 0, &cullStats);
+			// The visible copies go to the front of the instance buffer, the draw reads only those
+			visibleInstances.resize(visible);
+			util::ParallelFor(visible, dxh::CULL_GRAIN, [&](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; ++i)
+						visibleInstances[i] = instances[visibleIds[i]];
+				});
+			if (visible > 0)
+				uploads.Write(instanceBlock, visibleInstances.data(), visible * sizeof(dxh::InstanceData));
+			for (dxh::DrawCommand& draw : draws)
+				draw.instanceCount = static_cast<UINT>(visible);
+		}
+	}
+	else
+	{
+		const bool visible = dxh::IsVisible(frustum, mesh.bounds);
+		cullStats.tested = 1;
+		cullStats.visible = visible ? 1 : 0;
+		cullStats.culled = visible ? 0 : 1;
+		for (dxh::DrawCommand& draw : draws)
+			draw.instanceCount = visible ? 1 : 0;
+	}
+	uploads.Flush(*this);
 
-	// Map buffer data
-	MapBuffer(bVertex, mesh.vertices.data(), mesh.ByteWidth());
-	MapBuffer(bMatrix, &wvp, sizeof(wvp));
-	MapBuffer(bLight, &light, sizeof(light));
-	MapBuffer(bMaterial, &material, sizeof(material));
+	// Every copy shares the grid's scale, so one level fits them all, picked for the mesh center.
+	// Copies further away could take a coarser one, but that would split the instanced draw.
+	{
+		float pixelsPerUnit = dxh::PixelsPerUnit(frame, mesh.bounds.center, viewportHeight);
+		if (!instances.empty())
+		{
+			const dx::XMFLOAT4X4& w = instances[0].world; // spinning, the length of a column is the scale
+			pixelsPerUnit *= std::sqrt(w._11 * w._11 + w._21 * w._21 + w._31 * w._31);
+		}
+		const dxh::MeshLOD& level = lods.levels[dxh::SelectLOD(lods, pixelsPerUnit)];
+		for (dxh::DrawCommand& draw : draws)
+			draw.indexCount = level.indexCount, draw.firstIndex = level.firstIndex;
+	}
 
-	//Draw vertices
-	devicecontext->DrawIndexed(static_cast<UINT>(mesh.indices.size()), 0, 0);
+	//Draw vertices, every visible copy in one call when instanced
+	for (const dxh::DrawCommand& draw : draws)
+	{
+		if (draw.instanceCount == 0)
+			continue;
+		if (draw.instanceCount > 1)
+			devicecontext->DrawIndexedInstanced(draw.indexCount, draw.instanceCount, draw.firstIndex, 0, 0);
+		else
+			devicecontext->DrawIndexed(draw.indexCount, draw.firstIndex, 0);
+	}
 
 	/*
 	
 	*/
 
+	PROFILE_ZONE("Present");
 	swapchain->Present(0, 0);
 }
\ No newline at end of file
@@ -2,16 +2,36 @@
 #include "pch.h"
 
 #include "Utilities.h"
+#include "FileBlob.h"
+#include "Profiler.h"
+#include "FrameScheduler.h"
 #include "CustomDataTypes.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "MeshCache.h"
+#include "MipChain.h"
+#include "BlockCompression.h"
+#include "TextureStreamer.h"
+#include "AssetCache.h"
+#include "HotReload.h"
+#include "BufferUploads.h"
+#include "StateCache.h"
+#include "Instancing.h"
+#include "TransformSystem.h"
+#include "VertexTransform.h"
+#include "FrustumCulling.h"
+#include "MeshSimplifier.h"
 
 namespace dx = DirectX; //efficiency
 
-class DXHandler
+class DXHandler : public dxh::TextureUploadSink, public dxh::ReloadTarget, public dxh::UploadDevice, public dxh::PipelineBackend
 {
 public:
-	DXHandler(HWND handle);
+	//meshPath: OBJ to draw, empty draws the generated quad. instanceCount: copies on a grid, more than 1 draws them instanced.
+	DXHandler(HWND handle, const std::string& meshPath = "", UINT instanceCount = 1);
 	~DXHandler();
-	void Render(float dt = 0.0f);
+	void Simulate(float step); //advances the scene by one fixed step
+	void Render(float interpolation = 1.0f); //0 draws the scene as it was before the last Simulate, 1 as it is now
 	void SetViewport(FLOAT width, FLOAT height, FLOAT topleftx, FLOAT toplefty, FLOAT maxdepth, FLOAT mindepth);
 	void SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
 private:
@@ -25,25 +45,40 @@ private:
 	// Shaders & Pipeline
 	bool CreateShaders(ID3D11VertexShader*& vertexshader, ID3D11PixelShader*& pixelshader, ID3D11InputLayout*& inputLayout);
 	bool CreateVertexShader(ID3D11VertexShader*& vshader, ID3D11InputLayout*& inputLayout, std::string filepath);
+	bool CreateVertexShader(ID3D11VertexShader*& vshader, std::string filepath); //shares the input layout of the main vertex shader
 	bool CreateIndexBuffer(ID3D11Buffer*& vbuffer, const dxh::Mesh& mesh);
+	bool CreateIndexBuffer(ID3D11Buffer*& vbuffer, const void* indices, UINT byteWidth, DXGI_FORMAT format);
 	bool CreatePixelShader(ID3D11PixelShader*& pshader, std::string filepath);
 	bool CreateDepthStencil(UINT width, UINT height, ID3D11DepthStencilView*& dsview, ID3D11DepthStencilState*& dsstate);
-	bool CreateInputLayout(ID3D11InputLayout*& layout, const std::string& data);
+	bool CreateInputLayout(ID3D11InputLayout*& layout, const util::FileBlob& bytecode);
 	bool CreateVertexBuffer(ID3D11Buffer*& vbuffer, const dxh::Mesh& mesh);
+	bool CreateVertexBuffer(ID3D11Buffer*& vbuffer, const void* vertices, UINT byteWidth);
+	bool CreateInstanceBuffer(ID3D11Buffer*& ibuffer, ID3D11ShaderResourceView*& view, const std::vector<dxh::InstanceData>& instances);
 	// Texture
 	bool LoadImageToTexture(dxh::ImageData& target, const std::string filepath);
 	bool CreateTexture(ID3D11ShaderResourceView*& shaderresourceview);
+	bool CreateTexture(ID3D11ShaderResourceView*& shaderresourceview, const dxh::ImageData& image, dxh::BlockFormat format);
+	bool CreateTexture(ID3D11ShaderResourceView*& shaderresourceview, const dxh::TextureData& texture);
+	bool CreatePlaceholder(dxh::TextureHandle handle, const dxh::ImageData& placeholder) override;
+	bool Upload(dxh::TextureHandle handle, const dxh::TextureData& texture) override;
 	bool CreateSamplerState(ID3D11SamplerState*& samplerstate);
+	// Hot reload
+	bool ReloadAsset(dxh::AssetKind kind, const std::string& path) override;
 	// Constant buffer
 	bool CreateConstantBuffer(ID3D11Buffer*& cBuffer, UINT byteWidth);
+	dxh::BlockId TrackBuffer(ID3D11Buffer* buffer, const void* data, size_t bytes, dxh::UploadMode mode = dxh::UploadMode::Whole);
+	bool UploadBlock(dxh::BlockId block, const void* data, size_t offset, size_t bytes) override;
 	// MISC
-	std::string ReadShaderData(const std::string& filepath);
+	util::FileBlob ReadShaderData(const std::string& filepath);
 	bool CreateBuffers();
 	void GenerateMesh(dxh::Mesh& mesh);
+	bool LoadMesh(); //meshPath through its cache into lods (and mesh without a cache), the generated quad without one
 	void GenerateTexture(dxh::ImageData& id); //generates a default texture, not used
 	void MapBuffer(ID3D11Buffer*& cBuffer, const void* src, size_t size);
 	void Rotate(float dt);
+	dx::XMMATRIX RotationStep(float dt) const;
 	void SetAll();
+	void BindStates(dxh::StateKind kind, UINT firstSlot, UINT count, const dxh::StateBinding* values) override;
 	void SetupBufferObjects(RECT& rc);
 	// FOR IMGUI TESTING
 
@@ -59,27 +94,66 @@ private:
 	ID3D11VertexShader* vertexShader;
 	ID3D11InputLayout* inputLayout;
 	ID3D11PixelShader* pixelShader;
+	ID3D11VertexShader* instancedVertexShader = nullptr; //only with instanceCount > 1
 	// DepthStencil 
 	ID3D11DepthStencilView* depthStencilView;
 	ID3D11DepthStencilState* depthStencilState;
 	// Buffers
 	ID3D11Buffer* bVertex;
 	ID3D11Buffer* bIndex;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT; // R16 when the mesh has less than 65536 vertices
 	ID3D11Buffer* bMaterial;
 	ID3D11Buffer* bMatrix;
 	ID3D11Buffer* bLight;
+	// Instancing, per copy transforms in a structured buffer read by VertexShaderInstanced
+	ID3D11Buffer* bInstances = nullptr;
+	ID3D11ShaderResourceView* instanceView = nullptr;
+	std::vector<dxh::InstanceData> instances;
+	dxh::TransformSystem instanceTransforms;	//every copy spins in place, composed into instances each frame
+	std::vector<dxh::DrawCommand> draws;
+	// Culling, only the copies in view are uploaded and drawn
+	dxh::BoundsList instanceBounds;
+	std::vector<UINT> visibleIds;
+	std::vector<dxh::InstanceData> visibleInstances;
+	dxh::CullStats cullStats;	//of the last frame
+	// Levels of detail, packed into one vertex and index buffer, the draw picks the coarsest one that stays within a pixel
+	dxh::LODChain lods;
+	float viewportHeight = 1.0f;
+	// Uploads, only blocks that changed since the last frame are written
+	dxh::UploadTracker uploads;
+	std::vector<ID3D11Buffer*> uploadTargets; //by block
+	dxh::BlockId wvpBlock, lightBlock, materialBlock, instanceBlock;
 	// Texture
-	ID3D11ShaderResourceView* textureView;
+	ID3D11ShaderResourceView* textureView = nullptr;
 	ID3D11SamplerState* samplerState;
+	std::unique_ptr<dxh::AssetCache> assetCache;	//decoded images by path, shared by every texture load
+	std::unique_ptr<dxh::TextureStreamer> textureStreamer;
+	dxh::TextureHandle textureHandle = dxh::INVALID_TEXTURE;
+	// Hot reload
+	std::unique_ptr<dxh::HotReloader> hotReloader;
+	util::DeltaTimer reloadClock;
+	// Bindings, SetAll only reaches the context for what changed
+	dxh::StateCache stateCache{ *this };
+	dxh::StateBlock frameState;
+	D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	// Misc, variables and what not
 	dxh::WVP wvp;					//world, view projection matrices
+	dx::XMFLOAT4X4 previousWorld;	//world before the last Simulate, for interpolation
+	float lastStep = 0.0f;
 	dxh::SimpleLight light;
 	dxh::SimpleMaterial material;
-	dxh::Mesh mesh;
+	dxh::Mesh mesh;				//only name and bounds when it came from meshCache
+	dxh::MeshCache meshCache;	//mapped from LoadMesh until CreateBuffers uploaded it
 
 	// IMGUI TEST VARIABLES
 	float rotation_time = 6.0f; // time for a single rotation in seconds
 	float rotation_angle = RAD; // angle to be rotated after rotation_time has elapsed | Rotation per frame is: deltaTime * (angle/time) 
 	std::string texture = "sampletexture.png"; // texture being loaded
+	std::string meshPath; // OBJ to draw, its .dxhm cache is mapped instead when present, empty draws the generated quad
+	std::string vertexShaderPath = "hlsl/VertexShader.cso";
+	std::string pixelShaderPath = "hlsl/PixelShader.cso";
+	std::string instancedShaderPath = "hlsl/VertexShaderInstanced.cso";
+	UINT instanceCount = 1; // copies of the mesh on a grid, more than 1 draws them with one instanced draw
+	dxh::BlockFormat textureFormat = dxh::BlockFormat::BC7; // compression of the loaded texture, None uploads it as rgba8
 
 };
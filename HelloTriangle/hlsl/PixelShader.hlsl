@@ -25,6 +25,7 @@ struct PS_IN
 	float3 pos : POSITION;
 	float2 uv : UV;
 	float3 normal : NORMAL;
+	float4 tint : COLOR; //white unless drawn instanced
 };
 
 float4 main(PS_IN input) : SV_TARGET
@@ -33,7 +34,7 @@ float4 main(PS_IN input) : SV_TARGET
 	// INITIALISE VALUES
 	float4 final_pixel = (float4)1; //return value, initialized to 0, 0, 0, 0
 	// SAMPLE TEXTURE
-	float3 tex = testTexture.Sample(testSampler, input.uv).xyz;
+	float3 tex = testTexture.Sample(testSampler, input.uv).xyz * input.tint.xyz;
 
 	// AMBIENT
 	float3 ambient_lighting = light_color.xyz * m_ambi.xyz;
@@ -4,6 +4,8 @@ cbuffer MATRIX : register(b0)
 	float4x4 world;
 	float4x4 view;
 	float4x4 project;
+	float4x4 wvp;			//project * view * world, built once per object on the CPU
+	float4x4 normalMatrix;	//inverse transpose of world
 };
 
 struct VS_IN 
@@ -19,17 +21,19 @@ struct VS_OUT
 	float3 pos : POSITION;
 	float2 uv : UV;
 	float3 normal : NORMAL;
+	float4 tint : COLOR;
 };
 
 VS_OUT main(VS_IN input)
 {
 	VS_OUT output = (VS_OUT)0;
 
-	float4x4 transform = mul(world, mul(view, project));
+	float4 pos = float4(input.pos, 1.0f);
 
-	output.vpos   = mul(float4(input.pos, 1.0f), transform);
-	output.pos	  = mul(float4(input.pos, 1.0f), world).xyz; //avoid truncation
-	output.normal = mul(float4(input.normal, 1.0f), world).xyz;
+	output.vpos   = mul(pos, wvp);
+	output.pos	  = mul(pos, world).xyz; //world space for the lighting
+	output.normal = mul(input.normal, (float3x3)normalMatrix);
 	output.uv = input.uv;
+	output.tint = float4(1.0f, 1.0f, 1.0f, 1.0f);
 	return output;
 }
\ No newline at end of file
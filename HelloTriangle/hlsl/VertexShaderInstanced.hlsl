@@ -0,0 +1,51 @@
+
+cbuffer MATRIX : register(b0)
+{
+	float4x4 world;
+	float4x4 view;
+	float4x4 project;
+	float4x4 wvp;			//project * view * world, built once per object on the CPU
+	float4x4 normalMatrix;	//inverse transpose of world
+};
+
+struct INSTANCE
+{
+	float4x4 world; //applied before the shared world matrix
+	float4 tint;
+};
+
+StructuredBuffer<INSTANCE> instances : register(t0);
+
+struct VS_IN 
+{
+	float3 pos : POSITION;
+	float2 uv : UV;
+	float3 normal : NORMAL;
+	uint id : SV_InstanceID;
+};
+
+struct VS_OUT
+{
+	float4 vpos : SV_POSITION;
+	float3 pos : POSITION;
+	float2 uv : UV;
+	float3 normal : NORMAL;
+	float4 tint : COLOR;
+};
+
+VS_OUT main(VS_IN input)
+{
+	VS_OUT output = (VS_OUT)0;
+	INSTANCE instance = instances[input.id];
+
+	// Instances are placed in object space, so the shared matrices apply after them.
+	// Their scale is uniform, the instance matrix turns normals without distorting them.
+	float4 local = mul(float4(input.pos, 1.0f), instance.world);
+
+	output.vpos   = mul(local, wvp);
+	output.pos    = mul(local, world).xyz;
+	output.normal = mul(mul(input.normal, (float3x3)instance.world), (float3x3)normalMatrix);
+	output.uv = input.uv;
+	output.tint = instance.tint;
+	return output;
+}
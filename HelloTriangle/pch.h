@@ -2,8 +2,15 @@
 
 #pragma once
 //external libraries
+#if defined(_WIN32) || defined(_WIN64)
+#define NOMINMAX //keeps Windows.h from defining min and max macros
 #include <Windows.h>
 #include <d3d11.h>
+#include <tchar.h>
+#else
+//headless builds (software rasterizer and tools) have no Windows SDK
+typedef unsigned int UINT;
+#endif
 #include <DirectXMath.h>
 #include <fstream>
 #include <iostream>
@@ -14,6 +21,17 @@
 #include <memory>
 #include <utility>
 #include <unordered_map>
-#include <tchar.h>
-
-
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <list>
+#include <queue>
+#include <future>
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "../pch.h"
+
+#include "MappedFile.h"
+#include "Utilities.h"
+
+namespace util
+{
+	//Read-only view of contiguous bytes, the stand in for std::span<const std::byte>
+	struct ByteSpan
+	{
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+
+		ByteSpan() {}
+		ByteSpan(const void* data, size_t size) : data(static_cast<const unsigned char*>(data)), size(size) {}
+		const unsigned char* begin() const { return data; }
+		const unsigned char* end() const { return data + size; }
+		bool empty() const { return size == 0; }
+		const unsigned char& operator[](size_t i) const { return data[i]; }
+	};
+
+	//The whole contents of a file, read only. The file is memory mapped, or read with a single bulk read
+	//where it can not be (pipes, some network shares). Copies share the same bytes, so shader bytecode,
+	//images and meshes can be handed around and consumed in place without copying them again.
+	class FileBlob
+	{
+	public:
+		FileBlob() {}
+		explicit FileBlob(const std::string& filepath, bool allowMapping = true) { Open(filepath, allowMapping); }
+
+		bool Open(const std::string& filepath, bool allowMapping = true);
+		void Close() { contents.reset(); } //the bytes live on while other copies hold them
+		bool IsOpen() const { return contents != nullptr; }
+		bool IsMapped() const { return contents && contents->mapping.IsOpen(); }
+
+		const unsigned char* Data() const { return contents ? contents->data : nullptr; } //nullptr for empty files
+		size_t Size() const { return contents ? contents->size : 0; }
+		ByteSpan Span() const { return ByteSpan(Data(), Size()); }
+
+	private:
+		struct Contents
+		{
+			MappedFile mapping;
+			std::vector<unsigned char> bytes; //read fallback
+			const unsigned char* data = nullptr;
+			size_t size = 0;
+		};
+		std::shared_ptr<const Contents> contents;
+	};
+
+	inline
+		bool FileBlob::Open(const std::string& filepath, bool allowMapping)
+	{
+		contents.reset();
+		std::shared_ptr<Contents> next = std::make_shared<Contents>();
+		if (allowMapping && next->mapping.Open(filepath))
+		{
+			next->data = reinterpret_cast<const unsigned char*>(next->mapping.Data());
+			next->size = next->mapping.Size();
+		}
+		else
+		{
+			std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+			if (!file.is_open())
+				return false;
+			const std::streamoff size = file.tellg();
+			if (size < 0)
+				return false;
+			next->bytes.resize(static_cast<size_t>(size));
+			file.seekg(0, std::ios::beg);
+			if (size > 0 && !file.read(reinterpret_cast<char*>(next->bytes.data()), size))
+				return false;
+			next->data = next->bytes.empty() ? nullptr : next->bytes.data();
+			next->size = next->bytes.size();
+		}
+		contents = next;
+		return true;
+	}
+
+	//Reading the whole file each iteration the old way (istreambuf_iterator into a string) and as a blob,
+	//both sum every byte so the lazily mapped pages are paid for as well. Cold numbers need a dropped page cache.
+	struct FileBlobBenchmark
+	{
+		size_t bytes = 0;
+		int iterations = 0;
+		float streamSeconds = 0.0f;	//per iteration
+		float blobSeconds = 0.0f;	//per iteration, mapped
+		float readSeconds = 0.0f;	//per iteration, bulk read fallback
+	};
+
+	inline
+		FileBlobBenchmark BenchmarkFileBlob(const std::string& filepath, int iterations = 10)
+	{
+		FileBlobBenchmark result;
+		result.iterations = std::max(1, iterations);
+		volatile unsigned int sink = 0;
+		auto sum = [](const unsigned char* p, size_t n)
+		{
+			unsigned int s = 0;
+			for (size_t i = 0; i < n; i += 64) //one byte per cache line is enough to touch every page
+				s += p[i];
+			return s;
+		};
+
+		DeltaTimer timer;
+		for (int i = 0; i < result.iterations; ++i)
+		{
+			std::ifstream fstr(filepath, std::ios::binary | std::ios::ate);
+			std::string data;
+			data.reserve(static_cast<size_t>(fstr.tellg()));
+			fstr.seekg(0, std::ios::beg);
+			data.assign((std::istreambuf_iterator<char>(fstr)), std::istreambuf_iterator<char>());
+			sink = sink + sum(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+			result.bytes = data.size();
+		}
+		result.streamSeconds = timer.GetElapsed() / result.iterations;
+
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			timer.Restart();
+			for (int i = 0; i < result.iterations; ++i)
+			{
+				FileBlob blob(filepath, pass == 0);
+				sink = sink + sum(blob.Data(), blob.Size());
+			}
+			(pass == 0 ? result.blobSeconds : result.readSeconds) = timer.GetElapsed() / result.iterations;
+		}
+		return result;
+	}
+}
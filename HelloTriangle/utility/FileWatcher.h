@@ -0,0 +1,195 @@
+#pragma once
+
+#include "../pch.h"
+
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace util
+{
+	//Reports watched files that were written, created or replaced.
+	//Linux uses inotify on the parent directories (editors often save by renaming a new file over the old one,
+	//which a watch on the file itself would lose), everything else and failed inotify setups poll the
+	//modification time and size. Nothing runs in the background, Poll does all the work on the calling thread.
+	class FileWatcher
+	{
+	public:
+		//forcePolling skips inotify, pollInterval is the seconds between stat rounds when polling
+		explicit FileWatcher(bool forcePolling = false, float pollInterval = 0.5f);
+		~FileWatcher();
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		bool Watch(const std::string& path);	//false if the directory of path can not be watched
+		void Unwatch(const std::string& path);
+		bool IsWatched(const std::string& path) const { return files.count(path) != 0; }
+		//appends the watched paths that changed since the last call, a path is reported once per call.
+		//now is in seconds on any clock that does not go backwards, it only paces the polling.
+		size_t Poll(float now, std::vector<std::string>& changed);
+		bool UsingInotify() const { return inotifyFd >= 0; }
+
+	private:
+		struct FileState
+		{
+			long long modified = -1;	//-1 while the file does not exist
+			long long size = -1;
+		};
+
+		static void SplitPath(const std::string& path, std::string& directory, std::string& name);
+		static FileState Stat(const std::string& path);
+		size_t PollInotify(std::vector<std::string>& changed);
+		size_t PollStat(float now, std::vector<std::string>& changed);
+
+		std::unordered_map<std::string, FileState> files;	//watched path -> state at the last poll
+		float pollInterval;
+		float lastPoll = -FLT_MAX;
+		int inotifyFd = -1;
+		std::unordered_map<int, std::string> directories;	//inotify watch -> directory
+		std::unordered_map<std::string, int> watches;		//directory -> inotify watch
+		std::unordered_map<std::string, std::string> locations;	//directory|name -> watched path
+	};
+
+	inline
+		FileWatcher::FileWatcher(bool forcePolling, float pollInterval) : pollInterval(pollInterval)
+	{
+#if defined(__linux__)
+		if (!forcePolling)
+			inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#else
+		(void)forcePolling;
+#endif
+	}
+
+	inline
+		FileWatcher::~FileWatcher()
+	{
+#if defined(__linux__)
+		if (inotifyFd >= 0)
+			close(inotifyFd); //drops every watch with it
+#endif
+	}
+
+	inline
+		void FileWatcher::SplitPath(const std::string& path, std::string& directory, std::string& name)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		directory = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+		name = slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	inline
+		FileWatcher::FileState FileWatcher::Stat(const std::string& path)
+	{
+		FileState state;
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0)
+		{
+			state.modified = static_cast<long long>(info.st_mtime);
+#if defined(__linux__)
+			state.modified = state.modified * 1000000000ll + info.st_mtim.tv_nsec; //whole seconds miss quick saves
+#endif
+			state.size = static_cast<long long>(info.st_size);
+		}
+		return state;
+	}
+
+	inline
+		bool FileWatcher::Watch(const std::string& path)
+	{
+		if (files.count(path))
+			return true;
+#if defined(__linux__)
+		if (inotifyFd >= 0)
+		{
+			std::string directory, name;
+			SplitPath(path, directory, name);
+			if (!watches.count(directory))
+			{
+				const int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				if (wd < 0)
+					return false;
+				watches[directory] = wd;
+				directories[wd] = directory;
+			}
+			locations[directory + "|" + name] = path;
+		}
+#endif
+		files[path] = Stat(path);
+		return true;
+	}
+
+	inline
+		void FileWatcher::Unwatch(const std::string& path)
+	{
+		files.erase(path);
+		std::string directory, name;
+		SplitPath(path, directory, name);
+		locations.erase(directory + "|" + name);
+		//directory watches stay until the watcher dies, other files in them are likely watched too
+	}
+
+	inline
+		size_t FileWatcher::Poll(float now, std::vector<std::string>& changed)
+	{
+		return UsingInotify() ? PollInotify(changed) : PollStat(now, changed);
+	}
+
+	inline
+		size_t FileWatcher::PollStat(float now, std::vector<std::string>& changed)
+	{
+		if (now - lastPoll < pollInterval)
+			return 0;
+		lastPoll = now;
+		size_t count = 0;
+		for (auto& file : files)
+		{
+			const FileState state = Stat(file.first);
+			if (state.modified == file.second.modified && state.size == file.second.size)
+				continue;
+			file.second = state;
+			if (state.size < 0)
+				continue; //deleted, a replacement shows up as a change once it is written
+			changed.push_back(file.first);
+			++count;
+		}
+		return count;
+	}
+
+	inline
+		size_t FileWatcher::PollInotify(std::vector<std::string>& changed)
+	{
+		size_t count = 0;
+#if defined(__linux__)
+		std::vector<std::string> seen;
+		alignas(inotify_event) char buffer[4096];
+		for (;;)
+		{
+			const ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+			if (length <= 0)
+				break; //EAGAIN, nothing left
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+				auto directory = directories.find(event->wd);
+				if (directory == directories.end() || event->len == 0)
+					continue;
+				auto location = locations.find(directory->second + "|" + event->name);
+				if (location == locations.end() || std::find(seen.begin(), seen.end(), location->second) != seen.end())
+					continue;
+				seen.push_back(location->second);
+			}
+		}
+		for (const std::string& path : seen)
+		{
+			files[path] = Stat(path);
+			changed.push_back(path);
+			++count;
+		}
+#endif
+		return count;
+	}
+}
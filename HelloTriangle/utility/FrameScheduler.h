@@ -0,0 +1,181 @@
+#pragma once
+
+#include "../pch.h"
+
+#include "Utilities.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+namespace util
+{
+	//Time source of the scheduler in seconds. Tests supply a clock that only moves when told to.
+	class Clock
+	{
+	public:
+		virtual ~Clock() {}
+		virtual double Now() = 0;
+		virtual void SleepFor(double seconds) = 0;	//may oversleep, the scheduler spins the rest
+		virtual void Pause() {}						//called on every spin iteration
+	};
+
+	//DeltaTimer time, sleeps with the OS. Windows sleeps in 15.6 ms steps unless the timer resolution is raised.
+	class SteadyClock : public Clock
+	{
+	public:
+		SteadyClock()
+		{
+#if defined(_WIN32) || defined(_WIN64)
+			timeBeginPeriod(1);
+#endif
+		}
+		~SteadyClock()
+		{
+#if defined(_WIN32) || defined(_WIN64)
+			timeEndPeriod(1);
+#endif
+		}
+		double Now() override { return timer.GetElapsedPrecise(); }
+		void SleepFor(double seconds) override { std::this_thread::sleep_for(std::chrono::duration<double>(seconds)); }
+		void Pause() override { std::this_thread::yield(); }
+
+	private:
+		DeltaTimer timer;
+	};
+
+	struct FrameTiming
+	{
+		double time = 0.0;			//clock time the frame started at
+		float delta = 0.0f;			//seconds since the previous frame
+		float step = 0.0f;			//fixed simulation step
+		int steps = 0;				//simulation steps to run this frame
+		float interpolation = 1.0f;	//how far between the previous and the current simulation state to render, [0, 1)
+	};
+
+	//Frame to frame deviation. Capped: from the target interval, uncapped: from the mean.
+	struct FrameJitter
+	{
+		size_t frames = 0;
+		float meanMs = 0.0f;
+		float stddevMs = 0.0f;
+		float p99DeviationMs = 0.0f;
+		float maxDeviationMs = 0.0f;
+	};
+
+	//Paces the render loop. BeginFrame sleeps until shortly before the next frame is due and spins the
+	//rest (sleeps overshoot by up to a millisecond or two), then hands out fixed simulation steps for the
+	//time that passed. targetFps 0 does not wait at all, for benchmarks.
+	class FrameScheduler
+	{
+	public:
+		static const size_t JITTER_WINDOW = 1024;
+
+		explicit FrameScheduler(double targetFps = 60.0, double simulationHz = 60.0)
+			: FrameScheduler(DefaultClock(), targetFps, simulationHz) {}
+		FrameScheduler(Clock& clock, double targetFps = 60.0, double simulationHz = 60.0)
+			: clock(clock), step(1.0 / simulationHz) { SetTargetFps(targetFps); }
+
+		void SetTargetFps(double fps) { interval = fps > 0.0 ? 1.0 / fps : 0.0; next = -1.0; }
+		bool Uncapped() const { return interval == 0.0; }
+		//how long before the deadline sleeping stops and spinning starts
+		void SetSpinMargin(double seconds) { spinMargin = seconds; }
+		//frames that took longer than this (breakpoints, window drags) are simulated as if they had not
+		void SetMaxDelta(double seconds) { maxDelta = seconds; }
+
+		FrameTiming BeginFrame();
+		FrameJitter GetJitter() const;
+
+		static Clock& DefaultClock()
+		{
+			static SteadyClock clock;
+			return clock;
+		}
+
+	private:
+		void WaitUntil(double deadline);
+
+		Clock& clock;
+		double step;
+		double interval = 0.0;
+		double spinMargin = 0.002;
+		double maxDelta = 0.25;
+		double next = -1.0;		//deadline of the next frame, -1 before the first
+		double last = -1.0;		//start of the previous frame
+		double accumulator = 0.0;
+		std::vector<float> intervals = std::vector<float>(JITTER_WINDOW, 0.0f); //ring, seconds
+		size_t frames = 0;
+	};
+
+	inline
+		void FrameScheduler::WaitUntil(double deadline)
+	{
+		const double remaining = deadline - clock.Now();
+		if (remaining > spinMargin)
+			clock.SleepFor(remaining - spinMargin);
+		while (clock.Now() < deadline)
+			clock.Pause();
+	}
+
+	inline
+		FrameTiming FrameScheduler::BeginFrame()
+	{
+		if (!Uncapped() && next >= 0.0)
+			WaitUntil(next);
+		const double now = clock.Now();
+
+		if (!Uncapped())
+		{
+			// Deadlines advance by whole intervals so waits do not add up to drift,
+			// a frame that ran late starts a new schedule instead of rushing to catch up
+			next = next < 0.0 || now - next > interval ? now + interval : next + interval;
+		}
+
+		FrameTiming timing;
+		timing.time = now;
+		timing.step = static_cast<float>(step);
+		if (last >= 0.0)
+		{
+			const double delta = now - last;
+			timing.delta = static_cast<float>(delta);
+			intervals[frames % JITTER_WINDOW] = static_cast<float>(delta);
+			++frames;
+			accumulator += std::min(delta, maxDelta);
+		}
+		last = now;
+
+		timing.steps = static_cast<int>(accumulator / step);
+		accumulator -= timing.steps * step;
+		timing.interpolation = static_cast<float>(accumulator / step);
+		return timing;
+	}
+
+	inline
+		FrameJitter FrameScheduler::GetJitter() const
+	{
+		FrameJitter jitter;
+		jitter.frames = std::min(frames, JITTER_WINDOW);
+		if (jitter.frames == 0)
+			return jitter;
+		double sum = 0.0;
+		for (size_t i = 0; i < jitter.frames; ++i)
+			sum += intervals[i];
+		const double mean = sum / jitter.frames;
+		const double reference = Uncapped() ? mean : interval;
+
+		std::vector<float> deviations(jitter.frames);
+		double variance = 0.0;
+		for (size_t i = 0; i < jitter.frames; ++i)
+		{
+			deviations[i] = static_cast<float>(std::abs(intervals[i] - reference));
+			variance += (intervals[i] - mean) * (intervals[i] - mean);
+		}
+		std::sort(deviations.begin(), deviations.end());
+		jitter.meanMs = static_cast<float>(mean * 1000.0);
+		jitter.stddevMs = static_cast<float>(std::sqrt(variance / jitter.frames) * 1000.0);
+		jitter.p99DeviationMs = deviations[std::min(jitter.frames - 1, jitter.frames * 99 / 100)] * 1000.0f;
+		jitter.maxDeviationMs = deviations.back() * 1000.0f;
+		return jitter;
+	}
+}
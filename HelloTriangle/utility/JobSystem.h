@@ -0,0 +1,513 @@
+#pragma once
+
+#include "../pch.h"
+
+#include "Profiler.h"
+
+namespace util
+{
+	//number of hardware threads, never less than one
+	inline
+		unsigned int HardwareThreads()
+	{
+		const unsigned int n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : n;
+	}
+
+	class JobSystem;
+
+	namespace jobs
+	{
+		struct Job;
+
+		//Chase-Lev work stealing deque. The owning worker pushes and pops at the bottom,
+		//every other thread steals from the top. Fixed capacity, Push fails when full.
+		class WorkDeque
+		{
+		public:
+			static const int64_t CAPACITY = 1 << 12;
+
+			WorkDeque() : slots(CAPACITY)
+			{
+				for (std::atomic<Job*>& slot : slots)
+					slot.store(nullptr, std::memory_order_relaxed);
+			}
+
+			//owner only
+			bool Push(Job* job)
+			{
+				const int64_t b = bottom.load(std::memory_order_relaxed);
+				const int64_t t = top.load(std::memory_order_acquire);
+				if (b - t >= CAPACITY)
+					return false;
+				slots[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			//owner only, newest first
+			Job* Pop()
+			{
+				const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = top.load(std::memory_order_relaxed);
+				if (t > b)
+				{
+					bottom.store(b + 1, std::memory_order_relaxed); //was empty
+					return nullptr;
+				}
+				Job* job = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+				if (t == b)
+				{
+					// Last one, race the thieves for it
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						job = nullptr;
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			//any thread, oldest first
+			Job* Steal()
+			{
+				int64_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const int64_t b = bottom.load(std::memory_order_acquire);
+				if (t >= b)
+					return nullptr;
+				Job* job = slots[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return nullptr; //lost to another thief or the owner
+				return job;
+			}
+
+		private:
+			std::atomic<int64_t> top{ 0 };
+			char padding[64];	//keeps thieves and the owner off each other's cache line
+			std::atomic<int64_t> bottom{ 0 };
+			std::vector<std::atomic<Job*>> slots;
+		};
+	}
+
+	//Counts unfinished jobs. Jobs started with RunAfter wait for a counter to reach zero.
+	//Has to outlive every job that counts on it, JobSystem::Wait before it goes out of scope.
+	class JobCounter
+	{
+	public:
+		JobCounter() {}
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool Done() const { return pending.load() == 0 && finishing.load() == 0; }
+		int Pending() const { return pending.load(); }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<int> pending{ 0 };
+		std::atomic<int> finishing{ 0 };	//jobs between their decrement and their last access, Done waits for them
+		std::mutex mutex;
+		std::vector<jobs::Job*> continuations;	//RunAfter jobs, submitted when pending reaches zero
+	};
+
+	struct JobStats
+	{
+		size_t executed = 0;
+		size_t stolen = 0;		//taken from another worker's deque
+		size_t injected = 0;	//submitted from threads outside the pool
+	};
+
+	//Worker threads with one Chase-Lev deque each. Jobs submitted by a worker go to its own deque and
+	//idle workers steal from the others, jobs from any other thread go through a shared queue.
+	//Workers that Wait run any job until their counter is done, so waiting inside a job does not deadlock.
+	//Other threads only help with jobs of the counter they wait for, a frame never picks up background work.
+	class JobSystem
+	{
+	public:
+		//threads counts the threads that wait as well, 0 uses every hardware thread.
+		//There is always at least one worker unless threads is 1, then only Wait runs jobs.
+		explicit JobSystem(unsigned int threads = 0);
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		unsigned int ThreadCount() const { return static_cast<unsigned int>(workers.size()) + 1; }
+		unsigned int WorkerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+		void Run(std::function<void()> fn, JobCounter* counter = nullptr);
+		//fn starts once dependency reaches zero
+		void RunAfter(JobCounter& dependency, std::function<void()> fn, JobCounter* counter = nullptr);
+		//runs jobs on the calling thread until counter is done, outside the pool only jobs counted by counter
+		void Wait(JobCounter& counter);
+
+		//Splits [0, count) into chunks of at least grain elements and calls fn(begin, end) for each chunk.
+		//Chunks are taken from a shared counter by up to threads threads including the caller (0: all of the pool).
+		//grain = 0 picks one that gives every thread about eight chunks.
+		template<typename Fn>
+		void ParallelFor(size_t count, size_t grain, Fn&& fn, unsigned int threads = 0);
+
+		JobStats GetStats() const;
+
+		//the pool everything shares, started on first use
+		static JobSystem& Global()
+		{
+			static JobSystem system;
+			return system;
+		}
+
+	private:
+		struct Worker
+		{
+			jobs::WorkDeque deque;
+			std::thread thread;
+		};
+		//what the calling thread is to this system, workers know their index
+		struct ThreadSlot
+		{
+			const JobSystem* system = nullptr;
+			size_t index = 0;
+			uint32_t random = 0x9e3779b9u; //xorshift state for picking victims
+		};
+		static ThreadSlot& CurrentThread()
+		{
+			static thread_local ThreadSlot slot;
+			return slot;
+		}
+		Worker* CurrentWorker() const
+		{
+			ThreadSlot& slot = CurrentThread();
+			return slot.system == this ? workers[slot.index].get() : nullptr;
+		}
+
+		void Submit(jobs::Job* job);
+		jobs::Job* Find(const JobCounter* only = nullptr);
+		void Execute(jobs::Job* job);
+		bool RunOne(const JobCounter* only = nullptr);
+		void WorkerLoop(size_t index);
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::mutex injectMutex;
+		std::deque<jobs::Job*> injected;
+		std::atomic<int64_t> queued{ 0 };	//submitted and not yet taken
+		std::atomic<int> sleeping{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		std::atomic<bool> stopping{ false };
+		std::atomic<size_t> executed{ 0 }, stolen{ 0 }, injectedCount{ 0 };
+	};
+
+	namespace jobs
+	{
+		struct Job
+		{
+			std::function<void()> fn;
+			JobCounter* counter;
+		};
+	}
+
+	inline
+		JobSystem::JobSystem(unsigned int threads)
+	{
+		const unsigned int total = threads == 0 ? std::max(2u, HardwareThreads()) : threads;
+		for (unsigned int i = 1; i < total; ++i)
+			workers.emplace_back(new Worker());
+		// Every deque exists before any thread can steal from it
+		for (size_t i = 0; i < workers.size(); ++i)
+			workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+	}
+
+	inline
+		JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::unique_ptr<Worker>& worker : workers)
+			worker->thread.join();
+		// Jobs nobody waited for are dropped
+		jobs::Job* job;
+		while ((job = Find()) != nullptr)
+			delete job;
+	}
+
+	inline
+		void JobSystem::Run(std::function<void()> fn, JobCounter* counter)
+	{
+		if (counter)
+			counter->pending.fetch_add(1);
+		Submit(new jobs::Job{ std::move(fn), counter });
+	}
+
+	inline
+		void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> fn, JobCounter* counter)
+	{
+		if (counter)
+			counter->pending.fetch_add(1);
+		jobs::Job* job = new jobs::Job{ std::move(fn), counter };
+		{
+			std::lock_guard<std::mutex> lock(dependency.mutex);
+			if (dependency.pending.load() > 0)
+			{
+				dependency.continuations.push_back(job);
+				return;
+			}
+		}
+		Submit(job);
+	}
+
+	inline
+		void JobSystem::Submit(jobs::Job* job)
+	{
+		queued.fetch_add(1);
+		Worker* worker = CurrentWorker();
+		if (worker == nullptr || !worker->deque.Push(job))
+		{
+			std::lock_guard<std::mutex> lock(injectMutex);
+			injected.push_back(job);
+			if (worker == nullptr)
+				injectedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		// A sleeper checks queued under sleepMutex, notifying under it cannot slip between its check and its wait
+		if (sleeping.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wake.notify_one();
+		}
+	}
+
+	inline
+		jobs::Job* JobSystem::Find(const JobCounter* only)
+	{
+		if (only)
+		{
+			// Only the shared queue, jobs in the worker deques are left to the workers
+			std::lock_guard<std::mutex> lock(injectMutex);
+			auto it = std::find_if(injected.begin(), injected.end(), [only](const jobs::Job* job) { return job->counter == only; });
+			if (it == injected.end())
+				return nullptr;
+			jobs::Job* job = *it;
+			injected.erase(it);
+			return job;
+		}
+		ThreadSlot& slot = CurrentThread();
+		Worker* self = CurrentWorker();
+		if (self)
+		{
+			if (jobs::Job* job = self->deque.Pop())
+				return job;
+		}
+		{
+			std::lock_guard<std::mutex> lock(injectMutex);
+			if (!injected.empty())
+			{
+				jobs::Job* job = injected.front();
+				injected.pop_front();
+				return job;
+			}
+		}
+		if (workers.empty())
+			return nullptr;
+		// Start at a random victim so thieves spread out
+		slot.random ^= slot.random << 13;
+		slot.random ^= slot.random >> 17;
+		slot.random ^= slot.random << 5;
+		const size_t start = slot.random % workers.size();
+		for (size_t i = 0; i < workers.size(); ++i)
+		{
+			Worker* victim = workers[(start + i) % workers.size()].get();
+			if (victim == self)
+				continue;
+			if (jobs::Job* job = victim->deque.Steal())
+			{
+				stolen.fetch_add(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	inline
+		void JobSystem::Execute(jobs::Job* job)
+	{
+		queued.fetch_sub(1);
+		job->fn();
+		executed.fetch_add(1, std::memory_order_relaxed);
+		JobCounter* counter = job->counter;
+		delete job;
+		if (counter == nullptr)
+			return;
+
+		counter->finishing.fetch_add(1);
+		if (counter->pending.fetch_sub(1) == 1)
+		{
+			std::vector<jobs::Job*> ready;
+			{
+				std::lock_guard<std::mutex> lock(counter->mutex);
+				ready.swap(counter->continuations);
+			}
+			for (jobs::Job* next : ready)
+				Submit(next);
+		}
+		counter->finishing.fetch_sub(1); //the waiter may destroy the counter from here on
+	}
+
+	inline
+		bool JobSystem::RunOne(const JobCounter* only)
+	{
+		jobs::Job* job = Find(only);
+		if (job == nullptr)
+			return false;
+		Execute(job);
+		return true;
+	}
+
+	inline
+		void JobSystem::Wait(JobCounter& counter)
+	{
+		PROFILE_FUNCTION();
+		// A worker has to take whatever is there, the job it waits for may be stuck behind others in its deque.
+		// Any other thread (the render thread) sticks to its own jobs, unless there is nobody else to run them.
+		const JobCounter* only = CurrentWorker() || workers.empty() ? nullptr : &counter;
+		while (!counter.Done())
+		{
+			if (!RunOne(only))
+				std::this_thread::yield(); //the rest is running on other threads
+		}
+	}
+
+	inline
+		void JobSystem::WorkerLoop(size_t index)
+	{
+		ThreadSlot& slot = CurrentThread();
+		slot.system = this;
+		slot.index = index;
+		slot.random += static_cast<uint32_t>(index) * 0x6c078965u;
+		PROFILE_THREAD("Job worker " + std::to_string(index));
+
+		const int SPINS = 64;
+		int idle = 0;
+		while (!stopping.load())
+		{
+			if (RunOne())
+			{
+				idle = 0;
+				continue;
+			}
+			if (++idle < SPINS)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			// Nothing to do for a while, sleep until something is submitted
+			sleeping.fetch_add(1);
+			{
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				wake.wait(lock, [this]() { return stopping.load() || queued.load() > 0; });
+			}
+			sleeping.fetch_sub(1);
+			idle = 0;
+		}
+	}
+
+	template<typename Fn>
+	inline
+		void JobSystem::ParallelFor(size_t count, size_t grain, Fn&& fn, unsigned int threads)
+	{
+		if (count == 0)
+			return;
+		const size_t limit = threads == 0 ? ThreadCount() : std::min(threads, ThreadCount());
+		if (grain == 0)
+			grain = std::max<size_t>(1, count / (limit * 8));
+
+		const size_t chunks = (count + grain - 1) / grain;
+		const size_t helpers = std::min(limit, chunks) - 1;
+		if (helpers == 0)
+		{
+			fn(size_t(0), count);
+			return;
+		}
+
+		// Helpers that start after the chunks ran out return right away
+		std::atomic<size_t> next{ 0 };
+		auto work = [&]()
+		{
+			for (size_t chunk = next.fetch_add(1); chunk < chunks; chunk = next.fetch_add(1))
+			{
+				const size_t begin = chunk * grain;
+				fn(begin, std::min(begin + grain, count));
+			}
+		};
+		JobCounter counter;
+		for (size_t i = 0; i < helpers; ++i)
+			Run([&work]() { work(); }, &counter);
+		work();
+		Wait(counter);
+	}
+
+	inline
+		JobStats JobSystem::GetStats() const
+	{
+		JobStats stats;
+		stats.executed = executed.load(std::memory_order_relaxed);
+		stats.stolen = stolen.load(std::memory_order_relaxed);
+		stats.injected = injectedCount.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	// **********************************************************************************************************
+	// BENCHMARK
+	// **********************************************************************************************************
+
+	struct JobScaling
+	{
+		unsigned int threads = 0;
+		float ms = 0.0f;		//best of the runs
+		float speedup = 1.0f;	//over one thread
+	};
+
+	//ParallelFor over a float workload on pools of 1 to maxThreads threads (0: every hardware thread),
+	//doubling each time and always including maxThreads
+	inline
+		std::vector<JobScaling> BenchmarkJobSystem(unsigned int maxThreads = 0, size_t elements = 1 << 22, int runs = 5)
+	{
+		if (maxThreads == 0)
+			maxThreads = HardwareThreads();
+		std::vector<unsigned int> counts;
+		for (unsigned int n = 1; n < maxThreads; n *= 2)
+			counts.push_back(n);
+		counts.push_back(maxThreads);
+
+		std::vector<float> data(elements);
+		std::vector<JobScaling> results;
+		for (unsigned int threads : counts)
+		{
+			JobSystem system(threads);
+			JobScaling result;
+			result.threads = threads;
+			result.ms = FLT_MAX;
+			for (int run = 0; run < runs; ++run)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				system.ParallelFor(elements, 0, [&data](size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; ++i)
+						{
+							float x = static_cast<float>(i);
+							for (int k = 0; k < 32; ++k)
+								x = std::sqrt(x * 1.0001f + 1.0f);
+							data[i] = x;
+						}
+					});
+				const std::chrono::duration<float, std::milli> ms = std::chrono::steady_clock::now() - start;
+				result.ms = std::min(result.ms, ms.count());
+			}
+			result.speedup = results.empty() ? 1.0f : results.front().ms / result.ms;
+			results.push_back(result);
+		}
+		return results;
+	}
+}
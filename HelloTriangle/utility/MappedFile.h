@@ -0,0 +1,130 @@
+#pragma once
+
+#include "../pch.h"
+
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util
+{
+	//Read-only memory mapping of a whole file, unmapped when the object dies
+	class MappedFile
+	{
+	public:
+		MappedFile() : data(nullptr), size(0), open(false) {}
+		explicit MappedFile(const std::string& filepath) : data(nullptr), size(0), open(false) { Open(filepath); }
+		~MappedFile() { Close(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+		bool IsOpen() const { return open; }
+		const char* Data() const { return data; } //nullptr for empty files
+		size_t Size() const { return size; }
+
+	private:
+		const char* data;
+		size_t size;
+		bool open;
+#if defined(_WIN32) || defined(_WIN64)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#endif
+	};
+
+#if defined(_WIN32) || defined(_WIN64)
+	inline
+		bool MappedFile::Open(const std::string& filepath)
+	{
+		Close();
+		file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			Close();
+			return false;
+		}
+		size = static_cast<size_t>(fileSize.QuadPart);
+		open = true;
+		if (size == 0) //empty files can not be mapped
+			return true;
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			Close();
+			return false;
+		}
+		data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	inline
+		void MappedFile::Close()
+	{
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		data = nullptr;
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+		size = 0;
+		open = false;
+	}
+#else
+	inline
+		bool MappedFile::Open(const std::string& filepath)
+	{
+		Close();
+		const int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+		size = static_cast<size_t>(st.st_size);
+		if (size > 0)
+		{
+			void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapped == MAP_FAILED)
+			{
+				::close(fd);
+				size = 0;
+				return false;
+			}
+			madvise(mapped, size, MADV_SEQUENTIAL);
+			data = static_cast<const char*>(mapped);
+		}
+		::close(fd); //the mapping stays valid without the descriptor
+		open = true;
+		return true;
+	}
+
+	inline
+		void MappedFile::Close()
+	{
+		if (data)
+			munmap(const_cast<char*>(data), size);
+		data = nullptr;
+		size = 0;
+		open = false;
+	}
+#endif
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "../pch.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace util
+{
+	//Allocation interface for code that takes its memory from outside (stb_image, loaders).
+	//Implementations must be thread safe.
+	class Allocator
+	{
+	public:
+		virtual ~Allocator() {}
+		virtual void* Allocate(size_t size) = 0;
+		virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) = 0;
+		virtual void Free(void* p) = 0;
+	};
+
+	//plain malloc/realloc/free
+	class MallocAllocator : public Allocator
+	{
+	public:
+		void* Allocate(size_t size) override { return malloc(size); }
+		void* Reallocate(void* p, size_t, size_t newSize) override { return realloc(p, newSize); }
+		void Free(void* p) override { free(p); }
+	};
+
+	inline
+		Allocator& DefaultAllocator()
+	{
+		static MallocAllocator allocator;
+		return allocator;
+	}
+
+	//Size classes (four per power of two) with free lists. Freed blocks are kept for the next allocation
+	//of the same class instead of going back to the OS, so loading a batch of similar images reuses
+	//the scratch memory of the previous ones. Trim returns the kept blocks.
+	class PoolAllocator : public Allocator
+	{
+	public:
+		PoolAllocator() {}
+		~PoolAllocator() { Trim(); }
+		PoolAllocator(const PoolAllocator&) = delete;
+		PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+		void* Allocate(size_t size) override;
+		void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+		void Free(void* p) override;
+		void Trim();
+
+		size_t BytesInUse() const { return inUse; }
+		size_t PeakBytesInUse() const { return peak; }
+		size_t BytesCached() const { return cached; }	//freed and kept for reuse
+		size_t Reuses() const { return reuses; }		//allocations served from a free list
+
+	private:
+		static const int MIN_SHIFT = 6;		//smallest class is 64 bytes
+		static const int CLASS_COUNT = 4 * 40;
+		static const size_t HEADER = 16;	//size class in front of every block, keeps 16 byte alignment
+
+		static size_t ClassBytes(int c) { return size_t(4 + c % 4) << (MIN_SHIFT - 2 + c / 4); }
+		static int SizeClass(size_t size)
+		{
+			int c = 0;
+			while (c < CLASS_COUNT && ClassBytes(c) < size + HEADER)
+				++c;
+			return c;
+		}
+
+		std::mutex mutex;
+		std::vector<void*> freeLists[CLASS_COUNT];
+		size_t inUse = 0, peak = 0, cached = 0, reuses = 0;
+	};
+
+	inline
+		void* PoolAllocator::Allocate(size_t size)
+	{
+		const int c = SizeClass(size);
+		if (c >= CLASS_COUNT)
+			return nullptr;
+		const size_t bytes = ClassBytes(c);
+		char* block = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!freeLists[c].empty())
+			{
+				block = static_cast<char*>(freeLists[c].back());
+				freeLists[c].pop_back();
+				cached -= bytes;
+				++reuses;
+			}
+			inUse += bytes;
+			peak = std::max(peak, inUse);
+		}
+		if (block == nullptr)
+		{
+			block = static_cast<char*>(malloc(bytes));
+			if (block == nullptr)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				inUse -= bytes;
+				return nullptr;
+			}
+		}
+		memcpy(block, &c, sizeof(c));
+		return block + HEADER;
+	}
+
+	inline
+		void* PoolAllocator::Reallocate(void* p, size_t oldSize, size_t newSize)
+	{
+		if (p == nullptr)
+			return Allocate(newSize);
+		int c;
+		memcpy(&c, static_cast<char*>(p) - HEADER, sizeof(c));
+		if (newSize + HEADER <= ClassBytes(c))
+			return p; //still fits its block
+		void* next = Allocate(newSize);
+		if (next == nullptr)
+			return nullptr;
+		memcpy(next, p, std::min(oldSize, newSize));
+		Free(p);
+		return next;
+	}
+
+	inline
+		void PoolAllocator::Free(void* p)
+	{
+		if (p == nullptr)
+			return;
+		char* block = static_cast<char*>(p) - HEADER;
+		int c;
+		memcpy(&c, block, sizeof(c));
+		std::lock_guard<std::mutex> lock(mutex);
+		freeLists[c].push_back(block);
+		inUse -= ClassBytes(c);
+		cached += ClassBytes(c);
+	}
+
+	inline
+		void PoolAllocator::Trim()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (std::vector<void*>& list : freeLists)
+		{
+			for (void* block : list)
+				free(block);
+			list.clear();
+		}
+		cached = 0;
+	}
+
+	//peak resident set size of the process in bytes, 0 where it can not be read
+	inline
+		size_t PeakResidentBytes()
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize;
+		return 0;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#if defined(__APPLE__)
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024; //kilobytes on Linux
+#endif
+#endif
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../pch.h"
+
+#include "JobSystem.h"
+
+namespace util
+{
+	//Splits [0, count) into chunks of at least grain elements and calls fn(begin, end) for each chunk.
+	//Chunks are handed out to the shared job system, the calling thread does work as well.
+	//threads = 0 uses the whole pool, grain = 0 picks a grain from the pool size.
+	template<typename Fn>
+	inline
+		void ParallelFor(size_t count, size_t grain, Fn&& fn, unsigned int threads = 0)
+	{
+		JobSystem::Global().ParallelFor(count, grain, std::forward<Fn>(fn), threads);
+	}
+}
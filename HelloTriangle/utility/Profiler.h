@@ -0,0 +1,361 @@
+#pragma once
+
+#include "../pch.h"
+
+#include "Simd.h"
+
+//Scoped CPU zones. Build with DXH_PROFILE=0 to compile every zone out. Compiled in, zones only record
+//after Profiler::SetEnabled(true), until then they cost a flag check and no thread holds a buffer.
+#ifndef DXH_PROFILE
+#define DXH_PROFILE 1
+#endif
+
+namespace util
+{
+	namespace profiler
+	{
+		struct ZoneEvent
+		{
+			const char* name;	//has to outlive the profiler, string literals and __FUNCTION__ do
+			int64_t start;		//Profiler::Now ticks
+			int64_t end;
+			uint32_t depth;		//nesting on its thread, 0 is outermost
+		};
+
+		//The last CAPACITY events of one thread in a ring. Only the owning thread writes and recording takes
+		//no lock, so a reader running while the thread records may see a half written event at the oldest end.
+		class ThreadBuffer
+		{
+		public:
+			static const size_t CAPACITY = 1 << 16;
+
+			ThreadBuffer(uint32_t thread) : thread(thread), name("Thread " + std::to_string(thread)) {}
+
+			void Push(const ZoneEvent& event)
+			{
+				const size_t n = count.load(std::memory_order_relaxed);
+				if (!events) //zeroed, the pages are faulted in here and not by later zones
+					events.reset(new ZoneEvent[CAPACITY]());
+				events[n % CAPACITY] = event;
+				count.store(n + 1, std::memory_order_release);
+			}
+
+			//calls fn for the events still held, oldest first
+			template<typename Fn>
+			void ForEach(Fn&& fn) const
+			{
+				const size_t n = count.load(std::memory_order_acquire);
+				for (size_t i = n > CAPACITY ? n - CAPACITY : 0; i < n; ++i)
+					fn(events[i % CAPACITY]);
+			}
+			size_t Held() const { return std::min(count.load(std::memory_order_acquire), CAPACITY); }
+			size_t Overwritten() const { const size_t n = count.load(std::memory_order_acquire); return n > CAPACITY ? n - CAPACITY : 0; }
+
+			std::unique_ptr<ZoneEvent[]> events;	//allocated by the first event
+			std::atomic<size_t> count{ 0 };			//events ever pushed
+			uint32_t depth = 0;	//open zones, owning thread only
+			uint32_t thread;
+			std::string name;
+		};
+	}
+
+	struct FrameStats
+	{
+		size_t frames = 0;	//frames in the window the percentiles are taken over
+		float mean = 0.0f;	//milliseconds
+		float p50 = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+		float max = 0.0f;
+	};
+
+	struct ZoneSummary
+	{
+		const char* name = nullptr;
+		size_t calls = 0;
+		float totalMs = 0.0f;
+		float maxMs = 0.0f;
+	};
+
+	//Collects the zones of every thread and the frame times of the render loop.
+	class Profiler
+	{
+	public:
+		static const size_t FRAME_WINDOW = 1024; //frame times kept for the percentiles
+
+		static Profiler& Get()
+		{
+			static Profiler profiler;
+			return profiler;
+		}
+
+		//Timestamp for zones. The time stamp counter on x86 (invariant on every CPU this runs on), reading it
+		//is a fraction of a steady_clock call. Converted to nanoseconds only when the events are read.
+		static int64_t Now()
+		{
+#if DXH_X86
+			return static_cast<int64_t>(__rdtsc());
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+		double NanosecondsPerTick() const;
+
+		//the calling thread's buffer, created on first use
+		profiler::ThreadBuffer& ThisThread()
+		{
+			static thread_local profiler::ThreadBuffer* buffer = nullptr;
+			if (buffer == nullptr)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				threads.emplace_back(new profiler::ThreadBuffer(static_cast<uint32_t>(threads.size())));
+				buffer = threads.back().get();
+			}
+			return *buffer;
+		}
+
+		//zones and frames are only recorded while enabled, off by default
+		void SetEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+		bool Enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+		//shown instead of "Thread n" in the trace
+		void SetThreadName(const std::string& name)
+		{
+			profiler::ThreadBuffer& buffer = ThisThread();
+			std::lock_guard<std::mutex> lock(mutex);
+			buffer.name = name;
+		}
+
+		//call once per frame, the time since the previous call is one frame and shows up as a "Frame" zone
+		void FrameMark();
+		FrameStats GetFrameStats() const;
+		//calls and time per zone name over every recorded event, slowest total first
+		std::vector<ZoneSummary> SummarizeZones() const;
+
+		size_t EventCount() const;		//held in the rings
+		size_t DroppedEvents() const;	//overwritten by newer ones, the trace starts after them
+		//forgets every event and frame time, only while no other thread is inside a zone
+		void Clear();
+		//chrome://tracing and Perfetto read this, the overwritten event count goes into otherData
+		bool WriteChromeTrace(const std::string& filepath) const;
+
+	private:
+		Profiler() : startTicks(Now()), startTime(std::chrono::steady_clock::now()) {}
+
+		const int64_t startTicks;
+		const std::chrono::steady_clock::time_point startTime;
+		std::atomic<bool> enabled{ false };
+
+		mutable std::mutex mutex;
+		std::vector<std::unique_ptr<profiler::ThreadBuffer>> threads; //never shrinks, threads keep pointers into it
+		std::vector<float> frameTimes = std::vector<float>(FRAME_WINDOW, 0.0f); //ring, milliseconds
+		size_t frames = 0;
+		int64_t lastFrame = -1;	//ticks
+		std::chrono::steady_clock::time_point lastFrameTime;
+	};
+
+	//Records its lifetime as a zone on the calling thread
+	class ProfileZone
+	{
+	public:
+		explicit ProfileZone(const char* name) : buffer(Profiler::Get().Enabled() ? &Profiler::Get().ThisThread() : nullptr), name(name)
+		{
+			if (buffer == nullptr)
+				return;
+			depth = buffer->depth++;
+			start = Profiler::Now();
+		}
+		~ProfileZone()
+		{
+			if (buffer == nullptr)
+				return;
+			const int64_t end = Profiler::Now();
+			--buffer->depth;
+			buffer->Push({ name, start, end, depth });
+		}
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+	private:
+		profiler::ThreadBuffer* buffer;	//nullptr when the profiler was disabled at the start
+		const char* name;
+		int64_t start = 0;
+		uint32_t depth = 0;
+	};
+
+	inline
+		void Profiler::FrameMark()
+	{
+		if (!Enabled())
+		{
+			lastFrame = -1; //the frame after enabling starts the count
+			return;
+		}
+		const int64_t now = Now();
+		const std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+		if (lastFrame >= 0)
+		{
+			ThisThread().Push({ "Frame", lastFrame, now, 0 });
+			std::lock_guard<std::mutex> lock(mutex);
+			frameTimes[frames % FRAME_WINDOW] = std::chrono::duration<float, std::milli>(time - lastFrameTime).count();
+			++frames;
+		}
+		lastFrame = now;
+		lastFrameTime = time;
+	}
+
+	inline
+		double Profiler::NanosecondsPerTick() const
+	{
+#if DXH_X86
+		//measured over the whole run against steady_clock, the longer it ran the better the ratio
+		for (;;)
+		{
+			const int64_t ticks = Now();
+			const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+			if (ns >= 1e6 && ticks > startTicks)
+				return ns / static_cast<double>(ticks - startTicks);
+		}
+#else
+		return 1.0;
+#endif
+	}
+
+	inline
+		FrameStats Profiler::GetFrameStats() const
+	{
+		std::vector<float> times;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			times.assign(frameTimes.begin(), frameTimes.begin() + std::min(frames, FRAME_WINDOW));
+		}
+		FrameStats stats;
+		stats.frames = times.size();
+		if (times.empty())
+			return stats;
+		std::sort(times.begin(), times.end());
+		auto percentile = [&times](float p) { return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))]; };
+		double sum = 0.0;
+		for (float t : times)
+			sum += t;
+		stats.mean = static_cast<float>(sum / times.size());
+		stats.p50 = percentile(0.50f);
+		stats.p95 = percentile(0.95f);
+		stats.p99 = percentile(0.99f);
+		stats.max = times.back();
+		return stats;
+	}
+
+	inline
+		std::vector<ZoneSummary> Profiler::SummarizeZones() const
+	{
+		std::unordered_map<const char*, ZoneSummary> byName; //names are literals, the pointer is the identity
+		const float msPerTick = static_cast<float>(NanosecondsPerTick() * 1e-6);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const auto& thread : threads)
+			{
+				thread->ForEach([&](const profiler::ZoneEvent& event)
+					{
+						ZoneSummary& summary = byName[event.name];
+						const float ms = static_cast<float>(event.end - event.start) * msPerTick;
+						summary.name = event.name;
+						++summary.calls;
+						summary.totalMs += ms;
+						summary.maxMs = std::max(summary.maxMs, ms);
+					});
+			}
+		}
+		std::vector<ZoneSummary> result;
+		for (const auto& entry : byName)
+			result.push_back(entry.second);
+		std::sort(result.begin(), result.end(), [](const ZoneSummary& a, const ZoneSummary& b) { return a.totalMs > b.totalMs; });
+		return result;
+	}
+
+	inline
+		size_t Profiler::EventCount() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t count = 0;
+		for (const auto& thread : threads)
+			count += thread->Held();
+		return count;
+	}
+
+	inline
+		size_t Profiler::DroppedEvents() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t count = 0;
+		for (const auto& thread : threads)
+			count += thread->Overwritten();
+		return count;
+	}
+
+	inline
+		void Profiler::Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& thread : threads)
+			thread->count.store(0, std::memory_order_release);
+		frames = 0;
+		lastFrame = -1;
+	}
+
+	inline
+		bool Profiler::WriteChromeTrace(const std::string& filepath) const
+	{
+		std::ofstream file(filepath, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		auto escaped = [](const std::string& text)
+		{
+			std::string out;
+			for (char c : text)
+			{
+				if (c == '"' || c == '\\')
+					out += '\\';
+				out += c;
+			}
+			return out;
+		};
+
+		const double usPerTick = NanosecondsPerTick() * 1e-3;
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t dropped = 0;
+		for (const auto& thread : threads)
+			dropped += thread->Overwritten();
+		file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":\"" << dropped << "\"},\"traceEvents\":[";
+		bool first = true;
+		char number[64];
+		for (const auto& thread : threads)
+		{
+			file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->thread
+				<< ",\"args\":{\"name\":\"" << escaped(thread->name) << "\"}}";
+			first = false;
+			thread->ForEach([&](const profiler::ZoneEvent& event)
+				{
+					//complete events, microseconds with the nanoseconds kept as decimals
+					snprintf(number, sizeof(number), "\"ts\":%.3f,\"dur\":%.3f", (event.start - startTicks) * usPerTick, (event.end - event.start) * usPerTick);
+					file << ",\n{\"name\":\"" << escaped(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->thread << "," << number << "}";
+				});
+		}
+		file << "\n]}\n";
+		return file.good();
+	}
+}
+
+#if DXH_PROFILE
+#define DXH_PROFILE_JOIN2(a, b) a##b
+#define DXH_PROFILE_JOIN(a, b) DXH_PROFILE_JOIN2(a, b)
+#define PROFILE_ZONE(name) util::ProfileZone DXH_PROFILE_JOIN(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_FRAME() util::Profiler::Get().FrameMark()
+#define PROFILE_THREAD(name) util::Profiler::Get().SetThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
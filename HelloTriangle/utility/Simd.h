@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../pch.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DXH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define DXH_X86 0
+#endif
+
+//GCC and Clang only emit SIMD instructions in functions that ask for them, MSVC always does
+#if DXH_X86 && (defined(__GNUC__) || defined(__clang__))
+#define DXH_TARGET_SSE __attribute__((target("sse2")))
+#define DXH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define DXH_TARGET_SSE
+#define DXH_TARGET_AVX2
+#endif
+
+namespace util
+{
+#if DXH_X86
+	inline
+		bool CpuHasSSE2()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return true;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	inline
+		bool CpuHasAVX2() //AVX2 and FMA, with the OS saving the ymm registers
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!fma || !osxsave || !avx)
+			return false;
+		if ((_xgetbv(0) & 0x6) != 0x6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+#else
+	inline bool CpuHasSSE2() { return false; }
+	inline bool CpuHasAVX2() { return false; }
+#endif
+
+	//std::vector allocator for SIMD streams, Alignment must be a power of two
+	template<typename T, size_t Alignment = 32>
+	class AlignedAllocator
+	{
+	public:
+		typedef T value_type;
+		template<typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+		AlignedAllocator() noexcept {}
+		template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+		T* allocate(size_t n)
+		{
+			//over-allocate and keep the offset to the real block right in front of the aligned pointer
+			void* raw = ::operator new(n * sizeof(T) + Alignment + sizeof(void*));
+			uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + Alignment - 1) & ~(uintptr_t(Alignment) - 1);
+			reinterpret_cast<void**>(aligned)[-1] = raw;
+			return reinterpret_cast<T*>(aligned);
+		}
+		void deallocate(T* p, size_t) noexcept
+		{
+			if (p)
+				::operator delete(reinterpret_cast<void**>(p)[-1]);
+		}
+		template<typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+		template<typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+	};
+
+	template<typename T, size_t Alignment = 32>
+	using aligned_vector = std::vector<T, AlignedAllocator<T, Alignment>>;
+}
@@ -2,6 +2,10 @@
 
 #include "../pch.h"
 
+#if !(defined(_WIN32) || defined(_WIN64))
+#include <dirent.h>
+#endif
+
 namespace util
 {
 	//USED
@@ -21,7 +25,7 @@ namespace util
 		}
 		const float Delta()
 		{
-			const std::chrono::steady_clock::time_point now = std::chrono::high_resolution_clock::now();
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 			delta = now - last;
 			last = now;
 			lastdelta = delta.count();
@@ -33,15 +37,20 @@ namespace util
 		}
 		void Restart()
 		{
-			start = std::chrono::high_resolution_clock::now();
+			start = std::chrono::steady_clock::now();
 			last = start;
 		}
 		const float GetElapsed()const
 		{
-			std::chrono::steady_clock::time_point now = std::chrono::high_resolution_clock::now();
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 			std::chrono::duration<float> elapsed = now - start;
 			return elapsed.count();
 		}
+		const double GetElapsedPrecise()const //float loses sub-millisecond precision after a few hours
+		{
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			return elapsed.count();
+		}
 	};
 
 
@@ -63,7 +72,64 @@ namespace util
 			name.c_str(),
 			NULL);
 	}
+
+	//non fatal notes for the developer, shown in the debugger output window
+	inline
+		void DebugLog(const std::string& message)
+	{
+		OutputDebugStringA((message + "\n").c_str());
+	}
+#else
+	//headless builds have no message boxes, errors go to stderr
+	inline
+		void ErrorMessageBox(std::string message, std::string boxname = "error")
+	{
+		std::cerr << boxname << ": " << message << std::endl;
+	}
+
+	inline
+		void DebugLog(const std::string& message)
+	{
+		std::cerr << message << std::endl;
+	}
 #endif
+
+	//files directly in directory whose names end with extension (case sensitive), sorted
+	inline
+		std::vector<std::string> ListFiles(const std::string& directory, const std::string& extension)
+	{
+		std::vector<std::string> files;
+		auto matches = [&extension](const std::string& name)
+		{
+			return name.size() >= extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+		};
+#if defined(_WIN32) || defined(_WIN64)
+		WIN32_FIND_DATAA found;
+		HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &found);
+		if (find == INVALID_HANDLE_VALUE)
+			return files;
+		do
+		{
+			if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && matches(found.cFileName))
+				files.push_back(directory + "\\" + found.cFileName);
+		} while (FindNextFileA(find, &found));
+		FindClose(find);
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (dir == nullptr)
+			return files;
+		while (dirent* entry = readdir(dir))
+		{
+			const std::string name = entry->d_name;
+			if (name != "." && name != ".." && matches(name))
+				files.push_back(directory + "/" + name);
+		}
+		closedir(dir);
+#endif
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
 #if 0
 	inline
 		const std::string ReadFileAsString(const char* filepath) //puts every line in the strign
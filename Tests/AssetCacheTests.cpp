@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "AssetCache.h"
+
+TEST(AssetCacheInvalidateDetachesInFlightDecode)
+{
+	std::atomic<int> decodes{ 0 };
+	std::atomic<bool> firstStarted{ false }, releaseFirst{ false };
+	dxh::AssetCache cache([&](const std::string&, const dxh::ImageLoadOptions&, dxh::ImageData& target)
+	{
+		// The first decode reads the file before it changes and is held until after Invalidate
+		const int version = ++decodes;
+		if (version == 1)
+		{
+			firstStarted = true;
+			while (!releaseFirst)
+				std::this_thread::yield();
+		}
+		target = dxh::ImageData(1, 1, 4);
+		target.data.assign(4, static_cast<unsigned char>(version));
+		return true;
+	});
+
+	dxh::ImageHandle old;
+	std::thread first([&]() { old = cache.Get("texture.png"); });
+	while (!firstStarted)
+		std::this_thread::yield();
+
+	// Nothing was cached yet, the detached decode is not counted
+	CHECK(cache.Invalidate("texture.png") == 0);
+	// Does not wait for the detached decode, it reads the file again
+	dxh::ImageHandle fresh = cache.Get("texture.png");
+	CHECK(fresh && fresh->data[0] == 2);
+
+	releaseFirst = true;
+	first.join();
+	CHECK(old && old->data[0] == 1);
+	// The stale image did not replace the new one
+	dxh::ImageHandle cached = cache.Get("texture.png");
+	CHECK(cached == fresh);
+	CHECK(decodes == 2);
+}
+
+TEST(AssetCacheInvalidateCountsCachedImages)
+{
+	dxh::AssetCache cache([](const std::string&, const dxh::ImageLoadOptions& options, dxh::ImageData& target)
+	{
+		target = dxh::ImageData(1, 1, options.channels);
+		target.data.assign(options.channels, 0);
+		return true;
+	});
+	dxh::ImageLoadOptions gray;
+	gray.channels = 1;
+	cache.Get("a.png");
+	cache.Get("a.png", gray);
+	cache.Get("b.png");
+	// Every option variant of the path goes, other paths stay
+	CHECK(cache.Invalidate("a.png") == 2);
+	CHECK(!cache.Contains("a.png") && !cache.Contains("a.png", gray));
+	CHECK(cache.Contains("b.png"));
+	CHECK(cache.Invalidate("a.png") == 0);
+}
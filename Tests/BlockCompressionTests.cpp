@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "BlockCompression.h"
+
+namespace
+{
+	// Smooth color and alpha gradients with a soft wave, like a photo rather than noise
+	dxh::ImageData Gradient(int width, int height)
+	{
+		dxh::ImageData image(width, height, 4);
+		image.data.resize(size_t(width) * height * 4);
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+			{
+				unsigned char* p = &image.data[(size_t(y) * width + x) * 4];
+				const float wave = 0.5f + 0.5f * std::sin(x * 0.2f) * std::cos(y * 0.15f);
+				p[0] = static_cast<unsigned char>(255.0f * x / (width - 1));
+				p[1] = static_cast<unsigned char>(255.0f * y / (height - 1));
+				p[2] = static_cast<unsigned char>(255.0f * wave);
+				p[3] = static_cast<unsigned char>(255.0f * (1.0f - wave * 0.5f) * x / (width - 1));
+			}
+		return image;
+	}
+
+	struct Floor
+	{
+		dxh::BlockFormat format;
+		float rgb;
+		float alpha;	//0 where the format has no alpha
+	};
+	// A little under what the encoder reaches on the gradients at Normal quality
+	const Floor FLOORS[] = { { dxh::BlockFormat::BC1, 28.0f, 0.0f }, { dxh::BlockFormat::BC3, 28.0f, 40.0f }, { dxh::BlockFormat::BC7, 29.0f, 31.0f } };
+
+	const char* FormatName(dxh::BlockFormat format)
+	{
+		return format == dxh::BlockFormat::BC1 ? "BC1" : format == dxh::BlockFormat::BC3 ? "BC3" : "BC7";
+	}
+}
+
+TEST(BlockCompressionRoundTripPSNR)
+{
+	// 30x18 leaves partial blocks at the right and bottom edge
+	for (const dxh::ImageData& image : { Gradient(64, 64), Gradient(30, 18) })
+		for (const Floor& floor : FLOORS)
+		{
+			dxh::CompressedImage compressed;
+			CHECK(dxh::CompressImage(image, compressed, floor.format, dxh::CompressionQuality::Normal, 1));
+			CHECK(compressed.data.size() == size_t((image.width + 3) / 4) * ((image.height + 3) / 4) * dxh::BlockBytes(floor.format));
+			dxh::ImageData decoded;
+			CHECK(dxh::DecompressImage(compressed, decoded));
+			CHECK(decoded.width == image.width && decoded.height == image.height && decoded.channels == 4);
+			CHECK(dxh::PSNR(image, decoded) >= floor.rgb);
+			if (floor.alpha > 0.0f)
+				CHECK(dxh::PSNR(image, decoded, true) >= floor.alpha);
+		}
+}
+
+TEST(BlockCompressionDecodesFlatBlocksExactly)
+{
+	// Exact in 565 and, all channels odd, with a p-bit of 1 in BC7 mode 6
+	dxh::ImageData image(8, 8, 4);
+	for (int i = 0; i < 64; ++i)
+		image.data.insert(image.data.end(), { 255, 85, 255, 255 });
+	for (const Floor& floor : FLOORS)
+	{
+		dxh::CompressedImage compressed;
+		dxh::ImageData decoded;
+		CHECK(dxh::CompressImage(image, compressed, floor.format, dxh::CompressionQuality::Fast, 1));
+		CHECK(dxh::DecompressImage(compressed, decoded));
+		CHECK(std::isinf(dxh::PSNR(image, decoded)));
+	}
+}
+
+BENCHMARK(BlockCompressionThroughput)
+{
+	const dxh::ImageData image = Gradient(1024, 1024);
+	for (const Floor& floor : FLOORS)
+	{
+		const dxh::BlockCompressionStats stats = dxh::TestBlockCompression(image, floor.format);
+		std::cout << FormatName(floor.format) << ": " << stats.megapixelsPerSecond << " MP/s, ratio " << stats.compressionRatio
+			<< ", PSNR rgb " << stats.psnrRGB << " dB, alpha " << stats.psnrAlpha << " dB\n";
+		CHECK(stats.psnrRGB >= floor.rgb);
+	}
+}
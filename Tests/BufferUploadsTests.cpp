@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "BufferUploads.h"
+
+TEST(UploadsNothingWhenNothingIsDirty)
+{
+	dxh::UploadTracker tracker;
+	const float initial[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	const dxh::BlockId block = tracker.Add(sizeof(initial), dxh::UploadMode::Whole, initial);
+	dxh::NullUploadDevice device;
+	CHECK(tracker.Flush(device) == sizeof(initial)); //new blocks start dirty
+	CHECK(!tracker.Dirty(block));
+
+	device.Reset();
+	CHECK(!tracker.Write(block, initial, sizeof(initial))); //same bytes
+	CHECK(tracker.Flush(device) == 0);
+	CHECK(device.writes.empty());
+	CHECK(tracker.GetStats().unchangedWrites == 1);
+}
+
+TEST(UploadsOneMapPerDirtyWholeBlock)
+{
+	dxh::UploadTracker tracker;
+	std::vector<dxh::BlockId> blocks;
+	for (int i = 0; i < 4; ++i)
+		blocks.push_back(tracker.Add(256, dxh::UploadMode::Whole));
+	dxh::NullUploadDevice device;
+	tracker.Flush(device);
+	device.Reset();
+
+	// Several writes into two of the blocks, each goes up whole and once
+	const unsigned char one = 1, two = 2;
+	tracker.Write(blocks[1], &one, 1, 0);
+	tracker.Write(blocks[1], &two, 1, 200);
+	tracker.Write(blocks[3], &one, 1, 17);
+	CHECK(tracker.Flush(device) == 512);
+	CHECK(device.writes.size() == 2);
+	for (const dxh::NullUploadDevice::Write& write : device.writes)
+		CHECK(write.offset == 0 && write.bytes == 256 && (write.block == blocks[1] || write.block == blocks[3]));
+	CHECK(tracker.GetStats().lastFrameUploads == 2);
+}
+
+TEST(UploadsMergeCloseDirtyRanges)
+{
+	const size_t size = 64 * 1024;
+	dxh::UploadTracker tracker;
+	const dxh::BlockId block = tracker.Add(size, dxh::UploadMode::Ranges);
+	dxh::NullUploadDevice device;
+	tracker.Flush(device);
+	device.Reset();
+
+	// Within MERGE_GAP of each other: one range from the first to the last changed byte
+	const unsigned char value = 7;
+	tracker.Write(block, &value, 1, 1000);
+	tracker.Write(block, &value, 1, 1000 + dxh::UploadTracker::MERGE_GAP);
+	// Far away: its own range
+	tracker.Write(block, &value, 1, 40000);
+	tracker.Flush(device);
+	CHECK(device.writes.size() == 2);
+	if (device.writes.size() == 2)
+	{
+		CHECK(device.writes[0].offset == 1000 && device.writes[0].bytes == dxh::UploadTracker::MERGE_GAP + 1);
+		CHECK(device.writes[1].offset == 40000 && device.writes[1].bytes == 1);
+	}
+
+	// A write narrows down to the bytes that differ
+	device.Reset();
+	std::vector<unsigned char> span(100, 0);
+	span[40] = 9;
+	tracker.Write(block, span.data(), span.size(), 20000);
+	tracker.Flush(device);
+	CHECK(device.writes.size() == 1 && device.writes[0].offset == 20040 && device.writes[0].bytes == 1);
+
+	// More separate ranges than MAX_RANGES are merged down to it
+	device.Reset();
+	for (size_t i = 0; i < 2 * dxh::UploadTracker::MAX_RANGES; ++i)
+		tracker.Write(block, &value, 1, i * 1024 + 3);
+	tracker.Flush(device);
+	CHECK(device.writes.size() == dxh::UploadTracker::MAX_RANGES);
+}
+
+TEST(UploadsStayDirtyWhenTheDeviceFails)
+{
+	dxh::UploadTracker tracker;
+	const dxh::BlockId block = tracker.Add(64, dxh::UploadMode::Ranges);
+	dxh::NullUploadDevice device;
+	device.fail = true;
+	CHECK(tracker.Flush(device) == 0);
+	CHECK(tracker.Dirty(block));
+
+	device.fail = false;
+	CHECK(tracker.Flush(device) == 64);
+	CHECK(!tracker.Dirty(block));
+	CHECK(tracker.Flush(device) == 0);
+}
+
+TEST(UploadBenchmarkRuns)
+{
+	const dxh::UploadBenchmark result = dxh::BenchmarkUploads(200, 0.05f, 4);
+	CHECK(result.moving == 10);
+	// Only the movers' matrices go up after the first frame
+	CHECK(result.trackedUploadsPerFrame == result.moving);
+	CHECK(result.trackedBytesPerFrame < result.naiveBytesPerFrame);
+}
+
+BENCHMARK(UploadBytesPerFrame)
+{
+	const dxh::UploadBenchmark result = dxh::BenchmarkUploads();
+	std::cout << result.objects << " objects, " << result.moving << " moving: naive " << result.naiveBytesPerFrame << " bytes per frame, tracked "
+		<< result.trackedBytesPerFrame << " bytes in " << result.trackedUploadsPerFrame << " uploads, " << result.trackedMsPerFrame << " ms CPU\n";
+	CHECK(result.trackedBytesPerFrame < result.naiveBytesPerFrame);
+}
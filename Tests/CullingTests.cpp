@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "FrustumCulling.h"
+#include "SceneBVH.h"
+
+namespace
+{
+	// 90 degree vertical field of view looking down +z from the origin, wider than high like the window
+	dxh::Frustum CameraFrustum()
+	{
+		const float zn = 0.1f, zf = 100.0f, q = zf / (zf - zn);
+		return dxh::ExtractFrustum(DirectX::XMFLOAT4X4(
+			0.75f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, q, -zn * q,
+			0.0f, 0.0f, 1.0f, 0.0f));
+	}
+
+	// Boxes of different sizes in a cube around the camera, plenty of them across the planes
+	void ScatterBounds(dxh::BoundsList& bounds, size_t count, uint32_t seed)
+	{
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) * (1.0f / 16777216.0f); };
+		bounds.Resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			dxh::Bounds b;
+			b.center = dxh::float3(random() * 240.0f - 120.0f, random() * 240.0f - 120.0f, random() * 240.0f - 120.0f);
+			const dxh::float3 half(0.1f + random() * 4.0f, 0.1f + random() * 4.0f, 0.1f + random() * 4.0f);
+			b.min = b.center - half;
+			b.max = b.center + half;
+			b.radius = std::sqrt(half.x * half.x + half.y * half.y + half.z * half.z);
+			bounds.Set(i, b);
+		}
+	}
+
+	// The same objects through the plain scalar loop, one thread
+	std::vector<UINT> Reference(const dxh::Frustum& frustum, const dxh::BoundsList& bounds)
+	{
+		std::vector<UINT> visible;
+		dxh::CullObjects(frustum, bounds.Streams(), visible, dxh::CullKernel::Scalar, 1);
+		return visible;
+	}
+}
+
+TEST(CullSimdMatchesScalar)
+{
+	const dxh::Frustum frustum = CameraFrustum();
+	// Tails of the 4 and 8 wide kernels, and enough objects for several CULL_GRAIN jobs
+	const size_t counts[] = { 1, 3, 7, 9, 17, 1021, 3 * dxh::CULL_GRAIN + 5 };
+	for (size_t count : counts)
+	{
+		dxh::BoundsList bounds;
+		ScatterBounds(bounds, count, static_cast<uint32_t>(count));
+		const std::vector<UINT> reference = Reference(frustum, bounds);
+		for (dxh::CullKernel kernel : { dxh::CullKernel::Scalar, dxh::CullKernel::SSE, dxh::CullKernel::AVX2 })
+		{
+			if (!dxh::CullKernelSupported(kernel))
+				continue;
+			for (unsigned int threads : { 1u, 0u })
+			{
+				std::vector<UINT> visible;
+				CHECK(dxh::CullObjects(frustum, bounds.Streams(), visible, kernel, threads) == reference.size());
+				CHECK(visible == reference);
+			}
+		}
+	}
+}
+
+TEST(CullBenchmarkRuns)
+{
+	const dxh::CullBenchmark result = dxh::BenchmarkCulling(4096, 1);
+	CHECK(result.objects == 4096);
+	CHECK(result.visible > 0 && result.visible < result.objects);
+	CHECK(dxh::CullKernelSupported(result.kernel));
+}
+
+TEST(BVHFrustumMatchesLinearCull)
+{
+	const dxh::Frustum frustum = CameraFrustum();
+	dxh::BoundsList bounds;
+	ScatterBounds(bounds, 20000, 777u);
+	dxh::SceneBVH bvh;
+	bvh.Build(bounds.Streams());
+	CHECK(bvh.Count() == 20000);
+
+	// Tree order, sorted it has to be the flat list
+	std::vector<UINT> visible;
+	bvh.QueryFrustum(frustum, visible);
+	std::sort(visible.begin(), visible.end());
+	CHECK(visible == Reference(frustum, bounds));
+
+	// Moved objects after a refit, the tree is kept and only the boxes grow
+	dxh::BoundsList moved;
+	ScatterBounds(moved, 20000, 778u);
+	bvh.Refit(moved.Streams());
+	bvh.QueryFrustum(frustum, visible);
+	std::sort(visible.begin(), visible.end());
+	CHECK(visible == Reference(frustum, moved));
+}
+
+TEST(BVHBenchmarkRuns)
+{
+	const dxh::BVHBenchmark result = dxh::BenchmarkBVH(5000, 4);
+	CHECK(result.objects == 5000);
+	CHECK(result.visible > 0 && result.visible < result.objects);
+}
@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "FileBlob.h"
+
+namespace
+{
+	void WriteBytes(const std::string& path, size_t size)
+	{
+		std::vector<char> bytes(size);
+		for (size_t i = 0; i < size; ++i)
+			bytes[i] = static_cast<char>(i * 31 + i / 4096);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(bytes.data(), bytes.size());
+	}
+}
+
+TEST(FileBlobMappedAndReadAgree)
+{
+	const std::string path = "fileblob_test.bin";
+	WriteBytes(path, 100000);
+	util::FileBlob mapped(path), read(path, false);
+	CHECK(mapped.IsOpen() && read.IsOpen());
+	CHECK(!read.IsMapped());
+	CHECK(mapped.Size() == 100000 && read.Size() == 100000);
+	CHECK(std::equal(mapped.Span().begin(), mapped.Span().end(), read.Data()));
+	CHECK(mapped.Span()[4097] == static_cast<unsigned char>(4097 * 31 + 1));
+
+	// Copies share the bytes and keep them alive after the original is closed
+	util::FileBlob copy = mapped;
+	const unsigned char* data = mapped.Data();
+	mapped.Close();
+	CHECK(!mapped.IsOpen() && mapped.Data() == nullptr);
+	CHECK(copy.Data() == data && copy.Size() == 100000);
+	copy.Close();
+	std::remove(path.c_str());
+}
+
+TEST(FileBlobEmptyAndMissingFiles)
+{
+	const std::string path = "fileblob_empty.bin";
+	WriteBytes(path, 0);
+	for (bool mapping : { true, false })
+	{
+		util::FileBlob empty(path, mapping);
+		CHECK(empty.IsOpen());
+		CHECK(empty.Size() == 0 && empty.Data() == nullptr && empty.Span().empty());
+	}
+	std::remove(path.c_str());
+
+	util::FileBlob missing;
+	CHECK(!missing.Open("fileblob_missing.bin"));
+	CHECK(!missing.IsOpen() && missing.Size() == 0);
+}
+
+BENCHMARK(FileBlobReads)
+{
+	// Warm page cache, the file was just written
+	const std::string path = "fileblob_benchmark.bin";
+	WriteBytes(path, size_t(64) << 20);
+	const util::FileBlobBenchmark result = util::BenchmarkFileBlob(path);
+	std::cout << result.bytes << " bytes (ms per read): stream " << result.streamSeconds * 1000.0f << ", mapped blob "
+		<< result.blobSeconds * 1000.0f << ", bulk read " << result.readSeconds * 1000.0f << "\n";
+	CHECK(result.bytes == size_t(64) << 20);
+	std::remove(path.c_str());
+}
@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "FrameScheduler.h"
+
+namespace
+{
+	// Time only moves when the test or the scheduler advances it. Sleeps overshoot like the OS does.
+	class FakeClock : public util::Clock
+	{
+	public:
+		double now = 10.0;
+		double oversleep = 0.0;
+		size_t sleeps = 0, pauses = 0;
+
+		double Now() override { return now; }
+		void SleepFor(double seconds) override { now += seconds + oversleep; ++sleeps; }
+		void Pause() override { now += 0.00001; ++pauses; }
+	};
+
+	const double STEP = 1.0 / 64.0; // exact in binary, so step counts do not depend on rounding
+}
+
+TEST(SchedulerAccumulatesFixedSteps)
+{
+	FakeClock clock;
+	util::FrameScheduler scheduler(clock, 0.0, 64.0);
+	util::FrameTiming frame = scheduler.BeginFrame();
+	CHECK(frame.steps == 0);
+	CHECK(frame.delta == 0.0f);
+
+	clock.now += STEP * 2;
+	frame = scheduler.BeginFrame();
+	CHECK(frame.steps == 2);
+	CHECK(frame.interpolation == 0.0f);
+	CHECK_NEAR(frame.delta, STEP * 2, 1e-6);
+
+	// Half a step is not enough to simulate, it is rendered halfway between the states
+	clock.now += STEP / 2;
+	frame = scheduler.BeginFrame();
+	CHECK(frame.steps == 0);
+	CHECK_NEAR(frame.interpolation, 0.5f, 1e-6f);
+
+	clock.now += STEP * 3 / 4;
+	frame = scheduler.BeginFrame();
+	CHECK(frame.steps == 1);
+	CHECK_NEAR(frame.interpolation, 0.25f, 1e-6f);
+	CHECK(clock.sleeps == 0 && clock.pauses == 0);
+}
+
+TEST(SchedulerClampsLongFrames)
+{
+	FakeClock clock;
+	util::FrameScheduler scheduler(clock, 0.0, 64.0);
+	scheduler.BeginFrame();
+	// A breakpoint: the delta is honest but only maxDelta of it is simulated
+	clock.now += 5.0;
+	util::FrameTiming frame = scheduler.BeginFrame();
+	CHECK_NEAR(frame.delta, 5.0f, 1e-6f);
+	CHECK(frame.steps == 16);
+	CHECK(frame.interpolation == 0.0f);
+
+	scheduler.SetMaxDelta(STEP * 4);
+	clock.now += 1.0;
+	frame = scheduler.BeginFrame();
+	CHECK(frame.steps == 4);
+}
+
+TEST(SchedulerPacesWithoutDrift)
+{
+	FakeClock clock;
+	clock.oversleep = 0.0015;
+	util::FrameScheduler scheduler(clock, 64.0, 64.0);
+	const double first = scheduler.BeginFrame().time;
+	util::FrameTiming frame;
+	for (int i = 0; i < 100; ++i)
+	{
+		clock.now += 0.004; // the frame's work
+		frame = scheduler.BeginFrame();
+		CHECK(frame.steps == 1);
+	}
+	// Each wait slept until the spin margin (the oversleep fits in it) and spun the rest
+	CHECK(clock.sleeps == 100);
+	CHECK_NEAR(frame.time, first + 100 * STEP, 0.0001);
+
+	// A frame that runs late starts a new schedule instead of rushing the next ones
+	clock.now += STEP * 3;
+	const double late = scheduler.BeginFrame().time;
+	frame = scheduler.BeginFrame();
+	CHECK_NEAR(frame.time, late + STEP, 0.0001);
+}
+
+TEST(SchedulerJitterStats)
+{
+	FakeClock clock;
+	util::FrameScheduler uncapped(clock, 0.0, 64.0);
+	CHECK(uncapped.GetJitter().frames == 0);
+	uncapped.BeginFrame();
+	// Alternating 10 and 20 ms: mean 15, every frame 5 ms from it
+	for (int i = 0; i < 100; ++i)
+	{
+		clock.now += i % 2 ? 0.020 : 0.010;
+		uncapped.BeginFrame();
+	}
+	util::FrameJitter jitter = uncapped.GetJitter();
+	CHECK(jitter.frames == 100);
+	CHECK_NEAR(jitter.meanMs, 15.0f, 0.001f);
+	CHECK_NEAR(jitter.stddevMs, 5.0f, 0.001f);
+	CHECK_NEAR(jitter.p99DeviationMs, 5.0f, 0.001f);
+	CHECK_NEAR(jitter.maxDeviationMs, 5.0f, 0.001f);
+
+	// Capped deviations are measured from the target interval. One slow frame, and the short one
+	// after it that gets back on schedule, show up in the max but not in the p99.
+	util::FrameScheduler capped(clock, 64.0, 64.0);
+	capped.BeginFrame();
+	for (int i = 0; i < 1000; ++i)
+	{
+		clock.now += i == 500 ? STEP + 0.008 : 0.004;
+		capped.BeginFrame();
+	}
+	jitter = capped.GetJitter();
+	CHECK(jitter.frames == 1000);
+	CHECK(jitter.p99DeviationMs < 0.1f);
+	CHECK_NEAR(jitter.maxDeviationMs, 8.0f, 0.1f);
+
+	// Only the last JITTER_WINDOW frames count
+	for (size_t i = 0; i < util::FrameScheduler::JITTER_WINDOW; ++i)
+		capped.BeginFrame();
+	CHECK(capped.GetJitter().frames == util::FrameScheduler::JITTER_WINDOW);
+	CHECK(capped.GetJitter().maxDeviationMs < 0.1f);
+}
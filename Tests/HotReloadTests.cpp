@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "HotReload.h"
+
+namespace
+{
+	// Records reloads instead of recreating device objects
+	class RecordingTarget : public dxh::ReloadTarget
+	{
+	public:
+		std::vector<std::pair<dxh::AssetKind, std::string>> reloads;
+		bool accept = true;
+
+		bool ReloadAsset(dxh::AssetKind kind, const std::string& path) override
+		{
+			reloads.emplace_back(kind, path);
+			return accept;
+		}
+	};
+
+	void WriteFile(const std::string& path, const std::string& contents)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << contents;
+	}
+}
+
+TEST(ReloadQueueDebounces)
+{
+	dxh::ReloadQueue queue(0.2f);
+	std::vector<std::string> ready;
+	queue.Notify("a.cso", 1.0f);
+	CHECK(queue.Collect(1.1f, ready) == 0);
+	CHECK(ready.empty());
+	CHECK(queue.Collect(1.2f, ready) == 1);
+	CHECK(ready.size() == 1 && ready[0] == "a.cso");
+	CHECK(queue.Pending() == 0);
+	CHECK(queue.Collect(5.0f, ready) == 0);
+}
+
+TEST(ReloadQueueCoalescesRepeatedChanges)
+{
+	dxh::ReloadQueue queue(0.2f);
+	std::vector<std::string> ready;
+	// A compiler writing the file in three steps: every write restarts the quiet period
+	queue.Notify("a.cso", 1.0f);
+	queue.Notify("a.cso", 1.15f);
+	queue.Notify("b.png", 1.2f);
+	queue.Notify("a.cso", 1.3f);
+	CHECK(queue.Pending() == 2);
+	CHECK(queue.Collect(1.45f, ready) == 1);
+	CHECK(ready.size() == 1 && ready[0] == "b.png");
+	CHECK(queue.Collect(1.5f, ready) == 1);
+	CHECK(ready.size() == 2 && ready[1] == "a.cso");
+	CHECK(queue.Pending() == 0);
+}
+
+TEST(HotReloaderDispatchesDebouncedChanges)
+{
+	RecordingTarget target;
+	dxh::HotReloader reloader(target, 0.2f, true);
+	CHECK(reloader.Watch("hotreload_test_shader.cso", dxh::AssetKind::Shader));
+	CHECK(reloader.Watch("hotreload_test_texture.png", dxh::AssetKind::Texture));
+
+	reloader.NotifyChanged("hotreload_test_shader.cso", 1.0f);
+	reloader.NotifyChanged("hotreload_test_shader.cso", 1.1f);
+	reloader.NotifyChanged("hotreload_test_texture.png", 1.1f);
+	reloader.NotifyChanged("unwatched.png", 1.1f);
+	CHECK(reloader.Update(1.2f) == 0);
+	CHECK(reloader.Update(1.4f) == 2);
+	CHECK(target.reloads.size() == 2);
+	bool shader = false, texture = false;
+	for (const auto& reload : target.reloads)
+	{
+		shader = shader || (reload.first == dxh::AssetKind::Shader && reload.second == "hotreload_test_shader.cso");
+		texture = texture || (reload.first == dxh::AssetKind::Texture && reload.second == "hotreload_test_texture.png");
+	}
+	CHECK(shader && texture);
+
+	// Refused reloads are counted, a path unwatched while debouncing is dropped
+	target.accept = false;
+	reloader.NotifyChanged("hotreload_test_shader.cso", 2.0f);
+	reloader.NotifyChanged("hotreload_test_texture.png", 2.0f);
+	reloader.Unwatch("hotreload_test_texture.png");
+	CHECK(reloader.Update(3.0f) == 0);
+	CHECK(target.reloads.size() == 3);
+	const dxh::HotReloadStats stats = reloader.GetStats();
+	CHECK(stats.changes == 5);
+	CHECK(stats.reloads == 2);
+	CHECK(stats.failures == 1);
+}
+
+TEST(HotReloaderSeesFileWrites)
+{
+	const std::string path = "hotreload_test_watched.cso";
+	WriteFile(path, "old");
+	for (bool polling : { true, false })
+	{
+		RecordingTarget target;
+		dxh::HotReloader reloader(target, 0.2f, polling);
+		CHECK(reloader.Watch(path, dxh::AssetKind::Shader));
+		CHECK(reloader.Update(0.0f) == 0);
+		WriteFile(path, polling ? "polled change" : "inotify change");
+		// The write is seen on the next poll and reloaded once it has been quiet for the debounce time
+		CHECK(reloader.Update(1.0f) == 0);
+		CHECK(reloader.GetStats().changes == 1);
+		CHECK(reloader.Update(1.25f) == 1);
+		CHECK(target.reloads.size() == 1 && target.reloads[0].second == path);
+		CHECK(reloader.Update(3.0f) == 0);
+	}
+	std::remove(path.c_str());
+}
@@ -0,0 +1,71 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "ImageLoader.h"
+
+namespace
+{
+	// 2x2 rgba png: red, green / blue, half transparent white
+	const unsigned char TINY_PNG[] = {
+		0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52,
+		0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x08, 0x06, 0x00, 0x00, 0x00, 0x72, 0xb6, 0x0d,
+		0x24, 0x00, 0x00, 0x00, 0x13, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0xf8, 0xcf, 0xc0, 0xf0,
+		0x1f, 0x0c, 0x81, 0x34, 0x08, 0x34, 0x00, 0x00, 0x49, 0x49, 0x09, 0x78, 0x9c, 0x51, 0x17, 0x92,
+		0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+
+	void WriteTinyPng(const std::string& path)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(TINY_PNG), sizeof(TINY_PNG));
+	}
+}
+
+TEST(ImageLoaderDecodesIntoThePool)
+{
+	const std::string path = "imageloader_test.png";
+	WriteTinyPng(path);
+	util::PoolAllocator pool;
+	ImageLoadRaw loader(pool);
+	{
+		dxh::ImageData image;
+		CHECK(loader.ImageFromFile(image, path.c_str()));
+		CHECK(image.width == 2 && image.height == 2 && image.channels == 4);
+		CHECK(image.data.empty() && image.ByteSize() == 16);
+		const unsigned char expected[16] = { 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255, 255, 255, 255, 128 };
+		CHECK(std::memcmp(image.Pixels(), expected, 16) == 0);
+		CHECK(pool.PeakBytesInUse() > 0);
+	}
+	// The first image gave its buffer back, the second decode reuses it
+	const size_t reuses = pool.Reuses();
+	dxh::ImageData flipped;
+	CHECK(loader.ImageFromFile(flipped, path.c_str(), 3, true));
+	CHECK(pool.Reuses() > reuses);
+	CHECK(flipped.channels == 3 && flipped.ByteSize() == 12);
+	const unsigned char bottomUp[12] = { 0, 0, 255, 255, 255, 255, 255, 0, 0, 0, 255, 0 };
+	CHECK(std::memcmp(flipped.Pixels(), bottomUp, 12) == 0);
+	std::remove(path.c_str());
+}
+
+TEST(ImageDirectoryBenchmarkCountsFiles)
+{
+	const char* paths[] = { "imageloader_dir_a.png", "imageloader_dir_b.png", "imageloader_dir_c.png" };
+	for (const char* path : paths)
+		WriteTinyPng(path);
+	const ImageLoadBenchmark result = BenchmarkImageDirectory(".");
+	// The working directory may hold other pngs, at least ours were decoded through the pool
+	CHECK(result.files >= 3);
+	CHECK(result.bytesDecoded >= 3 * 16);
+	CHECK(result.poolPeakBytes > 0);
+	CHECK(result.poolReuses > 0);
+	for (const char* path : paths)
+		std::remove(path);
+}
+
+BENCHMARK(ImageDirectoryLoad)
+{
+	// Relative to the Tests project directory, the debugger's default working directory
+	const ImageLoadBenchmark result = BenchmarkImageDirectory("../HelloTriangle/resources");
+	std::cout << result.files << " files, " << result.bytesDecoded << " bytes decoded in " << result.seconds * 1000.0f << " ms, peak RSS "
+		<< result.peakResidentBytes << " bytes, pool peak " << result.poolPeakBytes << " bytes, " << result.poolReuses << " reuses\n";
+	CHECK(result.files > 0);
+}
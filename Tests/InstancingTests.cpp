@@ -0,0 +1,72 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "Instancing.h"
+
+TEST(PlanDrawsOneInstancedDraw)
+{
+	std::vector<dxh::DrawCommand> draws;
+	dxh::PlanDraws(draws, 36, 1000, true);
+	CHECK(draws.size() == 1);
+	CHECK(draws[0].indexCount == 36 && draws[0].instanceCount == 1000 && draws[0].firstIndex == 0);
+
+	// Without instancing every copy is its own draw
+	dxh::PlanDraws(draws, 36, 1000, false);
+	CHECK(draws.size() == 1000);
+	bool single = true;
+	for (const dxh::DrawCommand& draw : draws)
+		single = single && draw.indexCount == 36 && draw.instanceCount == 1;
+	CHECK(single);
+
+	dxh::PlanDraws(draws, 36, 0, true);
+	CHECK(draws.empty());
+}
+
+TEST(BuildInstancesFillsEveryIndexOnce)
+{
+	std::vector<dxh::InstanceData> instances;
+	std::vector<std::atomic<int>> fills(10000);
+	dxh::BuildInstances(instances, fills.size(), [&fills](size_t i, dxh::InstanceData& instance)
+		{
+			++fills[i];
+			instance.tint = DirectX::XMFLOAT4(static_cast<float>(i), 0.0f, 0.0f, 1.0f);
+		}, 64, 4);
+	CHECK(instances.size() == fills.size());
+	bool once = true;
+	for (size_t i = 0; i < fills.size(); ++i)
+		once = once && fills[i] == 1 && instances[i].tint.x == static_cast<float>(i);
+	CHECK(once);
+}
+
+TEST(InstanceGridFillsTheUnitSquare)
+{
+	// 10 copies make a 4x4 grid with 0.5 spacing
+	std::vector<dxh::InstanceData> instances;
+	dxh::BuildInstanceGrid(instances, 10, 1);
+	CHECK(instances.size() == 10);
+	CHECK_NEAR(instances[0].world._14, -0.75f, 1e-6f);
+	CHECK_NEAR(instances[0].world._24, -0.75f, 1e-6f);
+	CHECK_NEAR(instances[5].world._14, -0.25f, 1e-6f);
+	CHECK_NEAR(instances[5].world._24, -0.25f, 1e-6f);
+
+	bool inside = true, tinted = true;
+	for (const dxh::InstanceData& instance : instances)
+	{
+		const DirectX::XMFLOAT4X4& m = instance.world;
+		inside = inside && m._11 == 0.4f && m._22 == 0.4f && m._33 == 0.4f && m._44 == 1.0f
+			&& std::abs(m._14) + m._11 / 2 <= 1.0f && std::abs(m._24) + m._22 / 2 <= 1.0f;
+		tinted = tinted && instance.tint.x >= 0.5f && instance.tint.x <= 1.0f && instance.tint.y >= 0.5f
+			&& instance.tint.y <= 1.0f && instance.tint.z >= 0.5f && instance.tint.z <= 1.0f && instance.tint.w == 1.0f;
+	}
+	CHECK(inside);
+	CHECK(tinted);
+}
+
+TEST(InstanceGridIsTheSameOnAnyThreadCount)
+{
+	std::vector<dxh::InstanceData> serial, threaded;
+	dxh::BuildInstanceGrid(serial, 20000, 1);
+	dxh::BuildInstanceGrid(threaded, 20000, 4);
+	CHECK(serial.size() == threaded.size());
+	CHECK(std::memcmp(serial.data(), threaded.data(), serial.size() * sizeof(dxh::InstanceData)) == 0);
+}
@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "JobSystem.h"
+
+TEST(WaitOutsidePoolSkipsUnrelatedJobs)
+{
+	util::JobSystem pool(2);
+	std::atomic<bool> started{ false }, release{ false };
+	util::JobCounter blocker;
+	// Keeps the only worker busy, so queued jobs can only be run by the waiting thread
+	pool.Run([&]()
+	{
+		started = true;
+		while (!release)
+			std::this_thread::yield();
+	}, &blocker);
+	while (!started)
+		std::this_thread::yield();
+
+	// A background job queued before the frame's parallel work, like a texture decode
+	std::atomic<bool> backgroundRan{ false };
+	util::JobCounter background;
+	pool.Run([&]() { backgroundRan = true; }, &background);
+
+	std::atomic<size_t> sum{ 0 };
+	pool.ParallelFor(64, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			sum += i;
+	});
+	CHECK(sum == 64 * 63 / 2);
+	CHECK(!backgroundRan);
+
+	release = true;
+	pool.Wait(blocker);
+	pool.Wait(background);
+	CHECK(backgroundRan);
+}
+
+TEST(WaitInsideJobRunsNestedWork)
+{
+	util::JobSystem pool(2);
+	util::JobCounter outer;
+	std::atomic<size_t> sum{ 0 };
+	pool.Run([&]()
+	{
+		pool.ParallelFor(1000, 10, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				sum += i;
+		});
+	}, &outer);
+	pool.Wait(outer);
+	CHECK(sum == 1000 * 999 / 2);
+}
+
+TEST(JobScalingCoversEveryPoolSize)
+{
+	// Doubling thread counts up to the maximum, which is always included
+	const std::vector<util::JobScaling> scaling = util::BenchmarkJobSystem(6, 1 << 10, 1);
+	CHECK(scaling.size() == 4);
+	if (scaling.size() != 4)
+		return;
+	CHECK(scaling[0].threads == 1 && scaling[1].threads == 2 && scaling[2].threads == 4 && scaling[3].threads == 6);
+	CHECK(scaling[0].speedup == 1.0f);
+	for (const util::JobScaling& s : scaling)
+		CHECK(s.ms >= 0.0f && s.ms < FLT_MAX);
+}
+
+BENCHMARK(JobSystemScaling)
+{
+	for (const util::JobScaling& s : util::BenchmarkJobSystem())
+		std::cout << s.threads << " threads: " << s.ms << " ms, " << s.speedup << "x\n";
+}
@@ -0,0 +1,86 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "Lighting.h"
+
+namespace
+{
+	const float LIGHTING_EPSILON = 1e-3f; //the SIMD kernels approximate pow with polynomial log2/exp2
+
+	struct Fragments
+	{
+		std::vector<float> in[9];	//pos, normal, texel
+		std::vector<float> out[3];
+
+		explicit Fragments(size_t count)
+		{
+			// Fixed seed, the same fragments every run
+			uint32_t state = 12345u;
+			auto next = [&state]() { state = state * 1664525u + 1013904223u; return (state >> 8) * (1.0f / 16777216.0f); };
+			for (int s = 0; s < 9; ++s)
+			{
+				in[s].resize(count);
+				for (float& v : in[s])
+					v = s < 6 ? next() * 2.0f - 1.0f : next();
+			}
+			for (std::vector<float>& s : out)
+				s.assign(count, -1.0f);
+		}
+
+		dxh::FragmentStreams Streams()
+		{
+			dxh::FragmentStreams frags;
+			for (int c = 0; c < 3; ++c)
+			{
+				frags.pos[c] = in[c].data();
+				frags.normal[c] = in[3 + c].data();
+				frags.texel[c] = in[6 + c].data();
+				frags.color[c] = out[c].data();
+			}
+			frags.count = out[0].size();
+			return frags;
+		}
+	};
+
+	void SetupScene(dxh::SimpleLight& light, dxh::SimpleMaterial& material)
+	{
+		light.pos = dxh::float4(-0.5f, 0.5f, -2.0f, 1.0f);
+		light.color = dxh::float4(1.0f, 0.9f, 0.8f, 1.0f);
+		light.viewpos = dxh::float3(0.0f, 0.0f, -1.0f);
+		material.ambi_col = dxh::float4(0.2f, 0.2f, 0.2f, 0.0f);
+		material.diff_col = dxh::float4(0.6f, 0.6f, 0.6f, 0.0f);
+		material.spec_col = dxh::float4(1.0f, 1.0f, 1.0f, 0.0f);
+		material.spec_factor = 32.0f;
+	}
+}
+
+TEST(LightingSimdMatchesScalar)
+{
+	dxh::SimpleLight light;
+	dxh::SimpleMaterial material;
+	SetupScene(light, material);
+
+	// Counts around and between the 4 and 8 wide steps, so the scalar tails run too
+	const size_t counts[] = { 1, 3, 4, 5, 7, 8, 9, 15, 17, 31, 1021 };
+	for (size_t count : counts)
+	{
+		Fragments reference(count);
+		dxh::ShadeFragmentsScalar(reference.Streams(), light, material);
+		for (dxh::LightingKernel kernel : { dxh::LightingKernel::SSE, dxh::LightingKernel::AVX2 })
+		{
+			if (!dxh::LightingKernelSupported(kernel))
+				continue;
+			Fragments simd(count);
+			dxh::GetLightingFunc(kernel)(simd.Streams(), light, material);
+			for (int c = 0; c < 3; ++c)
+				for (size_t i = 0; i < count; ++i)
+					CHECK_NEAR(simd.out[c][i], reference.out[c][i], LIGHTING_EPSILON);
+		}
+	}
+}
+
+TEST(LightingBestKernelIsSupported)
+{
+	CHECK(dxh::LightingKernelSupported(dxh::LightingKernel::Scalar));
+	CHECK(dxh::LightingKernelSupported(dxh::BestLightingKernel()));
+}
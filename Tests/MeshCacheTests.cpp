@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+
+namespace
+{
+	const char QUAD_OBJ[] =
+		"v -1 -1 0\n"
+		"v 1 -1 0\n"
+		"v 1 1 0\n"
+		"v -1 1 0\n"
+		"f 1 2 3\n"
+		"f 1 3 4\n";
+
+	void WriteFile(const std::string& path, const std::string& text)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << text;
+	}
+
+	// Rolling height field of size x size quads, curved enough that every LOD level has some error
+	std::string TerrainObj(int size)
+	{
+		std::ostringstream obj;
+		for (int z = 0; z <= size; ++z)
+			for (int x = 0; x <= size; ++x)
+				obj << "v " << x << " " << std::sin(x * 0.3f) * std::cos(z * 0.2f) * 2.0f << " " << z << "\n";
+		obj << "vn 0 1 0\n"; //one shared normal, so no vertex is split by a normal seam
+		for (int z = 0; z < size; ++z)
+			for (int x = 0; x < size; ++x)
+			{
+				const int corner = z * (size + 1) + x + 1; //OBJ counts from 1
+				obj << "f " << corner << "//1 " << corner + size + 1 << "//1 " << corner + 1 << "//1\n";
+				obj << "f " << corner + 1 << "//1 " << corner + size + 1 << "//1 " << corner + size + 2 << "//1\n";
+			}
+		return obj.str();
+	}
+}
+
+TEST(MeshCacheGoesStaleWithItsSource)
+{
+	const std::string obj = "meshcache_test.obj", cache = obj + ".dxhm";
+	WriteFile(obj, QUAD_OBJ);
+	CHECK(dxh::ConvertObjToMeshCache(obj, cache, 1));
+
+	dxh::MeshCache mapped;
+	CHECK(mapped.Open(cache, obj));
+	CHECK(mapped.Open(cache)); //without a source only the format is checked
+	mapped.Close();
+
+	// Edited after the conversion, the cache no longer describes it
+	WriteFile(obj, std::string(QUAD_OBJ) + "v 0 0 1\nf 1 2 5\n");
+	CHECK(!mapped.Open(cache, obj));
+	CHECK(mapped.Open(cache));
+	mapped.Close();
+	CHECK(!mapped.Open(cache, "meshcache_missing.obj"));
+
+	std::remove(obj.c_str());
+	std::remove(cache.c_str());
+}
+
+TEST(MeshCacheRoundTripsConvertedMesh)
+{
+	const std::string obj = "meshcache_roundtrip.obj", cache = obj + ".dxhm";
+	WriteFile(obj, TerrainObj(40));
+	CHECK(dxh::ConvertObjToMeshCache(obj, cache, 1));
+
+	// What DXHandler builds in memory when there is no cache
+	ObjLoader loader(1);
+	dxh::Mesh reference;
+	CHECK(loader.MeshFromFile(reference, obj.c_str()));
+	dxh::OptimizeMesh(reference);
+	dxh::LODChain lods;
+	dxh::BuildLODChain(reference, dxh::DefaultLODRatios(), lods);
+	dxh::PackLODs(lods, reference);
+	CHECK(lods.levels.size() > 2);
+
+	dxh::MeshCache mapped;
+	CHECK(mapped.Open(cache, obj));
+	if (!mapped.IsOpen())
+		return;
+	// The blobs are what CreateBuffers hands to the device
+	CHECK(mapped.VertexCount() == reference.vertices.size());
+	CHECK(mapped.ByteWidth() == reference.ByteWidth());
+	CHECK(memcmp(mapped.Vertices(), reference.vertices.data(), reference.ByteWidth()) == 0);
+	CHECK(mapped.ShortIndices() == reference.ShortIndices());
+	CHECK(mapped.IndexCount() == reference.indices.size());
+	for (UINT i = 0; i < mapped.IndexCount(); ++i)
+	{
+		const UINT index = mapped.ShortIndices() ? static_cast<const uint16_t*>(mapped.Indices())[i] : static_cast<const UINT*>(mapped.Indices())[i];
+		if (index != reference.indices[i])
+		{
+			CHECK(index == reference.indices[i]);
+			break;
+		}
+	}
+
+	dxh::LODChain cached;
+	mapped.ToLODChain(cached);
+	CHECK(cached.levels.size() == lods.levels.size());
+	for (size_t i = 0; i < std::min(cached.levels.size(), lods.levels.size()); ++i)
+	{
+		CHECK(cached.levels[i].firstIndex == lods.levels[i].firstIndex);
+		CHECK(cached.levels[i].indexCount == lods.levels[i].indexCount);
+		CHECK(cached.levels[i].error == lods.levels[i].error);
+		CHECK(cached.levels[i].ratio == lods.levels[i].ratio);
+	}
+
+	const dxh::Bounds bounds = mapped.GetBounds();
+	CHECK(bounds.min == reference.bounds.min);
+	CHECK(bounds.max == reference.bounds.max);
+	CHECK_NEAR(bounds.radius, reference.bounds.radius, 1e-4);
+
+	dxh::Mesh copy;
+	mapped.ToMesh(copy);
+	CHECK(copy.indices == reference.indices);
+	mapped.Close();
+
+	std::remove(obj.c_str());
+	std::remove(cache.c_str());
+}
+
+BENCHMARK(MeshCacheLoadTimes)
+{
+	const std::string obj = "meshcache_benchmark.obj", cache = obj + ".dxhm";
+	WriteFile(obj, TerrainObj(400));
+	CHECK(dxh::ConvertObjToMeshCache(obj, cache));
+	const dxh::MeshCacheTimings t = dxh::BenchmarkMeshCache(obj, cache);
+	std::cout << "OBJ " << t.objBytes << " bytes: cold " << t.objCold << " ms, warm " << t.objWarm << " ms\n"
+		<< "cache " << t.cacheBytes << " bytes: cold " << t.cacheCold << " ms, warm " << t.cacheWarm << " ms\n";
+	CHECK(t.cacheBytes > 0);
+	std::remove(obj.c_str());
+	std::remove(cache.c_str());
+}
@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "MeshOptimizer.h"
+
+namespace
+{
+	// side x side quads on the xy plane at offset, triangles in a fixed pseudo random order
+	void AddGrid(dxh::Mesh& mesh, UINT side, float offset, uint32_t seed)
+	{
+		const UINT first = static_cast<UINT>(mesh.vertices.size());
+		for (UINT y = 0; y <= side; ++y)
+			for (UINT x = 0; x <= side; ++x)
+				mesh.vertices.push_back(dxh::Vertex(dxh::float3(offset + float(x), float(y), 0.0f), dxh::float3(0.0f, 0.0f, -1.0f), dxh::float2(float(x) / side, float(y) / side)));
+		std::vector<UINT> indices;
+		for (UINT y = 0; y < side; ++y)
+			for (UINT x = 0; x < side; ++x)
+			{
+				const UINT a = first + y * (side + 1) + x, b = a + 1, c = a + side + 1, d = c + 1;
+				indices.insert(indices.end(), { a, c, b, b, c, d });
+			}
+		uint32_t state = seed;
+		for (size_t t = indices.size() / 3; t > 1; --t)
+		{
+			state = state * 1664525u + 1013904223u;
+			const size_t other = (state >> 8) % t;
+			for (int c = 0; c < 3; ++c)
+				std::swap(indices[(t - 1) * 3 + c], indices[other * 3 + c]);
+		}
+		mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+	}
+
+	// Triangles by corner positions, each rotated to start at its smallest corner so the winding stays visible
+	std::vector<std::vector<float>> Triangles(const dxh::Mesh& mesh)
+	{
+		std::vector<std::vector<float>> triangles;
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+		{
+			std::vector<float> corners[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				const dxh::float3& p = mesh.vertices[mesh.indices[t + c]].pos;
+				corners[c] = { p.x, p.y, p.z };
+			}
+			const int first = static_cast<int>(std::min_element(corners, corners + 3) - corners);
+			std::vector<float> triangle;
+			for (int c = 0; c < 3; ++c)
+				triangle.insert(triangle.end(), corners[(first + c) % 3].begin(), corners[(first + c) % 3].end());
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+TEST(VertexCacheStatsOfKnownOrders)
+{
+	// Every corner of a lone triangle misses
+	dxh::CacheStats stats = dxh::AnalyzeVertexCache({ 0, 1, 2 }, 3);
+	CHECK_NEAR(stats.acmr, 3.0f, 1e-6f);
+	CHECK_NEAR(stats.atvr, 1.0f, 1e-6f);
+	// A strip of quads reuses two corners per triangle
+	stats = dxh::AnalyzeVertexCache({ 0, 1, 2, 2, 1, 3, 2, 3, 4, 4, 3, 5 }, 6);
+	CHECK_NEAR(stats.acmr, 1.5f, 1e-6f);
+	CHECK_NEAR(stats.atvr, 1.0f, 1e-6f);
+}
+
+TEST(OptimizeMeshImprovesACMR)
+{
+	dxh::Mesh mesh;
+	AddGrid(mesh, 64, 0.0f, 1u);
+	const std::vector<std::vector<float>> before = Triangles(mesh);
+	const size_t vertexCount = mesh.vertices.size();
+
+	const dxh::MeshOptimizeStats stats = dxh::OptimizeMesh(mesh);
+	CHECK(stats.before.acmr > 2.0f); // random order misses almost every corner
+	CHECK(stats.after.acmr < 0.8f);
+	CHECK(stats.after.atvr < 1.5f);
+	CHECK(stats.after.acmr == dxh::AnalyzeVertexCache(mesh.indices, mesh.vertices.size()).acmr);
+	CHECK(stats.shortIndices);
+	CHECK(stats.indexBytesAfter * 2 == stats.indexBytesBefore);
+
+	// Same triangles with the same winding, the vertices are reordered but none is lost
+	CHECK(mesh.vertices.size() == vertexCount);
+	CHECK(Triangles(mesh) == before);
+	// Vertex fetch order: each vertex is first used after all the ones before it
+	UINT highest = 0;
+	bool ordered = mesh.indices[0] == 0;
+	for (UINT i : mesh.indices)
+	{
+		ordered = ordered && i <= highest + 1;
+		highest = std::max(highest, i);
+	}
+	CHECK(ordered);
+}
+
+TEST(OptimizeVertexCacheRestartsOnEveryIsland)
+{
+	// Separate grids: the cache runs dry at the end of every island and the next start is picked by score
+	dxh::Mesh islands;
+	for (UINT i = 0; i < 12; ++i)
+		AddGrid(islands, 6 + i % 3, 20.0f * i, 100u + i);
+	const std::vector<std::vector<float>> before = Triangles(islands);
+	const float acmrBefore = dxh::AnalyzeVertexCache(islands.indices, islands.vertices.size()).acmr;
+
+	dxh::OptimizeVertexCache(islands.indices, islands.vertices.size());
+	CHECK(Triangles(islands) == before);
+	const float acmrAfter = dxh::AnalyzeVertexCache(islands.indices, islands.vertices.size()).acmr;
+	CHECK(acmrAfter < acmrBefore * 0.5f);
+	CHECK(acmrAfter < 1.0f);
+}
+
+TEST(PackIndices16KeepsValues)
+{
+	std::vector<uint16_t> packed;
+	dxh::PackIndices16({ 0, 1, 65535, 42 }, packed);
+	CHECK(packed.size() == 4);
+	CHECK(packed[0] == 0 && packed[1] == 1 && packed[2] == 65535 && packed[3] == 42);
+}
@@ -0,0 +1,82 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "MeshSimplifier.h"
+
+namespace
+{
+	// Unit sphere with one vertex per pole, the first and last column share positions but not uvs
+	dxh::Mesh Sphere(UINT slices, UINT stacks)
+	{
+		dxh::Mesh sphere;
+		sphere.vertices.push_back(dxh::Vertex(dxh::float3(0.0f, 1.0f, 0.0f), dxh::float3(0.0f, 1.0f, 0.0f), dxh::float2(0.5f, 0.0f)));
+		for (UINT s = 1; s < stacks; ++s)
+		{
+			const float theta = PI * s / stacks;
+			for (UINT i = 0; i <= slices; ++i)
+			{
+				const float phi = 2.0f * PI * (i % slices) / slices;
+				const dxh::float3 p(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				sphere.vertices.push_back(dxh::Vertex(p, p, dxh::float2(float(i) / slices, float(s) / stacks)));
+			}
+		}
+		sphere.vertices.push_back(dxh::Vertex(dxh::float3(0.0f, -1.0f, 0.0f), dxh::float3(0.0f, -1.0f, 0.0f), dxh::float2(0.5f, 1.0f)));
+		const UINT south = static_cast<UINT>(sphere.vertices.size() - 1);
+		auto index = [&](UINT s, UINT i) { return s == 0 ? 0 : s == stacks ? south : 1 + (s - 1) * (slices + 1) + i; };
+		for (UINT s = 0; s < stacks; ++s)
+			for (UINT i = 0; i < slices; ++i)
+			{
+				if (s > 0)
+					sphere.indices.insert(sphere.indices.end(), { index(s, i), index(s, i + 1), index(s + 1, i) });
+				if (s + 1 < stacks)
+					sphere.indices.insert(sphere.indices.end(), { index(s, i + 1), index(s + 1, i + 1), index(s + 1, i) });
+			}
+		sphere.UpdateBounds();
+		return sphere;
+	}
+}
+
+TEST(LODErrorGrowsWithEveryLevel)
+{
+	const dxh::Mesh sphere = Sphere(48, 24);
+	dxh::LODChain chain;
+	dxh::BuildLODChain(sphere, dxh::DefaultLODRatios(), chain);
+	CHECK(chain.levels.size() > 2);
+	if (chain.levels.empty())
+		return;
+	CHECK(chain.levels[0].error == 0.0f);
+	CHECK(chain.levels[0].mesh.indices.size() == sphere.indices.size());
+	for (size_t i = 1; i < chain.levels.size(); ++i)
+	{
+		CHECK(chain.levels[i].error >= chain.levels[i - 1].error);
+		CHECK(chain.levels[i].mesh.indices.size() < chain.levels[i - 1].mesh.indices.size());
+		CHECK(chain.levels[i].ratio < chain.levels[i - 1].ratio);
+	}
+}
+
+TEST(SelectLODCoarsensWithDistance)
+{
+	dxh::LODChain chain;
+	dxh::BuildLODChain(Sphere(48, 24), dxh::DefaultLODRatios(), chain);
+	CHECK(dxh::SelectLOD(chain, 1e9f) == 0);
+	CHECK(dxh::SelectLOD(chain, 1e-9f) == chain.levels.size() - 1);
+	size_t previous = 0;
+	for (float pixelsPerUnit = 4096.0f; pixelsPerUnit > 0.01f; pixelsPerUnit *= 0.5f)
+	{
+		const size_t level = dxh::SelectLOD(chain, pixelsPerUnit);
+		CHECK(level >= previous);
+		// Whatever it picks stays within a pixel
+		CHECK(chain.levels[level].error * pixelsPerUnit <= 1.0f || level == 0);
+		previous = level;
+	}
+}
+
+TEST(LODBenchmarkRuns)
+{
+	const dxh::LODBenchmark result = dxh::BenchmarkLODs(2048, 64);
+	CHECK(result.levels > 2);
+	CHECK(result.errors.size() == result.levels);
+	for (size_t i = 1; i < result.errors.size(); ++i)
+		CHECK(result.errors[i] >= result.errors[i - 1]);
+	CHECK(result.selectedVertices < result.fullVertices);
+}
@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "MeshSoA.h"
+
+namespace
+{
+	dxh::Mesh Scattered(size_t count)
+	{
+		dxh::Mesh mesh;
+		uint32_t state = 99u;
+		auto next = [&state]() { state = state * 1664525u + 1013904223u; return (state >> 8) * (1.0f / 16777216.0f) * 8.0f - 4.0f; };
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float x = next(), y = next(), z = next();
+			mesh.vertices.push_back(dxh::Vertex(dxh::float3(x, y, z), dxh::float3(next(), next(), next()), dxh::float2(next(), next())));
+		}
+		return mesh;
+	}
+}
+
+TEST(MeshSoARoundTrips)
+{
+	// Not a multiple of 8, so the SIMD passes have a tail
+	const dxh::Mesh mesh = Scattered(1003);
+	const dxh::MeshSoA soa(mesh);
+	CHECK(soa.VertexCount() == mesh.vertices.size());
+	CHECK(soa.ByteWidth() == mesh.ByteWidth());
+	dxh::Mesh back;
+	soa.ToMesh(back);
+	CHECK(back.vertices.size() == mesh.vertices.size());
+	CHECK(std::memcmp(back.vertices.data(), mesh.vertices.data(), mesh.ByteWidth()) == 0);
+}
+
+TEST(MeshSoAMatchesAoS)
+{
+	const dxh::Mesh mesh = Scattered(1003);
+	dxh::MeshSoA soa(mesh);
+
+	dxh::float3 aosMin, aosMax, soaMin, soaMax;
+	dxh::ComputeBounds(mesh, aosMin, aosMax);
+	dxh::ComputeBounds(soa, soaMin, soaMax);
+	CHECK(aosMin.x == soaMin.x && aosMin.y == soaMin.y && aosMin.z == soaMin.z);
+	CHECK(aosMax.x == soaMax.x && aosMax.y == soaMax.y && aosMax.z == soaMax.z);
+
+	const DirectX::XMFLOAT4X4 m(
+		0.0f, -2.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 0.0f, 2.0f,
+		0.0f, 0.0f, 3.0f, -1.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+	std::vector<dxh::float3> aos(mesh.vertices.size());
+	dxh::TransformPositions(mesh, m, aos.data());
+	// In place, the outputs alias the positions
+	dxh::TransformPositions(soa, m, soa.pos[0].data(), soa.pos[1].data(), soa.pos[2].data());
+	bool same = true;
+	for (size_t i = 0; i < aos.size(); ++i)
+		same = same && std::abs(aos[i].x - soa.pos[0][i]) < 1e-5f && std::abs(aos[i].y - soa.pos[1][i]) < 1e-5f && std::abs(aos[i].z - soa.pos[2][i]) < 1e-5f;
+	CHECK(same);
+}
+
+BENCHMARK(MeshLayouts)
+{
+	const dxh::MeshLayoutTimings t = dxh::BenchmarkMeshLayouts();
+	std::cout << t.vertices << " vertices (ms), transform AoS " << t.aosTransform << " SoA " << t.soaTransform
+		<< ", bounds AoS " << t.aosBounds << " SoA " << t.soaBounds << ", to SoA " << t.toSoA << ", to AoS " << t.toAoS << "\n";
+	CHECK(t.vertices == 1 << 20);
+}
@@ -0,0 +1,50 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "MeshWeld.h"
+
+namespace
+{
+	dxh::Vertex MakeVertex(float x, float y)
+	{
+		return dxh::Vertex(dxh::float3(x, y, 0.0f), dxh::float3(0.0f, 0.0f, -1.0f), dxh::float2(x, y));
+	}
+}
+
+TEST(WeldSharesEqualVertices)
+{
+	// Two triangles of a quad, the diagonal's corners appear twice
+	const std::vector<dxh::Vertex> soup = {
+		MakeVertex(0, 0), MakeVertex(0, 1), MakeVertex(1, 1),
+		MakeVertex(0, 0), MakeVertex(1, 1), MakeVertex(1, 0) };
+	dxh::Mesh mesh;
+	const dxh::WeldStats stats = dxh::WeldVertices(soup, mesh);
+	CHECK(stats.verticesIn == 6);
+	CHECK(mesh.vertices.size() == 4);
+	CHECK(mesh.indices.size() == 6);
+	for (size_t i = 0; i < soup.size(); ++i)
+		CHECK(mesh.vertices[mesh.indices[i]] == soup[i]);
+}
+
+TEST(WeldDropsPartialTriangle)
+{
+	// The two trailing vertices are no triangle, nothing may refer to them and they must not be kept
+	const std::vector<dxh::Vertex> soup = {
+		MakeVertex(0, 0), MakeVertex(0, 1), MakeVertex(1, 1),
+		MakeVertex(5, 5), MakeVertex(6, 6) };
+	for (UINT threads : { 1u, 4u })
+	{
+		dxh::Mesh mesh;
+		dxh::WeldVertices(soup, mesh, 0.0f, threads);
+		CHECK(mesh.indices.size() == 3);
+		CHECK(mesh.vertices.size() == 3);
+		std::vector<bool> used(mesh.vertices.size(), false);
+		for (UINT i : mesh.indices)
+		{
+			CHECK(i < mesh.vertices.size());
+			if (i < used.size())
+				used[i] = true;
+		}
+		CHECK(std::find(used.begin(), used.end(), false) == used.end());
+	}
+}
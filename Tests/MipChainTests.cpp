@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "MipChain.h"
+
+TEST(MipLevelCounts)
+{
+	CHECK(dxh::MipLevelCount(1, 1) == 1);
+	CHECK(dxh::MipLevelCount(2, 2) == 2);
+	CHECK(dxh::MipLevelCount(256, 256) == 9);
+	CHECK(dxh::MipLevelCount(640, 480) == 10);
+	CHECK(dxh::MipLevelCount(1, 300) == 9);
+
+	// D3D sizes: halved and rounded down, never below 1
+	dxh::ImageData image(7, 5, 4);
+	image.data.assign(7 * 5 * 4, 128);
+	dxh::MipChain chain;
+	CHECK(dxh::GenerateMipChain(image, chain));
+	CHECK(chain.LevelCount() == dxh::MipLevelCount(7, 5));
+	if (chain.LevelCount() != 3)
+		return;
+	CHECK(chain.levels[1].width == 3 && chain.levels[1].height == 2);
+	CHECK(chain.levels[2].width == 1 && chain.levels[2].height == 1);
+	CHECK(chain.levels[1].pitch == 3 * 4);
+	// Every level starts 16 byte aligned for the SIMD filter
+	for (const dxh::MipLevel& level : chain.levels)
+		CHECK(level.offset % 16 == 0);
+	CHECK(chain.levels[2].offset + 4 <= chain.data.size());
+}
+
+TEST(MipChainAveragesSrgbInLinearLight)
+{
+	// Black and white checker: half of linear 1.0 is sRGB 188, not the 128 of averaging the encoded bytes
+	dxh::ImageData image(2, 2, 4);
+	image.data = { 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0 };
+	dxh::MipChain srgb, plain;
+	CHECK(dxh::GenerateMipChain(image, srgb, true, 1));
+	CHECK(dxh::GenerateMipChain(image, plain, false, 1));
+	CHECK(srgb.LevelCount() == 2 && plain.LevelCount() == 2);
+	if (srgb.LevelCount() != 2 || plain.LevelCount() != 2)
+		return;
+	const unsigned char* s = srgb.LevelData(1);
+	const unsigned char* p = plain.LevelData(1);
+	for (int c = 0; c < 3; ++c)
+	{
+		CHECK(s[c] == 188);
+		CHECK(p[c] == 127 || p[c] == 128);
+	}
+	// Alpha is never sRGB
+	CHECK(s[3] == 127 || s[3] == 128);
+	CHECK(s[3] == p[3]);
+	// Level 0 is the source as is
+	CHECK(std::memcmp(srgb.LevelData(0), image.data.data(), image.data.size()) == 0);
+}
+
+TEST(MipChainIsTheSameOnAnyThreadCount)
+{
+	dxh::ImageData image(300, 200, 4);
+	image.data.resize(size_t(300) * 200 * 4);
+	for (size_t i = 0; i < image.data.size(); ++i)
+		image.data[i] = static_cast<unsigned char>(i * 7 + i / 1200);
+	dxh::MipChain serial, threaded;
+	CHECK(dxh::GenerateMipChain(image, serial, true, 1));
+	CHECK(dxh::GenerateMipChain(image, threaded, true, 4));
+	CHECK(serial.data.size() == threaded.data.size());
+	CHECK(std::equal(serial.data.begin(), serial.data.end(), threaded.data.begin()));
+}
+
+BENCHMARK(MipChainGeneration)
+{
+	const dxh::MipChainTimings t = dxh::BenchmarkMipChain();
+	std::cout << t.size << "x" << t.size << ", " << t.levels << " levels (ms): scalar " << t.scalar << ", SIMD " << t.simd
+		<< ", SIMD threaded " << t.simdParallel << " (" << t.megapixelsPerSecond << " MP/s)\n";
+	CHECK(t.levels == dxh::MipLevelCount(t.size, t.size));
+}
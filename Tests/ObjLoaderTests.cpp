@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "ObjLoader.h"
+#include "SoftwareRasterizer.h"
+#include "VertexTransform.h"
+
+namespace
+{
+	// Quad two units in front of a right handed camera at the origin looking down -z,
+	// counter clockwise as seen from the camera like every OBJ front face
+	const char QUAD_OBJ[] =
+		"v -1 -1 -2\n"
+		"v 1 -1 -2\n"
+		"v 1 1 -2\n"
+		"v -1 1 -2\n"
+		"f 1 2 3\n"
+		"f 1 3 4\n";
+
+	DirectX::XMFLOAT4X4 Identity()
+	{
+		return DirectX::XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	// Left handed camera at the origin looking down +z (where the mirrored quad ends up), 90 degree
+	// field of view, stored transposed like DXHandler uploads it
+	dxh::WVP Camera()
+	{
+		const float nearZ = 0.1f, farZ = 100.0f;
+		dxh::WVP wvp;
+		wvp.world = Identity();
+		wvp.view = Identity();
+		wvp.project = DirectX::XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, farZ / (farZ - nearZ), -nearZ * farZ / (farZ - nearZ),
+			0.0f, 0.0f, 1.0f, 0.0f);
+		dxh::UpdateObjectMatrices(wvp);
+		return wvp;
+	}
+}
+
+TEST(ObjImportKeepsFrontFacesClockwise)
+{
+	ObjLoader loader(1);
+	dxh::Mesh mesh;
+	CHECK(loader.MeshFromMemory(mesh, QUAD_OBJ, sizeof(QUAD_OBJ) - 1, "quad"));
+	CHECK(mesh.indices.size() == 6);
+	if (mesh.indices.size() != 6)
+		return;
+
+	// D3D culls back faces with FrontCounterClockwise = false, a front face has to be clockwise on screen
+	const dxh::WVP wvp = Camera();
+	for (size_t t = 0; t < mesh.indices.size(); t += 3)
+	{
+		float x[3], y[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			dxh::TransformedVertex v;
+			dxh::TransformVertex(wvp, mesh.vertices[mesh.indices[t + k]], v);
+			CHECK(v.vpos[3] > 0.0f);
+			x[k] = v.vpos[0] / v.vpos[3], y[k] = v.vpos[1] / v.vpos[3];
+		}
+		// y points up in clip space, so clockwise on screen is a negative signed area
+		const float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+		CHECK(area < 0.0f);
+	}
+	// The flat normals still face the camera
+	for (const dxh::Vertex& v : mesh.vertices)
+		CHECK_NEAR(v.normal.z, -1.0f, 1e-6);
+
+	// And the software backend, which culls like the D3D rasterizer state, draws both triangles
+	dxh::SoftwareRasterizer raster(64, 64, 1);
+	const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	raster.Clear(black);
+	dxh::ImageData texture(1, 1, 4);
+	texture.data.assign(4, 255);
+	raster.Render(mesh, wvp, dxh::SimpleLight(), dxh::SimpleMaterial(), texture);
+	CHECK(raster.GetStats().trianglesIn == 2);
+	CHECK(raster.GetStats().trianglesDrawn == 2);
+}
+
+TEST(ObjImportRightHandedKeepsWinding)
+{
+	ObjLoader loader(1);
+	loader.leftHanded = false;
+	dxh::Mesh mesh;
+	CHECK(loader.MeshFromMemory(mesh, QUAD_OBJ, sizeof(QUAD_OBJ) - 1, "quad"));
+	CHECK(mesh.indices.size() == 6);
+	// Corners in file order, the first triangle is v1 v2 v3
+	if (mesh.indices.size() == 6)
+	{
+		CHECK(mesh.vertices[mesh.indices[1]].pos == dxh::float3(1.0f, -1.0f, -2.0f));
+		CHECK(mesh.vertices[mesh.indices[2]].pos == dxh::float3(1.0f, 1.0f, -2.0f));
+	}
+}
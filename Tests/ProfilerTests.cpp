@@ -0,0 +1,76 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "Profiler.h"
+
+namespace
+{
+	// Zones on a fresh thread, so its buffer holds nothing the other tests left behind
+	void RecordOnNewThread(size_t zones, const char* last)
+	{
+		std::thread([zones, last]()
+		{
+			for (size_t i = 0; i + 1 < zones; ++i)
+				util::ProfileZone zone("Filler");
+			util::ProfileZone zone(last);
+		}).join();
+	}
+}
+
+TEST(ProfilerRecordsNothingWhileDisabled)
+{
+	util::Profiler& profiler = util::Profiler::Get();
+	profiler.SetEnabled(false);
+	profiler.Clear();
+	RecordOnNewThread(100, "Disabled");
+	profiler.FrameMark();
+	profiler.FrameMark();
+	CHECK(profiler.EventCount() == 0);
+	CHECK(profiler.GetFrameStats().frames == 0);
+}
+
+TEST(ProfilerKeepsTheNewestEvents)
+{
+	util::Profiler& profiler = util::Profiler::Get();
+	profiler.SetEnabled(true);
+	profiler.Clear();
+	const size_t capacity = util::profiler::ThreadBuffer::CAPACITY;
+	RecordOnNewThread(capacity + 10, "Newest");
+	CHECK(profiler.EventCount() == capacity);
+	CHECK(profiler.DroppedEvents() == 10);
+
+	// The ring overwrote the oldest zones, the last one is still there
+	bool newest = false;
+	for (const util::ZoneSummary& zone : profiler.SummarizeZones())
+		newest = newest || std::string(zone.name) == "Newest";
+	CHECK(newest);
+
+	const std::string path = "profiler_test.json";
+	CHECK(profiler.WriteChromeTrace(path));
+	std::ifstream file(path);
+	std::string head(128, '\0');
+	file.read(&head[0], head.size());
+	CHECK(head.find("\"droppedEvents\":\"10\"") != std::string::npos);
+	file.close();
+	std::remove(path.c_str());
+	profiler.SetEnabled(false);
+	profiler.Clear();
+}
+
+TEST(ProfilerFramePercentiles)
+{
+	util::Profiler& profiler = util::Profiler::Get();
+	profiler.SetEnabled(true);
+	profiler.Clear();
+	for (int i = 0; i < 5; ++i)
+	{
+		profiler.FrameMark();
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	const util::FrameStats stats = profiler.GetFrameStats();
+	CHECK(stats.frames == 4);
+	CHECK(stats.p50 >= 1.5f);
+	CHECK(stats.p50 <= stats.p95 && stats.p95 <= stats.p99 && stats.p99 <= stats.max);
+	profiler.SetEnabled(false);
+	profiler.Clear();
+}
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "StateCache.h"
+
+namespace
+{
+	dxh::StateBinding Object(size_t id)
+	{
+		return dxh::StateBinding(reinterpret_cast<const void*>(id));
+	}
+}
+
+TEST(StateCacheElidesBoundSlots)
+{
+	dxh::RecordingPipelineBackend backend;
+	dxh::StateCache cache(backend);
+	dxh::StateBlock block;
+	for (UINT slot = 0; slot < 4; ++slot)
+		block.Set(dxh::StateKind::PSResource, slot, Object(slot + 1));
+	cache.Apply(block);
+	CHECK(backend.calls.size() == 1);
+	CHECK(backend.calls.back().count == 4);
+
+	cache.Apply(block);
+	CHECK(backend.calls.size() == 1);
+	CHECK(cache.GetStats().elided == 4);
+}
+
+TEST(StateCachePassesHighSlotsThrough)
+{
+	dxh::RecordingPipelineBackend backend;
+	dxh::StateCache cache(backend);
+	const UINT high = dxh::StateCache::MAX_SLOTS + 4;
+	cache.Set(dxh::StateKind::PSResource, high, Object(1));
+	cache.Set(dxh::StateKind::PSResource, high, Object(1));
+	// Not tracked, so both are bound
+	CHECK(backend.calls.size() == 2);
+	CHECK(backend.calls.back().firstSlot == high);
+
+	// A run across the last cached slot is split, no call is longer than MAX_SLOTS
+	backend.calls.clear();
+	dxh::StateBlock block;
+	for (UINT slot = 0; slot < dxh::StateCache::MAX_SLOTS + 8; ++slot)
+		block.Set(dxh::StateKind::PSSampler, slot, Object(slot + 1));
+	cache.Apply(block);
+	UINT bound = 0;
+	for (const dxh::RecordingPipelineBackend::Call& call : backend.calls)
+	{
+		CHECK(call.count <= dxh::StateCache::MAX_SLOTS);
+		CHECK(call.firstSlot == bound);
+		bound += call.count;
+	}
+	CHECK(bound == dxh::StateCache::MAX_SLOTS + 8);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "pch.h"
+
+//Minimal test registry for the Tests project, every TEST registers itself before main runs.
+//CHECK reports the failed condition and keeps going, so one run shows every broken invariant.
+//BENCHMARK registers a measurement at full size, those only run with --bench and print their numbers.
+namespace test
+{
+	typedef void(*TestFunc)();
+
+	struct TestCase
+	{
+		const char* name;
+		TestFunc func;
+	};
+
+	inline std::vector<TestCase>& Registry()
+	{
+		static std::vector<TestCase> tests;
+		return tests;
+	}
+
+	inline std::vector<TestCase>& Benchmarks()
+	{
+		static std::vector<TestCase> benchmarks;
+		return benchmarks;
+	}
+
+	inline int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	struct Registrar
+	{
+		Registrar(std::vector<TestCase>& registry, const char* name, TestFunc func) { registry.push_back({ name, func }); }
+	};
+
+	inline void Fail(const char* file, int line, const std::string& what)
+	{
+		Failures()++;
+		std::cerr << file << "(" << line << "): CHECK failed: " << what << "\n";
+	}
+}
+
+#define TEST(name) \
+	static void name(); \
+	static test::Registrar name##_registrar(test::Registry(), #name, name); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static test::Registrar name##_registrar(test::Benchmarks(), #name, name); \
+	static void name()
+
+#define CHECK(cond) \
+	do { if (!(cond)) test::Fail(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_NEAR(a, b, eps) \
+	do { \
+		const double check_a = (a), check_b = (b); \
+		if (!(std::abs(check_a - check_b) <= (eps))) \
+		{ \
+			std::ostringstream check_ss; \
+			check_ss << #a " = " << check_a << ", " #b " = " << check_b << ", eps " << (eps); \
+			test::Fail(__FILE__, __LINE__, check_ss.str()); \
+		} \
+	} while (0)
@@ -0,0 +1,24 @@
+#include "pch.h"
+#include "Test.h"
+
+//Runs every registered test, a name on the command line runs only the tests containing it.
+//--bench [name] runs the benchmarks instead, they are too slow for every build.
+//Returns the number of failed checks, so the build or CI sees a failure as a non zero exit code.
+int main(int argc, char** argv)
+{
+	const bool bench = argc > 1 && std::string(argv[1]) == "--bench";
+	const int first = bench ? 2 : 1;
+	const std::string filter = argc > first ? argv[first] : "";
+	int run = 0;
+	for (const test::TestCase& t : bench ? test::Benchmarks() : test::Registry())
+	{
+		if (!filter.empty() && std::string(t.name).find(filter) == std::string::npos)
+			continue;
+		const int before = test::Failures();
+		t.func();
+		run++;
+		std::cout << (test::Failures() == before ? "[ OK ] " : "[FAIL] ") << t.name << "\n";
+	}
+	std::cout << run << (bench ? " benchmarks, " : " tests, ") << test::Failures() << " failed checks\n";
+	return test::Failures();
+}
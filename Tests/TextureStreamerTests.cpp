@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "TextureStreamer.h"
+
+namespace
+{
+	// Records what the streamer hands over instead of creating textures
+	class RecordingSink : public dxh::TextureUploadSink
+	{
+	public:
+		std::vector<dxh::BlockFormat> formats;
+		std::vector<UINT> levels;
+		std::thread::id uploadThread;
+
+		bool CreatePlaceholder(dxh::TextureHandle, const dxh::ImageData&) override { return true; }
+		bool Upload(dxh::TextureHandle, const dxh::TextureData& texture) override
+		{
+			formats.push_back(texture.format);
+			levels.push_back(texture.LevelCount());
+			uploadThread = std::this_thread::get_id();
+			return true;
+		}
+	};
+
+	bool Checker(const std::string& filepath, dxh::ImageData& target)
+	{
+		const int size = std::stoi(filepath);
+		target = dxh::ImageData(size, size, 4);
+		target.data.resize(size_t(size) * size * 4);
+		for (size_t i = 0; i < target.data.size(); ++i)
+			target.data[i] = static_cast<unsigned char>((i / 4 + i / (size * 4)) % 2 ? 255 : 0);
+		return true;
+	}
+}
+
+TEST(StreamerUploadsPreparedTextures)
+{
+	RecordingSink sink;
+	dxh::TextureStreamer streamer(sink, Checker, 0, 8 << 20, dxh::BlockFormat::BC1);
+	const dxh::TextureHandle square = streamer.Request("64");
+	const dxh::TextureHandle odd = streamer.Request("6");
+	streamer.WaitForDecodes();
+	streamer.Update();
+
+	CHECK(streamer.GetState(square) == dxh::TextureState::Resident);
+	CHECK(streamer.GetState(odd) == dxh::TextureState::Resident);
+	CHECK(sink.uploadThread == std::this_thread::get_id());
+	CHECK(sink.formats.size() == 2);
+	if (sink.formats.size() != 2)
+		return;
+	// Mips and compression were done by the decode job, 6x6 is not whole blocks and stays rgba8
+	const size_t big = sink.levels[0] == 7 ? 0 : 1;
+	CHECK(sink.levels[big] == 7);
+	CHECK(sink.formats[big] == dxh::BlockFormat::BC1);
+	CHECK(sink.levels[1 - big] == 3);
+	CHECK(sink.formats[1 - big] == dxh::BlockFormat::None);
+}
+
+TEST(StreamerBudgetCountsCompressedBytes)
+{
+	RecordingSink sink;
+	// BC1 is 8 bytes per 4x4 block: 64x64 down to 1x1 is 2048 + 512 + 128 + 32 + 8 + 8 + 8 bytes
+	const size_t compressed = 2744;
+	dxh::TextureStreamer streamer(sink, Checker, 0, compressed * 2, dxh::BlockFormat::BC1);
+	for (int i = 0; i < 3; ++i)
+		streamer.Request("64");
+	streamer.WaitForDecodes();
+
+	CHECK(streamer.Update() == compressed * 2);
+	CHECK(sink.formats.size() == 2);
+	CHECK(streamer.Update() == compressed);
+	CHECK(streamer.GetStats().bytesUploaded == compressed * 3);
+	CHECK(streamer.Idle());
+}
@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "TransformSystem.h"
+
+namespace
+{
+	const float TRANSFORM_EPSILON = 1e-5f; //the kernels reorder a few multiplies and adds
+
+	struct Objects
+	{
+		std::vector<float> in[10];	//pos, rotation, scale
+
+		explicit Objects(size_t count)
+		{
+			// Fixed seed, the same objects every run. Quaternions are left off unit length on purpose.
+			uint32_t state = 777u;
+			auto next = [&state]() { state = state * 1664525u + 1013904223u; return (state >> 8) * (1.0f / 16777216.0f); };
+			for (int s = 0; s < 10; ++s)
+			{
+				in[s].resize(count);
+				for (float& v : in[s])
+					v = s < 7 ? next() * 4.0f - 2.0f : 0.25f + next() * 2.0f;
+			}
+		}
+
+		dxh::TransformStreams Streams() const
+		{
+			dxh::TransformStreams streams;
+			for (int c = 0; c < 3; ++c)
+			{
+				streams.pos[c] = in[c].data();
+				streams.scale[c] = in[7 + c].data();
+			}
+			for (int c = 0; c < 4; ++c)
+				streams.rotation[c] = in[3 + c].data();
+			streams.count = in[0].size();
+			return streams;
+		}
+	};
+}
+
+TEST(TransformComposeMatchesHandComputed)
+{
+	// 90 degrees around z, the quaternion twice as long as a unit one
+	const float h = std::sqrt(0.5f) * 2.0f;
+	const float pos[3] = { 5.0f, 6.0f, 7.0f }, rot[4] = { 0.0f, 0.0f, h, h }, scale[3] = { 2.0f, 3.0f, 4.0f };
+	dxh::TransformStreams streams;
+	for (int c = 0; c < 3; ++c)
+	{
+		streams.pos[c] = &pos[c];
+		streams.scale[c] = &scale[c];
+	}
+	for (int c = 0; c < 4; ++c)
+		streams.rotation[c] = &rot[c];
+	streams.count = 1;
+
+	util::aligned_vector<DirectX::XMFLOAT4X4, 16> world(1);
+	dxh::ComposeWorldsScalar(streams, world.data(), sizeof(DirectX::XMFLOAT4X4));
+	// translation * rotation * scale, transposed: x goes to y, y to -x
+	const float expected[16] = {
+		0.0f, -3.0f, 0.0f, 5.0f,
+		2.0f, 0.0f, 0.0f, 6.0f,
+		0.0f, 0.0f, 4.0f, 7.0f,
+		0.0f, 0.0f, 0.0f, 1.0f };
+	for (int i = 0; i < 16; ++i)
+		CHECK_NEAR((&world[0]._11)[i], expected[i], TRANSFORM_EPSILON);
+}
+
+TEST(TransformSimdMatchesScalar)
+{
+	// Counts around and between the 4 and 8 wide steps, so the scalar tails run too
+	const size_t counts[] = { 1, 3, 4, 5, 7, 8, 9, 15, 17, 31, 1021 };
+	// A tight matrix array, and matrices inside a larger element like InstanceData
+	const size_t strides[] = { 64, 80 };
+	for (size_t count : counts)
+		for (size_t stride : strides)
+		{
+			const Objects objects(count);
+			util::aligned_vector<float, 16> reference(count * stride / sizeof(float), -1.0f);
+			dxh::ComposeWorldsScalar(objects.Streams(), reference.data(), stride);
+			for (dxh::TransformKernel kernel : { dxh::TransformKernel::SSE, dxh::TransformKernel::AVX2 })
+			{
+				if (!dxh::TransformKernelSupported(kernel))
+					continue;
+				util::aligned_vector<float, 16> simd(reference.size(), -1.0f);
+				dxh::GetTransformFunc(kernel)(objects.Streams(), simd.data(), stride);
+				for (size_t i = 0; i < simd.size(); ++i)
+					CHECK_NEAR(simd[i], reference[i], TRANSFORM_EPSILON);
+			}
+		}
+}
+
+TEST(TransformBestKernelIsSupported)
+{
+	CHECK(dxh::TransformKernelSupported(dxh::TransformKernel::Scalar));
+	CHECK(dxh::TransformKernelSupported(dxh::BestTransformKernel()));
+	CHECK(dxh::GetTransformFunc(dxh::BestTransformKernel()) != nullptr);
+}
+
+TEST(TransformSystemThreadedMatchesSingle)
+{
+	// More than one GRAIN, so several jobs and a tail
+	dxh::TransformSystem system;
+	const size_t count = dxh::TransformSystem::GRAIN * 2 + 5;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float f = static_cast<float>(i);
+		system.Add(dxh::float3(f, -f, 0.5f * f), DirectX::XMFLOAT4(std::sin(f), 0.0f, 0.0f, std::cos(f)), dxh::float3(1.0f, 2.0f, 3.0f));
+	}
+	system.RotateAll(DirectX::XMFLOAT4(0.0f, std::sqrt(0.5f), 0.0f, std::sqrt(0.5f)));
+	system.Update(dxh::TransformKernel::Scalar, 1);
+	const std::vector<DirectX::XMFLOAT4X4> single(system.GetWorlds(), system.GetWorlds() + count);
+	system.Update(dxh::BestTransformKernel(), 0);
+	bool same = true;
+	for (size_t i = 0; i < count; ++i)
+		for (int j = 0; j < 16; ++j)
+			same = same && std::abs((&single[i]._11)[j] - (&system.GetWorlds()[i]._11)[j]) <= TRANSFORM_EPSILON * std::max(1.0f, std::abs((&single[i]._11)[j]));
+	CHECK(same);
+}
+
+BENCHMARK(TransformsMillion)
+{
+	const dxh::TransformBenchmark result = dxh::BenchmarkTransforms();
+	std::cout << result.objects << " transforms: scalar " << result.scalarMs << " ms, " << dxh::TransformKernelName(result.kernel)
+		<< " " << result.bestMs << " ms, " << result.threads << " threads " << result.threadedMs << " ms\n";
+	CHECK(result.objects == 1 << 20);
+	CHECK(result.bestMs > 0.0f && result.threadedMs > 0.0f);
+}
@@ -0,0 +1,84 @@
+#include "pch.h"
+#include "Test.h"
+
+#include "VertexTransform.h"
+
+namespace
+{
+	// Rotation of angle around z, then non-uniform scale, then a translation, transposed like DXHandler uploads it
+	DirectX::XMFLOAT4X4 RotatedScaled(float angle, float sx, float sy, float sz)
+	{
+		const float c = std::cos(angle), s = std::sin(angle);
+		return DirectX::XMFLOAT4X4(
+			c * sx, -s * sy, 0.0f, 4.0f,
+			s * sx, c * sy, 0.0f, -1.0f,
+			0.0f, 0.0f, sz, 2.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+TEST(NormalMatrixIsTheInverseTranspose)
+{
+	// (R * S)^-T = R^-T * S^-T = R * S^-1 for a rotation R and a scale S
+	const float angle = 0.5f, sx = 2.0f, sy = 0.5f, sz = 3.0f;
+	const DirectX::XMFLOAT4X4 normal = dxh::NormalMatrix(RotatedScaled(angle, sx, sy, sz));
+	const float c = std::cos(angle), s = std::sin(angle);
+	const float expected[3][3] = {
+		{ c / sx, -s / sy, 0.0f },
+		{ s / sx, c / sy, 0.0f },
+		{ 0.0f, 0.0f, 1.0f / sz } };
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 3; ++j)
+			CHECK_NEAR(normal.m[i][j], expected[i][j], 1e-5f);
+	// No translation, the last row and column are the identity's
+	CHECK(normal.m[0][3] == 0.0f && normal.m[1][3] == 0.0f && normal.m[2][3] == 0.0f);
+	CHECK(normal.m[3][0] == 0.0f && normal.m[3][1] == 0.0f && normal.m[3][2] == 0.0f && normal.m[3][3] == 1.0f);
+
+	// A sheared matrix too: the transpose of the normal matrix times the world matrix is the identity
+	const DirectX::XMFLOAT4X4 sheared(
+		1.5f, 0.7f, -0.2f, 1.0f,
+		0.3f, 0.8f, 0.4f, 2.0f,
+		-0.6f, 0.1f, 2.5f, 3.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+	const DirectX::XMFLOAT4X4 n = dxh::NormalMatrix(sheared);
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < 3; ++j)
+		{
+			float dot = 0.0f;
+			for (int k = 0; k < 3; ++k)
+				dot += n.m[k][i] * sheared.m[k][j];
+			CHECK_NEAR(dot, i == j ? 1.0f : 0.0f, 1e-5f);
+		}
+}
+
+TEST(TransformedNormalsStayPerpendicular)
+{
+	// A 45 degree slope in x and z, stretched along x and squashed along z: the world matrix alone would tilt its normal
+	dxh::WVP wvp;
+	wvp.world = RotatedScaled(0.3f, 4.0f, 1.0f, 0.25f);
+	wvp.view = wvp.project = DirectX::XMFLOAT4X4(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+	dxh::UpdateObjectMatrices(wvp);
+
+	dxh::Vertex a, b;
+	a.pos = dxh::float3(0.0f, 0.0f, 0.0f);
+	b.pos = dxh::float3(1.0f, 0.0f, 1.0f);
+	a.normal = dxh::float3(-std::sqrt(0.5f), 0.0f, std::sqrt(0.5f));
+	dxh::TransformedVertex ta, tb;
+	dxh::TransformVertex(wvp, a, ta);
+	dxh::TransformVertex(wvp, b, tb);
+	const float tangent[3] = { tb.pos[0] - ta.pos[0], tb.pos[1] - ta.pos[1], tb.pos[2] - ta.pos[2] };
+	CHECK_NEAR(tangent[0] * ta.normal[0] + tangent[1] * ta.normal[1] + tangent[2] * ta.normal[2], 0.0f, 1e-5f);
+}
+
+BENCHMARK(VertexTransformPrecomputedMatrices)
+{
+	const dxh::VertexTransformTimings t = dxh::BenchmarkVertexTransform();
+	std::cout << t.vertices << " vertices: per vertex matrices " << t.perVertexMs << " ms, precomputed " << t.precomputedMs
+		<< " ms, max clip error " << t.maxClipError << "\n";
+	CHECK(t.vertices == 1 << 20);
+	CHECK(t.maxClipError < 1e-3f);
+}